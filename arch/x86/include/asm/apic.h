@@ -0,0 +1,91 @@
+#ifndef _ASM_X86_APIC_H
+#define _ASM_X86_APIC_H
+
+/* Local APIC (xAPIC, memory mapped). */
+
+#define APIC_DEFAULT_PHYS_BASE	0xfee00000
+
+#define APIC_ID			0x020
+#define APIC_LVR		0x030
+#define APIC_TASKPRI		0x080
+#define APIC_EOI		0x0b0
+#define APIC_SPIV		0x0f0
+#define APIC_SPIV_APIC_ENABLED	(1 << 8)
+#define APIC_ESR		0x280
+#define APIC_ICR		0x300
+#define APIC_ICR2		0x310
+#define APIC_LVTT		0x320
+#define APIC_LVTPC		0x340
+#define APIC_LVT0		0x350
+#define APIC_LVT1		0x360
+#define APIC_LVTERR		0x370
+#define APIC_TMICT		0x380
+#define APIC_TMCCT		0x390
+#define APIC_TDCR		0x3e0
+
+/* LVT entries */
+#define APIC_LVT_MASKED		(1 << 16)
+#define APIC_LVT_TIMER_ONESHOT	(0 << 17)
+#define APIC_LVT_TIMER_PERIODIC	(1 << 17)
+#define APIC_LVT_TIMER_TSCDEADLINE (2 << 17)
+
+/* Delivery modes, shared by the LVT and the ICR */
+#define APIC_DM_FIXED		0x00000
+#define APIC_DM_NMI		0x00400
+#define APIC_DM_INIT		0x00500
+#define APIC_DM_STARTUP		0x00600
+#define APIC_DM_EXTINT		0x00700
+
+/* ICR */
+#define APIC_ICR_BUSY		(1 << 12)
+#define APIC_INT_ASSERT		(1 << 14)
+#define APIC_INT_LEVELTRIG	(1 << 15)
+#define APIC_DEST_SHIFT		24
+
+#define APIC_TDR_DIV_16		0x3
+
+#ifndef __ASSEMBLY__
+
+#include <zhos/percpu.h>
+#include <zhos/types.h>
+
+extern u8 *apic_mmio;
+extern u32 cpu_to_apicid[NR_CPUS];
+
+static inline u32 apic_read(u32 reg)
+{
+	return *(volatile u32 *)(apic_mmio + reg);
+}
+
+static inline void apic_write(u32 reg, u32 v)
+{
+	*(volatile u32 *)(apic_mmio + reg) = v;
+}
+
+static inline void apic_eoi(void)
+{
+	apic_write(APIC_EOI, 0);
+}
+
+static inline bool apic_available(void)
+{
+	return apic_mmio;
+}
+
+void register_lapic_address(phys_addr_t address);
+int apic_register_cpu(u32 apicid);
+void apic_bsp_init(void);
+void setup_local_APIC(void);
+
+void apic_icr_write(u32 low, u32 apicid);
+void apic_send_IPI(unsigned int cpu, unsigned int vector);
+
+bool apic_timer_init(void);
+bool apic_timer_available(void);
+void setup_secondary_APIC_clock(void);
+
+void acpi_boot_init(void);
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* _ASM_X86_APIC_H */
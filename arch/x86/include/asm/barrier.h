@@ -0,0 +1,18 @@
+#ifndef _ASM_X86_BARRIER_H
+#define _ASM_X86_BARRIER_H
+
+#include <zhos/compiler.h>
+
+/*
+ * x86 is TSO: loads are not reordered with loads, nor stores with stores,
+ * so between CPUs only a full barrier needs an instruction.  rmb() and
+ * wmb() also order against weakly ordered and uncached device accesses.
+ */
+#define mb()		__asm__ __volatile__("mfence" ::: "memory")
+#define rmb()		__asm__ __volatile__("lfence" ::: "memory")
+#define wmb()		__asm__ __volatile__("sfence" ::: "memory")
+#define smp_mb()	__asm__ __volatile__("lock; addl $0,-4(%%rsp)" ::: "memory", "cc")
+#define smp_rmb()	barrier()
+#define smp_wmb()	barrier()
+
+#endif /* _ASM_X86_BARRIER_H */
@@ -0,0 +1,46 @@
+#ifndef _ASM_X86_DESC_H
+#define _ASM_X86_DESC_H
+
+#include <zhos/types.h>
+#include <zhos/compiler.h>
+
+struct desc_ptr {
+	u16 size;
+	u64 address;
+} __packed;
+
+struct gate_desc {
+	u16 offset_low;
+	u16 segment;
+	u8 ist;
+	u8 type_attr;
+	u16 offset_mid;
+	u32 offset_high;
+	u32 reserved;
+} __packed;
+
+#define GATE_INTERRUPT		0x8e	/* present, DPL0, 64-bit interrupt gate */
+#define GATE_INTERRUPT_USER	0xee	/* same, callable from ring 3 */
+
+struct tss_struct {
+	u32 reserved0;
+	u64 rsp[3];
+	u64 reserved1;
+	u64 ist[7];
+	u64 reserved2;
+	u16 reserved3;
+	u16 io_bitmap_base;
+} __packed;
+
+/* IST slots (1-based in the gate descriptor). */
+#define IST_DOUBLE_FAULT	1
+#define IST_NMI			2
+#define N_EXCEPTION_STACKS	2
+#define EXCEPTION_STACK_SIZE	4096
+
+void gdt_init(unsigned int cpu);
+void idt_init(void);
+void idt_load(void);
+void idt_set_gate(unsigned int vector, void *handler, u8 type, u8 ist);
+
+#endif /* _ASM_X86_DESC_H */
@@ -0,0 +1,31 @@
+#ifndef _ASM_X86_E820_H
+#define _ASM_X86_E820_H
+
+#include <zhos/types.h>
+
+/* BIOS INT 15h/E820 memory types, as passed on by the multiboot loader. */
+#define E820_TYPE_RAM		1
+#define E820_TYPE_RESERVED	2
+#define E820_TYPE_ACPI		3
+#define E820_TYPE_NVS		4
+#define E820_TYPE_UNUSABLE	5
+
+#define E820_MAX_ENTRIES	128
+
+struct e820_entry {
+	u64 addr;
+	u64 size;
+	u32 type;
+};
+
+struct e820_table {
+	u32 nr_entries;
+	struct e820_entry entries[E820_MAX_ENTRIES];
+};
+
+extern struct e820_table e820_table;
+
+/* Build e820_table from the boot information and hand RAM to memblock. */
+void e820__memory_setup(void);
+
+#endif /* _ASM_X86_E820_H */
@@ -0,0 +1,39 @@
+#ifndef _ASM_X86_FPU_H
+#define _ASM_X86_FPU_H
+
+#include <zhos/types.h>
+
+struct task_struct;
+
+/*
+ * x87/SSE/AVX register state (arch/x86/kernel/fpu.c), saved and restored
+ * lazily: a task that never executes an FPU instruction never has any.
+ */
+struct fpu {
+	void *state;		/* XSAVE or FXSAVE area, from the first use */
+	unsigned int last_cpu;	/* whose registers were last loaded from it */
+	bool active;		/* registers are live, saved at switch out */
+};
+
+/* Per-CPU setup, on each CPU before anything runs there. */
+void fpu_init_cpu(void);
+/* Feature detection and the boot CPU; after kmem_cache_init(). */
+void fpu_init(void);
+
+/* Called by switch_to() for a task that used the FPU this time slice. */
+void fpu_switch_out(struct task_struct *prev);
+/* Device-not-available exception: the first FPU use since switch in. */
+void do_device_not_available(void);
+/* Called by free_task(). */
+void fpu_free(struct task_struct *p);
+
+/*
+ * Using SIMD registers in the kernel.  The code between the two runs with
+ * preemption disabled and must not sleep; in an interrupt, check
+ * irq_fpu_usable() first and fall back to integer code if it says no.
+ */
+bool irq_fpu_usable(void);
+void kernel_fpu_begin(void);
+void kernel_fpu_end(void);
+
+#endif /* _ASM_X86_FPU_H */
@@ -0,0 +1,13 @@
+#ifndef _ASM_X86_I8259_H
+#define _ASM_X86_I8259_H
+
+#define PIC_MASTER_CMD		0x20
+#define PIC_MASTER_IMR		0x21
+#define PIC_SLAVE_CMD		0xa0
+#define PIC_SLAVE_IMR		0xa1
+
+#define PIC_CASCADE_IR		2
+
+void init_i8259(void);
+
+#endif /* _ASM_X86_I8259_H */
@@ -0,0 +1,87 @@
+#ifndef _ASM_X86_IO_H
+#define _ASM_X86_IO_H
+
+#include <zhos/types.h>
+#include <asm/page.h>
+
+static inline void outb(u8 v, u16 port)
+{
+	__asm__ __volatile__("outb %0, %1" : : "a"(v), "Nd"(port));
+}
+
+static inline void outw(u16 v, u16 port)
+{
+	__asm__ __volatile__("outw %0, %1" : : "a"(v), "Nd"(port));
+}
+
+static inline void outl(u32 v, u16 port)
+{
+	__asm__ __volatile__("outl %0, %1" : : "a"(v), "Nd"(port));
+}
+
+static inline u8 inb(u16 port)
+{
+	u8 v;
+
+	__asm__ __volatile__("inb %1, %0" : "=a"(v) : "Nd"(port));
+	return v;
+}
+
+static inline u16 inw(u16 port)
+{
+	u16 v;
+
+	__asm__ __volatile__("inw %1, %0" : "=a"(v) : "Nd"(port));
+	return v;
+}
+
+static inline u32 inl(u16 port)
+{
+	u32 v;
+
+	__asm__ __volatile__("inl %1, %0" : "=a"(v) : "Nd"(port));
+	return v;
+}
+
+/* A write to the unused POST port takes roughly 1us on ISA timing. */
+static inline void io_delay(void)
+{
+	outb(0, 0x80);
+}
+
+static inline void outb_p(u8 v, u16 port)
+{
+	outb(v, port);
+	io_delay();
+}
+
+static inline u8 inb_p(u16 port)
+{
+	u8 v = inb(port);
+
+	io_delay();
+	return v;
+}
+
+static inline u32 readl(const volatile void *addr)
+{
+	return *(const volatile u32 *)addr;
+}
+
+static inline void writel(u32 v, volatile void *addr)
+{
+	*(volatile u32 *)addr = v;
+}
+
+/*
+ * Device memory below BOOT_IDENTITY_SIZE is already mapped by the
+ * identity map (the MTRRs keep it uncached); nothing above is reachable.
+ */
+static inline void *ioremap(phys_addr_t pa, unsigned long size)
+{
+	if (pa + size > BOOT_IDENTITY_SIZE)
+		return NULL;
+	return phys_to_virt(pa);
+}
+
+#endif /* _ASM_X86_IO_H */
@@ -0,0 +1,17 @@
+#ifndef _ASM_X86_IRQ_H
+#define _ASM_X86_IRQ_H
+
+#include <zhos/types.h>
+#include <asm/ptrace.h>
+#include <asm/irq_vectors.h>
+
+/* Handlers for vectors that are not legacy IRQs (local APIC, IPIs). */
+typedef void (*vector_handler_t)(struct pt_regs *regs);
+
+void set_vector_handler(unsigned int vector, vector_handler_t fn);
+
+void do_interrupt(struct pt_regs *regs);
+void do_trap(struct pt_regs *regs);
+void do_page_fault(struct pt_regs *regs);
+
+#endif /* _ASM_X86_IRQ_H */
@@ -0,0 +1,27 @@
+#ifndef _ASM_X86_IRQ_REGS_H
+#define _ASM_X86_IRQ_REGS_H
+
+#include <zhos/percpu.h>
+#include <asm/ptrace.h>
+
+/*
+ * The register frame of whatever the running interrupt interrupted, for
+ * handlers that want to know where the CPU was (the profiler).  NULL
+ * outside interrupts.
+ */
+DECLARE_PER_CPU(struct pt_regs *, irq_regs);
+
+static inline struct pt_regs *get_irq_regs(void)
+{
+	return this_cpu_read(irq_regs);
+}
+
+static inline struct pt_regs *set_irq_regs(struct pt_regs *new_regs)
+{
+	struct pt_regs *old_regs = this_cpu_read(irq_regs);
+
+	this_cpu_write(irq_regs, new_regs);
+	return old_regs;
+}
+
+#endif /* _ASM_X86_IRQ_REGS_H */
@@ -0,0 +1,27 @@
+#ifndef _ASM_X86_IRQ_VECTORS_H
+#define _ASM_X86_IRQ_VECTORS_H
+
+/*
+ * Vector allocation:
+ *   0x00-0x1f  CPU exceptions
+ *   0x20-0x2f  legacy ISA IRQs routed through the 8259 pair
+ *   0xef       software interrupt timed by kernel/bench.c
+ *   0xf0-0xff  local vectors (APIC timer, IPIs, counters, spurious)
+ */
+#define NR_VECTORS		256
+#define FIRST_EXTERNAL_VECTOR	0x20
+
+#define IRQ0_VECTOR		0x20
+#define NR_LEGACY_IRQS		16
+#define NR_IRQS			NR_LEGACY_IRQS
+
+#define BENCH_VECTOR		0xef
+
+#define LOCAL_TIMER_VECTOR	0xf0
+#define RESCHEDULE_VECTOR	0xf1
+#define CALL_FUNCTION_VECTOR	0xf2
+#define PERF_PMI_VECTOR		0xf3
+#define ERROR_APIC_VECTOR	0xfe
+#define SPURIOUS_APIC_VECTOR	0xff
+
+#endif /* _ASM_X86_IRQ_VECTORS_H */
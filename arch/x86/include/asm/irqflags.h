@@ -0,0 +1,56 @@
+#ifndef _ASM_X86_IRQFLAGS_H
+#define _ASM_X86_IRQFLAGS_H
+
+#include <zhos/types.h>
+
+#define X86_EFLAGS_IF	(1UL << 9)
+
+static inline unsigned long native_save_fl(void)
+{
+	unsigned long flags;
+
+	__asm__ __volatile__("pushfq; popq %0" : "=r"(flags) : : "memory");
+	return flags;
+}
+
+static inline void local_irq_disable(void)
+{
+	__asm__ __volatile__("cli" : : : "memory");
+}
+
+static inline void local_irq_enable(void)
+{
+	__asm__ __volatile__("sti" : : : "memory");
+}
+
+static inline unsigned long local_irq_save(void)
+{
+	unsigned long flags = native_save_fl();
+
+	local_irq_disable();
+	return flags;
+}
+
+static inline void local_irq_restore(unsigned long flags)
+{
+	if (flags & X86_EFLAGS_IF)
+		local_irq_enable();
+}
+
+static inline bool irqs_disabled(void)
+{
+	return !(native_save_fl() & X86_EFLAGS_IF);
+}
+
+/* sti only takes effect after the next instruction, so no wakeup is lost. */
+static inline void safe_halt(void)
+{
+	__asm__ __volatile__("sti; hlt" : : : "memory");
+}
+
+static inline void halt(void)
+{
+	__asm__ __volatile__("hlt" : : : "memory");
+}
+
+#endif /* _ASM_X86_IRQFLAGS_H */
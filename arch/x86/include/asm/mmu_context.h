@@ -0,0 +1,21 @@
+#ifndef _ASM_X86_MMU_CONTEXT_H
+#define _ASM_X86_MMU_CONTEXT_H
+
+#include <zhos/mm_types.h>
+
+extern u64 last_mm_ctx_id;
+
+static inline void init_new_context(struct mm_struct *mm)
+{
+	mm->ctx_id = __atomic_add_fetch(&last_mm_ctx_id, 1, __ATOMIC_RELAXED);
+	mm->tlb_gen = 0;
+}
+
+/*
+ * Load @next's page tables (arch/x86/mm/tlb.c).  With PCIDs, @prev's
+ * translations stay in the TLB, tagged, for when it comes back.
+ * Interrupts or preemption disabled.
+ */
+void switch_mm(struct mm_struct *prev, struct mm_struct *next);
+
+#endif /* _ASM_X86_MMU_CONTEXT_H */
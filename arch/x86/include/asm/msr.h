@@ -0,0 +1,49 @@
+#ifndef _ASM_X86_MSR_H
+#define _ASM_X86_MSR_H
+
+#define MSR_IA32_APICBASE	0x0000001b
+#define MSR_IA32_PMC0		0x000000c1
+#define MSR_IA32_PERFEVTSEL0	0x00000186
+#define MSR_IA32_PERF_GLOBAL_STATUS	0x0000038e
+#define MSR_IA32_PERF_GLOBAL_CTRL	0x0000038f
+#define MSR_IA32_PERF_GLOBAL_OVF_CTRL	0x00000390
+#define MSR_IA32_TSC_DEADLINE	0x000006e0
+#define MSR_EFER		0xc0000080
+#define MSR_STAR		0xc0000081
+#define MSR_LSTAR		0xc0000082
+#define MSR_SYSCALL_MASK	0xc0000084
+#define MSR_FS_BASE		0xc0000100
+#define MSR_GS_BASE		0xc0000101
+#define MSR_KERNEL_GS_BASE	0xc0000102
+
+#define MSR_IA32_APICBASE_BSP	(1 << 8)
+#define MSR_IA32_APICBASE_X2APIC (1 << 10)
+#define MSR_IA32_APICBASE_ENABLE (1 << 11)
+#define MSR_IA32_APICBASE_BASE	(~0xfffULL)
+
+#define EFER_SCE		(1 << 0)
+#define EFER_LME		(1 << 8)
+#define EFER_NX			(1 << 11)
+
+#ifndef __ASSEMBLY__
+
+#include <zhos/types.h>
+
+static inline u64 rdmsr(u32 msr)
+{
+	u32 lo, hi;
+
+	__asm__ __volatile__("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+	return ((u64)hi << 32) | lo;
+}
+
+static inline void wrmsr(u32 msr, u64 v)
+{
+	__asm__ __volatile__("wrmsr"
+			     : : "c"(msr), "a"((u32)v), "d"((u32)(v >> 32))
+			     : "memory");
+}
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* _ASM_X86_MSR_H */
@@ -0,0 +1,49 @@
+#ifndef _ASM_X86_PAGE_H
+#define _ASM_X86_PAGE_H
+
+#define PAGE_SHIFT		12
+#define PAGE_SIZE		(1UL << PAGE_SHIFT)
+#define PAGE_MASK		(~(PAGE_SIZE - 1))
+
+#define PMD_SHIFT		21
+#define PMD_SIZE		(1UL << PMD_SHIFT)
+
+/* The kernel image is linked at -2GiB and loaded at 1MiB physical. */
+#define __START_KERNEL_map	0xffffffff80000000
+#define KERNEL_LOAD_PHYS	0x100000
+
+/* Extent of the boot identity map built by header.S. */
+#define BOOT_IDENTITY_SIZE	0x100000000
+
+#ifndef __ASSEMBLY__
+
+#include <zhos/types.h>
+
+/* Kernel image symbols <-> physical. */
+#define __pa_symbol(x)	((phys_addr_t)(unsigned long)(x) - __START_KERNEL_map)
+
+/*
+ * Physical memory is identity mapped: below BOOT_IDENTITY_SIZE from boot,
+ * all RAM once init_mem_mapping() has run.
+ */
+static inline void *phys_to_virt(phys_addr_t pa)
+{
+	return (void *)(unsigned long)pa;
+}
+
+/* Either a kernel image address or one in the identity map. */
+static inline phys_addr_t virt_to_phys(const void *x)
+{
+	unsigned long va = (unsigned long)x;
+
+	if (va >= __START_KERNEL_map)
+		return va - __START_KERNEL_map;
+	return va;
+}
+
+#define __pa(x)		virt_to_phys(x)
+#define __va(pa)	phys_to_virt(pa)
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* _ASM_X86_PAGE_H */
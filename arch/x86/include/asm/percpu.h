@@ -0,0 +1,20 @@
+#ifndef _ASM_X86_PERCPU_H
+#define _ASM_X86_PERCPU_H
+
+/*
+ * The GS base of each CPU holds its __per_cpu_offset[], so %gs:var
+ * addresses the CPU's own copy of var in a single instruction.
+ */
+DECLARE_PER_CPU(unsigned long, this_cpu_off);
+
+static __always_inline unsigned long __my_cpu_offset(void)
+{
+	unsigned long off;
+
+	__asm__ __volatile__("movq %%gs:%1, %0" : "=r"(off) : "m"(this_cpu_off));
+	return off;
+}
+
+void load_percpu_segment(unsigned int cpu);
+
+#endif /* _ASM_X86_PERCPU_H */
@@ -0,0 +1,23 @@
+#ifndef _ASM_X86_PERF_EVENT_H
+#define _ASM_X86_PERF_EVENT_H
+
+#include <zhos/perf_event.h>
+#include <zhos/types.h>
+
+struct task_struct;
+
+/* A task's counters (arch/x86/kernel/perf_event.c); all zero: none. */
+struct perf_thread {
+	unsigned int events;		/* counted: 1 << PERF_COUNT_HW_* */
+	u64 count[PERF_COUNT_HW_MAX];	/* totals up to the last switch out */
+};
+
+/* Per-CPU setup, on each CPU after its local APIC. */
+void perf_init_cpu(void);
+/* Counter detection and the boot CPU; before the others are started. */
+void perf_init(void);
+
+/* Called by switch_to() when @prev or @next counts events. */
+void perf_switch(struct task_struct *prev, struct task_struct *next);
+
+#endif /* _ASM_X86_PERF_EVENT_H */
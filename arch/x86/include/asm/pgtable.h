@@ -0,0 +1,171 @@
+#ifndef _ASM_X86_PGTABLE_H
+#define _ASM_X86_PGTABLE_H
+
+#include <zhos/compiler.h>
+#include <zhos/types.h>
+#include <asm/page.h>
+
+/*
+ * Four-level page tables: PGD (PML4), PUD (PDPT), PMD (PD) and PTE
+ * tables of 512 entries each.  A PUD or PMD entry with _PAGE_PSE maps a
+ * 1 GiB or 2 MiB page itself.  Entries are single 64-bit words, read and
+ * written whole, so the hardware walker never sees a torn one.
+ */
+#define PGDIR_SHIFT		39
+#define PUD_SHIFT		30
+#define PTRS_PER_PGD		512
+#define PTRS_PER_PUD		512
+#define PTRS_PER_PMD		512
+#define PTRS_PER_PTE		512
+
+#define PGDIR_SIZE		(1UL << PGDIR_SHIFT)
+#define PUD_SIZE		(1UL << PUD_SHIFT)
+#define PUD_MASK		(~(PUD_SIZE - 1))
+#define PMD_MASK		(~(PMD_SIZE - 1))
+
+#define _PAGE_PRESENT		(1UL << 0)
+#define _PAGE_RW		(1UL << 1)
+#define _PAGE_USER		(1UL << 2)
+#define _PAGE_PWT		(1UL << 3)
+#define _PAGE_PCD		(1UL << 4)
+#define _PAGE_ACCESSED		(1UL << 5)
+#define _PAGE_DIRTY		(1UL << 6)
+#define _PAGE_PSE		(1UL << 7)
+#define _PAGE_GLOBAL		(1UL << 8)
+
+/* Demand-paged kernel regions (mm/mmap.c): one PGD slot, 512 GiB. */
+#define VMAP_START		0xffffc90000000000UL
+#define VMAP_END		(VMAP_START + PGDIR_SIZE)
+
+#define PTE_PFN_MASK		0x000ffffffffff000UL
+
+/*
+ * Intermediate tables are left writable and the leaf decides, except
+ * that a PMD entry without _PAGE_RW write-protects a whole PTE table
+ * shared after fork (mm/memory.c).
+ */
+#define _KERNPG_TABLE		(_PAGE_PRESENT | _PAGE_RW | \
+				 _PAGE_ACCESSED | _PAGE_DIRTY)
+#define PAGE_KERNEL		(_PAGE_PRESENT | _PAGE_RW | \
+				 _PAGE_ACCESSED | _PAGE_DIRTY)
+#define PAGE_KERNEL_LARGE	(PAGE_KERNEL | _PAGE_PSE)
+
+typedef struct { u64 pgd; } pgd_t;
+typedef struct { u64 pud; } pud_t;
+typedef struct { u64 pmd; } pmd_t;
+typedef struct { u64 pte; } pte_t;
+
+#define pgd_val(x)		((x).pgd)
+#define pud_val(x)		((x).pud)
+#define pmd_val(x)		((x).pmd)
+#define pte_val(x)		((x).pte)
+#define __pgd(x)		((pgd_t){ (x) })
+#define __pud(x)		((pud_t){ (x) })
+#define __pmd(x)		((pmd_t){ (x) })
+#define __pte(x)		((pte_t){ (x) })
+
+#define pgd_index(a)		(((a) >> PGDIR_SHIFT) & (PTRS_PER_PGD - 1))
+#define pud_index(a)		(((a) >> PUD_SHIFT) & (PTRS_PER_PUD - 1))
+#define pmd_index(a)		(((a) >> PMD_SHIFT) & (PTRS_PER_PMD - 1))
+#define pte_index(a)		(((a) >> PAGE_SHIFT) & (PTRS_PER_PTE - 1))
+
+static inline bool pgd_none(pgd_t pgd) { return !pgd_val(pgd); }
+static inline bool pud_none(pud_t pud) { return !pud_val(pud); }
+static inline bool pmd_none(pmd_t pmd) { return !pmd_val(pmd); }
+static inline bool pte_none(pte_t pte) { return !pte_val(pte); }
+
+static inline bool pud_large(pud_t pud) { return pud_val(pud) & _PAGE_PSE; }
+static inline bool pmd_large(pmd_t pmd) { return pmd_val(pmd) & _PAGE_PSE; }
+static inline bool pte_present(pte_t pte)
+{
+	return pte_val(pte) & _PAGE_PRESENT;
+}
+
+static inline bool pte_write(pte_t pte) { return pte_val(pte) & _PAGE_RW; }
+static inline bool pmd_write(pmd_t pmd) { return pmd_val(pmd) & _PAGE_RW; }
+
+static inline pte_t pte_wrprotect(pte_t pte)
+{
+	return __pte(pte_val(pte) & ~_PAGE_RW);
+}
+
+static inline pmd_t pmd_wrprotect(pmd_t pmd)
+{
+	return __pmd(pmd_val(pmd) & ~_PAGE_RW);
+}
+
+static inline pte_t pte_mkwrite(pte_t pte)
+{
+	return __pte(pte_val(pte) | _PAGE_RW);
+}
+
+static inline pmd_t pmd_mkwrite(pmd_t pmd)
+{
+	return __pmd(pmd_val(pmd) | _PAGE_RW);
+}
+
+static inline unsigned long pmd_pfn(pmd_t pmd)
+{
+	return (pmd_val(pmd) & PTE_PFN_MASK) >> PAGE_SHIFT;
+}
+
+static inline unsigned long pte_pfn(pte_t pte)
+{
+	return (pte_val(pte) & PTE_PFN_MASK) >> PAGE_SHIFT;
+}
+
+static inline pte_t pfn_pte(unsigned long pfn, u64 prot)
+{
+	return __pte(((u64)pfn << PAGE_SHIFT) | prot);
+}
+
+static inline pmd_t pfn_pmd(unsigned long pfn, u64 prot)
+{
+	return __pmd(((u64)pfn << PAGE_SHIFT) | prot);
+}
+
+/* The table an upper-level entry points to, through the identity map. */
+static inline pud_t *pgd_page_vaddr(pgd_t pgd)
+{
+	return phys_to_virt(pgd_val(pgd) & PTE_PFN_MASK);
+}
+
+static inline pmd_t *pud_page_vaddr(pud_t pud)
+{
+	return phys_to_virt(pud_val(pud) & PTE_PFN_MASK);
+}
+
+static inline pte_t *pmd_page_vaddr(pmd_t pmd)
+{
+	return phys_to_virt(pmd_val(pmd) & PTE_PFN_MASK);
+}
+
+static inline pud_t *pud_offset(pgd_t *pgd, unsigned long addr)
+{
+	return pgd_page_vaddr(*pgd) + pud_index(addr);
+}
+
+static inline pmd_t *pmd_offset(pud_t *pud, unsigned long addr)
+{
+	return pud_page_vaddr(*pud) + pmd_index(addr);
+}
+
+static inline pte_t *pte_offset_kernel(pmd_t *pmd, unsigned long addr)
+{
+	return pmd_page_vaddr(*pmd) + pte_index(addr);
+}
+
+#define set_pgd(p, v)		WRITE_ONCE(*(p), (v))
+#define set_pud(p, v)		WRITE_ONCE(*(p), (v))
+#define set_pmd(p, v)		WRITE_ONCE(*(p), (v))
+#define set_pte(p, v)		WRITE_ONCE(*(p), (v))
+#define pgd_clear(p)		set_pgd(p, __pgd(0))
+#define pmd_clear(p)		set_pmd(p, __pmd(0))
+#define pte_clear(p)		set_pte(p, __pte(0))
+
+/* The kernel's own page table, shared by every CPU. */
+extern pgd_t *swapper_pg_dir;
+
+void init_mem_mapping(void);
+
+#endif /* _ASM_X86_PGTABLE_H */
@@ -0,0 +1,40 @@
+#ifndef _ASM_X86_PREEMPT_H
+#define _ASM_X86_PREEMPT_H
+
+#include <zhos/percpu.h>
+
+/*
+ * The preempt count is per CPU and changed by single %gs-relative
+ * instructions, so an interrupt or a migration can never land between
+ * the read and the write.
+ */
+DECLARE_PER_CPU(int, __preempt_count);
+
+static __always_inline int preempt_count(void)
+{
+	return this_cpu_read(__preempt_count);
+}
+
+static __always_inline void __preempt_count_add(int val)
+{
+	__asm__ __volatile__("addl %1, %%gs:%0"
+			     : "+m"(__preempt_count) : "ri"(val) : "memory");
+}
+
+static __always_inline void __preempt_count_sub(int val)
+{
+	__asm__ __volatile__("subl %1, %%gs:%0"
+			     : "+m"(__preempt_count) : "ri"(val) : "memory");
+}
+
+/* Decrement; true if the count reached zero. */
+static __always_inline bool __preempt_count_dec_and_test(void)
+{
+	bool zero;
+
+	__asm__ __volatile__("decl %%gs:%0"
+			     : "+m"(__preempt_count), "=@ccz"(zero) : : "memory");
+	return zero;
+}
+
+#endif /* _ASM_X86_PREEMPT_H */
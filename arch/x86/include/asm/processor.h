@@ -0,0 +1,119 @@
+#ifndef _ASM_X86_PROCESSOR_H
+#define _ASM_X86_PROCESSOR_H
+
+#include <zhos/types.h>
+
+#define X86_CR0_PE	(1UL << 0)
+#define X86_CR0_MP	(1UL << 1)
+#define X86_CR0_EM	(1UL << 2)
+#define X86_CR0_TS	(1UL << 3)
+#define X86_CR0_NE	(1UL << 5)
+#define X86_CR0_WP	(1UL << 16)
+#define X86_CR0_PG	(1UL << 31)
+
+#define X86_CR4_PAE	(1UL << 5)
+#define X86_CR4_PGE	(1UL << 7)
+#define X86_CR4_OSFXSR	(1UL << 9)
+#define X86_CR4_OSXMMEXCPT (1UL << 10)
+#define X86_CR4_PCIDE	(1UL << 17)
+#define X86_CR4_OSXSAVE	(1UL << 18)
+
+static inline void cpuid_count(u32 leaf, u32 sub, u32 *a, u32 *b, u32 *c, u32 *d)
+{
+	__asm__ __volatile__("cpuid"
+			     : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d)
+			     : "a"(leaf), "c"(sub));
+}
+
+static inline void cpuid(u32 leaf, u32 *a, u32 *b, u32 *c, u32 *d)
+{
+	cpuid_count(leaf, 0, a, b, c, d);
+}
+
+static inline unsigned long read_cr0(void)
+{
+	unsigned long v;
+
+	__asm__ __volatile__("mov %%cr0, %0" : "=r"(v));
+	return v;
+}
+
+static inline void write_cr0(unsigned long v)
+{
+	__asm__ __volatile__("mov %0, %%cr0" : : "r"(v) : "memory");
+}
+
+static inline unsigned long read_cr2(void)
+{
+	unsigned long v;
+
+	__asm__ __volatile__("mov %%cr2, %0" : "=r"(v));
+	return v;
+}
+
+static inline unsigned long read_cr3(void)
+{
+	unsigned long v;
+
+	__asm__ __volatile__("mov %%cr3, %0" : "=r"(v));
+	return v;
+}
+
+static inline void write_cr3(unsigned long v)
+{
+	__asm__ __volatile__("mov %0, %%cr3" : : "r"(v) : "memory");
+}
+
+static inline unsigned long read_cr4(void)
+{
+	unsigned long v;
+
+	__asm__ __volatile__("mov %%cr4, %0" : "=r"(v));
+	return v;
+}
+
+static inline void write_cr4(unsigned long v)
+{
+	__asm__ __volatile__("mov %0, %%cr4" : : "r"(v) : "memory");
+}
+
+/* Clear and set CR0.TS: FPU instructions trap (#NM) while it is set. */
+static inline void clts(void)
+{
+	__asm__ __volatile__("clts" : : : "memory");
+}
+
+static inline void stts(void)
+{
+	write_cr0(read_cr0() | X86_CR0_TS);
+}
+
+static inline void xsetbv(u32 index, u64 value)
+{
+	__asm__ __volatile__("xsetbv"
+			     : : "c"(index), "a"((u32)value),
+				 "d"((u32)(value >> 32)));
+}
+
+static inline u64 xgetbv(u32 index)
+{
+	u32 lo, hi;
+
+	__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(index));
+	return lo | (u64)hi << 32;
+}
+
+/* cpuid serialises: code written before it is what runs after. */
+static inline void sync_core(void)
+{
+	u32 a, b, c, d;
+
+	cpuid(1, &a, &b, &c, &d);
+}
+
+static inline void cpu_relax(void)
+{
+	__asm__ __volatile__("pause" : : : "memory");
+}
+
+#endif /* _ASM_X86_PROCESSOR_H */
@@ -0,0 +1,23 @@
+#ifndef _ASM_X86_PTRACE_H
+#define _ASM_X86_PTRACE_H
+
+#include <zhos/types.h>
+
+/* Register frame built by entry_64.S; keep the two in sync. */
+struct pt_regs {
+	u64 r15, r14, r13, r12, rbp, rbx;
+	u64 r11, r10, r9, r8, rax, rcx, rdx, rsi, rdi;
+	u64 vector;
+	u64 error_code;
+	/* pushed by the CPU */
+	u64 rip, cs, rflags, rsp, ss;
+};
+
+static inline bool user_mode(const struct pt_regs *regs)
+{
+	return regs->cs & 3;
+}
+
+void show_regs(const struct pt_regs *regs);
+
+#endif /* _ASM_X86_PTRACE_H */
@@ -0,0 +1,8 @@
+#ifndef _ASM_X86_RTC_H
+#define _ASM_X86_RTC_H
+
+#include <zhos/types.h>
+
+u64 rtc_read_seconds(void);
+
+#endif /* _ASM_X86_RTC_H */
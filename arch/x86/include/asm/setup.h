@@ -0,0 +1,12 @@
+#ifndef _ASM_X86_SETUP_H
+#define _ASM_X86_SETUP_H
+
+#include <zhos/types.h>
+#include <zhos/multiboot.h>
+
+extern struct multiboot_info *boot_info;
+
+void setup_arch(u32 magic, u32 mbi_phys);
+void time_init(void);
+
+#endif /* _ASM_X86_SETUP_H */
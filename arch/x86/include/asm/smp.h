@@ -0,0 +1,34 @@
+#ifndef _ASM_X86_SMP_H
+#define _ASM_X86_SMP_H
+
+/*
+ * Secondary CPUs start in real mode at a page-aligned address below 1MiB,
+ * where the trampoline (trampoline_64.S) is copied before they start.
+ */
+#define TRAMPOLINE_PHYS		0x8000
+
+/* Each secondary CPU's boot and idle stack. */
+#define SECONDARY_STACK_SIZE	0x4000
+
+#ifndef __ASSEMBLY__
+
+#include <zhos/compiler.h>
+#include <zhos/types.h>
+
+/* Filled in by the boot CPU for all the CPUs being started. */
+struct trampoline_header {
+	u32 cr3;
+	u32 nr_cpus;		/* entries of apicids to search */
+	u64 entry;
+	u64 stacks;		/* NR_CPUS stacks; CPU n takes the n-th */
+	u64 apicids;		/* cpu_to_apicid[] */
+};
+
+extern char trampoline_start[], trampoline_header[], trampoline_end[];
+
+void __noreturn start_secondary(unsigned int cpu);
+void smp_ipi_init(void);
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* _ASM_X86_SMP_H */
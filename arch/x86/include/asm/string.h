@@ -0,0 +1,41 @@
+#ifndef _ASM_X86_STRING_H
+#define _ASM_X86_STRING_H
+
+#include <zhos/types.h>
+
+/*
+ * memcpy(), memset(), memcmp() and csum_partial() are each one jump
+ * (arch/x86/lib/string_64.S), to the portable C version until
+ * string_init() has timed the variants below on this CPU and repointed
+ * it at the fastest.  Call the variants directly only to compare them.
+ */
+void *memcpy_erms(void *dst, const void *src, size_t n);
+void *memcpy_sse2(void *dst, const void *src, size_t n);
+void *memcpy_avx2(void *dst, const void *src, size_t n);
+void *memset_erms(void *s, int c, size_t n);
+void *memset_sse2(void *s, int c, size_t n);
+void *memset_avx2(void *s, int c, size_t n);
+int memcmp_sse2(const void *a, const void *b, size_t n);
+int memcmp_avx2(const void *a, const void *b, size_t n);
+u32 csum_partial_sse2(const void *buf, unsigned int len, u32 sum);
+u32 csum_partial_avx2(const void *buf, unsigned int len, u32 sum);
+
+/*
+ * The SIMD loops, whole blocks only (64 bytes for copy and set, one
+ * vector for compare and checksum), between kernel_fpu_begin/end.
+ * __memcmp_* return how many leading bytes are equal, in whole vectors;
+ * __csum_* the sum of the 32-bit words.
+ */
+void __memcpy_sse2(void *dst, const void *src, size_t n);
+void __memcpy_avx2(void *dst, const void *src, size_t n);
+void __memset_sse2(void *s, int c, size_t n);
+void __memset_avx2(void *s, int c, size_t n);
+size_t __memcmp_sse2(const void *a, const void *b, size_t n);
+size_t __memcmp_avx2(const void *a, const void *b, size_t n);
+u64 __csum_sse2(const void *buf, size_t n);
+u64 __csum_avx2(const void *buf, size_t n);
+
+/* Once the FPU is set up and pages can be allocated, before the APs. */
+void string_init(void);
+
+#endif /* _ASM_X86_STRING_H */
@@ -0,0 +1,35 @@
+#ifndef _ASM_X86_SWITCH_TO_H
+#define _ASM_X86_SWITCH_TO_H
+
+#include <asm/fpu.h>
+#include <asm/perf_event.h>
+
+struct task_struct;
+
+/*
+ * Save the callee-saved registers of @prev on its stack and resume @next
+ * from its own.  Returns, in @next's context, the task switched away
+ * from.
+ */
+struct task_struct *__switch_to_asm(struct task_struct *prev,
+				    struct task_struct *next);
+
+/* First instruction of a new task; see copy_thread(). */
+void ret_from_fork(void);
+
+/* Build the initial stack of @p so that it starts in @fn(@arg). */
+void copy_thread(struct task_struct *p, int (*fn)(void *), void *arg);
+
+/*
+ * FPU registers are saved only for a task that used them; see fpu.c.
+ * Counters are switched only when either task counts something.
+ */
+#define switch_to(prev, next) ({					\
+	if ((prev)->thread.fpu.active)					\
+		fpu_switch_out(prev);					\
+	if ((prev)->thread.perf.events | (next)->thread.perf.events)	\
+		perf_switch(prev, next);				\
+	__switch_to_asm(prev, next);					\
+})
+
+#endif /* _ASM_X86_SWITCH_TO_H */
@@ -0,0 +1,41 @@
+#ifndef _ASM_X86_TLBFLUSH_H
+#define _ASM_X86_TLBFLUSH_H
+
+#include <asm/processor.h>
+
+/* This CPU only. */
+static inline void __flush_tlb_one(unsigned long addr)
+{
+	__asm__ __volatile__("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+/*
+ * No global pages are used, so reloading cr3 drops every translation, of
+ * the current PCID if PCIDs are on.
+ */
+static inline void __flush_tlb_all(void)
+{
+	write_cr3(read_cr3());
+}
+
+/*
+ * Every CPU and every address space: the kernel's mappings are shared by
+ * all, so a change to one is only complete once this returns; the pages
+ * it used may be freed after.  Must be called with interrupts enabled.
+ */
+void flush_tlb_kernel_range(unsigned long start, unsigned long end);
+void flush_tlb_all(void);
+
+struct mm_struct;
+
+/*
+ * Every CPU that has @mm loaded; the others see its generation has
+ * moved on and flush when they next switch to it.  Interrupts enabled.
+ */
+void flush_tlb_mm_range(struct mm_struct *mm, unsigned long start,
+			unsigned long end);
+
+/* Per-CPU setup: PCIDs, where the CPU has them. */
+void tlb_init_cpu(void);
+
+#endif /* _ASM_X86_TLBFLUSH_H */
@@ -0,0 +1,27 @@
+#ifndef _ASM_X86_TSC_H
+#define _ASM_X86_TSC_H
+
+#include <zhos/types.h>
+
+static inline u64 rdtsc(void)
+{
+	u32 lo, hi;
+
+	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((u64)hi << 32) | lo;
+}
+
+/* rdtsc that is not executed ahead of earlier instructions. */
+static inline u64 rdtsc_ordered(void)
+{
+	u32 lo, hi;
+
+	__asm__ __volatile__("lfence; rdtsc" : "=a"(lo), "=d"(hi) : : "memory");
+	return ((u64)hi << 32) | lo;
+}
+
+extern unsigned long tsc_khz;
+
+void tsc_init(void);
+
+#endif /* _ASM_X86_TSC_H */
@@ -0,0 +1,61 @@
+/*
+ * CPU and interrupt controller enumeration from the ACPI MADT.
+ */
+#define pr_fmt(fmt) "acpi: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/acpi.h>
+#include <zhos/cpumask.h>
+#include <asm/apic.h>
+
+static int acpi_parse_lapic(const struct acpi_subtable_header *e)
+{
+	const struct acpi_madt_local_apic *p = (const void *)e;
+
+	if (p->lapic_flags & ACPI_MADT_ENABLED)
+		apic_register_cpu(p->id);
+	return 0;
+}
+
+static int acpi_parse_x2apic(const struct acpi_subtable_header *e)
+{
+	const struct acpi_madt_local_x2apic *p = (const void *)e;
+
+	if (p->lapic_flags & ACPI_MADT_ENABLED)
+		apic_register_cpu(p->local_apic_id);
+	return 0;
+}
+
+static int acpi_parse_lapic_addr_ovr(const struct acpi_subtable_header *e)
+{
+	const struct acpi_madt_local_apic_override *p = (const void *)e;
+
+	register_lapic_address(p->address);
+	return 0;
+}
+
+/* Without a MADT the machine is taken to be a uniprocessor. */
+void acpi_boot_init(void)
+{
+	struct acpi_table_madt *madt;
+
+	if (acpi_table_init())
+		return;
+
+	madt = (struct acpi_table_madt *)acpi_get_table(ACPI_SIG_MADT);
+	if (!madt) {
+		pr_info("no MADT\n");
+		return;
+	}
+
+	register_lapic_address(madt->address);
+	acpi_table_parse_entries(ACPI_SIG_MADT, sizeof(*madt),
+				 ACPI_MADT_TYPE_LOCAL_APIC_OVERRIDE,
+				 acpi_parse_lapic_addr_ovr);
+	acpi_table_parse_entries(ACPI_SIG_MADT, sizeof(*madt),
+				 ACPI_MADT_TYPE_LOCAL_APIC, acpi_parse_lapic);
+	acpi_table_parse_entries(ACPI_SIG_MADT, sizeof(*madt),
+				 ACPI_MADT_TYPE_LOCAL_X2APIC, acpi_parse_x2apic);
+
+	pr_info("%u CPUs enumerated\n", num_possible_cpus());
+}
@@ -0,0 +1,340 @@
+/*
+ * Local APIC: per-CPU interrupt controller, IPIs and the per-CPU timer.
+ *
+ * Each CPU's tick comes from its own APIC timer, so no interrupt is shared
+ * between CPUs.  The timer runs from the bus or core crystal clock, whose
+ * rate nothing reports reliably; it is measured once on the boot CPU
+ * against 8253 counter 2 and the result reused on every other CPU.  Where
+ * the CPU supports TSC-deadline mode the timer is armed with an absolute
+ * TSC value instead, which needs only the TSC calibration.
+ *
+ * The APIC timer keeps running in C1 (hlt), the only idle state used.
+ */
+#define pr_fmt(fmt) "apic: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/clockchips.h>
+#include <zhos/cpumask.h>
+#include <zhos/i8253.h>
+#include <zhos/jiffies.h>
+#include <zhos/smp.h>
+#include <asm/apic.h>
+#include <asm/barrier.h>
+#include <asm/irq.h>
+#include <asm/irqflags.h>
+#include <asm/msr.h>
+#include <asm/page.h>
+#include <asm/processor.h>
+#include <asm/tsc.h>
+
+#define CPUID_1_EDX_APIC		(1 << 9)
+#define CPUID_1_ECX_TSC_DEADLINE	(1 << 24)
+
+#define LAPIC_CALIBRATE_MS		10
+#define LAPIC_CALIBRATE_LOOPMIN		500
+#define LAPIC_CALIBRATE_RETRIES		3
+
+#define LAPIC_MIN_DELTA			0xf
+#define LAPIC_MAX_DELTA			0x7fffffff
+
+/* TSC-deadline clockevents count TSC cycles / TSC_DIVISOR, keeping Hz in u32. */
+#define TSC_DIVISOR			8
+
+u8 *apic_mmio;
+u32 cpu_to_apicid[NR_CPUS];
+
+static phys_addr_t lapic_phys = APIC_DEFAULT_PHYS_BASE;
+static unsigned int nr_cpus_found = 1;
+
+static u32 lapic_timer_hz;		/* APIC timer input / 16 */
+static bool lapic_tsc_deadline;
+static bool lapic_timer_ok;
+
+static DEFINE_PER_CPU(struct clock_event_device, lapic_events);
+
+void register_lapic_address(phys_addr_t address)
+{
+	lapic_phys = address;
+}
+
+/**
+ * apic_register_cpu - record a CPU enumerated by firmware
+ *
+ * The boot CPU keeps number 0 whatever its position in the table.
+ * Returns the CPU number, or -1 if there is no room for it.
+ */
+int apic_register_cpu(u32 apicid)
+{
+	unsigned int cpu;
+
+	if (apicid == cpu_to_apicid[0])
+		return 0;
+	if (nr_cpus_found >= NR_CPUS) {
+		pr_warn("APIC %u ignored, NR_CPUS=%u\n", apicid, NR_CPUS);
+		return -1;
+	}
+	/* xAPIC destinations are 8 bits. */
+	if (apicid > 0xfe) {
+		pr_warn("APIC %u needs x2APIC, ignored\n", apicid);
+		return -1;
+	}
+
+	cpu = nr_cpus_found++;
+	cpu_to_apicid[cpu] = apicid;
+	set_cpu_possible(cpu, true);
+	return cpu;
+}
+
+static void apic_spurious_interrupt(struct pt_regs *regs)
+{
+	/* No EOI: a spurious interrupt is not in service. */
+}
+
+static void apic_error_interrupt(struct pt_regs *regs)
+{
+	u32 esr;
+
+	apic_write(APIC_ESR, 0);
+	esr = apic_read(APIC_ESR);
+	apic_eoi();
+	pr_err("CPU%u: APIC error %x\n", smp_processor_id(), esr);
+}
+
+/* Per-CPU setup, on every CPU with interrupts disabled. */
+void setup_local_APIC(void)
+{
+	unsigned int cpu = smp_processor_id();
+
+	apic_write(APIC_TASKPRI, 0);
+	apic_write(APIC_SPIV, APIC_SPIV_APIC_ENABLED | SPURIOUS_APIC_VECTOR);
+
+	/*
+	 * The boot CPU's LINT0 keeps delivering the 8259 (virtual wire
+	 * mode); nothing else is wired to the others.
+	 */
+	apic_write(APIC_LVT0, cpu ? APIC_LVT_MASKED : APIC_DM_EXTINT);
+	apic_write(APIC_LVT1, APIC_DM_NMI | (cpu ? APIC_LVT_MASKED : 0));
+	apic_write(APIC_LVTT, APIC_LVT_MASKED | LOCAL_TIMER_VECTOR);
+	apic_write(APIC_LVTERR, ERROR_APIC_VECTOR);
+
+	/* ESR latches on write; two writes leave it clear. */
+	apic_write(APIC_ESR, 0);
+	apic_write(APIC_ESR, 0);
+	apic_eoi();
+}
+
+void apic_bsp_init(void)
+{
+	u32 a, b, c, d;
+	u64 base;
+
+	cpuid(1, &a, &b, &c, &d);
+	cpu_to_apicid[0] = b >> 24;
+	if (!(d & CPUID_1_EDX_APIC)) {
+		pr_info("no local APIC\n");
+		return;
+	}
+
+	base = rdmsr(MSR_IA32_APICBASE);
+	if (base & MSR_IA32_APICBASE_X2APIC) {
+		pr_warn("firmware left x2APIC mode on, not using the APIC\n");
+		return;
+	}
+	if ((base & MSR_IA32_APICBASE_BASE) != lapic_phys) {
+		base = (base & ~MSR_IA32_APICBASE_BASE) | lapic_phys;
+		wrmsr(MSR_IA32_APICBASE, base);
+	}
+	wrmsr(MSR_IA32_APICBASE, base | MSR_IA32_APICBASE_ENABLE);
+
+	apic_mmio = phys_to_virt(lapic_phys);
+
+	set_vector_handler(SPURIOUS_APIC_VECTOR, apic_spurious_interrupt);
+	set_vector_handler(ERROR_APIC_VECTOR, apic_error_interrupt);
+	setup_local_APIC();
+
+	pr_info("local APIC %u at %lx, version %x\n", cpu_to_apicid[0],
+		(unsigned long)lapic_phys, apic_read(APIC_LVR) & 0xff);
+}
+
+static void apic_wait_icr_idle(void)
+{
+	while (apic_read(APIC_ICR) & APIC_ICR_BUSY)
+		cpu_relax();
+}
+
+/* Send an interprocessor interrupt with ICR value @low to @apicid. */
+void apic_icr_write(u32 low, u32 apicid)
+{
+	unsigned long flags = local_irq_save();
+
+	apic_wait_icr_idle();
+	apic_write(APIC_ICR2, apicid << APIC_DEST_SHIFT);
+	apic_write(APIC_ICR, low);
+	local_irq_restore(flags);
+}
+
+void apic_send_IPI(unsigned int cpu, unsigned int vector)
+{
+	apic_icr_write(APIC_DM_FIXED | vector, cpu_to_apicid[cpu]);
+}
+
+/* --- timer -------------------------------------------------------------- */
+
+static int lapic_next_event(unsigned long delta, struct clock_event_device *evt)
+{
+	apic_write(APIC_TMICT, delta);
+	return 0;
+}
+
+static int lapic_next_deadline(unsigned long delta, struct clock_event_device *evt)
+{
+	wrmsr(MSR_IA32_TSC_DEADLINE, rdtsc() + (u64)delta * TSC_DIVISOR);
+	return 0;
+}
+
+static int lapic_timer_shutdown(struct clock_event_device *evt)
+{
+	apic_write(APIC_LVTT, APIC_LVT_MASKED | LOCAL_TIMER_VECTOR);
+	apic_write(APIC_TMICT, 0);
+	return 0;
+}
+
+static int lapic_timer_set_periodic(struct clock_event_device *evt)
+{
+	apic_write(APIC_LVTT, APIC_LVT_TIMER_PERIODIC | LOCAL_TIMER_VECTOR);
+	apic_write(APIC_TDCR, APIC_TDR_DIV_16);
+	apic_write(APIC_TMICT, lapic_timer_hz / HZ);
+	return 0;
+}
+
+static int lapic_timer_set_oneshot(struct clock_event_device *evt)
+{
+	if (lapic_tsc_deadline) {
+		apic_write(APIC_LVTT, APIC_LVT_TIMER_TSCDEADLINE | LOCAL_TIMER_VECTOR);
+		/* The SDM asks for a fence between the LVT and MSR writes. */
+		mb();
+	} else {
+		apic_write(APIC_LVTT, APIC_LVT_TIMER_ONESHOT | LOCAL_TIMER_VECTOR);
+		apic_write(APIC_TDCR, APIC_TDR_DIV_16);
+	}
+	return 0;
+}
+
+static void lapic_timer_interrupt(struct pt_regs *regs)
+{
+	struct clock_event_device *evt = this_cpu_ptr(&lapic_events);
+
+	apic_eoi();
+	if (evt->event_handler)
+		evt->event_handler(evt);
+}
+
+/*
+ * Count APIC timer decrements over one run of PIT counter 2, rejecting
+ * runs with a gap between polls that gives away an SMI.  Returns the
+ * timer rate at divide-by-16 in Hz, or 0 if the run was disturbed.
+ */
+static u32 lapic_calibrate(void)
+{
+	u32 latch = PIT_TICK_RATE * LAPIC_CALIBRATE_MS / 1000;
+	u32 start, prev, now, delta, dmin = ~0U, dmax = 0;
+	unsigned long flags;
+	int loops = 0;
+
+	flags = local_irq_save();
+	apic_write(APIC_LVTT, APIC_LVT_MASKED | LOCAL_TIMER_VECTOR);
+	apic_write(APIC_TDCR, APIC_TDR_DIV_16);
+
+	pit_ch2_start(latch);
+	apic_write(APIC_TMICT, ~0U);
+	start = prev = now = apic_read(APIC_TMCCT);
+	while (!pit_ch2_expired()) {
+		now = apic_read(APIC_TMCCT);
+		delta = prev - now;
+		prev = now;
+		if (delta < dmin)
+			dmin = delta;
+		if (delta > dmax)
+			dmax = delta;
+		loops++;
+	}
+	pit_ch2_stop();
+
+	apic_write(APIC_TMICT, 0);
+	local_irq_restore(flags);
+
+	if (loops < LAPIC_CALIBRATE_LOOPMIN || dmax > 10 * (dmin + 1))
+		return 0;
+	return (u64)(start - now) * PIT_TICK_RATE / latch;
+}
+
+static void setup_APIC_timer(void)
+{
+	struct clock_event_device *evt = this_cpu_ptr(&lapic_events);
+
+	evt->name = lapic_tsc_deadline ? "lapic-deadline" : "lapic";
+	evt->rating = lapic_tsc_deadline ? 160 : 150;
+	evt->set_state_oneshot = lapic_timer_set_oneshot;
+	evt->set_state_shutdown = lapic_timer_shutdown;
+
+	if (lapic_tsc_deadline) {
+		evt->features = CLOCK_EVT_FEAT_ONESHOT;
+		evt->set_next_event = lapic_next_deadline;
+		clockevents_config_and_register(evt, tsc_khz * (1000 / TSC_DIVISOR),
+						LAPIC_MIN_DELTA, LAPIC_MAX_DELTA);
+	} else {
+		evt->features = CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT;
+		evt->set_state_periodic = lapic_timer_set_periodic;
+		evt->set_next_event = lapic_next_event;
+		clockevents_config_and_register(evt, lapic_timer_hz,
+						LAPIC_MIN_DELTA, LAPIC_MAX_DELTA);
+	}
+}
+
+/**
+ * apic_timer_init - calibrate the APIC timer and make it the boot CPU's tick
+ *
+ * Returns false if there is no usable APIC timer; the PIT tick is the
+ * fallback and secondary CPUs then stay offline.
+ */
+bool apic_timer_init(void)
+{
+	unsigned long hz;
+	u32 a, b, c, d;
+	int i;
+
+	if (!apic_available())
+		return false;
+
+	cpuid(1, &a, &b, &c, &d);
+	lapic_tsc_deadline = (c & CPUID_1_ECX_TSC_DEADLINE) && tsc_khz;
+
+	if (!lapic_tsc_deadline) {
+		for (i = 0; i < LAPIC_CALIBRATE_RETRIES && !lapic_timer_hz; i++)
+			lapic_timer_hz = lapic_calibrate();
+		if (!lapic_timer_hz) {
+			pr_warn("timer calibration failed\n");
+			return false;
+		}
+		hz = lapic_timer_hz * 16UL;
+		pr_info("timer %lu.%03lu MHz\n", hz / 1000000, hz / 1000 % 1000);
+	} else {
+		pr_info("timer in TSC-deadline mode\n");
+	}
+
+	set_vector_handler(LOCAL_TIMER_VECTOR, lapic_timer_interrupt);
+	setup_APIC_timer();
+	lapic_timer_ok = true;
+	return true;
+}
+
+bool apic_timer_available(void)
+{
+	return lapic_timer_ok;
+}
+
+/* Secondary CPUs reuse the boot CPU's calibration. */
+void setup_secondary_APIC_clock(void)
+{
+	setup_APIC_timer();
+}
@@ -0,0 +1,125 @@
+/*
+ * The firmware memory map.
+ *
+ * The multiboot loader passes on the BIOS E820 map; older loaders only
+ * give the sizes of low and extended memory, which are turned into an
+ * equivalent two-entry map.  Entries are sorted and RAM that overlaps
+ * anything else is dropped, then the RAM is registered with memblock.
+ */
+#define pr_fmt(fmt) "e820: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/memblock.h>
+#include <asm/e820.h>
+#include <asm/page.h>
+#include <asm/setup.h>
+
+struct e820_table e820_table;
+
+static void __e820__range_add(u64 addr, u64 size, u32 type)
+{
+	struct e820_entry *e;
+
+	if (!size)
+		return;
+	if (e820_table.nr_entries >= E820_MAX_ENTRIES) {
+		pr_warn("too many entries, dropping 0x%llx-0x%llx\n",
+			(unsigned long long)addr,
+			(unsigned long long)(addr + size - 1));
+		return;
+	}
+	e = &e820_table.entries[e820_table.nr_entries++];
+	e->addr = addr;
+	e->size = size;
+	e->type = type;
+}
+
+static void e820__from_multiboot(void)
+{
+	struct multiboot_mmap_entry *m;
+	unsigned long p, end;
+
+	if (boot_info->flags & MULTIBOOT_INFO_MEM_MAP) {
+		p = (unsigned long)phys_to_virt(boot_info->mmap_addr);
+		end = p + boot_info->mmap_length;
+		for (; p < end; p += m->size + sizeof(m->size)) {
+			m = (struct multiboot_mmap_entry *)p;
+			__e820__range_add(m->addr, m->len, m->type);
+		}
+	} else if (boot_info->flags & MULTIBOOT_INFO_MEMORY) {
+		__e820__range_add(0, (u64)boot_info->mem_lower << 10,
+				  E820_TYPE_RAM);
+		__e820__range_add(0x100000, (u64)boot_info->mem_upper << 10,
+				  E820_TYPE_RAM);
+	} else {
+		panic("no memory map from the boot loader");
+	}
+}
+
+/* Sort by address; RAM that overlaps a non-RAM entry loses the overlap. */
+static void e820__sanitize(void)
+{
+	struct e820_entry *e = e820_table.entries, tmp;
+	u32 n = e820_table.nr_entries, i, j;
+
+	for (i = 1; i < n; i++) {
+		tmp = e[i];
+		for (j = i; j > 0 && e[j - 1].addr > tmp.addr; j--)
+			e[j] = e[j - 1];
+		e[j] = tmp;
+	}
+
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < n; j++) {
+			u64 s, end;
+
+			if (i == j || e[i].type != E820_TYPE_RAM ||
+			    e[j].type == E820_TYPE_RAM)
+				continue;
+			s = max(e[i].addr, e[j].addr);
+			end = min(e[i].addr + e[i].size, e[j].addr + e[j].size);
+			if (s >= end)
+				continue;
+			/* Keep the larger RAM piece outside the overlap. */
+			if (s - e[i].addr >= e[i].addr + e[i].size - end) {
+				e[i].size = s - e[i].addr;
+			} else {
+				e[i].size = e[i].addr + e[i].size - end;
+				e[i].addr = end;
+			}
+		}
+	}
+}
+
+static const char *e820_type_name(u32 type)
+{
+	switch (type) {
+	case E820_TYPE_RAM:		return "usable";
+	case E820_TYPE_RESERVED:	return "reserved";
+	case E820_TYPE_ACPI:		return "ACPI data";
+	case E820_TYPE_NVS:		return "ACPI NVS";
+	case E820_TYPE_UNUSABLE:	return "unusable";
+	default:			return "type?";
+	}
+}
+
+void e820__memory_setup(void)
+{
+	struct e820_entry *e;
+	u32 i;
+
+	e820__from_multiboot();
+	e820__sanitize();
+
+	for (i = 0; i < e820_table.nr_entries; i++) {
+		e = &e820_table.entries[i];
+		if (!e->size)
+			continue;
+		pr_info("[mem 0x%016llx-0x%016llx] %s\n",
+			(unsigned long long)e->addr,
+			(unsigned long long)(e->addr + e->size - 1),
+			e820_type_name(e->type));
+		if (e->type == E820_TYPE_RAM)
+			memblock_add(e->addr, e->size);
+	}
+}
@@ -0,0 +1,224 @@
+/*
+ * Lazy FPU state switching.
+ *
+ * Most tasks never touch an x87, SSE or AVX register, and those that do
+ * rarely do so in every time slice, so the registers are not switched
+ * with the task.  CR0.TS is set whenever the task on a CPU has not used
+ * them since it was switched in; the first FPU instruction then traps
+ * (#NM), and the handler loads the task's saved state, unless the
+ * registers still hold it, and clears TS until the next switch.  Only a
+ * task that took that trap has its state saved when it is switched out,
+ * with XSAVEOPT where there is one, which skips components unchanged
+ * since the last restore.
+ *
+ * Each CPU records the task whose state its registers were last loaded
+ * from, and each task the CPU it was loaded on, so a task that is the
+ * only FPU user on its CPU switches out and back in with one save and
+ * one trap, and no restore.  The state area itself is allocated at the
+ * first trap.
+ *
+ * Kernel code that wants the SIMD registers brackets their use with
+ * kernel_fpu_begin() and kernel_fpu_end(), which save the current task's
+ * live state, if any, and leave the registers marked as nobody's.
+ */
+#define pr_fmt(fmt) "fpu: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/cpumask.h>
+#include <zhos/percpu.h>
+#include <zhos/preempt.h>
+#include <zhos/sched.h>
+#include <zhos/slab.h>
+#include <zhos/smp.h>
+#include <asm/fpu.h>
+#include <asm/irqflags.h>
+#include <asm/processor.h>
+
+/* x87, SSE, AVX and AVX-512; MPX, PKRU and the like are left off. */
+#define XFEATURE_MASK_KERNEL	0xe7ULL
+
+#define FXSAVE_SIZE		512
+#define MXCSR_DEFAULT		0x1f80
+#define FCW_DEFAULT		0x037f
+
+static bool use_xsave, use_xsaveopt;
+static u64 xfeatures;
+static unsigned int xstate_size = FXSAVE_SIZE;
+static struct kmem_cache *fpu_state_cachep;
+
+static DEFINE_PER_CPU(struct task_struct *, fpu_owner);
+static DEFINE_PER_CPU(bool, in_kernel_fpu);
+
+static void fpu_save(void *state)
+{
+	if (use_xsaveopt)
+		__asm__ __volatile__("xsaveopt64 (%0)"
+				     : : "r"(state), "a"(-1), "d"(-1)
+				     : "memory");
+	else if (use_xsave)
+		__asm__ __volatile__("xsave64 (%0)"
+				     : : "r"(state), "a"(-1), "d"(-1)
+				     : "memory");
+	else
+		__asm__ __volatile__("fxsave64 (%0)"
+				     : : "r"(state) : "memory");
+}
+
+static void fpu_restore(const void *state)
+{
+	if (use_xsave)
+		__asm__ __volatile__("xrstor64 (%0)"
+				     : : "r"(state), "a"(-1), "d"(-1)
+				     : "memory");
+	else
+		__asm__ __volatile__("fxrstor64 (%0)"
+				     : : "r"(state) : "memory");
+}
+
+/*
+ * A zeroed XSAVE header marks every component as in its initial state,
+ * so only the legacy area's control words need setting, for FXRSTOR.
+ */
+static void fpstate_init(void *state)
+{
+	u8 *p = state;
+
+	*(u16 *)p = FCW_DEFAULT;
+	*(u32 *)(p + 24) = MXCSR_DEFAULT;
+}
+
+void fpu_init_cpu(void)
+{
+	unsigned long cr4 = read_cr4() | X86_CR4_OSFXSR | X86_CR4_OSXMMEXCPT;
+
+	write_cr0((read_cr0() & ~X86_CR0_EM) | X86_CR0_MP | X86_CR0_NE |
+		  X86_CR0_TS);
+	if (use_xsave)
+		cr4 |= X86_CR4_OSXSAVE;
+	write_cr4(cr4);
+	if (use_xsave)
+		xsetbv(0, xfeatures);
+}
+
+void fpu_init(void)
+{
+	u32 eax, ebx, ecx, edx;
+
+	cpuid(1, &eax, &ebx, &ecx, &edx);
+	if (!(edx & (1U << 24)) || !(edx & (1U << 25)))
+		panic("CPU without FXSAVE or SSE");
+	if (ecx & (1U << 26)) {
+		cpuid_count(0xd, 0, &eax, &ebx, &ecx, &edx);
+		xfeatures = (eax | (u64)edx << 32) & XFEATURE_MASK_KERNEL;
+		use_xsave = true;
+		cpuid_count(0xd, 1, &eax, &ebx, &ecx, &edx);
+		use_xsaveopt = eax & 1;
+	}
+
+	fpu_init_cpu();
+	if (use_xsave) {
+		/* The size for the features now enabled in XCR0. */
+		cpuid_count(0xd, 0, &eax, &ebx, &ecx, &edx);
+		xstate_size = ebx;
+	}
+	fpu_state_cachep = kmem_cache_create("fpu_state", xstate_size, 64,
+					     SLAB_PANIC, NULL);
+	pr_info("%s, features %#llx, %u bytes of state per task\n",
+		use_xsaveopt ? "xsaveopt" : use_xsave ? "xsave" : "fxsave",
+		(unsigned long long)xfeatures, xstate_size);
+}
+
+/* Interrupts disabled; @prev's registers are live on this CPU. */
+void fpu_switch_out(struct task_struct *prev)
+{
+	struct fpu *fpu = &prev->thread.fpu;
+
+	fpu_save(fpu->state);
+	fpu->active = false;
+	stts();
+}
+
+void do_device_not_available(void)
+{
+	struct task_struct *tsk = current;
+	struct fpu *fpu = &tsk->thread.fpu;
+	unsigned int cpu = smp_processor_id();
+	bool fresh = false;
+	unsigned long flags;
+
+	/* It would get the interrupted task's registers to clobber. */
+	if (in_interrupt())
+		panic("FPU used in an interrupt without kernel_fpu_begin()");
+
+	flags = local_irq_save();
+	if (unlikely(!fpu->state)) {
+		fpu->state = kmem_cache_zalloc(fpu_state_cachep, GFP_ATOMIC);
+		if (!fpu->state)
+			panic("no memory for the FPU state of %s", tsk->comm);
+		fpstate_init(fpu->state);
+		fresh = true;
+	}
+	clts();
+	if (fresh || this_cpu_read(fpu_owner) != tsk || fpu->last_cpu != cpu) {
+		fpu_restore(fpu->state);
+		this_cpu_write(fpu_owner, tsk);
+		fpu->last_cpu = cpu;
+	}
+	fpu->active = true;
+	local_irq_restore(flags);
+}
+
+/* @p is dead; make sure no CPU thinks a new task at its address owns it. */
+void fpu_free(struct task_struct *p)
+{
+	struct task_struct *owner;
+	unsigned int cpu;
+
+	if (!p->thread.fpu.state)
+		return;
+	for_each_possible_cpu(cpu) {
+		owner = p;
+		__atomic_compare_exchange_n(per_cpu_ptr(&fpu_owner, cpu),
+					    &owner, NULL, false,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+	}
+	kmem_cache_free(fpu_state_cachep, p->thread.fpu.state);
+}
+
+/* False in an interrupt that arrived inside kernel_fpu_begin/end. */
+bool irq_fpu_usable(void)
+{
+	return !this_cpu_read(in_kernel_fpu);
+}
+
+/**
+ * kernel_fpu_begin - make the SIMD registers available to kernel code
+ *
+ * Saves the current task's registers if they are live and leaves them
+ * owned by nobody, so that the task reloads them at its next FPU
+ * instruction.  Disables preemption until kernel_fpu_end().
+ */
+void kernel_fpu_begin(void)
+{
+	struct fpu *fpu = &current->thread.fpu;
+	unsigned long flags;
+
+	preempt_disable();
+	flags = local_irq_save();
+	BUG_ON(this_cpu_read(in_kernel_fpu));
+	this_cpu_write(in_kernel_fpu, true);
+	if (fpu->active) {
+		fpu_save(fpu->state);
+		fpu->active = false;
+	}
+	this_cpu_write(fpu_owner, NULL);
+	clts();
+	local_irq_restore(flags);
+}
+
+void kernel_fpu_end(void)
+{
+	stts();
+	this_cpu_write(in_kernel_fpu, false);
+	preempt_enable();
+}
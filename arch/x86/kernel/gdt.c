@@ -0,0 +1,70 @@
+/*
+ * Global descriptor table and task state segment.
+ *
+ * Long mode ignores segment bases and limits except for the TSS, which
+ * supplies the ring-0 stack for user->kernel transitions and the IST
+ * stacks used by #DF and NMI.  Loading a TSS marks its descriptor busy,
+ * so every CPU has its own GDT, TSS and IST stacks.
+ */
+#include <zhos/kernel.h>
+#include <zhos/percpu.h>
+#include <zhos/string.h>
+#include <asm/desc.h>
+#include <asm/segment.h>
+
+static DEFINE_PER_CPU_ALIGNED(u64 [GDT_ENTRIES], gdt) = {
+	[GDT_ENTRY_KERNEL_CS]	= 0x00af9a000000ffff,
+	[GDT_ENTRY_KERNEL_DS]	= 0x00cf92000000ffff,
+	[GDT_ENTRY_USER32_CS]	= 0x00cffa000000ffff,
+	[GDT_ENTRY_USER_DS]	= 0x00cff2000000ffff,
+	[GDT_ENTRY_USER_CS]	= 0x00affa000000ffff,
+};
+
+static DEFINE_PER_CPU_ALIGNED(struct tss_struct, tss);
+static DEFINE_PER_CPU_ALIGNED(u8 [N_EXCEPTION_STACKS][EXCEPTION_STACK_SIZE],
+			      exception_stacks);
+
+static void set_tss_desc(u64 *desc, struct tss_struct *t)
+{
+	u64 base = (u64)t;
+	u64 limit = sizeof(*t) - 1;
+
+	desc[0] = (limit & 0xffff) |
+		  ((base & 0xffffff) << 16) |
+		  (0x89ULL << 40) |		/* present, 64-bit available TSS */
+		  (((limit >> 16) & 0xf) << 48) |
+		  (((base >> 24) & 0xff) << 56);
+	desc[1] = base >> 32;
+}
+
+void gdt_init(unsigned int cpu)
+{
+	u64 *g = per_cpu(gdt, cpu);
+	struct tss_struct *t = &per_cpu(tss, cpu);
+	struct desc_ptr gdtr = {
+		.size = sizeof(gdt) - 1,
+		.address = (u64)g,
+	};
+	int i;
+
+	memset(t, 0, sizeof(*t));
+	for (i = 0; i < N_EXCEPTION_STACKS; i++)
+		t->ist[i] = (u64)&per_cpu(exception_stacks, cpu)[i][EXCEPTION_STACK_SIZE];
+	t->io_bitmap_base = sizeof(*t);
+	set_tss_desc(&g[GDT_ENTRY_TSS], t);
+
+	__asm__ __volatile__(
+		"lgdt %0\n\t"
+		"pushq %1\n\t"
+		"leaq 1f(%%rip), %%rax\n\t"
+		"pushq %%rax\n\t"
+		"lretq\n"
+		"1:\n\t"
+		"movl %2, %%eax\n\t"
+		"movl %%eax, %%ds\n\t"
+		"movl %%eax, %%es\n\t"
+		"movl %%eax, %%ss\n\t"
+		"ltr %w3"
+		: : "m"(gdtr), "i"(__KERNEL_CS), "i"(__KERNEL_DS), "r"(__TSS_SEL)
+		: "rax", "memory");
+}
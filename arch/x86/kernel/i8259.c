@@ -0,0 +1,102 @@
+/*
+ * 8259A interrupt controller pair, remapped to IRQ0_VECTOR..+15.
+ */
+#include <zhos/kernel.h>
+#include <zhos/irq.h>
+#include <zhos/spinlock.h>
+#include <asm/io.h>
+#include <asm/i8259.h>
+
+#define OCW3_READ_ISR	0x0b
+#define OCW2_EOI	0x20
+
+static DEFINE_SPINLOCK(i8259_lock);
+static u16 cached_irq_mask = 0xffff;
+
+static void i8259_write_mask(void)
+{
+	outb(cached_irq_mask & 0xff, PIC_MASTER_IMR);
+	outb(cached_irq_mask >> 8, PIC_SLAVE_IMR);
+}
+
+static void i8259_mask(unsigned int irq)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&i8259_lock, flags);
+	cached_irq_mask |= 1 << irq;
+	i8259_write_mask();
+	spin_unlock_irqrestore(&i8259_lock, flags);
+}
+
+static void i8259_unmask(unsigned int irq)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&i8259_lock, flags);
+	cached_irq_mask &= ~(1 << irq);
+	i8259_write_mask();
+	spin_unlock_irqrestore(&i8259_lock, flags);
+}
+
+static void i8259_eoi(unsigned int irq)
+{
+	if (irq >= 8)
+		outb(OCW2_EOI, PIC_SLAVE_CMD);
+	outb(OCW2_EOI, PIC_MASTER_CMD);
+}
+
+static u8 i8259_read_isr(u16 cmd_port)
+{
+	outb(OCW3_READ_ISR, cmd_port);
+	return inb(cmd_port);
+}
+
+/*
+ * IRQ7 and IRQ15 are raised for interrupts that went away before the
+ * INTA cycle; the in-service bit tells the two apart.  A spurious IRQ15
+ * still needs an EOI on the master for the cascade line.
+ */
+static bool i8259_spurious(unsigned int irq)
+{
+	if (irq == 7 && !(i8259_read_isr(PIC_MASTER_CMD) & 0x80))
+		return true;
+	if (irq == 15 && !(i8259_read_isr(PIC_SLAVE_CMD) & 0x80)) {
+		outb(OCW2_EOI, PIC_MASTER_CMD);
+		return true;
+	}
+	return false;
+}
+
+static struct irq_chip i8259_chip = {
+	.name		= "XT-PIC",
+	.mask		= i8259_mask,
+	.unmask		= i8259_unmask,
+	.eoi		= i8259_eoi,
+	.spurious	= i8259_spurious,
+};
+
+void init_i8259(void)
+{
+	unsigned int irq;
+
+	outb(0xff, PIC_MASTER_IMR);
+	outb(0xff, PIC_SLAVE_IMR);
+
+	/* ICW1: edge triggered, cascade, ICW4 needed */
+	outb_p(0x11, PIC_MASTER_CMD);
+	outb_p(IRQ0_VECTOR, PIC_MASTER_IMR);		/* ICW2: vector base */
+	outb_p(1 << PIC_CASCADE_IR, PIC_MASTER_IMR);	/* ICW3: slave on IR2 */
+	outb_p(0x01, PIC_MASTER_IMR);			/* ICW4: 8086 mode */
+
+	outb_p(0x11, PIC_SLAVE_CMD);
+	outb_p(IRQ0_VECTOR + 8, PIC_SLAVE_IMR);
+	outb_p(PIC_CASCADE_IR, PIC_SLAVE_IMR);
+	outb_p(0x01, PIC_SLAVE_IMR);
+
+	cached_irq_mask = 0xffff & ~(1 << PIC_CASCADE_IR);
+	i8259_write_mask();
+
+	for (irq = 0; irq < NR_LEGACY_IRQS; irq++)
+		irq_set_chip(irq, &i8259_chip);
+}
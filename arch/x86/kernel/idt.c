@@ -0,0 +1,55 @@
+/*
+ * Interrupt descriptor table.  All 256 vectors point at the stubs in
+ * entry_64.S; dispatch happens in do_interrupt().
+ */
+#include <zhos/kernel.h>
+#include <asm/desc.h>
+#include <asm/segment.h>
+#include <asm/irq_vectors.h>
+
+#define STUB_SIZE	16
+
+extern char interrupt_stubs_start[];
+
+static struct gate_desc idt[NR_VECTORS] __aligned(16);
+
+void idt_set_gate(unsigned int vector, void *handler, u8 type, u8 ist)
+{
+	struct gate_desc *g = &idt[vector];
+	u64 addr = (u64)handler;
+
+	g->offset_low = addr & 0xffff;
+	g->segment = __KERNEL_CS;
+	g->ist = ist;
+	g->type_attr = type;
+	g->offset_mid = (addr >> 16) & 0xffff;
+	g->offset_high = addr >> 32;
+	g->reserved = 0;
+}
+
+/* Every CPU shares the one table. */
+void idt_load(void)
+{
+	struct desc_ptr idtr = {
+		.size = sizeof(idt) - 1,
+		.address = (u64)idt,
+	};
+
+	__asm__ __volatile__("lidt %0" : : "m"(idtr));
+}
+
+void idt_init(void)
+{
+	unsigned int v;
+
+	for (v = 0; v < NR_VECTORS; v++)
+		idt_set_gate(v, interrupt_stubs_start + v * STUB_SIZE,
+			     GATE_INTERRUPT, 0);
+
+	idt_set_gate(2, interrupt_stubs_start + 2 * STUB_SIZE,
+		     GATE_INTERRUPT, IST_NMI);
+	idt_set_gate(8, interrupt_stubs_start + 8 * STUB_SIZE,
+		     GATE_INTERRUPT, IST_DOUBLE_FAULT);
+
+	idt_load();
+}
@@ -0,0 +1,144 @@
+/*
+ * Interrupt dispatch.  Exceptions go to do_trap(), legacy IRQ vectors
+ * through irq_desc[] and their irq_chip, and everything else to a
+ * per-vector handler.  Whatever the handlers deferred runs as softirqs
+ * once they are done, before the return.
+ */
+#include <zhos/kernel.h>
+#include <zhos/errno.h>
+#include <zhos/irq.h>
+#include <zhos/preempt.h>
+#include <zhos/rcupdate.h>
+#include <zhos/sched.h>
+#include <zhos/softirq.h>
+#include <zhos/spinlock.h>
+#include <zhos/trace.h>
+#include <asm/irq.h>
+#include <asm/irq_regs.h>
+
+struct irq_desc irq_desc[NR_IRQS];
+static DEFINE_SPINLOCK(irq_desc_lock);
+
+static vector_handler_t vector_handlers[NR_VECTORS];
+static unsigned long spurious_vectors;
+
+DEFINE_PER_CPU(struct pt_regs *, irq_regs);
+
+void irq_set_chip(unsigned int irq, struct irq_chip *chip)
+{
+	if (irq < NR_IRQS)
+		irq_desc[irq].chip = chip;
+}
+
+int request_irq(unsigned int irq, irq_handler_t handler, const char *name,
+		void *dev_id)
+{
+	struct irq_desc *desc;
+	unsigned long flags;
+
+	if (irq >= NR_IRQS || !handler)
+		return -EINVAL;
+
+	desc = &irq_desc[irq];
+	spin_lock_irqsave(&irq_desc_lock, flags);
+	if (desc->handler) {
+		spin_unlock_irqrestore(&irq_desc_lock, flags);
+		return -EBUSY;
+	}
+	desc->handler = handler;
+	desc->dev_id = dev_id;
+	desc->name = name;
+	if (desc->chip)
+		desc->chip->unmask(irq);
+	spin_unlock_irqrestore(&irq_desc_lock, flags);
+	return 0;
+}
+
+void free_irq(unsigned int irq, void *dev_id)
+{
+	struct irq_desc *desc;
+	unsigned long flags;
+
+	if (irq >= NR_IRQS)
+		return;
+
+	desc = &irq_desc[irq];
+	spin_lock_irqsave(&irq_desc_lock, flags);
+	if (desc->dev_id == dev_id) {
+		if (desc->chip)
+			desc->chip->mask(irq);
+		desc->handler = NULL;
+		desc->dev_id = NULL;
+		desc->name = NULL;
+	}
+	spin_unlock_irqrestore(&irq_desc_lock, flags);
+}
+
+void disable_irq(unsigned int irq)
+{
+	if (irq < NR_IRQS && irq_desc[irq].chip)
+		irq_desc[irq].chip->mask(irq);
+}
+
+void enable_irq(unsigned int irq)
+{
+	if (irq < NR_IRQS && irq_desc[irq].chip)
+		irq_desc[irq].chip->unmask(irq);
+}
+
+void set_vector_handler(unsigned int vector, vector_handler_t fn)
+{
+	if (vector >= FIRST_EXTERNAL_VECTOR && vector < NR_VECTORS)
+		vector_handlers[vector] = fn;
+}
+
+static void handle_irq(unsigned int irq)
+{
+	struct irq_desc *desc = &irq_desc[irq];
+
+	if (desc->chip && desc->chip->spurious && desc->chip->spurious(irq)) {
+		desc->spurious++;
+		return;
+	}
+
+	desc->count++;
+	if (desc->handler)
+		desc->handler(irq, desc->dev_id);
+	else
+		desc->spurious++;
+
+	if (desc->chip)
+		desc->chip->eoi(irq);
+}
+
+void do_interrupt(struct pt_regs *regs)
+{
+	unsigned int vector = regs->vector;
+	struct pt_regs *old_regs;
+
+	if (vector < FIRST_EXTERNAL_VECTOR) {
+		do_trap(regs);
+		return;
+	}
+
+	rcu_irq_enter();
+	__preempt_count_add(HARDIRQ_OFFSET);
+	old_regs = set_irq_regs(regs);
+	trace_irq_entry(vector);
+	if (vector >= IRQ0_VECTOR && vector < IRQ0_VECTOR + NR_IRQS)
+		handle_irq(vector - IRQ0_VECTOR);
+	else if (vector_handlers[vector])
+		vector_handlers[vector](regs);
+	else
+		spurious_vectors++;
+	trace_irq_exit(vector);
+	set_irq_regs(old_regs);
+	__preempt_count_sub(HARDIRQ_OFFSET);
+	/* Still out of idle as far as RCU is concerned. */
+	irq_exit_softirq();
+	rcu_irq_exit();
+
+	/* A handler woke something that should run instead of us. */
+	if (!preempt_count() && need_resched())
+		preempt_schedule_irq();
+}
@@ -0,0 +1,313 @@
+/*
+ * Hardware performance counters (Intel architectural performance
+ * monitoring).
+ *
+ * CPUID leaf 0xa gives the version, the number and width of the
+ * general-purpose counters, and which of the architectural events the
+ * CPU cannot count.  Each counter has an event select MSR saying what it
+ * counts and whether it interrupts on overflow.  Version 2 onwards adds
+ * a global enable, left with every counter on so that the event selects
+ * alone start and stop them, and a status register of the counters that
+ * overflowed.
+ *
+ * Counting is per task.  A task asks for a set of events and gets
+ * counters 0, 1, ... for them in event order; they are started from zero
+ * when it is switched in and stopped and added to its totals when it is
+ * switched out, so nothing another task does on the CPU is charged to
+ * it.  A task that counts nothing costs switch_to() one test.
+ *
+ * The last counter is kept back for sampling.  Started at -period on
+ * every CPU, it overflows every period events and raises a performance
+ * monitoring interrupt, whose handler takes a profiler sample of the
+ * interrupted context (kernel/profile.c) and starts it again.  The
+ * interrupt is an ordinary vector, so like the profiler's timer it
+ * cannot see into code that runs with interrupts off.
+ *
+ * AMD's counters have MSRs of their own and no leaf 0xa, and emulators
+ * often have none at all; there the counters simply are not available.
+ */
+#define pr_fmt(fmt) "perf: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/bitops.h>
+#include <zhos/errno.h>
+#include <zhos/perf_event.h>
+#include <zhos/preempt.h>
+#include <zhos/profile.h>
+#include <zhos/sched.h>
+#include <zhos/smp.h>
+#include <zhos/string.h>
+#include <asm/apic.h>
+#include <asm/irq.h>
+#include <asm/irqflags.h>
+#include <asm/msr.h>
+#include <asm/perf_event.h>
+#include <asm/processor.h>
+
+#define EVENTSEL_USR		(1ULL << 16)
+#define EVENTSEL_OS		(1ULL << 17)
+#define EVENTSEL_INT		(1ULL << 20)
+#define EVENTSEL_ENABLE		(1ULL << 22)
+
+#define PERF_MAX_COUNTERS	8U
+/* Counters are written through the legacy MSRs, which sign-extend bit 31. */
+#define PERF_MAX_PERIOD		0x7fffffffULL
+
+struct perf_hw_event {
+	u8 event, umask;
+	u8 cpuid_bit;		/* set in leaf 0xa EBX: not available */
+};
+
+static const struct perf_hw_event perf_hw_events[PERF_COUNT_HW_MAX] = {
+	[PERF_COUNT_HW_CPU_CYCLES]		= { 0x3c, 0x00, 0 },
+	[PERF_COUNT_HW_INSTRUCTIONS]		= { 0xc0, 0x00, 1 },
+	[PERF_COUNT_HW_CACHE_REFERENCES]	= { 0x2e, 0x4f, 3 },
+	[PERF_COUNT_HW_CACHE_MISSES]		= { 0x2e, 0x41, 4 },
+	[PERF_COUNT_HW_BRANCH_INSTRUCTIONS]	= { 0xc4, 0x00, 5 },
+	[PERF_COUNT_HW_BRANCH_MISSES]		= { 0xc5, 0x00, 6 },
+};
+
+const char *const perf_hw_event_names[PERF_COUNT_HW_MAX] = {
+	[PERF_COUNT_HW_CPU_CYCLES]		= "cycles",
+	[PERF_COUNT_HW_INSTRUCTIONS]		= "instructions",
+	[PERF_COUNT_HW_CACHE_REFERENCES]	= "cache-references",
+	[PERF_COUNT_HW_CACHE_MISSES]		= "cache-misses",
+	[PERF_COUNT_HW_BRANCH_INSTRUCTIONS]	= "branches",
+	[PERF_COUNT_HW_BRANCH_MISSES]		= "branch-misses",
+};
+
+static unsigned int perf_version;
+static unsigned int nr_counters;	/* 0: no PMU */
+static unsigned int perf_events_ok;	/* 1 << PERF_COUNT_HW_* */
+static u64 counter_mask;		/* the counters' width */
+
+static unsigned int sample_event;
+static u64 sample_period;		/* 0 while not sampling */
+
+#define sample_counter()	(nr_counters - 1)
+
+static u64 perf_eventsel(unsigned int id)
+{
+	const struct perf_hw_event *e = &perf_hw_events[id];
+
+	return e->event | (u64)e->umask << 8 | EVENTSEL_USR | EVENTSEL_OS |
+	       EVENTSEL_ENABLE;
+}
+
+int perf_event_lookup(const char *name)
+{
+	unsigned int id;
+
+	for (id = 0; id < PERF_COUNT_HW_MAX; id++)
+		if (!strcmp(name, perf_hw_event_names[id]))
+			return id;
+	return -EINVAL;
+}
+
+/* Interrupts disabled: start @perf's counters on this CPU from zero. */
+static void perf_task_load(const struct perf_thread *perf)
+{
+	unsigned int events = perf->events, id, i;
+
+	for (i = 0; events; i++, events &= events - 1) {
+		id = __builtin_ctz(events);
+		wrmsr(MSR_IA32_PMC0 + i, 0);
+		wrmsr(MSR_IA32_PERFEVTSEL0 + i, perf_eventsel(id));
+	}
+}
+
+/* Interrupts disabled: stop @perf's counters and add them to its totals. */
+static void perf_task_save(struct perf_thread *perf)
+{
+	unsigned int events = perf->events, id, i;
+
+	for (i = 0; events; i++, events &= events - 1) {
+		id = __builtin_ctz(events);
+		wrmsr(MSR_IA32_PERFEVTSEL0 + i, 0);
+		perf->count[id] += rdmsr(MSR_IA32_PMC0 + i) & counter_mask;
+	}
+}
+
+/* Interrupts disabled; the counters are @prev's, if anyone's. */
+void perf_switch(struct task_struct *prev, struct task_struct *next)
+{
+	if (prev->thread.perf.events)
+		perf_task_save(&prev->thread.perf);
+	if (next->thread.perf.events)
+		perf_task_load(&next->thread.perf);
+}
+
+int perf_task_enable(unsigned int events)
+{
+	struct perf_thread *perf = &current->thread.perf;
+	unsigned long flags;
+
+	if (!nr_counters)
+		return -ENODEV;
+	if (!events || (events & ~perf_events_ok))
+		return -EINVAL;
+	if (hweight64(events) > nr_counters - 1)
+		return -ENOSPC;
+
+	flags = local_irq_save();
+	if (perf->events)
+		perf_task_save(perf);
+	perf->events = events;
+	memset(perf->count, 0, sizeof(perf->count));
+	perf_task_load(perf);
+	local_irq_restore(flags);
+	return 0;
+}
+
+void perf_task_disable(void)
+{
+	struct perf_thread *perf = &current->thread.perf;
+	unsigned long flags;
+
+	flags = local_irq_save();
+	if (perf->events)
+		perf_task_save(perf);
+	perf->events = 0;
+	local_irq_restore(flags);
+}
+
+int perf_task_read(struct task_struct *p, u64 counts[PERF_COUNT_HW_MAX])
+{
+	struct perf_thread *perf = &p->thread.perf;
+	unsigned int events, id, i;
+	unsigned long flags;
+
+	if (!nr_counters)
+		return -ENODEV;
+
+	flags = local_irq_save();
+	memcpy(counts, perf->count, sizeof(perf->count));
+	/* Still counting on this CPU: add what the counters have so far. */
+	events = p == current ? perf->events : 0;
+	for (i = 0; events; i++, events &= events - 1) {
+		id = __builtin_ctz(events);
+		counts[id] += rdmsr(MSR_IA32_PMC0 + i) & counter_mask;
+	}
+	local_irq_restore(flags);
+	return 0;
+}
+
+static void perf_sample_start_cpu(void *info)
+{
+	unsigned int c = sample_counter();
+
+	wrmsr(MSR_IA32_PERFEVTSEL0 + c, 0);
+	wrmsr(MSR_IA32_PMC0 + c, -sample_period);
+	wrmsr(MSR_IA32_PERFEVTSEL0 + c,
+	      perf_eventsel(sample_event) | EVENTSEL_INT);
+}
+
+static void perf_sample_stop_cpu(void *info)
+{
+	wrmsr(MSR_IA32_PERFEVTSEL0 + sample_counter(), 0);
+}
+
+/**
+ * perf_sample_start - sample on counter overflow
+ * @event: PERF_COUNT_HW_* to count
+ * @period: events between samples
+ *
+ * Every online CPU calls profile_sample() one @period of @event after
+ * the last.  Returns -EBUSY if sampling is already on.
+ */
+int perf_sample_start(unsigned int event, u64 period)
+{
+	if (!nr_counters || !apic_available())
+		return -ENODEV;
+	if (event >= PERF_COUNT_HW_MAX || !(perf_events_ok & (1U << event)) ||
+	    !period || period > PERF_MAX_PERIOD)
+		return -EINVAL;
+	if (READ_ONCE(sample_period))
+		return -EBUSY;
+
+	sample_event = event;
+	WRITE_ONCE(sample_period, period);
+	preempt_disable();
+	perf_sample_start_cpu(NULL);
+	preempt_enable();
+	smp_call_function(perf_sample_start_cpu, NULL);
+	return 0;
+}
+
+void perf_sample_stop(void)
+{
+	if (!READ_ONCE(sample_period))
+		return;
+	WRITE_ONCE(sample_period, 0);
+	preempt_disable();
+	perf_sample_stop_cpu(NULL);
+	preempt_enable();
+	smp_call_function(perf_sample_stop_cpu, NULL);
+}
+
+static void perf_pmi_interrupt(struct pt_regs *regs)
+{
+	u64 period = READ_ONCE(sample_period);
+	unsigned int c = sample_counter();
+
+	/* Only the sampling counter interrupts; just clear the status. */
+	if (perf_version >= 2)
+		wrmsr(MSR_IA32_PERF_GLOBAL_OVF_CTRL,
+		      rdmsr(MSR_IA32_PERF_GLOBAL_STATUS));
+	if (period) {
+		profile_sample(regs);
+		wrmsr(MSR_IA32_PMC0 + c, -period);
+	} else {
+		wrmsr(MSR_IA32_PERFEVTSEL0 + c, 0);
+	}
+	/* Delivering the interrupt masked the LVT entry. */
+	apic_write(APIC_LVTPC, PERF_PMI_VECTOR);
+	apic_eoi();
+}
+
+void perf_init_cpu(void)
+{
+	unsigned int i;
+
+	if (!nr_counters)
+		return;
+	for (i = 0; i < nr_counters; i++)
+		wrmsr(MSR_IA32_PERFEVTSEL0 + i, 0);
+	if (perf_version >= 2)
+		wrmsr(MSR_IA32_PERF_GLOBAL_CTRL, (1ULL << nr_counters) - 1);
+	if (apic_available())
+		apic_write(APIC_LVTPC, PERF_PMI_VECTOR);
+}
+
+void perf_init(void)
+{
+	u32 eax, ebx, ecx, edx, max_leaf;
+	unsigned int nr, width, len, id;
+
+	cpuid(0, &max_leaf, &ebx, &ecx, &edx);
+	if (max_leaf < 0xa) {
+		pr_info("no architectural performance monitoring\n");
+		return;
+	}
+	cpuid(0xa, &eax, &ebx, &ecx, &edx);
+	nr = (eax >> 8) & 0xff;
+	width = (eax >> 16) & 0xff;
+	len = eax >> 24;
+	/* One counter for tasks and one for sampling, at the least. */
+	if (!(eax & 0xff) || nr < 2 || !width) {
+		pr_info("no architectural performance monitoring\n");
+		return;
+	}
+
+	for (id = 0; id < PERF_COUNT_HW_MAX; id++)
+		if (perf_hw_events[id].cpuid_bit < len &&
+		    !(ebx & (1U << perf_hw_events[id].cpuid_bit)))
+			perf_events_ok |= 1U << id;
+	perf_version = eax & 0xff;
+	counter_mask = width >= 64 ? ~0ULL : (1ULL << width) - 1;
+	set_vector_handler(PERF_PMI_VECTOR, perf_pmi_interrupt);
+	nr_counters = min(nr, PERF_MAX_COUNTERS);
+	perf_init_cpu();
+	pr_info("version %u, %u counters of %u bits, events %#x\n",
+		perf_version, nr_counters, width, perf_events_ok);
+}
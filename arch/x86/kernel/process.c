@@ -0,0 +1,32 @@
+/*
+ * Task context: the per-CPU current task pointer and the initial stack
+ * of a new task.
+ */
+#include <zhos/kernel.h>
+#include <zhos/sched.h>
+#include <asm/current.h>
+#include <asm/switch_to.h>
+
+DEFINE_PER_CPU(struct task_struct *, current_task);
+
+/* What __switch_to_asm() pops, lowest address first. */
+struct fork_frame {
+	unsigned long r15, r14, r13, r12, rbx, rbp;
+	unsigned long ret_addr;
+};
+
+_Static_assert(__builtin_offsetof(struct task_struct, thread.sp) == 0,
+	       "entry_64.S expects thread.sp at offset 0");
+
+void copy_thread(struct task_struct *p, int (*fn)(void *), void *arg)
+{
+	struct fork_frame *frame;
+
+	frame = (struct fork_frame *)((char *)p->stack + THREAD_SIZE) - 1;
+	*frame = (struct fork_frame) {
+		.rbx = (unsigned long)fn,
+		.r12 = (unsigned long)arg,
+		.ret_addr = (unsigned long)ret_from_fork,
+	};
+	p->thread.sp = (unsigned long)frame;
+}
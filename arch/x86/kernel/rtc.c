@@ -0,0 +1,107 @@
+/*
+ * The CMOS real-time clock, read once at boot to start CLOCK_REALTIME.
+ *
+ * It counts whole seconds only and takes port I/O per field, so it is
+ * never read again: from here on the wall clock is the monotonic clock
+ * plus the offset this sets.
+ */
+#define pr_fmt(fmt) "rtc: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/time.h>
+#include <asm/io.h>
+#include <asm/irqflags.h>
+#include <asm/processor.h>
+#include <asm/rtc.h>
+
+#define RTC_PORT_INDEX		0x70
+#define RTC_PORT_DATA		0x71
+
+#define RTC_SECONDS		0x00
+#define RTC_MINUTES		0x02
+#define RTC_HOURS		0x04
+#define RTC_DAY_OF_MONTH	0x07
+#define RTC_MONTH		0x08
+#define RTC_YEAR		0x09
+#define RTC_REG_A		0x0a
+#define  RTC_UIP		0x80	/* update in progress */
+#define RTC_REG_B		0x0b
+#define  RTC_24H		0x02
+#define  RTC_DM_BINARY		0x04
+
+struct rtc_time {
+	unsigned int sec, min, hour, day, mon, year;
+};
+
+static u8 cmos_read(u8 reg)
+{
+	outb(reg, RTC_PORT_INDEX);
+	return inb(RTC_PORT_DATA);
+}
+
+static unsigned int bcd2bin(u8 v)
+{
+	return (v & 0x0f) + (v >> 4) * 10;
+}
+
+static void rtc_read_raw(struct rtc_time *t)
+{
+	while (cmos_read(RTC_REG_A) & RTC_UIP)
+		cpu_relax();
+	t->sec = cmos_read(RTC_SECONDS);
+	t->min = cmos_read(RTC_MINUTES);
+	t->hour = cmos_read(RTC_HOURS);
+	t->day = cmos_read(RTC_DAY_OF_MONTH);
+	t->mon = cmos_read(RTC_MONTH);
+	t->year = cmos_read(RTC_YEAR);
+}
+
+/**
+ * rtc_read_seconds - the CMOS clock, in seconds since the epoch
+ *
+ * The fields are read until two passes agree, so that an update between
+ * the UIP check and the reads cannot tear them.  Without a century
+ * register, two-digit years below 70 are taken to be 20xx.
+ *
+ * Returns 0 if the clock holds nothing sensible.
+ */
+u64 rtc_read_seconds(void)
+{
+	struct rtc_time t, prev;
+	unsigned long flags;
+	bool pm;
+	u8 b;
+
+	flags = local_irq_save();
+	rtc_read_raw(&t);
+	do {
+		prev = t;
+		rtc_read_raw(&t);
+	} while (t.sec != prev.sec || t.min != prev.min || t.hour != prev.hour ||
+		 t.day != prev.day || t.mon != prev.mon || t.year != prev.year);
+	b = cmos_read(RTC_REG_B);
+	local_irq_restore(flags);
+
+	pm = !(b & RTC_24H) && (t.hour & 0x80);
+	t.hour &= 0x7f;
+	if (!(b & RTC_DM_BINARY)) {
+		t.sec = bcd2bin(t.sec);
+		t.min = bcd2bin(t.min);
+		t.hour = bcd2bin(t.hour);
+		t.day = bcd2bin(t.day);
+		t.mon = bcd2bin(t.mon);
+		t.year = bcd2bin(t.year);
+	}
+	if (!(b & RTC_24H))
+		t.hour = t.hour % 12 + (pm ? 12 : 0);
+	t.year += t.year < 70 ? 2000 : 1900;
+
+	if (t.sec > 59 || t.min > 59 || t.hour > 23 || !t.day || t.day > 31 ||
+	    !t.mon || t.mon > 12) {
+		pr_warn("invalid time, wall clock starts at the epoch\n");
+		return 0;
+	}
+	pr_info("%04u-%02u-%02u %02u:%02u:%02u UTC\n", t.year, t.mon, t.day,
+		t.hour, t.min, t.sec);
+	return mktime64(t.year, t.mon, t.day, t.hour, t.min, t.sec);
+}
@@ -0,0 +1,72 @@
+/*
+ * Architecture setup: take over from the boot loader, record the memory
+ * map, bring up the descriptor tables and interrupt controllers, and
+ * enumerate the CPUs and memory nodes.
+ */
+#include <zhos/kernel.h>
+#include <zhos/cmdline.h>
+#include <zhos/memblock.h>
+#include <zhos/numa.h>
+#include <zhos/percpu.h>
+#include <asm/apic.h>
+#include <asm/desc.h>
+#include <asm/e820.h>
+#include <asm/i8259.h>
+#include <asm/page.h>
+#include <asm/pgtable.h>
+#include <asm/setup.h>
+#include <asm/smp.h>
+#include <asm/tlbflush.h>
+
+struct multiboot_info *boot_info;
+
+extern char _end[];
+
+/* Memory in use before the page allocator takes over what is left. */
+static void reserve_boot_memory(u32 mbi_phys)
+{
+	struct multiboot_module *mod;
+	u32 i;
+
+	/* BIOS data, EBDA, the SMP trampoline page, video memory and ROMs. */
+	memblock_reserve(0, KERNEL_LOAD_PHYS);
+	memblock_reserve(KERNEL_LOAD_PHYS, __pa_symbol(_end) - KERNEL_LOAD_PHYS);
+
+	/* Boot modules stay where the loader put them. */
+	memblock_reserve(mbi_phys, sizeof(*boot_info));
+	if (!(boot_info->flags & MULTIBOOT_INFO_MODS) || !boot_info->mods_count)
+		return;
+	memblock_reserve(boot_info->mods_addr,
+			 boot_info->mods_count * sizeof(*mod));
+	mod = phys_to_virt(boot_info->mods_addr);
+	for (i = 0; i < boot_info->mods_count; i++)
+		memblock_reserve(mod[i].mod_start,
+				 mod[i].mod_end - mod[i].mod_start);
+}
+
+void setup_arch(u32 magic, u32 mbi_phys)
+{
+	if (magic != MULTIBOOT_BOOTLOADER_MAGIC)
+		panic("not loaded by a multiboot loader (magic %x)", magic);
+
+	boot_info = phys_to_virt(mbi_phys);
+	if (boot_info->flags & MULTIBOOT_INFO_CMDLINE)
+		cmdline_init(phys_to_virt(boot_info->cmdline));
+	if (boot_command_line[0])
+		pr_info("command line: %s\n", boot_command_line);
+
+	e820__memory_setup();
+	reserve_boot_memory(mbi_phys);
+	init_mem_mapping();
+
+	setup_per_cpu_areas();
+	gdt_init(0);
+	idt_init();
+	tlb_init_cpu();
+	init_i8259();
+
+	acpi_boot_init();
+	numa_init();
+	apic_bsp_init();
+	smp_ipi_init();
+}
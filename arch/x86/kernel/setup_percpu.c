@@ -0,0 +1,45 @@
+/*
+ * Per-CPU areas.  The linker script reserves NR_CPUS copies of the
+ * .data..percpu template in .bss; each CPU's GS base points at its copy.
+ */
+#define pr_fmt(fmt) "percpu: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/percpu.h>
+#include <zhos/smp.h>
+#include <zhos/string.h>
+#include <asm/msr.h>
+
+extern char __per_cpu_start[], __per_cpu_end[], __per_cpu_areas[];
+
+unsigned long __per_cpu_offset[NR_CPUS];
+
+DEFINE_PER_CPU(unsigned long, this_cpu_off);
+DEFINE_PER_CPU(unsigned int, cpu_number);
+
+void load_percpu_segment(unsigned int cpu)
+{
+	wrmsr(MSR_GS_BASE, __per_cpu_offset[cpu]);
+}
+
+/*
+ * Until this runs the GS base is 0 and per-CPU accesses (the preempt count
+ * of early spinlocks) go to the template itself; they leave it balanced.
+ */
+void setup_per_cpu_areas(void)
+{
+	unsigned long size = __per_cpu_end - __per_cpu_start;
+	unsigned int cpu;
+
+	for (cpu = 0; cpu < NR_CPUS; cpu++) {
+		char *area = __per_cpu_areas + cpu * size;
+
+		memcpy(area, __per_cpu_start, size);
+		__per_cpu_offset[cpu] = area - __per_cpu_start;
+		per_cpu(this_cpu_off, cpu) = __per_cpu_offset[cpu];
+		per_cpu(cpu_number, cpu) = cpu;
+	}
+	load_percpu_segment(0);
+
+	pr_info("%u areas of %lu bytes\n", NR_CPUS, size);
+}
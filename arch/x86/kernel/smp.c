@@ -0,0 +1,106 @@
+/*
+ * Interprocessor interrupts.
+ */
+#include <zhos/kernel.h>
+#include <zhos/smp.h>
+#include <zhos/spinlock.h>
+#include <asm/apic.h>
+#include <asm/irq.h>
+#include <asm/processor.h>
+#include <asm/smp.h>
+
+/*
+ * The interrupt itself is the message.  The sender has set need_resched
+ * where it wants a reschedule; the return from the interrupt, or the
+ * idle loop once out of hlt, acts on it.  Otherwise it only makes an
+ * idle CPU re-evaluate its tick.
+ */
+static void reschedule_interrupt(struct pt_regs *regs)
+{
+	apic_eoi();
+}
+
+void smp_send_reschedule(unsigned int cpu)
+{
+	if (cpu_online(cpu))
+		apic_send_IPI(cpu, RESCHEDULE_VECTOR);
+}
+
+/*
+ * One cross-call at a time: call_lock serialises the senders, and the
+ * sender waits for every target to have run the function before it lets
+ * the next one in.  It waits with interrupts on, so that two CPUs
+ * calling each other cannot deadlock.
+ */
+static DEFINE_SPINLOCK(call_lock);
+static void (*call_func)(void *info);
+static void *call_info;
+static unsigned int call_pending;
+
+static void call_function_interrupt(struct pt_regs *regs)
+{
+	void (*func)(void *info) = READ_ONCE(call_func);
+	void *info = READ_ONCE(call_info);
+
+	apic_eoi();
+	func(info);
+	__atomic_sub_fetch(&call_pending, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * smp_call_function_many - run a function on some other online CPUs
+ * @mask: the CPUs; this one and offline ones are skipped
+ * @func: called from the interrupt handler, so it must not sleep
+ * @info: its argument
+ *
+ * Returns once each of them has run @func.  @mask may change meanwhile;
+ * the CPUs are those in it when the call is sent.  Must be called with
+ * interrupts enabled.
+ */
+void smp_call_function_many(const struct cpumask *mask,
+			    void (*func)(void *info), void *info)
+{
+	struct cpumask targets;
+	unsigned int cpu, self, i, n;
+
+	spin_lock(&call_lock);
+	self = smp_processor_id();
+	for (i = 0; i < CPUMASK_WORDS; i++)
+		targets.bits[i] = READ_ONCE(mask->bits[i]) &
+				  READ_ONCE(cpu_online_mask->bits[i]);
+	cpumask_clear_cpu(self, &targets);
+	n = cpumask_weight(&targets);
+	if (!n) {
+		spin_unlock(&call_lock);
+		return;
+	}
+	call_func = func;
+	call_info = info;
+	__atomic_store_n(&call_pending, n, __ATOMIC_RELEASE);
+	for_each_cpu(cpu, &targets)
+		apic_send_IPI(cpu, CALL_FUNCTION_VECTOR);
+	while (__atomic_load_n(&call_pending, __ATOMIC_ACQUIRE))
+		cpu_relax();
+	spin_unlock(&call_lock);
+}
+
+/**
+ * smp_call_function - run a function on every other online CPU
+ * @func: called from the interrupt handler, so it must not sleep
+ * @info: its argument
+ *
+ * Returns once every other CPU has run @func.  Must be called with
+ * interrupts enabled.
+ */
+void smp_call_function(void (*func)(void *info), void *info)
+{
+	if (num_online_cpus() == 1)
+		return;
+	smp_call_function_many(cpu_online_mask, func, info);
+}
+
+void smp_ipi_init(void)
+{
+	set_vector_handler(RESCHEDULE_VECTOR, reschedule_interrupt);
+	set_vector_handler(CALL_FUNCTION_VECTOR, call_function_interrupt);
+}
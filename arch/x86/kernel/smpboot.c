@@ -0,0 +1,129 @@
+/*
+ * Secondary CPU bring-up.
+ *
+ * Every CPU found in the MADT is started at once with the INIT-SIPI-SIPI
+ * sequence through the real-mode trampoline, which all of them run
+ * together, so bringing up more CPUs costs no more waiting than one.
+ * The APIC timer calibration from the boot CPU is shared, so a started
+ * CPU only sets up its own descriptor tables, APIC and tick, marks
+ * itself online and enters the idle loop, where it picks up (or steals)
+ * tasks.
+ */
+#define pr_fmt(fmt) "smp: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/cpumask.h>
+#include <zhos/delay.h>
+#include <zhos/sched.h>
+#include <zhos/smp.h>
+#include <zhos/string.h>
+#include <zhos/timekeeping.h>
+#include <zhos/timer.h>
+#include <asm/apic.h>
+#include <asm/barrier.h>
+#include <asm/desc.h>
+#include <asm/fpu.h>
+#include <asm/irqflags.h>
+#include <asm/page.h>
+#include <asm/percpu.h>
+#include <asm/perf_event.h>
+#include <asm/pgtable.h>
+#include <asm/smp.h>
+#include <asm/tlbflush.h>
+
+#define CPU_CALLIN_TIMEOUT_MS	1000
+
+static u8 secondary_stacks[NR_CPUS][SECONDARY_STACK_SIZE] __aligned(PAGE_SIZE);
+
+void __noreturn start_secondary(unsigned int cpu)
+{
+	gdt_init(cpu);
+	idt_load();
+	load_percpu_segment(cpu);
+	fpu_init_cpu();
+	tlb_init_cpu();
+
+	setup_local_APIC();
+	perf_init_cpu();
+	init_timers_cpu(cpu);
+	init_idle(cpu);
+	setup_secondary_APIC_clock();
+
+	set_cpu_online(cpu, true);
+
+	local_irq_enable();
+	cpu_idle_loop();
+}
+
+static struct trampoline_header *trampoline_hdr(void)
+{
+	return phys_to_virt(TRAMPOLINE_PHYS + (trampoline_header - trampoline_start));
+}
+
+static void send_init(unsigned int cpu)
+{
+	apic_icr_write(APIC_INT_LEVELTRIG | APIC_INT_ASSERT | APIC_DM_INIT,
+		       cpu_to_apicid[cpu]);
+}
+
+void smp_init(void)
+{
+	struct trampoline_header *th = trampoline_hdr();
+	unsigned int cpu, nr_cpus = 0;
+	u64 t0, timeout;
+	int i;
+
+	if (num_possible_cpus() == 1)
+		return;
+	if (!apic_timer_available()) {
+		pr_info("no APIC timer, staying on one CPU\n");
+		return;
+	}
+
+	memcpy(phys_to_virt(TRAMPOLINE_PHYS), trampoline_start,
+	       trampoline_end - trampoline_start);
+	for_each_possible_cpu(cpu)
+		nr_cpus = cpu + 1;
+	th->cr3 = __pa(swapper_pg_dir);
+	th->nr_cpus = nr_cpus;
+	th->entry = (u64)start_secondary;
+	th->stacks = (u64)secondary_stacks;
+	th->apicids = (u64)cpu_to_apicid;
+	mb();
+
+	/*
+	 * Intel MP specification: INIT, 10 ms, then two STARTUPs 200 us
+	 * apart, each step sent to every CPU before the wait.
+	 */
+	t0 = clock_now_ns();
+	for_each_possible_cpu(cpu)
+		if (cpu)
+			send_init(cpu);
+	mdelay(10);
+	for (i = 0; i < 2; i++) {
+		for_each_possible_cpu(cpu)
+			if (cpu)
+				apic_icr_write(APIC_DM_STARTUP |
+					       (TRAMPOLINE_PHYS >> PAGE_SHIFT),
+					       cpu_to_apicid[cpu]);
+		udelay(200);
+	}
+
+	timeout = t0 + CPU_CALLIN_TIMEOUT_MS * NSEC_PER_MSEC;
+	while (num_online_cpus() < num_possible_cpus() &&
+	       (s64)(clock_now_ns() - timeout) < 0)
+		cpu_relax();
+
+	for_each_possible_cpu(cpu) {
+		if (cpu_online(cpu))
+			continue;
+		/* Park it again, out of the trampoline. */
+		send_init(cpu);
+		pr_warn("CPU%u (APIC %u) did not start\n", cpu,
+			cpu_to_apicid[cpu]);
+		set_cpu_possible(cpu, false);
+	}
+
+	pr_info("%u CPUs online in %llu us\n", num_online_cpus(),
+		(unsigned long long)((clock_now_ns() - t0) / NSEC_PER_USEC));
+}
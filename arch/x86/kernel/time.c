@@ -0,0 +1,23 @@
+#include <zhos/kernel.h>
+#include <zhos/i8253.h>
+#include <zhos/tick.h>
+#include <zhos/timekeeping.h>
+#include <asm/apic.h>
+#include <asm/rtc.h>
+#include <asm/setup.h>
+#include <asm/tsc.h>
+
+/*
+ * The 8253 is a clocksource of last resort and the calibration reference
+ * for the TSC and APIC timer; it only ticks if there is no APIC timer.
+ * The wall clock is started from the RTC once the best clocksource is up.
+ */
+void time_init(void)
+{
+	tick_nohz_init();
+	clocksource_i8253_init();
+	tsc_init();
+	timekeeping_set_wall(rtc_read_seconds() * NSEC_PER_SEC);
+	if (!apic_timer_init())
+		clockevent_i8253_init();
+}
@@ -0,0 +1,67 @@
+/*
+ * CPU exception handling.  Only page faults in anonymous regions
+ * (arch/x86/mm/fault.c) and the first FPU use of a time slice (fpu.c)
+ * are recoverable; anything else: report and stop.
+ */
+#include <zhos/kernel.h>
+#include <asm/fpu.h>
+#include <asm/irq.h>
+#include <asm/processor.h>
+
+static const char *const exception_names[32] = {
+	[0]  = "divide error",
+	[1]  = "debug",
+	[2]  = "NMI",
+	[3]  = "breakpoint",
+	[4]  = "overflow",
+	[5]  = "bound range",
+	[6]  = "invalid opcode",
+	[7]  = "device not available",
+	[8]  = "double fault",
+	[10] = "invalid TSS",
+	[11] = "segment not present",
+	[12] = "stack segment",
+	[13] = "general protection",
+	[14] = "page fault",
+	[16] = "x87 FPU error",
+	[17] = "alignment check",
+	[18] = "machine check",
+	[19] = "SIMD exception",
+	[20] = "virtualization",
+	[21] = "control protection",
+};
+
+void show_regs(const struct pt_regs *regs)
+{
+	printk("RIP: %04lx:%016lx RFLAGS: %08lx\n", regs->cs, regs->rip, regs->rflags);
+	printk("RSP: %04lx:%016lx ERR: %lx\n", regs->ss, regs->rsp, regs->error_code);
+	printk("RAX: %016lx RBX: %016lx RCX: %016lx\n", regs->rax, regs->rbx, regs->rcx);
+	printk("RDX: %016lx RSI: %016lx RDI: %016lx\n", regs->rdx, regs->rsi, regs->rdi);
+	printk("RBP: %016lx R8:  %016lx R9:  %016lx\n", regs->rbp, regs->r8, regs->r9);
+	printk("R10: %016lx R11: %016lx R12: %016lx\n", regs->r10, regs->r11, regs->r12);
+	printk("R13: %016lx R14: %016lx R15: %016lx\n", regs->r13, regs->r14, regs->r15);
+	printk("CR2: %016lx CR3: %016lx\n", read_cr2(), read_cr3());
+}
+
+void do_trap(struct pt_regs *regs)
+{
+	unsigned int vector = regs->vector;
+	const char *name = exception_names[vector];
+
+	if (vector == 2) {
+		printk("NMI received at %lx\n", regs->rip);
+		return;
+	}
+	if (vector == 7) {
+		do_device_not_available();
+		return;
+	}
+	if (vector == 14) {
+		do_page_fault(regs);
+		return;
+	}
+
+	printk("\nexception %u (%s)\n", vector, name ? name : "reserved");
+	show_regs(regs);
+	panic("unhandled exception");
+}
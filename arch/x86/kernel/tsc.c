@@ -0,0 +1,227 @@
+/*
+ * Time stamp counter clocksource.
+ *
+ * The TSC frequency is measured against 8253 counter 2 at boot, after
+ * which timestamps cost one rdtsc instead of a latch command and two port
+ * reads.  Counter 2 is independent of the tick (counter 0) and is gated
+ * and polled through port 0x61, so calibration needs no interrupts and can
+ * run before any clock is up.
+ *
+ * A full calibration spends TSC_CALIBRATE_MS polling.  Its result is kept
+ * in the BIOS data area's inter-application communication area, which
+ * survives a warm reboot; the next boot only checks the cached value
+ * against a short TSC_VERIFY_MS window.
+ *
+ * Only an invariant TSC ticks at a constant rate through P- and C-state
+ * changes.  Any other is still registered, for want of anything better,
+ * but rated below the PIT so that timekeeping does not pick it.
+ */
+#define pr_fmt(fmt) "tsc: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/clocksource.h>
+#include <zhos/cmdline.h>
+#include <zhos/i8253.h>
+#include <zhos/timekeeping.h>
+#include <zhos/vdso.h>
+#include <asm/irqflags.h>
+#include <asm/page.h>
+#include <asm/processor.h>
+#include <asm/tsc.h>
+
+#define CPUID_1_EDX_TSC			(1 << 4)
+#define CPUID_80000007_EDX_INVTSC	(1 << 8)
+
+#define TSC_CALIBRATE_MS		50
+#define TSC_CALIBRATE_LOOPMIN		5000
+#define TSC_CALIBRATE_RETRIES		3
+#define TSC_VERIFY_MS			2
+#define TSC_VERIFY_LOOPMIN		200
+#define TSC_VERIFY_TOLERANCE		200	/* 1/200 = 0.5% */
+
+#define TSC_RATING			300
+#define TSC_RATING_UNSTABLE		100	/* below the PIT's 110 */
+
+/* BDA inter-application communication area, 0x4f0-0x4ff. */
+#define TSC_CACHE_PHYS			0x4f0
+#define TSC_CACHE_MAGIC			0x43435354	/* "TSCC" */
+
+struct tsc_cache {
+	u32 magic;
+	u32 khz;
+	u32 signature;		/* CPUID.1:EAX */
+	u32 csum;
+};
+
+unsigned long tsc_khz;
+
+static u64 tsc_read(struct clocksource *cs)
+{
+	return rdtsc_ordered();
+}
+
+static struct clocksource tsc_clocksource = {
+	.name	= "tsc",
+	.read	= tsc_read,
+	.mask	= CLOCKSOURCE_MASK(64),
+	.rating	= TSC_RATING,
+	.vdso_clock_mode = VDSO_CLOCKMODE_TSC,
+};
+
+/**
+ * pit_calibrate_tsc - count TSC cycles over one mode-0 run of counter 2
+ *
+ * The longest gap between two polls of counter 2 gives away SMIs or a
+ * preempted vCPU; such runs are rejected.
+ *
+ * Returns kHz, or 0 if the run was disturbed.
+ */
+static unsigned long pit_calibrate_tsc(u32 latch, int loopmin)
+{
+	u64 start, prev, now, delta, dmin = ~0ULL, dmax = 0;
+	unsigned long flags;
+	int loops = 0;
+
+	flags = local_irq_save();
+
+	pit_ch2_start(latch);
+
+	start = prev = now = rdtsc_ordered();
+	while (!pit_ch2_expired()) {
+		now = rdtsc_ordered();
+		delta = now - prev;
+		prev = now;
+		if (delta < dmin)
+			dmin = delta;
+		if (delta > dmax)
+			dmax = delta;
+		loops++;
+	}
+
+	pit_ch2_stop();
+	local_irq_restore(flags);
+
+	if (loops < loopmin || dmax > 10 * dmin)
+		return 0;
+
+	/* latch PIT clocks took (now - start) TSC cycles */
+	return (now - start) * PIT_TICK_RATE / latch / 1000;
+}
+
+static u32 pit_latch_ms(unsigned int ms)
+{
+	return PIT_TICK_RATE * ms / 1000;
+}
+
+static u32 cpu_signature(void)
+{
+	u32 a, b, c, d;
+
+	cpuid(1, &a, &b, &c, &d);
+	return a;
+}
+
+static u32 tsc_cache_csum(const struct tsc_cache *tc)
+{
+	return ~(tc->magic ^ tc->khz ^ tc->signature);
+}
+
+static unsigned long tsc_cache_lookup(void)
+{
+	struct tsc_cache *tc = phys_to_virt(TSC_CACHE_PHYS);
+	unsigned long khz, cached;
+
+	if (tc->magic != TSC_CACHE_MAGIC || tc->csum != tsc_cache_csum(tc) ||
+	    tc->signature != cpu_signature())
+		return 0;
+
+	cached = tc->khz;
+	khz = pit_calibrate_tsc(pit_latch_ms(TSC_VERIFY_MS), TSC_VERIFY_LOOPMIN);
+	if (!khz)
+		return 0;
+	if (khz > cached + cached / TSC_VERIFY_TOLERANCE ||
+	    khz < cached - cached / TSC_VERIFY_TOLERANCE) {
+		pr_info("cached %lu kHz, measured %lu kHz: recalibrating\n",
+			cached, khz);
+		return 0;
+	}
+	return cached;
+}
+
+static void tsc_cache_store(unsigned long khz)
+{
+	struct tsc_cache *tc = phys_to_virt(TSC_CACHE_PHYS);
+
+	tc->magic = TSC_CACHE_MAGIC;
+	tc->khz = khz;
+	tc->signature = cpu_signature();
+	tc->csum = tsc_cache_csum(tc);
+}
+
+static unsigned long tsc_calibrate(void)
+{
+	unsigned long khz;
+	int i;
+
+	khz = tsc_cache_lookup();
+	if (khz) {
+		pr_info("using cached calibration\n");
+		return khz;
+	}
+
+	for (i = 0; i < TSC_CALIBRATE_RETRIES; i++) {
+		khz = pit_calibrate_tsc(pit_latch_ms(TSC_CALIBRATE_MS),
+					TSC_CALIBRATE_LOOPMIN);
+		if (khz) {
+			tsc_cache_store(khz);
+			return khz;
+		}
+	}
+	return 0;
+}
+
+static bool tsc_invariant(void)
+{
+	u32 a, b, c, d;
+
+	cpuid(0x80000000, &a, &b, &c, &d);
+	if (a < 0x80000007)
+		return false;
+	cpuid(0x80000007, &a, &b, &c, &d);
+	return d & CPUID_80000007_EDX_INVTSC;
+}
+
+void tsc_init(void)
+{
+	u32 a, b, c, d;
+	char opt[16];
+
+	cpuid(1, &a, &b, &c, &d);
+	if (!(d & CPUID_1_EDX_TSC)) {
+		pr_info("no TSC, staying on %s\n", current_clocksource_name());
+		return;
+	}
+	if (!cmdline_get("tsc", opt, sizeof(opt)) && !strcmp(opt, "unstable")) {
+		pr_info("marked unstable on the command line\n");
+		return;
+	}
+
+	if (!cmdline_get("tsc_khz", opt, sizeof(opt)))
+		tsc_khz = simple_strtoull(opt, NULL, 0);
+	else
+		tsc_khz = tsc_calibrate();
+	if (!tsc_khz) {
+		pr_warn("calibration failed\n");
+		return;
+	}
+	if (tsc_invariant()) {
+		pr_info("%lu.%03lu MHz, invariant\n", tsc_khz / 1000,
+			tsc_khz % 1000);
+	} else {
+		tsc_clocksource.rating = TSC_RATING_UNSTABLE;
+		pr_info("%lu.%03lu MHz, not invariant: rated below the PIT\n",
+			tsc_khz / 1000, tsc_khz % 1000);
+	}
+
+	clocksource_register_khz(&tsc_clocksource, tsc_khz);
+}
@@ -0,0 +1,306 @@
+/*
+ * SIMD memory and checksum primitives, and the choice between them.
+ *
+ * The SSE2 and AVX2 variants wrap the block loops in string_64.S.  Below
+ * SIMD_MIN_BYTES, or in an interrupt that arrived inside someone else's
+ * kernel_fpu_begin(), the portable version does all the work: claiming
+ * the FPU costs a CR0 write each way, and a save when the task has live
+ * registers, which only a long run amortises.  Otherwise the head up to
+ * the destination's alignment and the tail after the last whole block go
+ * to the portable version too.
+ *
+ * string_init() times each variant the CPU can run on a 4 KiB buffer,
+ * the best of a few runs, and points each primitive's jump at the
+ * fastest.  Rep movsb usually wins copies on CPUs that have fast string
+ * operations; the vector loops win compares and checksums.
+ */
+#define pr_fmt(fmt) "string: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/checksum.h>
+#include <zhos/gfp.h>
+#include <zhos/mm.h>
+#include <zhos/string.h>
+#include <asm/fpu.h>
+#include <asm/processor.h>
+#include <asm/string.h>
+#include <asm/tsc.h>
+
+#define SIMD_MIN_BYTES		512
+#define TIME_BYTES		4096
+#define TIME_ROUNDS		8
+
+typedef void (*copy_loop_t)(void *dst, const void *src, size_t n);
+typedef void (*set_loop_t)(void *s, int c, size_t n);
+typedef size_t (*cmp_loop_t)(const void *a, const void *b, size_t n);
+typedef u64 (*csum_loop_t)(const void *buf, size_t n);
+
+static __always_inline void *simd_memcpy(void *dst, const void *src,
+					 size_t n, size_t align,
+					 copy_loop_t loop)
+{
+	char *d = dst;
+	const char *s = src;
+	size_t head, bulk;
+
+	if (n < SIMD_MIN_BYTES || !irq_fpu_usable())
+		return memcpy_generic(dst, src, n);
+	head = -(unsigned long)d & (align - 1);
+	bulk = (n - head) & ~63UL;
+	memcpy_generic(d, s, head);
+	kernel_fpu_begin();
+	loop(d + head, s + head, bulk);
+	kernel_fpu_end();
+	memcpy_generic(d + head + bulk, s + head + bulk, n - head - bulk);
+	return dst;
+}
+
+void *memcpy_sse2(void *dst, const void *src, size_t n)
+{
+	return simd_memcpy(dst, src, n, 16, __memcpy_sse2);
+}
+
+void *memcpy_avx2(void *dst, const void *src, size_t n)
+{
+	return simd_memcpy(dst, src, n, 32, __memcpy_avx2);
+}
+
+static __always_inline void *simd_memset(void *s, int c, size_t n,
+					 size_t align, set_loop_t loop)
+{
+	char *p = s;
+	size_t head, bulk;
+
+	if (n < SIMD_MIN_BYTES || !irq_fpu_usable())
+		return memset_generic(s, c, n);
+	head = -(unsigned long)p & (align - 1);
+	bulk = (n - head) & ~63UL;
+	memset_generic(p, c, head);
+	kernel_fpu_begin();
+	loop(p + head, c, bulk);
+	kernel_fpu_end();
+	memset_generic(p + head + bulk, c, n - head - bulk);
+	return s;
+}
+
+void *memset_sse2(void *s, int c, size_t n)
+{
+	return simd_memset(s, c, n, 16, __memset_sse2);
+}
+
+void *memset_avx2(void *s, int c, size_t n)
+{
+	return simd_memset(s, c, n, 32, __memset_avx2);
+}
+
+static __always_inline int simd_memcmp(const void *a, const void *b,
+				       size_t n, size_t vec, cmp_loop_t loop)
+{
+	const char *x = a, *y = b;
+	size_t same;
+
+	if (n < SIMD_MIN_BYTES || !irq_fpu_usable())
+		return memcmp_generic(a, b, n);
+	kernel_fpu_begin();
+	same = loop(x, y, n & ~(vec - 1));
+	kernel_fpu_end();
+	/* The first unequal vector, if any, and the tail. */
+	return memcmp_generic(x + same, y + same, n - same);
+}
+
+int memcmp_sse2(const void *a, const void *b, size_t n)
+{
+	return simd_memcmp(a, b, n, 16, __memcmp_sse2);
+}
+
+int memcmp_avx2(const void *a, const void *b, size_t n)
+{
+	return simd_memcmp(a, b, n, 32, __memcmp_avx2);
+}
+
+/*
+ * The vector loop's sum, folded to 32 bits with end-around carry, is
+ * just another partial sum; whole vectors keep the tail's bytes in the
+ * same lanes as the portable version would have them.
+ */
+static __always_inline u32 simd_csum(const void *buf, unsigned int len,
+				     u32 sum, size_t vec, csum_loop_t loop)
+{
+	const char *p = buf;
+	size_t bulk = len & ~(vec - 1);
+	u64 acc;
+
+	if (len < SIMD_MIN_BYTES || !irq_fpu_usable())
+		return csum_partial_generic(buf, len, sum);
+	kernel_fpu_begin();
+	acc = loop(p, bulk);
+	kernel_fpu_end();
+	acc = (acc & 0xffffffff) + (acc >> 32) + sum;
+	acc = (acc & 0xffffffff) + (acc >> 32);
+	acc = (acc & 0xffffffff) + (acc >> 32);
+	return csum_partial_generic(p + bulk, len - bulk, acc);
+}
+
+u32 csum_partial_sse2(const void *buf, unsigned int len, u32 sum)
+{
+	return simd_csum(buf, len, sum, 16, __csum_sse2);
+}
+
+u32 csum_partial_avx2(const void *buf, unsigned int len, u32 sum)
+{
+	return simd_csum(buf, len, sum, 32, __csum_avx2);
+}
+
+/* Selection. */
+
+enum {
+	NEEDS_NOTHING,
+	NEEDS_ERMS,
+	NEEDS_AVX2,
+};
+
+struct string_variant {
+	const char *name;
+	unsigned int needs;
+	void *fn;
+};
+
+struct string_func {
+	const char *name;
+	void *entry;			/* its patchable jmp */
+	void (*run)(void *fn, void *a, void *b);
+	struct string_variant variants[4];	/* NULL name ends */
+};
+
+static void run_memcpy(void *fn, void *a, void *b)
+{
+	((void *(*)(void *, const void *, size_t))fn)(a, b, TIME_BYTES);
+}
+
+static void run_memset(void *fn, void *a, void *b)
+{
+	((void *(*)(void *, int, size_t))fn)(a, 0x5a, TIME_BYTES);
+}
+
+static void run_memcmp(void *fn, void *a, void *b)
+{
+	((int (*)(const void *, const void *, size_t))fn)(a, b, TIME_BYTES);
+}
+
+static void run_csum(void *fn, void *a, void *b)
+{
+	((u32 (*)(const void *, unsigned int, u32))fn)(a, TIME_BYTES, 0);
+}
+
+/* Set and copy first: compare and checksum then run on equal buffers. */
+static struct string_func string_funcs[] = {
+	{ "memset", memset, run_memset, {
+		{ "generic", NEEDS_NOTHING, memset_generic },
+		{ "erms", NEEDS_ERMS, memset_erms },
+		{ "sse2", NEEDS_NOTHING, memset_sse2 },
+		{ "avx2", NEEDS_AVX2, memset_avx2 },
+	} },
+	{ "memcpy", memcpy, run_memcpy, {
+		{ "generic", NEEDS_NOTHING, memcpy_generic },
+		{ "erms", NEEDS_ERMS, memcpy_erms },
+		{ "sse2", NEEDS_NOTHING, memcpy_sse2 },
+		{ "avx2", NEEDS_AVX2, memcpy_avx2 },
+	} },
+	{ "memcmp", memcmp, run_memcmp, {
+		{ "generic", NEEDS_NOTHING, memcmp_generic },
+		{ "sse2", NEEDS_NOTHING, memcmp_sse2 },
+		{ "avx2", NEEDS_AVX2, memcmp_avx2 },
+	} },
+	{ "csum_partial", csum_partial, run_csum, {
+		{ "generic", NEEDS_NOTHING, csum_partial_generic },
+		{ "sse2", NEEDS_NOTHING, csum_partial_sse2 },
+		{ "avx2", NEEDS_AVX2, csum_partial_avx2 },
+	} },
+};
+
+static bool cpu_can_run(unsigned int needs)
+{
+	u32 max, a, b, c, d;
+
+	if (needs == NEEDS_NOTHING)
+		return true;
+	cpuid(0, &max, &b, &c, &d);
+	if (max < 7)
+		return false;
+	cpuid_count(7, 0, &a, &b, &c, &d);
+	if (needs == NEEDS_ERMS)
+		return b & (1U << 9);
+	/* AVX2, and fpu.c having enabled the YMM state in XCR0. */
+	return (b & (1U << 5)) && (read_cr4() & X86_CR4_OSXSAVE) &&
+	       (xgetbv(0) & 6) == 6;
+}
+
+/* Point the jmp at @entry to @target; the APs are not running yet. */
+static void patch_jmp(void *entry, void *target)
+{
+	u8 *p = entry;
+	u32 rel = (unsigned long)target - (unsigned long)(p + 5);
+	unsigned int i;
+
+	BUG_ON(p[0] != 0xe9);
+	for (i = 0; i < 4; i++)
+		WRITE_ONCE(p[1 + i], rel >> (8 * i));
+	sync_core();
+}
+
+static u64 time_variant(struct string_func *f, void *fn, void *a, void *b)
+{
+	u64 best = ~0ULL, t;
+	unsigned int i;
+
+	for (i = 0; i < TIME_ROUNDS; i++) {
+		t = rdtsc_ordered();
+		f->run(fn, a, b);
+		t = rdtsc_ordered() - t;
+		best = min(best, t);
+	}
+	return best;
+}
+
+void string_init(void)
+{
+	struct string_func *f;
+	struct string_variant *v, *fastest;
+	struct page *page;
+	char line[128] = "";
+	unsigned int i, j, n;
+	u64 t, best;
+	void *a, *b;
+
+	page = alloc_pages(GFP_KERNEL, get_order(2 * TIME_BYTES));
+	if (!page) {
+		pr_warn("no memory to time the variants with\n");
+		return;
+	}
+	a = page_address(page);
+	b = a + TIME_BYTES;
+	memset_generic(b, 0x5a, TIME_BYTES);
+
+	for (j = 0; j < ARRAY_SIZE(string_funcs); j++) {
+		f = &string_funcs[j];
+		fastest = NULL;
+		best = ~0ULL;
+		n = 0;
+		for (i = 0; i < ARRAY_SIZE(f->variants); i++) {
+			v = &f->variants[i];
+			if (!v->name || !cpu_can_run(v->needs))
+				continue;
+			t = time_variant(f, v->fn, a, b);
+			n += snprintf(line + n, sizeof(line) - n, " %s %llu",
+				      v->name, (unsigned long long)t);
+			if (t < best) {
+				best = t;
+				fastest = v;
+			}
+		}
+		patch_jmp(f->entry, fastest->fn);
+		pr_info("%s:%s cycles/%u bytes, using %s\n", f->name, line,
+			TIME_BYTES, fastest->name);
+	}
+	__free_pages(page, get_order(2 * TIME_BYTES));
+}
@@ -0,0 +1,64 @@
+/*
+ * Page faults.  The only ones expected are in anonymous regions, which
+ * sit between VMAP_START and VMAP_END in the current address space:
+ * first touches, and writes to pages shared copy-on-write since a fork.
+ * The rest are bugs and stop the machine, as any other exception does.
+ */
+#include <zhos/kernel.h>
+#include <zhos/errno.h>
+#include <zhos/mm.h>
+#include <zhos/mm_types.h>
+#include <zhos/preempt.h>
+#include <zhos/sched.h>
+#include <asm/irq.h>
+#include <asm/irqflags.h>
+#include <asm/pgtable.h>
+#include <asm/processor.h>
+
+/* error_code bits */
+#define X86_PF_PROT		(1UL << 0)	/* page was present */
+#define X86_PF_WRITE		(1UL << 1)
+#define X86_PF_USER		(1UL << 2)
+#define X86_PF_RSVD		(1UL << 3)
+
+static void __noreturn bad_page_fault(struct pt_regs *regs,
+				      unsigned long addr, const char *why)
+{
+	printk("\npage fault at %016lx: %s (%s, %s)\n", addr, why,
+	       regs->error_code & X86_PF_WRITE ? "write" : "read",
+	       regs->error_code & X86_PF_PROT ? "present" : "not present");
+	show_regs(regs);
+	panic("unhandled page fault");
+}
+
+void do_page_fault(struct pt_regs *regs)
+{
+	unsigned long addr = read_cr2();
+	unsigned int flags = 0;
+	int ret;
+
+	if (addr < VMAP_START || addr >= VMAP_END)
+		bad_page_fault(regs, addr, "no mapping");
+	if (regs->error_code & (X86_PF_RSVD | X86_PF_USER))
+		bad_page_fault(regs, addr, "bad access");
+	/* Every mapping is readable: a protection fault has to be a write. */
+	if (regs->error_code & X86_PF_WRITE)
+		flags |= FAULT_FLAG_WRITE;
+	else if (regs->error_code & X86_PF_PROT)
+		bad_page_fault(regs, addr, "bad access");
+	/*
+	 * Backing the page takes mmap_lock, which neither an interrupted
+	 * holder on this CPU nor a TLB shootdown waiting on it could get
+	 * past.
+	 */
+	if (in_interrupt() || !(regs->rflags & X86_EFLAGS_IF))
+		bad_page_fault(regs, addr, "in atomic context");
+
+	/* Zeroing a huge page takes a while: let interrupts in. */
+	local_irq_enable();
+	ret = handle_mm_fault(current->mm ?: &init_mm, addr, flags);
+	local_irq_disable();
+	if (ret)
+		bad_page_fault(regs, addr, ret == -EFAULT ? "no region" :
+			       "out of memory");
+}
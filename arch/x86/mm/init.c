@@ -0,0 +1,128 @@
+/*
+ * The kernel page tables.
+ *
+ * header.S maps just enough to get going: the low 4 GiB identity mapped
+ * with 2 MiB pages, and the kernel image again at -2 GiB.  Once memblock
+ * knows where RAM is, the tables are rebuilt to cover all of it.  The
+ * low 4 GiB, which also holds the devices, keep 2 MiB pages; RAM above
+ * it gets 1 GiB pages where the CPU has them and a whole gigabyte is
+ * RAM, 2 MiB pages elsewhere.  Either way a direct map access costs one
+ * TLB entry per 2 MiB or more, never per 4 KiB.
+ *
+ * Everything else the kernel maps (mm/memory.c) goes into the same
+ * tables: every CPU runs on swapper_pg_dir.
+ */
+#define pr_fmt(fmt) "mm: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/memblock.h>
+#include <zhos/mm.h>
+#include <zhos/mm_types.h>
+#include <zhos/string.h>
+#include <asm/page.h>
+#include <asm/pgtable.h>
+#include <asm/processor.h>
+#include <asm/tlbflush.h>
+
+extern char boot_pml4[];
+
+pgd_t *swapper_pg_dir = (pgd_t *)boot_pml4;
+
+/* Most physical memory the page tables are built to cover: 64 TiB. */
+#define MAXMEM			(1ULL << 46)
+
+static unsigned long nr_gbpages, nr_lpages;
+
+/* Page tables must be below 4 GiB: APs load cr3 in 32-bit mode. */
+static void *alloc_low_table(void)
+{
+	void *p = phys_to_virt(memblock_alloc(PAGE_SIZE, PAGE_SIZE));
+
+	memset(p, 0, PAGE_SIZE);
+	return p;
+}
+
+static bool cpu_has_gbpages(void)
+{
+	u32 a, b, c, d;
+
+	cpuid(0x80000001, &a, &b, &c, &d);
+	return d & (1U << 26);
+}
+
+static void map_pmd_range(pud_t *pud, phys_addr_t start, phys_addr_t end)
+{
+	pmd_t *pmd;
+
+	if (pud_none(*pud))
+		set_pud(pud, __pud(__pa(alloc_low_table()) | _KERNPG_TABLE));
+	pmd = pmd_offset(pud, start);
+	for (; start < end; start += PMD_SIZE, pmd++) {
+		set_pmd(pmd, pfn_pmd(PFN_DOWN(start), PAGE_KERNEL_LARGE));
+		nr_lpages++;
+	}
+}
+
+/* Identity map [0, end), end a multiple of 2 MiB. */
+static void map_direct(pgd_t *pgd, phys_addr_t end, bool gbpages)
+{
+	phys_addr_t pa, next;
+	pud_t *pud;
+
+	for (pa = 0; pa < end; pa = next) {
+		next = min(ALIGN_DOWN(pa, PUD_SIZE) + PUD_SIZE, end);
+		if (pgd_none(pgd[pgd_index(pa)]))
+			set_pgd(&pgd[pgd_index(pa)],
+				__pgd(__pa(alloc_low_table()) | _KERNPG_TABLE));
+		pud = pud_offset(&pgd[pgd_index(pa)], pa);
+		if (gbpages && pa >= BOOT_IDENTITY_SIZE &&
+		    next - pa == PUD_SIZE &&
+		    memblock_is_region_memory(pa, PUD_SIZE)) {
+			set_pud(pud, __pud(pa | PAGE_KERNEL_LARGE));
+			nr_gbpages++;
+			continue;
+		}
+		map_pmd_range(pud, pa, next);
+	}
+}
+
+/**
+ * init_mem_mapping - map all of RAM and switch every CPU to it
+ *
+ * Called once from setup_arch(), after memblock knows the memory map
+ * and before anything is allocated above 4 GiB.
+ */
+void init_mem_mapping(void)
+{
+	phys_addr_t end, ram_end;
+	pud_t *pud_low, *pud_high;
+	pgd_t *pgd;
+
+	/* The end of RAM, wherever it is, not just below the boot map. */
+	memblock_limit = MAXMEM;
+	ram_end = memblock_end_of_DRAM();
+	memblock_limit = BOOT_IDENTITY_SIZE;
+
+	end = max(ALIGN(ram_end, PMD_SIZE), (phys_addr_t)BOOT_IDENTITY_SIZE);
+	pgd = alloc_low_table();
+	map_direct(pgd, end, cpu_has_gbpages());
+
+	/*
+	 * The image at -2 GiB shares the tables mapping physical 0-2 GiB,
+	 * the two PD pages under the first two PUD entries.
+	 */
+	pud_low = pgd_page_vaddr(pgd[0]);
+	pud_high = alloc_low_table();
+	pud_high[510] = pud_low[0];
+	pud_high[511] = pud_low[1];
+	set_pgd(&pgd[pgd_index(__START_KERNEL_map)],
+		__pgd(__pa(pud_high) | _KERNPG_TABLE));
+
+	write_cr3(__pa(pgd));
+	swapper_pg_dir = pgd;
+	init_mm.pgd = pgd;
+	memblock_limit = end;
+
+	pr_info("direct map 0x0-0x%llx: %lu 1G, %lu 2M pages\n",
+		(unsigned long long)end, nr_gbpages, nr_lpages);
+}
@@ -0,0 +1,180 @@
+/*
+ * NUMA nodes.
+ *
+ * The firmware tables (drivers/acpi/numa.c) give the memory ranges of
+ * each node, the node of each CPU by APIC id, and the distances between
+ * nodes.  numa_init() turns them into each CPU's node and, for each node,
+ * the order in which the page allocator falls back to the others,
+ * nearest first.  Every frame's node is kept in its struct page; until
+ * page_alloc_init() has recorded it there, early_pfn_to_nid() looks it
+ * up in the ranges here.
+ *
+ * Memory the SRAT does not cover goes to node 0, as do CPUs it does not
+ * mention.  Without a usable SRAT, or with "numa=off", node 0 is all
+ * there is.
+ */
+#define pr_fmt(fmt) "numa: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/cmdline.h>
+#include <zhos/cpumask.h>
+#include <zhos/errno.h>
+#include <zhos/numa.h>
+#include <zhos/percpu.h>
+#include <zhos/string.h>
+#include <asm/apic.h>
+#include <asm/page.h>
+
+#define NR_NODE_MEMBLKS		(MAX_NUMNODES * 4)
+#define MAX_LOCAL_APIC		256
+
+struct numa_memblk {
+	u64 start, end;
+	int nid;
+};
+
+static struct numa_memblk numa_memblks[NR_NODE_MEMBLKS];
+static unsigned int nr_memblks;
+static s8 apicid_to_node[MAX_LOCAL_APIC];
+static u8 numa_distance[MAX_NUMNODES][MAX_NUMNODES];	/* 0: not given */
+
+unsigned int nr_node_ids = 1;
+u8 node_order[MAX_NUMNODES][MAX_NUMNODES];
+DEFINE_PER_CPU(int, numa_node);
+
+int numa_add_memblk(int nid, u64 start, u64 end)
+{
+	if (nr_memblks >= NR_NODE_MEMBLKS)
+		return -ENOSPC;
+	numa_memblks[nr_memblks].start = start;
+	numa_memblks[nr_memblks].end = end;
+	numa_memblks[nr_memblks].nid = nid;
+	nr_memblks++;
+	return 0;
+}
+
+void numa_set_apicid_node(u32 apicid, int nid)
+{
+	if (apicid < MAX_LOCAL_APIC)
+		apicid_to_node[apicid] = nid;
+}
+
+void numa_set_distance(int from, int to, int distance)
+{
+	/* Local is 10 by definition, anything else further. */
+	if ((from == to) != (distance == LOCAL_DISTANCE) ||
+	    distance < LOCAL_DISTANCE || distance > 254)
+		return;
+	numa_distance[from][to] = distance;
+}
+
+int node_distance(int from, int to)
+{
+	if (from == to)
+		return LOCAL_DISTANCE;
+	return numa_distance[from][to] ?: REMOTE_DISTANCE;
+}
+
+int early_pfn_to_nid(unsigned long pfn)
+{
+	static unsigned int last;
+	u64 addr = (u64)pfn << PAGE_SHIFT;
+	struct numa_memblk *mb;
+	unsigned int i;
+
+	/* Called for every frame in turn: the last hit is the likely one. */
+	for (i = 0; i < nr_memblks; i++) {
+		mb = &numa_memblks[(last + i) % nr_memblks];
+		if (addr >= mb->start && addr < mb->end) {
+			last = (last + i) % nr_memblks;
+			return mb->nid;
+		}
+	}
+	return 0;
+}
+
+static void numa_reset(void)
+{
+	unsigned int i;
+
+	nr_memblks = 0;
+	nr_node_ids = 1;
+	memset(numa_distance, 0, sizeof(numa_distance));
+	for (i = 0; i < MAX_LOCAL_APIC; i++)
+		apicid_to_node[i] = NUMA_NO_NODE;
+}
+
+/* Nearest first; equally near nodes by id. */
+static void build_node_order(void)
+{
+	unsigned int nid, i, j;
+	u8 *order, t;
+
+	for (nid = 0; nid < nr_node_ids; nid++) {
+		order = node_order[nid];
+		for (i = 0; i < nr_node_ids; i++)
+			order[i] = i;
+		for (i = 1; i < nr_node_ids; i++) {
+			for (j = i; j > 0; j--) {
+				if (node_distance(nid, order[j - 1]) <=
+				    node_distance(nid, order[j]))
+					break;
+				t = order[j];
+				order[j] = order[j - 1];
+				order[j - 1] = t;
+			}
+		}
+	}
+}
+
+static u64 node_memory(int nid)
+{
+	u64 bytes = 0;
+	unsigned int i;
+
+	for (i = 0; i < nr_memblks; i++)
+		if (numa_memblks[i].nid == nid)
+			bytes += numa_memblks[i].end - numa_memblks[i].start;
+	return bytes;
+}
+
+void numa_init(void)
+{
+	unsigned int cpu, nid, i, n, len;
+	char val[8], line[64];
+	int max = 0, node;
+
+	numa_reset();
+	if (!cmdline_get("numa", val, sizeof(val)) && !strcmp(val, "off")) {
+		pr_info("off\n");
+	} else if (acpi_numa_init()) {
+		numa_reset();
+	} else {
+		for (i = 0; i < nr_memblks; i++)
+			max = max(max, numa_memblks[i].nid);
+		for (i = 0; i < MAX_LOCAL_APIC; i++)
+			max = max(max, (int)apicid_to_node[i]);
+		nr_node_ids = max + 1;
+	}
+
+	for_each_possible_cpu(cpu) {
+		node = cpu_to_apicid[cpu] < MAX_LOCAL_APIC ?
+		       apicid_to_node[cpu_to_apicid[cpu]] : NUMA_NO_NODE;
+		per_cpu(numa_node, cpu) = node == NUMA_NO_NODE ? 0 : node;
+	}
+	build_node_order();
+
+	if (nr_node_ids == 1)
+		return;
+	for (nid = 0; nid < nr_node_ids; nid++) {
+		n = 0;
+		for_each_possible_cpu(cpu)
+			n += cpu_to_node(cpu) == (int)nid;
+		line[0] = '\0';
+		for (i = 0, len = 0; i < nr_node_ids; i++)
+			len += snprintf(line + len, sizeof(line) - len, " %d",
+					node_distance(nid, i));
+		pr_info("node %u: %llu MiB, %u CPUs, distances%s\n", nid,
+			(unsigned long long)node_memory(nid) >> 20, n, line);
+	}
+}
@@ -0,0 +1,249 @@
+/*
+ * TLB shootdown and address space switches.
+ *
+ * All CPUs share the kernel's page tables, so a kernel mapping that is
+ * removed or changed has to leave every TLB before its memory can be
+ * reused.  Short ranges are dropped a page at a time with invlpg; beyond
+ * a few dozen pages reloading cr3 and refilling costs less.
+ *
+ * Where the CPU has PCIDs, it keeps the translations of the last
+ * TLB_NR_DYN_ASIDS address spaces it ran, each under its own PCID, so
+ * that switching back to one flushes nothing and refills nothing.  A
+ * slot records the mm it holds by ctx_id, which is never reused, and how
+ * far that mm's flushes have reached it by tlb_gen.  A flush of an mm
+ * bumps the mm's tlb_gen and interrupts only the CPUs in its cpumask,
+ * those that have it loaded; a CPU holding the mm in an idle slot has
+ * left the mask, and sees the generation has moved on when it next
+ * switches to it, and flushes that PCID then.  Kernel mappings are in
+ * every PCID, so a kernel flush also empties all the idle slots.
+ *
+ * Without PCIDs the same bookkeeping runs with one slot, and every
+ * switch to another mm flushes it.
+ */
+#define pr_fmt(fmt) "tlb: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/mm_types.h>
+#include <zhos/percpu.h>
+#include <zhos/preempt.h>
+#include <zhos/smp.h>
+#include <asm/irqflags.h>
+#include <asm/mmu_context.h>
+#include <asm/page.h>
+#include <asm/processor.h>
+#include <asm/tlbflush.h>
+
+#define FLUSH_ONE_CEILING	33
+#define TLB_NR_DYN_ASIDS	6
+#define CR3_NOFLUSH		(1UL << 63)
+#define X86_FEATURE_PCID	(1U << 17)	/* cpuid 1, ecx */
+
+struct tlb_context {
+	u64 ctx_id;			/* 0: empty */
+	u64 tlb_gen;
+};
+
+struct tlb_state {
+	struct mm_struct *loaded_mm;
+	unsigned int loaded_asid;	/* slot; its PCID is one more */
+	unsigned int next_asid;		/* to evict next */
+	struct tlb_context ctxs[TLB_NR_DYN_ASIDS];
+};
+
+static DEFINE_PER_CPU_ALIGNED(struct tlb_state, cpu_tlbstate);
+static bool pcid_enabled;
+
+/* init_mm is 1. */
+u64 last_mm_ctx_id = 1;
+
+static unsigned long build_cr3(struct mm_struct *mm, unsigned int asid,
+			       bool flush)
+{
+	if (!pcid_enabled)
+		return __pa(mm->pgd);
+	return __pa(mm->pgd) | (asid + 1) | (flush ? 0 : CR3_NOFLUSH);
+}
+
+void switch_mm(struct mm_struct *prev, struct mm_struct *next)
+{
+	struct mm_struct *old;
+	struct tlb_state *ts;
+	unsigned long flags;
+	unsigned int asid;
+	bool flush = true;
+	u64 gen;
+
+	flags = local_irq_save();
+	ts = this_cpu_ptr(&cpu_tlbstate);
+	if (ts->loaded_mm == next) {
+		local_irq_restore(flags);
+		return;
+	}
+
+	/*
+	 * Join next's mask before reading its generation: a flusher bumps
+	 * the generation before reading the mask, so either it sees us and
+	 * sends an IPI, or we see the generation it bumped and flush.
+	 */
+	cpumask_set_cpu(smp_processor_id(), mm_cpumask(next));
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	gen = __atomic_load_n(&next->tlb_gen, __ATOMIC_ACQUIRE);
+	asid = 0;
+	if (pcid_enabled) {
+		for (asid = 0; asid < TLB_NR_DYN_ASIDS; asid++)
+			if (ts->ctxs[asid].ctx_id == next->ctx_id)
+				break;
+		if (asid < TLB_NR_DYN_ASIDS) {
+			flush = ts->ctxs[asid].tlb_gen != gen;
+		} else {
+			asid = ts->next_asid;
+			ts->next_asid = (asid + 1) % TLB_NR_DYN_ASIDS;
+		}
+	}
+	ts->ctxs[asid].ctx_id = next->ctx_id;
+	ts->ctxs[asid].tlb_gen = gen;
+	old = ts->loaded_mm;
+	ts->loaded_mm = next;
+	ts->loaded_asid = asid;
+	write_cr3(build_cr3(next, asid, flush));
+	/* Its slot is idle now; the generation catches what we miss. */
+	cpumask_clear_cpu(smp_processor_id(), mm_cpumask(old));
+	local_irq_restore(flags);
+}
+
+/* A kernel mapping changed: no idle slot can be trusted any more. */
+static void invalidate_other_asids(void)
+{
+	struct tlb_state *ts = this_cpu_ptr(&cpu_tlbstate);
+	unsigned int asid;
+
+	if (!pcid_enabled)
+		return;
+	for (asid = 0; asid < TLB_NR_DYN_ASIDS; asid++)
+		if (asid != ts->loaded_asid)
+			ts->ctxs[asid].ctx_id = 0;
+}
+
+struct flush_range {
+	struct mm_struct *mm;		/* NULL: kernel mappings */
+	unsigned long start, end;
+	u64 new_tlb_gen;
+};
+
+static void flush_range_local(const struct flush_range *r)
+{
+	unsigned long addr;
+
+	if ((r->end - r->start) >> PAGE_SHIFT > FLUSH_ONE_CEILING) {
+		__flush_tlb_all();
+		return;
+	}
+	for (addr = r->start; addr < r->end; addr += PAGE_SIZE)
+		__flush_tlb_one(addr);
+}
+
+static void do_flush_range(void *info)
+{
+	flush_range_local(info);
+	invalidate_other_asids();
+}
+
+void flush_tlb_kernel_range(unsigned long start, unsigned long end)
+{
+	struct flush_range r = {
+		.start	= start & PAGE_MASK,
+		.end	= ALIGN(end, PAGE_SIZE),
+	};
+
+	preempt_disable();
+	do_flush_range(&r);
+	smp_call_function(do_flush_range, &r);
+	preempt_enable();
+}
+
+/*
+ * Bring this CPU's TLB up to the mm's generation.  When this flush is the
+ * only one it has missed, its range is enough; otherwise another flush's
+ * IPI may still be on its way, and a full flush covers that one too.
+ */
+static void do_flush_mm(void *info)
+{
+	const struct flush_range *r = info;
+	struct tlb_state *ts = this_cpu_ptr(&cpu_tlbstate);
+	struct tlb_context *ctx = &ts->ctxs[ts->loaded_asid];
+	u64 mm_gen;
+
+	if (ts->loaded_mm != r->mm)
+		return;
+	mm_gen = __atomic_load_n(&r->mm->tlb_gen, __ATOMIC_ACQUIRE);
+	if (ctx->tlb_gen == mm_gen)
+		return;
+	if (r->new_tlb_gen == ctx->tlb_gen + 1 && r->new_tlb_gen == mm_gen)
+		flush_range_local(r);
+	else
+		__flush_tlb_all();
+	ctx->tlb_gen = mm_gen;
+}
+
+void flush_tlb_mm_range(struct mm_struct *mm, unsigned long start,
+			unsigned long end)
+{
+	struct flush_range r = {
+		.mm	= mm,
+		.start	= start & PAGE_MASK,
+		.end	= ALIGN(end, PAGE_SIZE),
+	};
+	unsigned long flags;
+
+	/* Ordered after the page table change, before any CPU is told. */
+	r.new_tlb_gen = __atomic_add_fetch(&mm->tlb_gen, 1, __ATOMIC_SEQ_CST);
+
+	preempt_disable();
+	flags = local_irq_save();
+	do_flush_mm(&r);
+	local_irq_restore(flags);
+	smp_call_function_many(mm_cpumask(mm), do_flush_mm, &r);
+	preempt_enable();
+}
+
+static void do_flush_all(void *info)
+{
+	__flush_tlb_all();
+	invalidate_other_asids();
+}
+
+void flush_tlb_all(void)
+{
+	preempt_disable();
+	do_flush_all(NULL);
+	smp_call_function(do_flush_all, NULL);
+	preempt_enable();
+}
+
+/*
+ * Called on each CPU while it still runs on init_mm's page tables with
+ * PCID 0; init_mm takes slot 0.  The CPUs are assumed to be alike.
+ */
+void tlb_init_cpu(void)
+{
+	struct tlb_state *ts = this_cpu_ptr(&cpu_tlbstate);
+	u32 eax, ebx, ecx, edx;
+
+	cpuid(1, &eax, &ebx, &ecx, &edx);
+	if (ecx & X86_FEATURE_PCID) {
+		write_cr4(read_cr4() | X86_CR4_PCIDE);
+		if (!pcid_enabled)
+			pr_info("PCID: %u address spaces kept per CPU\n",
+				TLB_NR_DYN_ASIDS);
+		pcid_enabled = true;
+	}
+
+	cpumask_set_cpu(smp_processor_id(), mm_cpumask(&init_mm));
+	ts->loaded_mm = &init_mm;
+	ts->loaded_asid = 0;
+	ts->next_asid = 1 % TLB_NR_DYN_ASIDS;
+	ts->ctxs[0].ctx_id = init_mm.ctx_id;
+	ts->ctxs[0].tlb_gen = __atomic_load_n(&init_mm.tlb_gen,
+					      __ATOMIC_ACQUIRE);
+	write_cr3(build_cr3(&init_mm, 0, true));
+}
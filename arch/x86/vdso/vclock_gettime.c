@@ -0,0 +1,81 @@
+/*
+ * clock_gettime() and gettimeofday() without entering the kernel.
+ *
+ * With the TSC as clocksource the time is the vDSO data page's base plus
+ * the cycles since cycle_last, scaled as the timekeeper does it, under
+ * the page's seqcount; one rdtsc and a few loads, no trap and no port
+ * I/O.  Any other clocksource, or clock, goes the slow way.
+ *
+ * This file touches nothing of the kernel but the data page and the
+ * kernel's fallback calls, so that it can be built into a user-mapped
+ * image once there are user address spaces: the data page is then read
+ * through its mapping and the fallbacks become system calls.
+ */
+#include <zhos/kernel.h>
+#include <zhos/clocksource.h>
+#include <zhos/seqlock.h>
+#include <zhos/time.h>
+#include <zhos/vdso.h>
+#include <asm/tsc.h>
+
+static __always_inline const struct vdso_data *vdso_get_data(void)
+{
+	return &vdso_data;
+}
+
+/*
+ * cycle_last was taken on whichever CPU ran the tick, and this CPU's TSC
+ * may trail it by a few cycles: clocksource_delta() counts that as none,
+ * as clock_now_ns() does.
+ */
+static __always_inline u64 vdso_calc_delta(const struct vdso_data *vd,
+					   u64 cycles)
+{
+	return clocksource_delta(cycles, vd->cycle_last, vd->mask) * vd->mult;
+}
+
+/* Returns false if the time cannot be read from the page. */
+static __always_inline bool do_hres(const struct vdso_data *vd, bool real,
+				    u64 *ns)
+{
+	unsigned int seq;
+	u64 t;
+
+	do {
+		seq = read_seqcount_begin(&vd->seq);
+		if (vd->clock_mode != VDSO_CLOCKMODE_TSC)
+			return false;
+		t = vd->base_ns + ((vdso_calc_delta(vd, rdtsc_ordered()) +
+				    vd->base_frac) >> vd->shift);
+		if (real)
+			t += vd->offs_real;
+	} while (read_seqcount_retry(&vd->seq, seq));
+
+	*ns = t;
+	return true;
+}
+
+int __vdso_clock_gettime(clockid_t clock, struct timespec64 *ts)
+{
+	u64 ns;
+
+	if ((clock == CLOCK_REALTIME || clock == CLOCK_MONOTONIC) &&
+	    do_hres(vdso_get_data(), clock == CLOCK_REALTIME, &ns)) {
+		ns_to_timespec64(ns, ts);
+		return 0;
+	}
+	return do_clock_gettime(clock, ts);
+}
+
+int __vdso_gettimeofday(struct timeval *tv, void *tz)
+{
+	u64 ns;
+
+	if (!tv)
+		return 0;
+	if (do_hres(vdso_get_data(), true, &ns)) {
+		ns_to_timeval(ns, tv);
+		return 0;
+	}
+	return do_gettimeofday(tv);
+}
@@ -0,0 +1,108 @@
+/*
+ * Bios: allocation, building and completion.
+ *
+ * A bio is only ever as large as the queue it is built for takes in one
+ * request, so submission never has to split one.
+ */
+#include <zhos/kernel.h>
+#include <zhos/bio.h>
+#include <zhos/blk-mq.h>
+#include <zhos/blkdev.h>
+#include <zhos/errno.h>
+#include <zhos/gfp.h>
+#include <zhos/mm.h>
+#include <zhos/slab.h>
+#include <zhos/wait.h>
+
+/* Shared by every submit_bio_wait(), so no waker touches a dead stack. */
+static DECLARE_WAIT_QUEUE_HEAD(bio_wait);
+
+int blk_status_to_errno(blk_status_t status)
+{
+	switch (status) {
+	case BLK_STS_OK:
+		return 0;
+	case BLK_STS_RESOURCE:
+		return -EBUSY;
+	case BLK_STS_NOTSUPP:
+		return -EINVAL;
+	default:
+		return -EIO;
+	}
+}
+
+struct bio *bio_alloc(struct gendisk *disk, unsigned int nr_vecs,
+		      enum req_op op)
+{
+	struct bio *bio;
+
+	nr_vecs = clamp(nr_vecs, 1U,
+			(unsigned int)disk->queue->limits.max_segments);
+	bio = kzalloc(sizeof(*bio) + nr_vecs * sizeof(struct bio_vec),
+		      GFP_KERNEL);
+	if (!bio)
+		return NULL;
+	bio->bi_disk = disk;
+	bio->bi_op = op;
+	bio->bi_max_vecs = nr_vecs;
+	return bio;
+}
+
+void bio_put(struct bio *bio)
+{
+	kfree(bio);
+}
+
+bool bio_add_page(struct bio *bio, struct page *page, unsigned int len,
+		  unsigned int offset)
+{
+	const struct queue_limits *lim = &bio->bi_disk->queue->limits;
+	struct bio_vec *bv;
+
+	if (bio->bi_vcnt == bio->bi_max_vecs ||
+	    (bio->bi_size + len) >> SECTOR_SHIFT > lim->max_sectors)
+		return false;
+
+	bv = &bio->bi_io_vec[bio->bi_vcnt++];
+	bv->bv_page = page;
+	bv->bv_len = len;
+	bv->bv_offset = offset;
+	bio->bi_size += len;
+	return true;
+}
+
+void submit_bio(struct bio *bio)
+{
+	struct gendisk *disk = bio->bi_disk;
+
+	if (bio_end_sector(bio) > disk->capacity ||
+	    (bio->bi_op == REQ_OP_WRITE && disk->read_only)) {
+		bio->bi_status = BLK_STS_IOERR;
+		bio_endio(bio);
+		return;
+	}
+	blk_mq_submit_bio(bio);
+}
+
+void bio_endio(struct bio *bio)
+{
+	if (bio->bi_end_io)
+		bio->bi_end_io(bio);
+}
+
+static void submit_bio_wait_endio(struct bio *bio)
+{
+	WRITE_ONCE(*(bool *)bio->bi_private, true);
+	wake_up(&bio_wait);
+}
+
+int submit_bio_wait(struct bio *bio)
+{
+	bool done = false;
+
+	bio->bi_private = &done;
+	bio->bi_end_io = submit_bio_wait_endio;
+	submit_bio(bio);
+	wait_event(bio_wait, READ_ONCE(done));
+	return blk_status_to_errno(bio->bi_status);
+}
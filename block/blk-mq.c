@@ -0,0 +1,627 @@
+/*
+ * Multi-queue block layer.
+ *
+ * A bio is first offered for merging: to the requests held in the
+ * submitting task's plug, then to those waiting in this CPU's software
+ * queue, newest first, so that a sequential stream grows the request at
+ * its head.  Failing that it takes a tag of the hardware queue the CPU
+ * maps to, and with it the request preallocated for that tag.  Plugged
+ * requests wait in the plug until it is flushed; others go straight to
+ * the software queue, and the hardware queue is run.
+ *
+ * Running a hardware queue takes what its software queues hold and hands
+ * it to ->queue_rq(), telling the driver which request ends the batch so
+ * the device is notified once per batch rather than once per request.
+ * Only one CPU dispatches a given hardware queue at a time; anyone who
+ * finds it busy just asks that CPU to go round again.  When the driver is
+ * full the leftovers stay on the hardware queue's dispatch list and the
+ * queue is left alone, so new requests keep merging in the software
+ * queues, until a completion restarts it.
+ *
+ * Completions are ended in batches: the bios of every request first,
+ * then all the tags go back under one lock, and the waiters for tags are
+ * woken and the queue restarted once.  A driver's interrupt handler only
+ * collects the batch and hands it to BLOCK_SOFTIRQ, which ends it with
+ * interrupts enabled.
+ */
+#define pr_fmt(fmt) "blk-mq: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/bio.h>
+#include <zhos/bitops.h>
+#include <zhos/blk-mq.h>
+#include <zhos/blkdev.h>
+#include <zhos/cpumask.h>
+#include <zhos/errno.h>
+#include <zhos/gfp.h>
+#include <zhos/list.h>
+#include <zhos/percpu.h>
+#include <zhos/sched.h>
+#include <zhos/slab.h>
+#include <zhos/smp.h>
+#include <zhos/softirq.h>
+#include <zhos/spinlock.h>
+#include <zhos/wait.h>
+#include <asm/barrier.h>
+
+#define BLK_DEF_MAX_SECTORS	256	/* 128 KiB */
+#define BLK_DEF_MAX_SEGMENTS	32
+
+/* Requests a plug holds before it is flushed anyway. */
+#define BLK_MAX_REQUEST_COUNT	32
+/* Waiting requests a bio is checked against for a merge. */
+#define BLK_MAX_MERGE_SCAN	8
+
+struct blk_mq_tags {
+	spinlock_t lock;		/* interrupts off */
+	unsigned int nr_tags;
+	unsigned int nr_free;
+	u64 *bitmap;			/* set: in use */
+	struct request **rqs;
+	struct wait_queue_head wait;	/* for a free tag */
+};
+
+static void blk_mq_free_tags(struct blk_mq_tags *tags)
+{
+	unsigned int i;
+
+	if (!tags)
+		return;
+	if (tags->rqs) {
+		for (i = 0; i < tags->nr_tags; i++)
+			kfree(tags->rqs[i]);
+	}
+	kfree(tags->rqs);
+	kfree(tags->bitmap);
+	kfree(tags);
+}
+
+static struct blk_mq_tags *blk_mq_alloc_tags(unsigned int depth,
+					     unsigned int cmd_size)
+{
+	unsigned int i, words = DIV_ROUND_UP(depth, 64);
+	struct blk_mq_tags *tags;
+	struct request *rq;
+
+	tags = kzalloc(sizeof(*tags), GFP_KERNEL);
+	if (!tags)
+		return NULL;
+	spin_lock_init(&tags->lock);
+	init_waitqueue_head(&tags->wait);
+	tags->nr_tags = depth;
+	tags->nr_free = depth;
+	tags->bitmap = kcalloc(words, sizeof(u64), GFP_KERNEL);
+	tags->rqs = kcalloc(depth, sizeof(*tags->rqs), GFP_KERNEL);
+	if (!tags->bitmap || !tags->rqs)
+		goto fail;
+	/* The bits past the last tag are never free. */
+	if (depth % 64)
+		tags->bitmap[words - 1] = ~0ULL << (depth % 64);
+
+	for (i = 0; i < depth; i++) {
+		rq = kzalloc(sizeof(*rq) + cmd_size, GFP_KERNEL);
+		if (!rq)
+			goto fail;
+		rq->tag = i;
+		INIT_LIST_HEAD(&rq->queuelist);
+		tags->rqs[i] = rq;
+	}
+	return tags;
+
+fail:
+	blk_mq_free_tags(tags);
+	return NULL;
+}
+
+/**
+ * blk_mq_alloc_tag_set - allocate the tags and requests of a tag set
+ * @set: ops, nr_hw_queues, queue_depth and cmd_size filled in
+ */
+int blk_mq_alloc_tag_set(struct blk_mq_tag_set *set)
+{
+	unsigned int i;
+
+	if (!set->ops || !set->ops->queue_rq || !set->nr_hw_queues ||
+	    !set->queue_depth || set->queue_depth > BLK_MQ_MAX_DEPTH)
+		return -EINVAL;
+
+	set->tags = kcalloc(set->nr_hw_queues, sizeof(*set->tags), GFP_KERNEL);
+	if (!set->tags)
+		return -ENOMEM;
+	for (i = 0; i < set->nr_hw_queues; i++) {
+		set->tags[i] = blk_mq_alloc_tags(set->queue_depth,
+						 set->cmd_size);
+		if (!set->tags[i])
+			goto fail;
+	}
+	return 0;
+
+fail:
+	while (i--)
+		blk_mq_free_tags(set->tags[i]);
+	kfree(set->tags);
+	set->tags = NULL;
+	return -ENOMEM;
+}
+
+static int blk_mq_get_tag(struct blk_mq_tags *tags)
+{
+	unsigned long flags;
+	unsigned int i;
+	int tag = -1;
+
+	spin_lock_irqsave(&tags->lock, flags);
+	if (tags->nr_free) {
+		for (i = 0; !~tags->bitmap[i]; i++)
+			;
+		tag = i * 64 + __ffs64(~tags->bitmap[i]);
+		tags->bitmap[i] |= 1ULL << (tag % 64);
+		tags->nr_free--;
+	}
+	spin_unlock_irqrestore(&tags->lock, flags);
+	return tag;
+}
+
+/* tags->lock held. */
+static void __blk_mq_put_tag(struct blk_mq_tags *tags, unsigned int tag)
+{
+	tags->bitmap[tag / 64] &= ~(1ULL << (tag % 64));
+	tags->nr_free++;
+}
+
+/**
+ * blk_mq_init_queue - set up a request queue over a tag set
+ * @set: allocated with blk_mq_alloc_tag_set()
+ * @queuedata: the driver's, in q->queuedata
+ *
+ * The possible CPUs are spread over the hardware queues in turn.  The
+ * queue starts with conservative limits the driver lowers or raises.
+ */
+struct request_queue *blk_mq_init_queue(struct blk_mq_tag_set *set,
+					void *queuedata)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct request_queue *q;
+	struct blk_mq_ctx *ctx;
+	unsigned int i, cpu;
+
+	q = kzalloc(sizeof(*q), GFP_KERNEL);
+	if (!q)
+		return NULL;
+	q->tag_set = set;
+	q->queuedata = queuedata;
+	q->nr_hw_queues = set->nr_hw_queues;
+	q->limits.max_sectors = BLK_DEF_MAX_SECTORS;
+	q->limits.max_segments = BLK_DEF_MAX_SEGMENTS;
+	q->limits.logical_block_size = SECTOR_SIZE;
+
+	q->queue_hw_ctx = kcalloc(q->nr_hw_queues, sizeof(*q->queue_hw_ctx),
+				  GFP_KERNEL);
+	q->queue_ctx = kcalloc(NR_CPUS, sizeof(*q->queue_ctx), GFP_KERNEL);
+	if (!q->queue_hw_ctx || !q->queue_ctx)
+		goto fail;
+
+	for (i = 0; i < q->nr_hw_queues; i++) {
+		hctx = kzalloc(sizeof(*hctx), GFP_KERNEL);
+		if (!hctx)
+			goto fail;
+		q->queue_hw_ctx[i] = hctx;
+		spin_lock_init(&hctx->lock);
+		INIT_LIST_HEAD(&hctx->dispatch);
+		hctx->queue = q;
+		hctx->tags = set->tags[i];
+		hctx->queue_num = i;
+		if (set->ops->init_hctx &&
+		    set->ops->init_hctx(hctx, set->driver_data, i))
+			goto fail;
+	}
+
+	for (cpu = 0; cpu < NR_CPUS; cpu++) {
+		ctx = &q->queue_ctx[cpu];
+		spin_lock_init(&ctx->lock);
+		INIT_LIST_HEAD(&ctx->rq_list);
+		ctx->cpu = cpu;
+		ctx->hctx = q->queue_hw_ctx[0];
+	}
+	i = 0;
+	for_each_possible_cpu(cpu)
+		q->queue_ctx[cpu].hctx = q->queue_hw_ctx[i++ % q->nr_hw_queues];
+	return q;
+
+fail:
+	if (q->queue_hw_ctx) {
+		for (i = 0; i < q->nr_hw_queues; i++)
+			kfree(q->queue_hw_ctx[i]);
+	}
+	kfree(q->queue_hw_ctx);
+	kfree(q->queue_ctx);
+	kfree(q);
+	return NULL;
+}
+
+static void blk_mq_end_bios(struct request *rq, blk_status_t status)
+{
+	struct bio *bio = rq->bio, *next;
+
+	rq->bio = rq->biotail = NULL;
+	while (bio) {
+		next = bio->bi_next;
+		bio->bi_next = NULL;
+		bio->bi_status = status;
+		bio_endio(bio);
+		bio = next;
+	}
+}
+
+/* @nr requests of @hctx have given back their tags. */
+static void blk_mq_requests_done(struct blk_mq_hw_ctx *hctx, unsigned int nr)
+{
+	unsigned long flags;
+	bool run;
+
+	/* The freed tags before the peek at the waiters. */
+	smp_mb();
+	if (waitqueue_active(&hctx->tags->wait))
+		wake_up(&hctx->tags->wait);
+
+	spin_lock_irqsave(&hctx->lock, flags);
+	hctx->nr_completed += nr;
+	run = hctx->restart;
+	hctx->restart = false;
+	spin_unlock_irqrestore(&hctx->lock, flags);
+
+	if (run)
+		blk_mq_run_hw_queue(hctx);
+}
+
+void blk_mq_end_request(struct request *rq, blk_status_t status)
+{
+	struct blk_mq_hw_ctx *hctx = rq->mq_hctx;
+	struct blk_mq_tags *tags = hctx->tags;
+	unsigned long flags;
+
+	blk_mq_end_bios(rq, status);
+
+	spin_lock_irqsave(&tags->lock, flags);
+	__blk_mq_put_tag(tags, rq->tag);
+	spin_unlock_irqrestore(&tags->lock, flags);
+
+	blk_mq_requests_done(hctx, 1);
+}
+
+void blk_mq_end_request_batch(struct io_comp_batch *iob)
+{
+	struct blk_mq_hw_ctx *hctx;
+	struct blk_mq_tags *tags;
+	struct request *rq, *n;
+	unsigned long flags;
+	unsigned int nr;
+
+	list_for_each_entry(rq, &iob->list, queuelist)
+		blk_mq_end_bios(rq, rq->status);
+
+	/* One pass per hardware queue; a request is reused once its tag is free. */
+	while (!list_empty(&iob->list)) {
+		hctx = list_first_entry(&iob->list, struct request,
+					queuelist)->mq_hctx;
+		tags = hctx->tags;
+		nr = 0;
+
+		spin_lock_irqsave(&tags->lock, flags);
+		list_for_each_entry_safe(rq, n, &iob->list, queuelist) {
+			if (rq->mq_hctx != hctx)
+				continue;
+			list_del_init(&rq->queuelist);
+			__blk_mq_put_tag(tags, rq->tag);
+			nr++;
+		}
+		spin_unlock_irqrestore(&tags->lock, flags);
+
+		blk_mq_requests_done(hctx, nr);
+	}
+}
+
+/* Requests completed on this CPU, for the softirq; interrupts off. */
+static DEFINE_PER_CPU(struct list_head, blk_cpu_done);
+
+/**
+ * blk_mq_complete_batch - end a batch of completions later, from the softirq
+ * @iob: gathered by the driver's interrupt handler; left empty
+ */
+void blk_mq_complete_batch(struct io_comp_batch *iob)
+{
+	unsigned long flags;
+
+	if (list_empty(&iob->list))
+		return;
+	flags = local_irq_save();
+	list_splice_tail_init(&iob->list, this_cpu_ptr(&blk_cpu_done));
+	raise_softirq_irqoff(BLOCK_SOFTIRQ);
+	local_irq_restore(flags);
+}
+
+static void blk_done_softirq(void)
+{
+	DEFINE_IO_COMP_BATCH(iob);
+
+	local_irq_disable();
+	list_splice_init(this_cpu_ptr(&blk_cpu_done), &iob.list);
+	local_irq_enable();
+	blk_mq_end_request_batch(&iob);
+}
+
+/*
+ * Give @list to the driver in order, stopping at the first request it has
+ * no room for, which stays on @list with the rest.
+ */
+static void blk_mq_dispatch_rq_list(struct blk_mq_hw_ctx *hctx,
+				    struct list_head *list)
+{
+	const struct blk_mq_ops *ops = hctx->queue->tag_set->ops;
+	unsigned int queued = 0, commits = 0;
+	bool needs_commit = false, last;
+	struct request *rq;
+	blk_status_t ret;
+
+	while (!list_empty(list)) {
+		rq = list_first_entry(list, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+		last = list_empty(list);
+
+		ret = ops->queue_rq(hctx, rq, last);
+		if (ret == BLK_STS_RESOURCE) {
+			list_add(&rq->queuelist, list);
+			break;
+		}
+		if (ret != BLK_STS_OK) {
+			blk_mq_end_request(rq, ret);
+			continue;
+		}
+		queued++;
+		needs_commit = !last;
+		if (last)
+			commits++;
+	}
+
+	/* The batch stopped short of the request marked last. */
+	if (needs_commit) {
+		if (ops->commit_rqs)
+			ops->commit_rqs(hctx);
+		commits++;
+	}
+	__atomic_add_fetch(&hctx->dispatched, queued, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&hctx->commits, commits, __ATOMIC_RELAXED);
+}
+
+/* hctx->lock held. */
+static void blk_mq_flush_busy_ctxs(struct blk_mq_hw_ctx *hctx,
+				   struct list_head *list)
+{
+	struct request_queue *q = hctx->queue;
+	struct blk_mq_ctx *ctx;
+	unsigned int cpu;
+
+	for_each_cpu(cpu, &hctx->ctx_map) {
+		ctx = &q->queue_ctx[cpu];
+		cpumask_clear_cpu(cpu, &hctx->ctx_map);
+		spin_lock(&ctx->lock);
+		list_splice_tail_init(&ctx->rq_list, list);
+		spin_unlock(&ctx->lock);
+	}
+}
+
+/**
+ * blk_mq_run_hw_queue - dispatch what a hardware queue has waiting
+ * @hctx: the queue
+ *
+ * From any context.  Returns at once if another CPU is dispatching it,
+ * which then picks up whatever the caller queued.
+ */
+void blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx)
+{
+	unsigned long flags, completed;
+	LIST_HEAD(list);
+
+	spin_lock_irqsave(&hctx->lock, flags);
+	if (hctx->running) {
+		hctx->rerun = true;
+		spin_unlock_irqrestore(&hctx->lock, flags);
+		return;
+	}
+	hctx->running = true;
+
+	do {
+		hctx->rerun = false;
+		if (hctx->restart)
+			break;
+		list_splice_init(&hctx->dispatch, &list);
+		blk_mq_flush_busy_ctxs(hctx, &list);
+		if (list_empty(&list))
+			break;
+		completed = hctx->nr_completed;
+		spin_unlock_irqrestore(&hctx->lock, flags);
+
+		blk_mq_dispatch_rq_list(hctx, &list);
+
+		spin_lock_irqsave(&hctx->lock, flags);
+		if (!list_empty(&list)) {
+			list_splice_init(&list, &hctx->dispatch);
+			/* A completion since we looked has made room already. */
+			if (hctx->nr_completed == completed)
+				hctx->restart = true;
+			else
+				hctx->rerun = true;
+		}
+	} while (hctx->rerun);
+
+	hctx->running = false;
+	spin_unlock_irqrestore(&hctx->lock, flags);
+}
+
+static bool blk_rq_merge_ok(struct request *rq, struct bio *bio)
+{
+	const struct queue_limits *lim = &rq->q->limits;
+
+	return rq->q == bio->bi_disk->queue && rq->op == bio->bi_op &&
+	       rq->nr_phys_segments + bio->bi_vcnt <= lim->max_segments &&
+	       (rq->__data_len + bio->bi_size) >> SECTOR_SHIFT <=
+			lim->max_sectors;
+}
+
+static bool blk_attempt_bio_merge(struct request *rq, struct bio *bio)
+{
+	if (!blk_rq_merge_ok(rq, bio))
+		return false;
+
+	if (blk_rq_pos(rq) + blk_rq_sectors(rq) == bio->bi_sector) {
+		rq->biotail->bi_next = bio;
+		rq->biotail = bio;
+	} else if (bio_end_sector(bio) == blk_rq_pos(rq)) {
+		bio->bi_next = rq->bio;
+		rq->bio = bio;
+		rq->__sector = bio->bi_sector;
+	} else {
+		return false;
+	}
+	rq->__data_len += bio->bi_size;
+	rq->nr_phys_segments += bio->bi_vcnt;
+	__atomic_add_fetch(&rq->mq_hctx->merged, 1, __ATOMIC_RELAXED);
+	return true;
+}
+
+static bool blk_attempt_list_merge(struct list_head *list, struct bio *bio)
+{
+	struct request *rq;
+	unsigned int n = 0;
+
+	list_for_each_entry_reverse(rq, list, queuelist) {
+		if (blk_attempt_bio_merge(rq, bio))
+			return true;
+		if (++n == BLK_MAX_MERGE_SCAN)
+			break;
+	}
+	return false;
+}
+
+/* A free request of this CPU's hardware queue; sleeps until there is one. */
+static struct request *blk_mq_get_request(struct request_queue *q,
+					  struct bio *bio)
+{
+	struct blk_mq_ctx *ctx = &q->queue_ctx[smp_processor_id()];
+	struct blk_mq_hw_ctx *hctx = ctx->hctx;
+	struct blk_mq_tags *tags = hctx->tags;
+	struct request *rq;
+	int tag;
+
+	/* Sleeping flushes our plug, whose requests would hold up the tags. */
+	tag = blk_mq_get_tag(tags);
+	if (tag < 0)
+		wait_event(tags->wait, (tag = blk_mq_get_tag(tags)) >= 0);
+	__atomic_add_fetch(&hctx->queued, 1, __ATOMIC_RELAXED);
+
+	rq = tags->rqs[tag];
+	rq->q = q;
+	rq->mq_ctx = ctx;
+	rq->mq_hctx = hctx;
+	rq->op = bio->bi_op;
+	rq->status = BLK_STS_OK;
+	rq->__sector = bio->bi_sector;
+	rq->__data_len = bio->bi_size;
+	rq->nr_phys_segments = bio->bi_vcnt;
+	rq->bio = rq->biotail = bio;
+	return rq;
+}
+
+static void blk_mq_insert_requests(struct blk_mq_ctx *ctx,
+				   struct list_head *list)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctx->lock, flags);
+	list_splice_tail_init(list, &ctx->rq_list);
+	spin_unlock_irqrestore(&ctx->lock, flags);
+	cpumask_set_cpu(ctx->cpu, &ctx->hctx->ctx_map);
+}
+
+void blk_mq_submit_bio(struct bio *bio)
+{
+	struct request_queue *q = bio->bi_disk->queue;
+	struct blk_plug *plug = current->plug;
+	struct blk_mq_ctx *ctx;
+	struct request *rq;
+	unsigned long flags;
+	LIST_HEAD(list);
+	bool merged;
+
+	bio->bi_next = NULL;
+	if (plug && blk_attempt_list_merge(&plug->mq_list, bio))
+		return;
+
+	ctx = &q->queue_ctx[smp_processor_id()];
+	spin_lock_irqsave(&ctx->lock, flags);
+	merged = blk_attempt_list_merge(&ctx->rq_list, bio);
+	spin_unlock_irqrestore(&ctx->lock, flags);
+	if (merged)
+		return;
+
+	rq = blk_mq_get_request(q, bio);
+	if (plug) {
+		list_add_tail(&rq->queuelist, &plug->mq_list);
+		if (++plug->count >= BLK_MAX_REQUEST_COUNT)
+			blk_flush_plug(plug);
+		return;
+	}
+
+	list_add_tail(&rq->queuelist, &list);
+	blk_mq_insert_requests(rq->mq_ctx, &list);
+	blk_mq_run_hw_queue(rq->mq_hctx);
+}
+
+void blk_start_plug(struct blk_plug *plug)
+{
+	INIT_LIST_HEAD(&plug->mq_list);
+	plug->count = 0;
+	/* Nested plugs go to the outermost. */
+	if (!current->plug)
+		current->plug = plug;
+}
+
+/*
+ * Move the plugged requests to their software queues, a software queue's
+ * worth under one lock, and run each hardware queue once.
+ */
+void blk_flush_plug(struct blk_plug *plug)
+{
+	struct blk_mq_ctx *ctx;
+	struct request *rq, *n;
+	LIST_HEAD(list);
+
+	while (!list_empty(&plug->mq_list)) {
+		ctx = list_first_entry(&plug->mq_list, struct request,
+				       queuelist)->mq_ctx;
+		list_for_each_entry_safe(rq, n, &plug->mq_list, queuelist) {
+			if (rq->mq_ctx == ctx)
+				list_move_tail(&rq->queuelist, &list);
+		}
+		blk_mq_insert_requests(ctx, &list);
+		blk_mq_run_hw_queue(ctx->hctx);
+	}
+	plug->count = 0;
+}
+
+void blk_finish_plug(struct blk_plug *plug)
+{
+	if (current->plug != plug)
+		return;
+	blk_flush_plug(plug);
+	current->plug = NULL;
+}
+
+void blk_mq_init(void)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu)
+		INIT_LIST_HEAD(per_cpu_ptr(&blk_cpu_done, cpu));
+	open_softirq(BLOCK_SOFTIRQ, blk_done_softirq);
+}
@@ -0,0 +1,136 @@
+/*
+ * Disks and their page cache.
+ *
+ * Every disk's bd_inode covers its whole capacity, in whole pages, page
+ * index n holding sectors 8n to 8n + 7.  The page cache hands it runs of
+ * consecutive pages, which become as few bios as the queue limits allow,
+ * submitted under a plug so that they reach the driver as one batch.
+ *
+ * Disks are never removed; the list is walked under RCU and disk_lock
+ * only serialises additions.
+ */
+#define pr_fmt(fmt) "block: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/bio.h>
+#include <zhos/blkdev.h>
+#include <zhos/errno.h>
+#include <zhos/fs.h>
+#include <zhos/list.h>
+#include <zhos/mm.h>
+#include <zhos/pagemap.h>
+#include <zhos/rculist.h>
+#include <zhos/spinlock.h>
+#include <zhos/string.h>
+
+static LIST_HEAD(disk_list);
+static DEFINE_SPINLOCK(disk_lock);
+
+static void blkdev_end_io(struct bio *bio)
+{
+	int err = blk_status_to_errno(bio->bi_status);
+	struct bio_vec *bv;
+	unsigned int i;
+
+	bio_for_each_bvec(bv, bio, i) {
+		if (bio->bi_op == REQ_OP_READ)
+			end_page_read(bv->bv_page, err);
+		else
+			end_page_writeback(bv->bv_page, err);
+	}
+	bio_put(bio);
+}
+
+static int blkdev_submit_pages(struct address_space *mapping,
+			       struct page **pages, unsigned int nr,
+			       enum req_op op)
+{
+	struct gendisk *disk = mapping->host->i_private;
+	struct blk_plug plug;
+	unsigned int i = 0;
+	struct bio *bio;
+
+	blk_start_plug(&plug);
+	while (i < nr) {
+		bio = bio_alloc(disk, nr - i, op);
+		if (!bio)
+			break;
+		bio->bi_sector = (sector_t)pages[i]->index << PAGE_SECTORS_SHIFT;
+		bio->bi_end_io = blkdev_end_io;
+		while (i < nr && bio_add_page(bio, pages[i], PAGE_SIZE, 0))
+			i++;
+		if (!bio->bi_vcnt) {
+			bio_put(bio);
+			break;
+		}
+		submit_bio(bio);
+	}
+	blk_finish_plug(&plug);
+
+	if (!i)
+		return -ENOMEM;
+	/* Out of memory part way: the rest fail now. */
+	for (; i < nr; i++) {
+		if (op == REQ_OP_READ)
+			end_page_read(pages[i], -ENOMEM);
+		else
+			end_page_writeback(pages[i], -ENOMEM);
+	}
+	return 0;
+}
+
+static int blkdev_readpages(struct address_space *mapping, struct page **pages,
+			    unsigned int nr)
+{
+	return blkdev_submit_pages(mapping, pages, nr, REQ_OP_READ);
+}
+
+static int blkdev_writepages(struct address_space *mapping,
+			     struct page **pages, unsigned int nr)
+{
+	return blkdev_submit_pages(mapping, pages, nr, REQ_OP_WRITE);
+}
+
+static const struct address_space_operations blkdev_aops = {
+	.readpages	= blkdev_readpages,
+	.writepages	= blkdev_writepages,
+};
+
+/**
+ * add_disk - make a disk available
+ * @disk: disk_name, queue and capacity filled in
+ */
+void add_disk(struct gendisk *disk)
+{
+	unsigned long flags;
+
+	inode_init(&disk->bd_inode, 0, &blkdev_aops);
+	disk->bd_inode.i_size = (disk->capacity << SECTOR_SHIFT) & PAGE_MASK;
+	disk->bd_inode.i_private = disk;
+
+	spin_lock_irqsave(&disk_lock, flags);
+	list_add_tail_rcu(&disk->list, &disk_list);
+	spin_unlock_irqrestore(&disk_lock, flags);
+
+	pr_info("%s: %llu sectors (%llu MiB)%s, %u hardware queue%s\n",
+		disk->disk_name, (unsigned long long)disk->capacity,
+		(unsigned long long)(disk->capacity >> (20 - SECTOR_SHIFT)),
+		disk->read_only ? ", read-only" : "",
+		disk->queue->nr_hw_queues,
+		disk->queue->nr_hw_queues == 1 ? "" : "s");
+}
+
+struct gendisk *get_gendisk(const char *name)
+{
+	struct gendisk *disk, *found = NULL;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(disk, &disk_list, list) {
+		if (!strcmp(disk->disk_name, name)) {
+			found = disk;
+			break;
+		}
+	}
+	rcu_read_unlock();
+	return found;
+}
@@ -0,0 +1,146 @@
+/*
+ * NUMA topology from the ACPI SRAT and SLIT.
+ *
+ * The SRAT puts each CPU, by APIC id, and each memory range in a
+ * proximity domain.  Domains are numbered by the firmware, not always
+ * densely, so each one is given the next node id the first time it is
+ * seen.  The SLIT, if there is one, has the distance between every pair
+ * of domains.  Disabled entries and hot-pluggable memory are skipped.
+ */
+#define pr_fmt(fmt) "acpi: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/acpi.h>
+#include <zhos/errno.h>
+#include <zhos/numa.h>
+
+#define MAX_PXM_DOMAINS		256
+
+static int pxm_to_node_map[MAX_PXM_DOMAINS];
+static unsigned int nr_pxm_nodes;
+static unsigned int srat_revision;
+static unsigned int srat_memblks;
+
+static int acpi_map_pxm_to_node(u32 pxm)
+{
+	if (pxm >= MAX_PXM_DOMAINS) {
+		pr_warn("proximity domain %u ignored\n", pxm);
+		return NUMA_NO_NODE;
+	}
+	if (pxm_to_node_map[pxm] == NUMA_NO_NODE) {
+		if (nr_pxm_nodes >= MAX_NUMNODES) {
+			pr_warn("proximity domain %u ignored, %u nodes at most\n",
+				pxm, MAX_NUMNODES);
+			return NUMA_NO_NODE;
+		}
+		pxm_to_node_map[pxm] = nr_pxm_nodes++;
+	}
+	return pxm_to_node_map[pxm];
+}
+
+static int acpi_parse_cpu_affinity(const struct acpi_subtable_header *e)
+{
+	const struct acpi_srat_cpu_affinity *p = (const void *)e;
+	u32 pxm = p->proximity_domain_lo;
+	int nid;
+
+	if (!(p->flags & ACPI_SRAT_CPU_ENABLED))
+		return 0;
+	/* Revision 1 has only the low byte. */
+	if (srat_revision >= 2)
+		pxm |= p->proximity_domain_hi[0] << 8 |
+		       p->proximity_domain_hi[1] << 16 |
+		       (u32)p->proximity_domain_hi[2] << 24;
+	nid = acpi_map_pxm_to_node(pxm);
+	if (nid != NUMA_NO_NODE)
+		numa_set_apicid_node(p->apic_id, nid);
+	return 0;
+}
+
+static int acpi_parse_x2apic_affinity(const struct acpi_subtable_header *e)
+{
+	const struct acpi_srat_x2apic_cpu_affinity *p = (const void *)e;
+	int nid;
+
+	if (!(p->flags & ACPI_SRAT_CPU_ENABLED))
+		return 0;
+	nid = acpi_map_pxm_to_node(p->proximity_domain);
+	if (nid != NUMA_NO_NODE)
+		numa_set_apicid_node(p->apic_id, nid);
+	return 0;
+}
+
+static int acpi_parse_memory_affinity(const struct acpi_subtable_header *e)
+{
+	const struct acpi_srat_mem_affinity *p = (const void *)e;
+	int nid;
+
+	if (!(p->flags & ACPI_SRAT_MEM_ENABLED) ||
+	    (p->flags & ACPI_SRAT_MEM_HOT_PLUGGABLE) || !p->length)
+		return 0;
+	nid = acpi_map_pxm_to_node(p->proximity_domain);
+	if (nid == NUMA_NO_NODE)
+		return 0;
+	if (numa_add_memblk(nid, p->base_address,
+			    p->base_address + p->length)) {
+		pr_warn("SRAT: too many memory ranges\n");
+		return -ENOSPC;
+	}
+	srat_memblks++;
+	return 0;
+}
+
+static void acpi_parse_slit(void)
+{
+	struct acpi_table_slit *slit;
+	u64 n, i, j;
+	int from, to;
+
+	slit = (struct acpi_table_slit *)acpi_get_table(ACPI_SIG_SLIT);
+	if (!slit)
+		return;
+	n = slit->locality_count;
+	if (n > MAX_PXM_DOMAINS ||
+	    sizeof(*slit) + n * n > slit->header.length) {
+		pr_warn("SLIT: bad size, distances ignored\n");
+		return;
+	}
+	for (i = 0; i < n; i++) {
+		from = pxm_to_node_map[i];
+		for (j = 0; j < n && from != NUMA_NO_NODE; j++) {
+			to = pxm_to_node_map[j];
+			if (to != NUMA_NO_NODE)
+				numa_set_distance(from, to,
+						  slit->entry[i * n + j]);
+		}
+	}
+}
+
+int acpi_numa_init(void)
+{
+	struct acpi_table_srat *srat;
+	unsigned int i;
+
+	for (i = 0; i < MAX_PXM_DOMAINS; i++)
+		pxm_to_node_map[i] = NUMA_NO_NODE;
+
+	srat = (struct acpi_table_srat *)acpi_get_table(ACPI_SIG_SRAT);
+	if (!srat)
+		return -ENODEV;
+	srat_revision = srat->header.revision;
+
+	acpi_table_parse_entries(ACPI_SIG_SRAT, sizeof(*srat),
+				 ACPI_SRAT_TYPE_CPU_AFFINITY,
+				 acpi_parse_cpu_affinity);
+	acpi_table_parse_entries(ACPI_SIG_SRAT, sizeof(*srat),
+				 ACPI_SRAT_TYPE_X2APIC_CPU_AFFINITY,
+				 acpi_parse_x2apic_affinity);
+	if (acpi_table_parse_entries(ACPI_SIG_SRAT, sizeof(*srat),
+				     ACPI_SRAT_TYPE_MEMORY_AFFINITY,
+				     acpi_parse_memory_affinity) < 0 ||
+	    !srat_memblks)
+		return -EINVAL;
+
+	acpi_parse_slit();
+	return 0;
+}
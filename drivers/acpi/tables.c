@@ -0,0 +1,164 @@
+/*
+ * ACPI static table lookup.
+ *
+ * The RSDP is found by the BIOS search of the EBDA and the 0xe0000-0xfffff
+ * ROM area; it points at the XSDT (or, for ACPI 1.0, the RSDT), whose
+ * entries point at the individual tables.  Tables are read in place
+ * through the boot identity map, so anything above it is ignored.
+ */
+#define pr_fmt(fmt) "acpi: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/acpi.h>
+#include <zhos/errno.h>
+#include <zhos/string.h>
+#include <asm/page.h>
+
+#define BIOS_EBDA_SEGMENT	0x40e
+#define BIOS_ROM_START		0xe0000
+#define BIOS_ROM_END		0x100000
+
+static struct acpi_table_header *root_table;
+static unsigned int root_entry_size;	/* 8 for the XSDT, 4 for the RSDT */
+
+static u8 acpi_checksum(const void *p, unsigned long len)
+{
+	const u8 *b = p;
+	u8 sum = 0;
+
+	while (len--)
+		sum += *b++;
+	return sum;
+}
+
+static struct acpi_table_rsdp *acpi_scan_rsdp(phys_addr_t start,
+					      unsigned long len)
+{
+	phys_addr_t pa;
+
+	for (pa = start; pa < start + len; pa += 16) {
+		struct acpi_table_rsdp *rsdp = phys_to_virt(pa);
+
+		if (memcmp(rsdp->signature, "RSD PTR ", 8))
+			continue;
+		if (acpi_checksum(rsdp, 20))
+			continue;
+		if (rsdp->revision >= 2 &&
+		    acpi_checksum(rsdp, rsdp->length))
+			continue;
+		return rsdp;
+	}
+	return NULL;
+}
+
+static struct acpi_table_rsdp *acpi_find_rsdp(void)
+{
+	phys_addr_t ebda = (phys_addr_t)*(u16 *)phys_to_virt(BIOS_EBDA_SEGMENT) << 4;
+	struct acpi_table_rsdp *rsdp = NULL;
+
+	if (ebda >= 0x80000 && ebda < 0xa0000)
+		rsdp = acpi_scan_rsdp(ebda, 1024);
+	if (!rsdp)
+		rsdp = acpi_scan_rsdp(BIOS_ROM_START, BIOS_ROM_END - BIOS_ROM_START);
+	return rsdp;
+}
+
+static struct acpi_table_header *acpi_map_table(u64 pa)
+{
+	struct acpi_table_header *t;
+
+	if (!pa || pa + sizeof(*t) > BOOT_IDENTITY_SIZE)
+		return NULL;
+	t = phys_to_virt(pa);
+	if (pa + t->length > BOOT_IDENTITY_SIZE || acpi_checksum(t, t->length))
+		return NULL;
+	return t;
+}
+
+int acpi_table_init(void)
+{
+	struct acpi_table_rsdp *rsdp = acpi_find_rsdp();
+	char oem[sizeof(rsdp->oem_id) + 1];
+
+	if (!rsdp) {
+		pr_info("no RSDP found\n");
+		return -ENODEV;
+	}
+
+	if (rsdp->revision >= 2 && rsdp->xsdt_physical_address) {
+		root_table = acpi_map_table(rsdp->xsdt_physical_address);
+		root_entry_size = 8;
+	}
+	if (!root_table) {
+		root_table = acpi_map_table(rsdp->rsdt_physical_address);
+		root_entry_size = 4;
+	}
+	if (!root_table) {
+		pr_warn("bad root table\n");
+		return -EINVAL;
+	}
+
+	memcpy(oem, rsdp->oem_id, sizeof(rsdp->oem_id));
+	oem[sizeof(rsdp->oem_id)] = '\0';
+	pr_info("RSDP %s, %s\n", oem, root_entry_size == 8 ? "XSDT" : "RSDT");
+	return 0;
+}
+
+struct acpi_table_header *acpi_get_table(const char *signature)
+{
+	unsigned int i, n;
+	u8 *entries;
+
+	if (!root_table)
+		return NULL;
+
+	entries = (u8 *)(root_table + 1);
+	n = (root_table->length - sizeof(*root_table)) / root_entry_size;
+	for (i = 0; i < n; i++) {
+		u64 pa = 0;
+		struct acpi_table_header *t;
+
+		memcpy(&pa, entries + i * root_entry_size, root_entry_size);
+		t = acpi_map_table(pa);
+		if (t && !memcmp(t->signature, signature, 4))
+			return t;
+	}
+	return NULL;
+}
+
+/**
+ * acpi_table_parse_entries - call @handler for each subtable of type @type
+ * @signature: table to walk
+ * @table_size: size of the fixed part of the table before the subtables
+ * @type: subtable type, or -1 for all
+ * @handler: callback; a negative return stops the walk
+ *
+ * Returns the number of entries handled, or a negative errno.
+ */
+int acpi_table_parse_entries(const char *signature, unsigned int table_size,
+			     int type, acpi_tbl_entry_handler handler)
+{
+	struct acpi_table_header *t = acpi_get_table(signature);
+	const u8 *p, *end;
+	int count = 0, ret;
+
+	if (!t)
+		return -ENODEV;
+
+	p = (const u8 *)t + table_size;
+	end = (const u8 *)t + t->length;
+	while (p + sizeof(struct acpi_subtable_header) <= end) {
+		const struct acpi_subtable_header *e = (const void *)p;
+
+		if (e->length < sizeof(*e) || p + e->length > end)
+			break;
+		if (type < 0 || e->type == type) {
+			ret = handler(e);
+			if (ret < 0)
+				return ret;
+			count++;
+		}
+		p += e->length;
+	}
+	return count;
+}
@@ -0,0 +1,508 @@
+/*
+ * Virtio block device, legacy PCI interface, as provided by QEMU's
+ * virtio-blk-pci.
+ *
+ * Each virtqueue is a blk-mq hardware queue of its own; with
+ * VIRTIO_BLK_F_MQ there are as many as the device offers and there are
+ * CPUs.  A request is a descriptor chain: the header, one descriptor per
+ * segment and the status byte the device writes back, all pointing into
+ * the request's driver data and the bios' pages.  The device is notified
+ * once per batch blk-mq hands over, and only if it has not said it is
+ * already polling the ring.  The interrupt drains every queue's used ring
+ * and hands what it finds to blk-mq in one batch per queue, to be ended
+ * from the softirq.
+ */
+#define pr_fmt(fmt) "virtio-blk: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/bio.h>
+#include <zhos/blk-mq.h>
+#include <zhos/blkdev.h>
+#include <zhos/cpumask.h>
+#include <zhos/errno.h>
+#include <zhos/gfp.h>
+#include <zhos/irq.h>
+#include <zhos/mm.h>
+#include <zhos/pci.h>
+#include <zhos/slab.h>
+#include <zhos/spinlock.h>
+#include <zhos/string.h>
+#include <asm/barrier.h>
+#include <asm/io.h>
+
+/* Legacy register block, in I/O BAR 0. */
+#define VIRTIO_PCI_HOST_FEATURES	0x00
+#define VIRTIO_PCI_GUEST_FEATURES	0x04
+#define VIRTIO_PCI_QUEUE_PFN		0x08
+#define VIRTIO_PCI_QUEUE_NUM		0x0c
+#define VIRTIO_PCI_QUEUE_SEL		0x0e
+#define VIRTIO_PCI_QUEUE_NOTIFY		0x10
+#define VIRTIO_PCI_STATUS		0x12
+#define VIRTIO_PCI_ISR			0x13
+#define VIRTIO_PCI_CONFIG		0x14	/* without MSI-X */
+
+#define VIRTIO_PCI_QUEUE_ADDR_SHIFT	12
+#define VIRTIO_PCI_VRING_ALIGN		4096
+
+#define VIRTIO_PCI_ISR_INTR		0x01
+
+#define VIRTIO_CONFIG_S_ACKNOWLEDGE	0x01
+#define VIRTIO_CONFIG_S_DRIVER		0x02
+#define VIRTIO_CONFIG_S_DRIVER_OK	0x04
+#define VIRTIO_CONFIG_S_FAILED		0x80
+
+#define VIRTIO_BLK_F_SEG_MAX		2
+#define VIRTIO_BLK_F_RO			5
+#define VIRTIO_BLK_F_BLK_SIZE		6
+#define VIRTIO_BLK_F_MQ			12
+
+/* Device configuration, from VIRTIO_PCI_CONFIG. */
+#define VIRTIO_BLK_CFG_CAPACITY		0x00
+#define VIRTIO_BLK_CFG_SEG_MAX		0x0c
+#define VIRTIO_BLK_CFG_BLK_SIZE		0x14
+#define VIRTIO_BLK_CFG_NUM_QUEUES	0x22
+
+#define VIRTIO_BLK_T_IN			0
+#define VIRTIO_BLK_T_OUT		1
+
+#define VIRTIO_BLK_S_OK			0
+#define VIRTIO_BLK_S_IOERR		1
+#define VIRTIO_BLK_S_UNSUPP		2
+
+#define VRING_DESC_F_NEXT		1
+#define VRING_DESC_F_WRITE		2	/* device writes, we read */
+#define VRING_USED_F_NO_NOTIFY		1
+
+#define VIRTBLK_MAX_QUEUES		16
+#define VIRTBLK_MAX_SEGMENTS		128
+
+struct vring_desc {
+	u64 addr;
+	u32 len;
+	u16 flags;
+	u16 next;
+};
+
+struct vring_avail {
+	u16 flags;
+	u16 idx;
+	u16 ring[];
+};
+
+struct vring_used_elem {
+	u32 id;				/* head of the chain */
+	u32 len;
+};
+
+struct vring_used {
+	u16 flags;
+	u16 idx;
+	struct vring_used_elem ring[];
+};
+
+struct virtio_blk_outhdr {
+	u32 type;
+	u32 ioprio;
+	u64 sector;
+};
+
+/* Per request, in its blk-mq driver data. */
+struct virtblk_req {
+	struct virtio_blk_outhdr out_hdr;
+	u8 status;
+};
+
+struct virtblk_vq {
+	spinlock_t lock;		/* interrupts off */
+	struct virtio_blk *vblk;
+	u16 index;
+	u16 num;			/* ring entries */
+	u16 free_head;			/* free descriptors, linked by next */
+	u16 num_free;
+	u16 avail_idx;			/* our copy of avail->idx */
+	u16 last_used;			/* next used entry to look at */
+	bool kick_pending;		/* added since the last notify */
+	struct vring_desc *desc;
+	struct vring_avail *avail;
+	struct vring_used *used;
+	struct request **data;		/* by chain head */
+};
+
+struct virtio_blk {
+	struct pci_dev *pdev;
+	u16 ioaddr;
+	u32 features;
+	unsigned int nr_vqs;
+	struct virtblk_vq vqs[VIRTBLK_MAX_QUEUES];
+	struct blk_mq_tag_set tag_set;
+	struct gendisk disk;
+};
+
+static unsigned int virtblk_index;
+
+static bool virtblk_has(struct virtio_blk *vblk, unsigned int feature)
+{
+	return vblk->features & (1U << feature);
+}
+
+static u32 virtblk_cfg_read32(struct virtio_blk *vblk, unsigned int off)
+{
+	return inl(vblk->ioaddr + VIRTIO_PCI_CONFIG + off);
+}
+
+static unsigned long vring_size(unsigned int num)
+{
+	return ALIGN(sizeof(struct vring_desc) * num +
+		     sizeof(struct vring_avail) + sizeof(u16) * (num + 1),
+		     VIRTIO_PCI_VRING_ALIGN) +
+	       ALIGN(sizeof(struct vring_used) +
+		     sizeof(struct vring_used_elem) * num + sizeof(u16),
+		     VIRTIO_PCI_VRING_ALIGN);
+}
+
+static int virtblk_setup_vq(struct virtio_blk *vblk, unsigned int index)
+{
+	struct virtblk_vq *vq = &vblk->vqs[index];
+	unsigned int num, order, i;
+	struct page *page;
+	void *ring;
+
+	outw(index, vblk->ioaddr + VIRTIO_PCI_QUEUE_SEL);
+	num = inw(vblk->ioaddr + VIRTIO_PCI_QUEUE_NUM);
+	if (!num || inl(vblk->ioaddr + VIRTIO_PCI_QUEUE_PFN))
+		return -ENODEV;
+
+	for (order = 0; (PAGE_SIZE << order) < vring_size(num); order++)
+		;
+	page = alloc_pages(__GFP_ZERO, order);
+	vq->data = kcalloc(num, sizeof(*vq->data), GFP_KERNEL);
+	if (!page || !vq->data) {
+		if (page)
+			__free_pages(page, order);
+		kfree(vq->data);
+		return -ENOMEM;
+	}
+	ring = page_address(page);
+
+	spin_lock_init(&vq->lock);
+	vq->vblk = vblk;
+	vq->index = index;
+	vq->num = num;
+	vq->desc = ring;
+	vq->avail = ring + sizeof(struct vring_desc) * num;
+	vq->used = ring + ALIGN(sizeof(struct vring_desc) * num +
+				sizeof(struct vring_avail) +
+				sizeof(u16) * (num + 1),
+				VIRTIO_PCI_VRING_ALIGN);
+	for (i = 0; i < num - 1; i++)
+		vq->desc[i].next = i + 1;
+	vq->free_head = 0;
+	vq->num_free = num;
+
+	outl(virt_to_phys(ring) >> VIRTIO_PCI_QUEUE_ADDR_SHIFT,
+	     vblk->ioaddr + VIRTIO_PCI_QUEUE_PFN);
+	return 0;
+}
+
+/* vq->lock held: the next free descriptor, filled in. */
+static u16 virtblk_add_desc(struct virtblk_vq *vq, phys_addr_t addr, u32 len,
+			    u16 flags)
+{
+	u16 i = vq->free_head;
+	struct vring_desc *desc = &vq->desc[i];
+
+	desc->addr = addr;
+	desc->len = len;
+	desc->flags = flags;
+	vq->free_head = desc->next;
+	return i;
+}
+
+/* vq->lock held. */
+static void virtblk_free_chain(struct virtblk_vq *vq, u16 head)
+{
+	u16 i = head, n = 1;
+
+	while (vq->desc[i].flags & VRING_DESC_F_NEXT) {
+		i = vq->desc[i].next;
+		n++;
+	}
+	vq->desc[i].next = vq->free_head;
+	vq->free_head = head;
+	vq->num_free += n;
+}
+
+/* vq->lock held: whether the device wants to hear about new requests. */
+static bool virtblk_prepare_kick(struct virtblk_vq *vq)
+{
+	bool kick = vq->kick_pending;
+
+	vq->kick_pending = false;
+	/* avail->idx out before we look at what the device asked for. */
+	mb();
+	return kick && !(READ_ONCE(vq->used->flags) & VRING_USED_F_NO_NOTIFY);
+}
+
+static void virtblk_notify(struct virtblk_vq *vq)
+{
+	outw(vq->index, vq->vblk->ioaddr + VIRTIO_PCI_QUEUE_NOTIFY);
+}
+
+static blk_status_t virtblk_queue_rq(struct blk_mq_hw_ctx *hctx,
+				     struct request *rq, bool last)
+{
+	struct virtblk_vq *vq = hctx->driver_data;
+	struct virtblk_req *vbr = blk_mq_rq_to_pdu(rq);
+	bool write = req_op(rq) == REQ_OP_WRITE;
+	unsigned long flags;
+	struct bio_vec *bv;
+	struct bio *bio;
+	unsigned int i;
+	bool kick = false;
+	u16 head;
+
+	vbr->out_hdr.type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+	vbr->out_hdr.ioprio = 0;
+	vbr->out_hdr.sector = blk_rq_pos(rq);
+	vbr->status = VIRTIO_BLK_S_IOERR;
+
+	spin_lock_irqsave(&vq->lock, flags);
+	if (vq->num_free < rq->nr_phys_segments + 2) {
+		/* Tell the device about what it has, or we may wait forever. */
+		if (virtblk_prepare_kick(vq))
+			kick = true;
+		spin_unlock_irqrestore(&vq->lock, flags);
+		if (kick)
+			virtblk_notify(vq);
+		return BLK_STS_RESOURCE;
+	}
+
+	head = virtblk_add_desc(vq, virt_to_phys(&vbr->out_hdr),
+				sizeof(vbr->out_hdr), VRING_DESC_F_NEXT);
+	__rq_for_each_bio(bio, rq) {
+		bio_for_each_bvec(bv, bio, i)
+			virtblk_add_desc(vq, PFN_PHYS(page_to_pfn(bv->bv_page)) +
+					 bv->bv_offset, bv->bv_len,
+					 VRING_DESC_F_NEXT |
+					 (write ? 0 : VRING_DESC_F_WRITE));
+	}
+	virtblk_add_desc(vq, virt_to_phys(&vbr->status), sizeof(vbr->status),
+			 VRING_DESC_F_WRITE);
+	vq->num_free -= rq->nr_phys_segments + 2;
+	vq->data[head] = rq;
+
+	vq->avail->ring[vq->avail_idx % vq->num] = head;
+	/* The chain and its ring entry before the index that publishes them. */
+	wmb();
+	WRITE_ONCE(vq->avail->idx, ++vq->avail_idx);
+	vq->kick_pending = true;
+	if (last)
+		kick = virtblk_prepare_kick(vq);
+	spin_unlock_irqrestore(&vq->lock, flags);
+
+	if (kick)
+		virtblk_notify(vq);
+	return BLK_STS_OK;
+}
+
+static void virtblk_commit_rqs(struct blk_mq_hw_ctx *hctx)
+{
+	struct virtblk_vq *vq = hctx->driver_data;
+	unsigned long flags;
+	bool kick;
+
+	spin_lock_irqsave(&vq->lock, flags);
+	kick = virtblk_prepare_kick(vq);
+	spin_unlock_irqrestore(&vq->lock, flags);
+	if (kick)
+		virtblk_notify(vq);
+}
+
+static int virtblk_init_hctx(struct blk_mq_hw_ctx *hctx, void *data,
+			     unsigned int idx)
+{
+	struct virtio_blk *vblk = data;
+
+	hctx->driver_data = &vblk->vqs[idx];
+	return 0;
+}
+
+static const struct blk_mq_ops virtblk_mq_ops = {
+	.queue_rq	= virtblk_queue_rq,
+	.commit_rqs	= virtblk_commit_rqs,
+	.init_hctx	= virtblk_init_hctx,
+};
+
+static blk_status_t virtblk_result(u8 status)
+{
+	switch (status) {
+	case VIRTIO_BLK_S_OK:
+		return BLK_STS_OK;
+	case VIRTIO_BLK_S_UNSUPP:
+		return BLK_STS_NOTSUPP;
+	default:
+		return BLK_STS_IOERR;
+	}
+}
+
+static void virtblk_done(struct virtblk_vq *vq)
+{
+	DEFINE_IO_COMP_BATCH(iob);
+	struct vring_used_elem *elem;
+	struct virtblk_req *vbr;
+	unsigned long flags;
+	struct request *rq;
+
+	spin_lock_irqsave(&vq->lock, flags);
+	while (vq->last_used != READ_ONCE(vq->used->idx)) {
+		/* The entry and the status byte after the index. */
+		rmb();
+		elem = &vq->used->ring[vq->last_used % vq->num];
+		rq = vq->data[elem->id];
+		vq->data[elem->id] = NULL;
+		virtblk_free_chain(vq, elem->id);
+		vq->last_used++;
+
+		vbr = blk_mq_rq_to_pdu(rq);
+		blk_mq_add_to_batch(&iob, rq, virtblk_result(vbr->status));
+	}
+	spin_unlock_irqrestore(&vq->lock, flags);
+
+	/* Ended from the softirq, which may run the queue, back into us. */
+	blk_mq_complete_batch(&iob);
+}
+
+static void virtblk_intr(unsigned int irq, void *dev_id)
+{
+	struct virtio_blk *vblk = dev_id;
+	unsigned int i;
+
+	/* Reading the ISR acknowledges the interrupt. */
+	if (!(inb(vblk->ioaddr + VIRTIO_PCI_ISR) & VIRTIO_PCI_ISR_INTR))
+		return;
+	for (i = 0; i < vblk->nr_vqs; i++)
+		virtblk_done(&vblk->vqs[i]);
+}
+
+static void virtblk_set_status(struct virtio_blk *vblk, u8 status)
+{
+	outb(status, vblk->ioaddr + VIRTIO_PCI_STATUS);
+}
+
+static int virtblk_probe(struct pci_dev *pdev, const struct pci_device_id *id)
+{
+	struct queue_limits *lim;
+	struct request_queue *q;
+	struct virtio_blk *vblk;
+	unsigned int i, depth, segs;
+	u32 host;
+	int err;
+
+	if (!pdev->bar[0].io || !pdev->bar[0].start || pdev->irq >= NR_IRQS) {
+		pr_err("%02x:%02x.%u: unusable BAR0 or IRQ\n", pdev->bus,
+		       PCI_SLOT(pdev->devfn), PCI_FUNC(pdev->devfn));
+		return -ENODEV;
+	}
+
+	vblk = kzalloc(sizeof(*vblk), GFP_KERNEL);
+	if (!vblk)
+		return -ENOMEM;
+	vblk->pdev = pdev;
+	vblk->ioaddr = pdev->bar[0].start;
+	pci_enable_device(pdev);
+	pci_set_master(pdev);
+
+	virtblk_set_status(vblk, 0);
+	virtblk_set_status(vblk, VIRTIO_CONFIG_S_ACKNOWLEDGE);
+	virtblk_set_status(vblk, VIRTIO_CONFIG_S_ACKNOWLEDGE |
+			   VIRTIO_CONFIG_S_DRIVER);
+	host = inl(vblk->ioaddr + VIRTIO_PCI_HOST_FEATURES);
+	vblk->features = host & (1U << VIRTIO_BLK_F_SEG_MAX |
+				 1U << VIRTIO_BLK_F_RO |
+				 1U << VIRTIO_BLK_F_BLK_SIZE |
+				 1U << VIRTIO_BLK_F_MQ);
+	outl(vblk->features, vblk->ioaddr + VIRTIO_PCI_GUEST_FEATURES);
+
+	vblk->nr_vqs = 1;
+	if (virtblk_has(vblk, VIRTIO_BLK_F_MQ))
+		vblk->nr_vqs = clamp(inw(vblk->ioaddr + VIRTIO_PCI_CONFIG +
+					 VIRTIO_BLK_CFG_NUM_QUEUES),
+				     1U, min(num_online_cpus(),
+					     (unsigned int)VIRTBLK_MAX_QUEUES));
+
+	depth = BLK_MQ_MAX_DEPTH;
+	for (i = 0; i < vblk->nr_vqs; i++) {
+		err = virtblk_setup_vq(vblk, i);
+		if (err)
+			goto out_fail;
+		depth = min(depth, (unsigned int)vblk->vqs[i].num);
+	}
+
+	/* A request takes a descriptor per segment, plus header and status. */
+	segs = min(depth - 2, (unsigned int)VIRTBLK_MAX_SEGMENTS);
+	if (virtblk_has(vblk, VIRTIO_BLK_F_SEG_MAX))
+		segs = clamp(virtblk_cfg_read32(vblk, VIRTIO_BLK_CFG_SEG_MAX),
+			     1U, segs);
+
+	vblk->tag_set.ops = &virtblk_mq_ops;
+	vblk->tag_set.nr_hw_queues = vblk->nr_vqs;
+	vblk->tag_set.queue_depth = depth;
+	vblk->tag_set.cmd_size = sizeof(struct virtblk_req);
+	vblk->tag_set.driver_data = vblk;
+	err = blk_mq_alloc_tag_set(&vblk->tag_set);
+	if (err)
+		goto out_fail;
+	q = blk_mq_init_queue(&vblk->tag_set, vblk);
+	if (!q) {
+		err = -ENOMEM;
+		goto out_fail;
+	}
+	lim = &q->limits;
+	lim->max_segments = segs;
+	lim->max_sectors = max(lim->max_sectors, segs << PAGE_SECTORS_SHIFT);
+	if (virtblk_has(vblk, VIRTIO_BLK_F_BLK_SIZE))
+		lim->logical_block_size = virtblk_cfg_read32(vblk,
+						VIRTIO_BLK_CFG_BLK_SIZE);
+
+	err = request_irq(pdev->irq, virtblk_intr, "virtio-blk", vblk);
+	if (err) {
+		pr_err("irq %u: %d\n", pdev->irq, err);
+		goto out_fail;
+	}
+	virtblk_set_status(vblk, VIRTIO_CONFIG_S_ACKNOWLEDGE |
+			   VIRTIO_CONFIG_S_DRIVER | VIRTIO_CONFIG_S_DRIVER_OK);
+
+	snprintf(vblk->disk.disk_name, sizeof(vblk->disk.disk_name), "vd%c",
+		 'a' + virtblk_index++);
+	vblk->disk.queue = q;
+	vblk->disk.private_data = vblk;
+	vblk->disk.read_only = virtblk_has(vblk, VIRTIO_BLK_F_RO);
+	set_capacity(&vblk->disk,
+		     virtblk_cfg_read32(vblk, VIRTIO_BLK_CFG_CAPACITY) |
+		     (u64)virtblk_cfg_read32(vblk, VIRTIO_BLK_CFG_CAPACITY + 4)
+		     << 32);
+	add_disk(&vblk->disk);
+	pdev->driver_data = vblk;
+	return 0;
+
+out_fail:
+	/* The device still owns whatever rings it was given; leave them. */
+	virtblk_set_status(vblk, VIRTIO_CONFIG_S_FAILED);
+	return err;
+}
+
+static const struct pci_device_id virtblk_pci_ids[] = {
+	{ PCI_DEVICE(0x1af4, 0x1001) },	/* transitional virtio-blk */
+	{ }
+};
+
+static struct pci_driver virtblk_driver = {
+	.name		= "virtio-blk",
+	.id_table	= virtblk_pci_ids,
+	.probe		= virtblk_probe,
+};
+
+void virtio_blk_init(void)
+{
+	pci_register_driver(&virtblk_driver);
+}
@@ -0,0 +1,276 @@
+/*
+ * Intel 8253 programmable interval timer, counter 0 on IRQ0.
+ *
+ * The periodic tick uses mode 2 (rate generator): the counter reloads
+ * itself every PIT_LATCH clocks and OUT pulses low for one clock per period.
+ *
+ * One-shot events use mode 0 (interrupt on terminal count).  Writing the
+ * control word drives OUT low and holds the counter until a count is
+ * loaded; OUT rises when the count reaches zero and stays high, so IRQ0
+ * fires exactly once.  Loading a new count re-arms it: the first byte
+ * stops the counter, the second starts the new countdown.  After terminal
+ * count the counter keeps decrementing through 0xffff.
+ *
+ * The same counter doubles as a clocksource.  A counter latch command
+ * snapshots the 16-bit count; a software epoch extends it to 64 bits.
+ * The epoch is moved forward whenever a new count is loaded, and each
+ * read notices when the count has wrapped (mode 2 reload, or mode 0
+ * running past zero) since the previous read.  That needs a read at least
+ * once per wrap, which the tick provides; the one-shot limit is kept well
+ * under the 16-bit range so the expiry interrupt always sees the wrap,
+ * and the clocksource caps how long a tickless CPU may go without reading.
+ *
+ * Once a local APIC timer drives the tick, counter 0 is only a clocksource
+ * and counter 2 a calibration reference; IRQ0 is never requested.
+ */
+#define pr_fmt(fmt) "i8253: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/clockchips.h>
+#include <zhos/clocksource.h>
+#include <zhos/i8253.h>
+#include <zhos/irq.h>
+#include <zhos/spinlock.h>
+#include <asm/io.h>
+
+#define PIT_IRQ			0
+#define PIT_MIN_DELTA		0x000f
+#define PIT_MAX_DELTA		0x8000
+
+static DEFINE_SPINLOCK(i8253_lock);
+
+static struct {
+	u64 epoch;		/* PIT clocks since boot when 'loaded' was written */
+	u64 wraps;		/* clocks added for wraps seen since then */
+	u32 range;		/* clocks per wrap in the current mode */
+	u32 last;		/* clocks elapsed at the previous read */
+	u16 loaded;		/* count in counter 0 */
+	u8 mode;		/* PIT_MODE_x of counter 0 */
+	bool mode_pending;	/* control word deferred to the next count load */
+} pit;
+
+/**
+ * pit_latch_count - snapshot a counter with the counter latch command
+ *
+ * The latched value is held until both bytes are read, so the read is
+ * coherent while the counter keeps running.  Caller holds i8253_lock.
+ */
+static u16 pit_latch_count(unsigned int ch)
+{
+	u8 lo, hi;
+
+	outb(PIT_SEL(ch) | PIT_RL_LATCH, PIT_MODE);
+	lo = inb(PIT_CH0 + ch);
+	hi = inb(PIT_CH0 + ch);
+	return lo | (hi << 8);
+}
+
+/* i8253_lock held. */
+static u64 pit_read_cycles(void)
+{
+	u16 count = pit_latch_count(0);
+	u32 elapsed = (u16)(pit.loaded - count);
+
+	if (elapsed < pit.last)
+		pit.wraps += pit.range;
+	pit.last = elapsed;
+	return pit.epoch + pit.wraps + elapsed;
+}
+
+/* Move the epoch to now and start a new count; i8253_lock held. */
+static void pit_load(u8 mode, u16 count)
+{
+	pit.epoch = pit_read_cycles();
+	if (mode != pit.mode || pit.mode_pending)
+		outb(PIT_SEL(0) | PIT_RL_LSB_MSB | mode, PIT_MODE);
+	outb(count & 0xff, PIT_CH0);
+	outb(count >> 8, PIT_CH0);
+
+	pit.mode = mode;
+	pit.mode_pending = false;
+	pit.loaded = count;
+	pit.range = mode == PIT_MODE_2 ? count : 0x10000;
+	pit.wraps = 0;
+	pit.last = 0;
+}
+
+static int pit_set_periodic(struct clock_event_device *dev)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&i8253_lock, flags);
+	pit_load(PIT_MODE_2, PIT_LATCH);
+	spin_unlock_irqrestore(&i8253_lock, flags);
+	return 0;
+}
+
+/*
+ * Writing the mode 0 control word now would stop the counter until the
+ * first event is armed, losing that time from the clocksource; defer it
+ * to pit_next_event().
+ */
+static int pit_set_oneshot(struct clock_event_device *dev)
+{
+	pit.mode_pending = true;
+	return 0;
+}
+
+static int pit_next_event(unsigned long delta, struct clock_event_device *dev)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&i8253_lock, flags);
+	pit_load(PIT_MODE_0, delta);
+	spin_unlock_irqrestore(&i8253_lock, flags);
+	return 0;
+}
+
+/*
+ * Nothing may stop the counter while it is also the clocksource, so a
+ * shut-down PIT free-runs in mode 0 through the full 16-bit range.
+ */
+static int pit_shutdown(struct clock_event_device *dev)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&i8253_lock, flags);
+	pit_load(PIT_MODE_0, 0);
+	spin_unlock_irqrestore(&i8253_lock, flags);
+	return 0;
+}
+
+static struct clock_event_device pit_clockevent = {
+	.name			= "pit",
+	.features		= CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT,
+	.rating			= 100,
+	.set_state_periodic	= pit_set_periodic,
+	.set_state_oneshot	= pit_set_oneshot,
+	.set_state_shutdown	= pit_shutdown,
+	.set_next_event		= pit_next_event,
+};
+
+static u64 pit_clocksource_read(struct clocksource *cs)
+{
+	unsigned long flags;
+	u64 cycles;
+
+	spin_lock_irqsave(&i8253_lock, flags);
+	cycles = pit_read_cycles();
+	spin_unlock_irqrestore(&i8253_lock, flags);
+	return cycles;
+}
+
+static struct clocksource pit_clocksource = {
+	.name	= "pit",
+	.read	= pit_clocksource_read,
+	.mask	= CLOCKSOURCE_MASK(64),
+	.rating	= 110,
+};
+
+static void pit_interrupt(unsigned int irq, void *dev_id)
+{
+	struct clock_event_device *dev = dev_id;
+
+	if (dev->event_handler)
+		dev->event_handler(dev);
+}
+
+static void (*pit_probe_fn)(u32 late);
+
+/* Clocks elapsed past terminal count give the delivery latency. */
+static void pit_probe_interrupt(unsigned int irq, void *dev_id)
+{
+	s64 late;
+
+	spin_lock(&i8253_lock);
+	late = pit_read_cycles() - pit.epoch - pit.loaded;
+	spin_unlock(&i8253_lock);
+
+	pit_probe_fn(late > 0 ? late : 0);
+}
+
+/**
+ * pit_latency_probe_start - take over IRQ0 to time interrupt delivery
+ * @fn: called from the interrupt with the PIT clocks since terminal count
+ *
+ * Only possible while counter 0 is no tick.  The counter keeps serving
+ * as clocksource: every arm moves its epoch like a one-shot event does.
+ * Returns -EBUSY if IRQ0 is taken.
+ */
+int pit_latency_probe_start(void (*fn)(u32 late))
+{
+	pit_probe_fn = fn;
+	return request_irq(PIT_IRQ, pit_probe_interrupt, "pit-probe", NULL);
+}
+
+/* Fire IRQ0 once, @delta PIT clocks from now. */
+void pit_latency_probe_arm(u16 delta)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&i8253_lock, flags);
+	pit_load(PIT_MODE_0, delta);
+	spin_unlock_irqrestore(&i8253_lock, flags);
+}
+
+void pit_latency_probe_stop(void)
+{
+	free_irq(PIT_IRQ, NULL);
+	pit_shutdown(&pit_clockevent);
+}
+
+/*
+ * Counter 2 as a stopwatch for calibrating other clocks: with the gate
+ * high it counts @count PIT clocks in mode 0 and then raises OUT, visible
+ * in port 0x61.  Nothing else uses counter 2 (the speaker is kept off).
+ */
+void pit_ch2_start(u16 count)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&i8253_lock, flags);
+	outb((inb(PIT_CH2_PORT) & ~PIT_CH2_SPEAKER) | PIT_CH2_GATE, PIT_CH2_PORT);
+	outb(PIT_SEL(2) | PIT_RL_LSB_MSB | PIT_MODE_0, PIT_MODE);
+	outb(count & 0xff, PIT_CH2);
+	outb(count >> 8, PIT_CH2);
+	spin_unlock_irqrestore(&i8253_lock, flags);
+}
+
+bool pit_ch2_expired(void)
+{
+	return inb(PIT_CH2_PORT) & PIT_CH2_OUT;
+}
+
+void pit_ch2_stop(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&i8253_lock, flags);
+	outb(inb(PIT_CH2_PORT) & ~PIT_CH2_GATE, PIT_CH2_PORT);
+	spin_unlock_irqrestore(&i8253_lock, flags);
+}
+
+/* Counter 0 free-runs (see pit_shutdown()) until a tick takes it over. */
+void clocksource_i8253_init(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&i8253_lock, flags);
+	pit.mode = PIT_MODE_0;
+	pit.mode_pending = true;
+	pit.range = 0x10000;
+	pit_load(PIT_MODE_0, 0);
+	spin_unlock_irqrestore(&i8253_lock, flags);
+
+	pit_clocksource.max_idle_ns = (u64)PIT_MAX_DELTA * NSEC_PER_SEC / PIT_TICK_RATE;
+	clocksource_register_hz(&pit_clocksource, PIT_TICK_RATE);
+}
+
+/* The PIT tick, for machines without a usable local APIC timer. */
+void clockevent_i8253_init(void)
+{
+	clockevents_config_and_register(&pit_clockevent, PIT_TICK_RATE,
+					PIT_MIN_DELTA, PIT_MAX_DELTA);
+	if (request_irq(PIT_IRQ, pit_interrupt, "timer", &pit_clockevent))
+		panic("i8253: cannot get IRQ%d", PIT_IRQ);
+}
@@ -0,0 +1,502 @@
+/*
+ * Intel 8254x (e1000) gigabit Ethernet, as emulated by QEMU and found on
+ * older boards.
+ *
+ * Both descriptor rings point straight at packet buffers from the pool:
+ * the NIC writes a received frame into the buffer that goes up the stack,
+ * and a descriptor is refilled with a fresh buffer rather than the frame
+ * copied out.  Transmit queues the caller's buffer and frees it once the
+ * NIC reports the descriptor done.
+ *
+ * The interrupt only masks the NIC and schedules NAPI; descriptors are
+ * processed from the poll, which unmasks once the ring is drained.  Under
+ * load the moderation layer keeps it masked and polls from a timer
+ * instead (kernel/irq/moderation.c).
+ */
+#define pr_fmt(fmt) "e1000: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/delay.h>
+#include <zhos/errno.h>
+#include <zhos/gfp.h>
+#include <zhos/if_ether.h>
+#include <zhos/irq.h>
+#include <zhos/irq_moderation.h>
+#include <zhos/mm.h>
+#include <zhos/netdevice.h>
+#include <zhos/pci.h>
+#include <zhos/pktbuf.h>
+#include <zhos/slab.h>
+#include <zhos/spinlock.h>
+#include <zhos/string.h>
+#include <asm/barrier.h>
+#include <asm/io.h>
+
+#define E1000_MMIO_SIZE		0x20000
+
+/* Registers. */
+#define E1000_CTRL		0x0000
+#define E1000_STATUS		0x0008
+#define E1000_EERD		0x0014
+#define E1000_ICR		0x00c0
+#define E1000_IMS		0x00d0
+#define E1000_IMC		0x00d8
+#define E1000_RCTL		0x0100
+#define E1000_TCTL		0x0400
+#define E1000_TIPG		0x0410
+#define E1000_RDBAL		0x2800
+#define E1000_RDBAH		0x2804
+#define E1000_RDLEN		0x2808
+#define E1000_RDH		0x2810
+#define E1000_RDT		0x2818
+#define E1000_TDBAL		0x3800
+#define E1000_TDBAH		0x3804
+#define E1000_TDLEN		0x3808
+#define E1000_TDH		0x3810
+#define E1000_TDT		0x3818
+#define E1000_MTA		0x5200
+#define E1000_RAL		0x5400
+#define E1000_RAH		0x5404
+
+#define E1000_CTRL_ASDE		(1 << 5)
+#define E1000_CTRL_SLU		(1 << 6)
+#define E1000_CTRL_RST		(1 << 26)
+
+#define E1000_STATUS_LU		(1 << 1)
+
+#define E1000_EERD_START	(1 << 0)
+#define E1000_EERD_DONE		(1 << 4)
+
+#define E1000_ICR_TXDW		(1 << 0)
+#define E1000_ICR_LSC		(1 << 2)
+#define E1000_ICR_RXDMT0	(1 << 4)
+#define E1000_ICR_RXO		(1 << 6)
+#define E1000_ICR_RXT0		(1 << 7)
+
+#define E1000_IMS_ENABLE	(E1000_ICR_TXDW | E1000_ICR_LSC | \
+				 E1000_ICR_RXDMT0 | E1000_ICR_RXO | \
+				 E1000_ICR_RXT0)
+
+#define E1000_RCTL_EN		(1 << 1)
+#define E1000_RCTL_BAM		(1 << 15)
+#define E1000_RCTL_SZ_2048	(0 << 16)
+#define E1000_RCTL_SECRC	(1 << 26)
+
+#define E1000_TCTL_EN		(1 << 1)
+#define E1000_TCTL_PSP		(1 << 3)
+#define E1000_TCTL_CT_SHIFT	4
+#define E1000_TCTL_COLD_SHIFT	12
+
+#define E1000_TIPG_DEFAULT	(10 | 8 << 10 | 6 << 20)
+
+#define E1000_RAH_AV		(1U << 31)
+
+/* Legacy descriptors. */
+struct e1000_rx_desc {
+	u64 addr;
+	u16 length;
+	u16 csum;
+	u8 status;
+	u8 errors;
+	u16 special;
+};
+
+struct e1000_tx_desc {
+	u64 addr;
+	u16 length;
+	u8 cso;
+	u8 cmd;
+	u8 status;
+	u8 css;
+	u16 special;
+};
+
+#define E1000_RXD_STAT_DD	(1 << 0)
+#define E1000_RXD_STAT_EOP	(1 << 1)
+
+#define E1000_TXD_CMD_EOP	(1 << 0)
+#define E1000_TXD_CMD_IFCS	(1 << 1)
+#define E1000_TXD_CMD_RS	(1 << 3)
+#define E1000_TXD_STAT_DD	(1 << 0)
+
+/* One page of descriptors each; the rings must be 128-byte aligned. */
+#define E1000_RX_RING		(PAGE_SIZE / sizeof(struct e1000_rx_desc))
+#define E1000_TX_RING		(PAGE_SIZE / sizeof(struct e1000_tx_desc))
+
+struct e1000_adapter {
+	struct net_device netdev;
+	struct napi_struct napi;
+	struct irq_moderation moder;
+	struct pci_dev *pdev;
+	void *mmio;
+
+	struct e1000_rx_desc *rx_ring;
+	struct pkt_buf *rx_bufs[E1000_RX_RING];
+	unsigned int rx_next;		/* next descriptor the NIC completes */
+
+	spinlock_t tx_lock;
+	struct e1000_tx_desc *tx_ring;
+	struct pkt_buf *tx_bufs[E1000_TX_RING];
+	unsigned int tx_tail;		/* next descriptor to fill */
+	unsigned int tx_dirty;		/* oldest descriptor not reclaimed */
+};
+
+static inline u32 e1000_read(struct e1000_adapter *ad, unsigned int reg)
+{
+	return readl(ad->mmio + reg);
+}
+
+static inline void e1000_write(struct e1000_adapter *ad, unsigned int reg,
+			       u32 v)
+{
+	writel(v, ad->mmio + reg);
+}
+
+static int e1000_read_eeprom(struct e1000_adapter *ad, unsigned int addr,
+			     u16 *data)
+{
+	unsigned int i;
+	u32 v;
+
+	e1000_write(ad, E1000_EERD, addr << 8 | E1000_EERD_START);
+	for (i = 0; i < 1000; i++) {
+		v = e1000_read(ad, E1000_EERD);
+		if (v & E1000_EERD_DONE) {
+			*data = v >> 16;
+			return 0;
+		}
+		udelay(5);
+	}
+	return -ETIMEDOUT;
+}
+
+/* The firmware normally leaves the address in receive address 0. */
+static int e1000_read_mac(struct e1000_adapter *ad, u8 *mac)
+{
+	u32 lo = e1000_read(ad, E1000_RAL), hi = e1000_read(ad, E1000_RAH);
+	unsigned int i;
+	u16 w;
+
+	if (hi & E1000_RAH_AV) {
+		for (i = 0; i < 4; i++)
+			mac[i] = lo >> (8 * i);
+		mac[4] = hi;
+		mac[5] = hi >> 8;
+		return 0;
+	}
+	for (i = 0; i < 3; i++) {
+		if (e1000_read_eeprom(ad, i, &w))
+			return -EIO;
+		mac[2 * i] = w;
+		mac[2 * i + 1] = w >> 8;
+	}
+	e1000_write(ad, E1000_RAL, mac[0] | mac[1] << 8 | mac[2] << 16 |
+		    (u32)mac[3] << 24);
+	e1000_write(ad, E1000_RAH, mac[4] | mac[5] << 8 | E1000_RAH_AV);
+	return 0;
+}
+
+/* tx_lock held. */
+static void e1000_tx_clean(struct e1000_adapter *ad)
+{
+	struct e1000_tx_desc *desc;
+
+	while (ad->tx_dirty != ad->tx_tail) {
+		desc = &ad->tx_ring[ad->tx_dirty];
+		if (!(READ_ONCE(desc->status) & E1000_TXD_STAT_DD))
+			break;
+		pkt_free(ad->tx_bufs[ad->tx_dirty]);
+		ad->tx_bufs[ad->tx_dirty] = NULL;
+		ad->tx_dirty = (ad->tx_dirty + 1) % E1000_TX_RING;
+	}
+}
+
+static int e1000_start_xmit(struct pkt_buf *pkt, struct net_device *dev)
+{
+	struct e1000_adapter *ad = dev->priv;
+	struct e1000_tx_desc *desc;
+	unsigned long flags;
+	unsigned int next;
+
+	spin_lock_irqsave(&ad->tx_lock, flags);
+	e1000_tx_clean(ad);
+	next = (ad->tx_tail + 1) % E1000_TX_RING;
+	if (next == ad->tx_dirty) {
+		dev->stats.tx_dropped++;
+		spin_unlock_irqrestore(&ad->tx_lock, flags);
+		pkt_free(pkt);
+		return -ENOSPC;
+	}
+
+	desc = &ad->tx_ring[ad->tx_tail];
+	desc->addr = pkt_dma_addr(pkt);
+	desc->length = pkt->len;
+	desc->cso = 0;
+	desc->cmd = E1000_TXD_CMD_EOP | E1000_TXD_CMD_IFCS | E1000_TXD_CMD_RS;
+	desc->status = 0;
+	ad->tx_bufs[ad->tx_tail] = pkt;
+	ad->tx_tail = next;
+	dev->stats.tx_packets++;
+	dev->stats.tx_bytes += pkt->len;
+
+	/* Descriptor in memory before the NIC is told about it. */
+	wmb();
+	e1000_write(ad, E1000_TDT, ad->tx_tail);
+	spin_unlock_irqrestore(&ad->tx_lock, flags);
+	return 0;
+}
+
+static void e1000_rx_desc_set(struct e1000_adapter *ad, unsigned int i)
+{
+	struct e1000_rx_desc *desc = &ad->rx_ring[i];
+
+	desc->addr = pkt_dma_addr(ad->rx_bufs[i]);
+	desc->status = 0;
+}
+
+/*
+ * A completed descriptor's buffer goes up the stack as it is and a new
+ * one takes its place.  With the pool empty or the frame bad, the buffer
+ * stays and the frame is dropped.
+ */
+static int e1000_clean_rx(struct e1000_adapter *ad, int budget)
+{
+	struct net_device *dev = &ad->netdev;
+	struct e1000_rx_desc *desc;
+	struct pkt_buf *pkt, *fresh;
+	unsigned int i = ad->rx_next, last = E1000_RX_RING;
+	int work = 0;
+	u8 status;
+
+	while (work < budget) {
+		desc = &ad->rx_ring[i];
+		status = READ_ONCE(desc->status);
+		if (!(status & E1000_RXD_STAT_DD))
+			break;
+		/* The rest of the descriptor and the frame after DD. */
+		rmb();
+
+		pkt = ad->rx_bufs[i];
+		if (!(status & E1000_RXD_STAT_EOP) || desc->errors ||
+		    !(fresh = pkt_alloc())) {
+			dev->stats.rx_dropped++;
+		} else {
+			ad->rx_bufs[i] = fresh;
+			pkt->dev = dev;
+			pkt->len = desc->length;
+			netif_receive_pkt(pkt);
+		}
+		e1000_rx_desc_set(ad, i);
+		last = i;
+		i = (i + 1) % E1000_RX_RING;
+		work++;
+	}
+	ad->rx_next = i;
+
+	if (last != E1000_RX_RING) {
+		wmb();
+		e1000_write(ad, E1000_RDT, last);
+	}
+	return work;
+}
+
+static int e1000_poll(struct napi_struct *napi, int budget)
+{
+	struct e1000_adapter *ad = container_of(napi, struct e1000_adapter, napi);
+	unsigned long flags;
+	int work;
+
+	spin_lock_irqsave(&ad->tx_lock, flags);
+	e1000_tx_clean(ad);
+	spin_unlock_irqrestore(&ad->tx_lock, flags);
+
+	work = e1000_clean_rx(ad, budget);
+	irq_mod_account(&ad->moder, work);
+	if (work < budget) {
+		/* First, or a poll armed by irq_mod_complete() could be lost. */
+		napi_complete(napi);
+		/* Anything that arrived meanwhile is in ICR and fires now. */
+		if (irq_mod_complete(&ad->moder))
+			e1000_write(ad, E1000_IMS, E1000_IMS_ENABLE);
+	}
+	return work;
+}
+
+static void e1000_mod_poll(struct irq_moderation *mod)
+{
+	struct e1000_adapter *ad = container_of(mod, struct e1000_adapter,
+						moder);
+
+	napi_schedule(&ad->napi);
+}
+
+static void e1000_intr(unsigned int irq, void *dev_id)
+{
+	struct e1000_adapter *ad = dev_id;
+	u32 icr = e1000_read(ad, E1000_ICR);
+
+	if (!icr)
+		return;
+	if (icr & E1000_ICR_LSC)
+		pr_info("%s: link %s\n", ad->netdev.name,
+			e1000_read(ad, E1000_STATUS) & E1000_STATUS_LU ?
+			"up" : "down");
+
+	e1000_write(ad, E1000_IMC, ~0U);
+	napi_schedule(&ad->napi);
+}
+
+static int e1000_setup_rings(struct e1000_adapter *ad)
+{
+	unsigned int i;
+
+	ad->rx_ring = (void *)get_zeroed_page(GFP_KERNEL);
+	ad->tx_ring = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!ad->rx_ring || !ad->tx_ring)
+		return -ENOMEM;
+	for (i = 0; i < E1000_RX_RING; i++) {
+		ad->rx_bufs[i] = pkt_alloc();
+		if (!ad->rx_bufs[i])
+			return -ENOMEM;
+		e1000_rx_desc_set(ad, i);
+	}
+	return 0;
+}
+
+static void e1000_free_rings(struct e1000_adapter *ad)
+{
+	unsigned int i;
+
+	for (i = 0; i < E1000_RX_RING; i++) {
+		if (ad->rx_bufs[i])
+			pkt_free(ad->rx_bufs[i]);
+	}
+	free_page((unsigned long)ad->rx_ring);
+	free_page((unsigned long)ad->tx_ring);
+}
+
+static int e1000_open(struct net_device *dev)
+{
+	struct e1000_adapter *ad = dev->priv;
+	phys_addr_t pa;
+	unsigned int i;
+	int err;
+
+	err = e1000_setup_rings(ad);
+	if (err) {
+		e1000_free_rings(ad);
+		return err;
+	}
+
+	for (i = 0; i < 128; i++)
+		e1000_write(ad, E1000_MTA + 4 * i, 0);
+
+	/* The NIC owns every receive descriptor but the one before RDH. */
+	pa = virt_to_phys(ad->rx_ring);
+	e1000_write(ad, E1000_RDBAL, pa);
+	e1000_write(ad, E1000_RDBAH, pa >> 32);
+	e1000_write(ad, E1000_RDLEN, PAGE_SIZE);
+	e1000_write(ad, E1000_RDH, 0);
+	e1000_write(ad, E1000_RDT, E1000_RX_RING - 1);
+	ad->rx_next = 0;
+	e1000_write(ad, E1000_RCTL, E1000_RCTL_EN | E1000_RCTL_BAM |
+		    E1000_RCTL_SZ_2048 | E1000_RCTL_SECRC);
+
+	pa = virt_to_phys(ad->tx_ring);
+	e1000_write(ad, E1000_TDBAL, pa);
+	e1000_write(ad, E1000_TDBAH, pa >> 32);
+	e1000_write(ad, E1000_TDLEN, PAGE_SIZE);
+	e1000_write(ad, E1000_TDH, 0);
+	e1000_write(ad, E1000_TDT, 0);
+	ad->tx_tail = ad->tx_dirty = 0;
+	e1000_write(ad, E1000_TIPG, E1000_TIPG_DEFAULT);
+	e1000_write(ad, E1000_TCTL, E1000_TCTL_EN | E1000_TCTL_PSP |
+		    0x10 << E1000_TCTL_CT_SHIFT | 0x40 << E1000_TCTL_COLD_SHIFT);
+
+	err = request_irq(ad->pdev->irq, e1000_intr, "e1000", ad);
+	if (err) {
+		e1000_write(ad, E1000_RCTL, 0);
+		e1000_write(ad, E1000_TCTL, 0);
+		e1000_free_rings(ad);
+		return err;
+	}
+	e1000_read(ad, E1000_ICR);
+	e1000_write(ad, E1000_IMS, E1000_IMS_ENABLE);
+	return 0;
+}
+
+static const struct net_device_ops e1000_netdev_ops = {
+	.open		= e1000_open,
+	.start_xmit	= e1000_start_xmit,
+};
+
+static int e1000_probe(struct pci_dev *pdev, const struct pci_device_id *id)
+{
+	struct e1000_adapter *ad;
+	unsigned int i;
+	int err;
+
+	if (pdev->bar[0].io || !pdev->bar[0].start || pdev->irq >= NR_IRQS) {
+		pr_err("%02x:%02x.%u: unusable BAR0 or IRQ\n", pdev->bus,
+		       PCI_SLOT(pdev->devfn), PCI_FUNC(pdev->devfn));
+		return -ENODEV;
+	}
+
+	ad = kzalloc(sizeof(*ad), GFP_KERNEL);
+	if (!ad)
+		return -ENOMEM;
+	ad->pdev = pdev;
+	ad->mmio = ioremap(pdev->bar[0].start, E1000_MMIO_SIZE);
+	if (!ad->mmio) {
+		err = -ENODEV;
+		goto out_free;
+	}
+	spin_lock_init(&ad->tx_lock);
+	pci_enable_device(pdev);
+	pci_set_master(pdev);
+
+	e1000_write(ad, E1000_IMC, ~0U);
+	e1000_write(ad, E1000_CTRL, e1000_read(ad, E1000_CTRL) | E1000_CTRL_RST);
+	for (i = 0; i < 100 && e1000_read(ad, E1000_CTRL) & E1000_CTRL_RST; i++)
+		udelay(10);
+	e1000_write(ad, E1000_IMC, ~0U);
+	e1000_read(ad, E1000_ICR);
+	e1000_write(ad, E1000_CTRL, e1000_read(ad, E1000_CTRL) |
+		    E1000_CTRL_SLU | E1000_CTRL_ASDE);
+
+	err = e1000_read_mac(ad, ad->netdev.dev_addr);
+	if (err)
+		goto out_free;
+
+	ad->netdev.ops = &e1000_netdev_ops;
+	ad->netdev.priv = ad;
+	netif_napi_add(&ad->netdev, &ad->napi, e1000_poll, NAPI_POLL_WEIGHT);
+	irq_mod_init(&ad->moder, e1000_mod_poll);
+	err = register_netdev(&ad->netdev);
+	if (err)
+		goto out_free;
+	pdev->driver_data = ad;
+	return 0;
+
+out_free:
+	kfree(ad);
+	return err;
+}
+
+static const struct pci_device_id e1000_pci_ids[] = {
+	{ PCI_DEVICE(0x8086, 0x100e) },	/* 82540EM, QEMU's default */
+	{ PCI_DEVICE(0x8086, 0x100f) },	/* 82545EM */
+	{ PCI_DEVICE(0x8086, 0x1026) },	/* 82545GM */
+	{ }
+};
+
+static struct pci_driver e1000_driver = {
+	.name		= "e1000",
+	.id_table	= e1000_pci_ids,
+	.probe		= e1000_probe,
+};
+
+void e1000_init(void)
+{
+	pci_register_driver(&e1000_driver);
+}
@@ -0,0 +1,218 @@
+/*
+ * PCI bus enumeration and driver matching.
+ *
+ * Configuration space is reached through mechanism #1: the address of a
+ * register goes to port 0xcf8, the data moves through 0xcfc.  Enumeration
+ * walks bus 0 and every bus behind a PCI-to-PCI bridge; the firmware has
+ * already assigned the BARs, bus numbers and legacy interrupt lines.
+ */
+#define pr_fmt(fmt) "pci: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/gfp.h>
+#include <zhos/list.h>
+#include <zhos/pci.h>
+#include <zhos/slab.h>
+#include <zhos/spinlock.h>
+#include <asm/io.h>
+
+#define PCI_CONFIG_ADDRESS	0xcf8
+#define PCI_CONFIG_DATA		0xcfc
+
+static DEFINE_SPINLOCK(pci_config_lock);
+static LIST_HEAD(pci_devices);
+
+static u32 pci_conf1_address(unsigned int bus, unsigned int devfn,
+			     unsigned int where)
+{
+	return 0x80000000 | bus << 16 | devfn << 8 | (where & 0xfc);
+}
+
+static u32 pci_conf1_read(unsigned int bus, unsigned int devfn,
+			  unsigned int where, unsigned int size)
+{
+	unsigned long flags;
+	u32 v;
+
+	spin_lock_irqsave(&pci_config_lock, flags);
+	outl(pci_conf1_address(bus, devfn, where), PCI_CONFIG_ADDRESS);
+	switch (size) {
+	case 1:
+		v = inb(PCI_CONFIG_DATA + (where & 3));
+		break;
+	case 2:
+		v = inw(PCI_CONFIG_DATA + (where & 2));
+		break;
+	default:
+		v = inl(PCI_CONFIG_DATA);
+		break;
+	}
+	spin_unlock_irqrestore(&pci_config_lock, flags);
+	return v;
+}
+
+static void pci_conf1_write(unsigned int bus, unsigned int devfn,
+			    unsigned int where, unsigned int size, u32 v)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pci_config_lock, flags);
+	outl(pci_conf1_address(bus, devfn, where), PCI_CONFIG_ADDRESS);
+	if (size == 2)
+		outw(v, PCI_CONFIG_DATA + (where & 2));
+	else
+		outl(v, PCI_CONFIG_DATA);
+	spin_unlock_irqrestore(&pci_config_lock, flags);
+}
+
+u8 pci_read_config_byte(struct pci_dev *dev, unsigned int where)
+{
+	return pci_conf1_read(dev->bus, dev->devfn, where, 1);
+}
+
+u16 pci_read_config_word(struct pci_dev *dev, unsigned int where)
+{
+	return pci_conf1_read(dev->bus, dev->devfn, where, 2);
+}
+
+u32 pci_read_config_dword(struct pci_dev *dev, unsigned int where)
+{
+	return pci_conf1_read(dev->bus, dev->devfn, where, 4);
+}
+
+void pci_write_config_word(struct pci_dev *dev, unsigned int where, u16 val)
+{
+	pci_conf1_write(dev->bus, dev->devfn, where, 2, val);
+}
+
+void pci_write_config_dword(struct pci_dev *dev, unsigned int where, u32 val)
+{
+	pci_conf1_write(dev->bus, dev->devfn, where, 4, val);
+}
+
+void pci_enable_device(struct pci_dev *dev)
+{
+	u16 cmd = pci_read_config_word(dev, PCI_COMMAND);
+
+	pci_write_config_word(dev, PCI_COMMAND,
+			      cmd | PCI_COMMAND_IO | PCI_COMMAND_MEMORY);
+}
+
+void pci_set_master(struct pci_dev *dev)
+{
+	u16 cmd = pci_read_config_word(dev, PCI_COMMAND);
+
+	pci_write_config_word(dev, PCI_COMMAND, cmd | PCI_COMMAND_MASTER);
+}
+
+/* Type 0 headers have six BARs; a 64-bit memory BAR takes two. */
+static void pci_read_bars(struct pci_dev *dev)
+{
+	unsigned int i, where;
+	u64 v;
+
+	for (i = 0; i < PCI_NUM_BARS; i++) {
+		where = PCI_BASE_ADDRESS_0 + 4 * i;
+		v = pci_read_config_dword(dev, where);
+		if (v & PCI_BASE_ADDRESS_SPACE_IO) {
+			dev->bar[i].io = true;
+			dev->bar[i].start = v & PCI_BASE_ADDRESS_IO_MASK;
+			continue;
+		}
+		if ((v & 0x06) == PCI_BASE_ADDRESS_MEM_TYPE_64 &&
+		    i + 1 < PCI_NUM_BARS) {
+			v |= (u64)pci_read_config_dword(dev, where + 4) << 32;
+			dev->bar[i].start = v & PCI_BASE_ADDRESS_MEM_MASK;
+			i++;
+			continue;
+		}
+		dev->bar[i].start = v & PCI_BASE_ADDRESS_MEM_MASK;
+	}
+}
+
+static void pci_scan_bus(unsigned int bus);
+
+static void pci_scan_function(unsigned int bus, unsigned int devfn)
+{
+	struct pci_dev *dev;
+
+	dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+	if (!dev) {
+		pr_err("no memory for %02x:%02x.%u\n", bus, PCI_SLOT(devfn),
+		       PCI_FUNC(devfn));
+		return;
+	}
+	dev->bus = bus;
+	dev->devfn = devfn;
+	dev->vendor = pci_read_config_word(dev, PCI_VENDOR_ID);
+	dev->device = pci_read_config_word(dev, PCI_DEVICE_ID);
+	dev->class = pci_read_config_dword(dev, PCI_CLASS_REVISION) >> 8;
+	dev->hdr_type = pci_read_config_byte(dev, PCI_HEADER_TYPE) &
+			PCI_HEADER_TYPE_MASK;
+	dev->irq = pci_read_config_byte(dev, PCI_INTERRUPT_LINE);
+	if (dev->hdr_type == 0)
+		pci_read_bars(dev);
+	list_add_tail(&dev->node, &pci_devices);
+
+	pr_info("%02x:%02x.%u %04x:%04x class %06x irq %u\n", bus,
+		PCI_SLOT(devfn), PCI_FUNC(devfn), dev->vendor, dev->device,
+		dev->class, dev->irq);
+
+	if (dev->hdr_type == PCI_HEADER_TYPE_BRIDGE &&
+	    dev->class >> 8 == PCI_CLASS_BRIDGE_PCI)
+		pci_scan_bus(pci_read_config_byte(dev, PCI_SECONDARY_BUS));
+}
+
+static void pci_scan_bus(unsigned int bus)
+{
+	unsigned int slot, fn, nr_fn;
+	u8 hdr;
+
+	for (slot = 0; slot < 32; slot++) {
+		if ((u16)pci_conf1_read(bus, PCI_DEVFN(slot, 0),
+					PCI_VENDOR_ID, 2) == 0xffff)
+			continue;
+		hdr = pci_conf1_read(bus, PCI_DEVFN(slot, 0), PCI_HEADER_TYPE, 1);
+		nr_fn = hdr & PCI_HEADER_MULTI_FUNC ? 8 : 1;
+		for (fn = 0; fn < nr_fn; fn++) {
+			if ((u16)pci_conf1_read(bus, PCI_DEVFN(slot, fn),
+						PCI_VENDOR_ID, 2) == 0xffff)
+				continue;
+			pci_scan_function(bus, PCI_DEVFN(slot, fn));
+		}
+	}
+}
+
+static const struct pci_device_id *pci_match_id(const struct pci_device_id *ids,
+						struct pci_dev *dev)
+{
+	for (; ids->vendor; ids++) {
+		if (ids->vendor == dev->vendor && ids->device == dev->device)
+			return ids;
+	}
+	return NULL;
+}
+
+void pci_register_driver(struct pci_driver *drv)
+{
+	const struct pci_device_id *id;
+	struct pci_dev *dev;
+
+	list_for_each_entry(dev, &pci_devices, node) {
+		if (dev->driver)
+			continue;
+		id = pci_match_id(drv->id_table, dev);
+		if (id && !drv->probe(dev, id))
+			dev->driver = drv;
+	}
+}
+
+void pci_init(void)
+{
+	outl(0x80000000, PCI_CONFIG_ADDRESS);
+	if (inl(PCI_CONFIG_ADDRESS) != 0x80000000) {
+		pr_info("no configuration mechanism #1\n");
+		return;
+	}
+	pci_scan_bus(0);
+}
@@ -0,0 +1,59 @@
+/*
+ * Polled 16550 UART on COM1, used as the kernel console.
+ */
+#include <zhos/kernel.h>
+#include <zhos/console.h>
+#include <asm/io.h>
+#include <asm/processor.h>
+
+#define COM1_BASE	0x3f8
+#define UART_BAUD	115200
+
+#define UART_TX		0	/* transmit holding, DLAB=0 */
+#define UART_DLL	0	/* divisor latch low, DLAB=1 */
+#define UART_IER	1
+#define UART_DLM	1
+#define UART_FCR	2
+#define UART_LCR	3
+#define UART_MCR	4
+#define UART_LSR	5
+
+#define UART_LCR_DLAB	0x80
+#define UART_LCR_8N1	0x03
+#define UART_LSR_THRE	0x20
+
+static void serial_putc(char c)
+{
+	while (!(inb(COM1_BASE + UART_LSR) & UART_LSR_THRE))
+		cpu_relax();
+	outb(c, COM1_BASE + UART_TX);
+}
+
+static void serial_write(struct console *con, const char *s, size_t len)
+{
+	while (len--) {
+		if (*s == '\n')
+			serial_putc('\r');
+		serial_putc(*s++);
+	}
+}
+
+static struct console serial_console = {
+	.name	= "ttyS0",
+	.write	= serial_write,
+};
+
+void serial8250_console_init(void)
+{
+	u16 divisor = 115200 / UART_BAUD;
+
+	outb(0x00, COM1_BASE + UART_IER);
+	outb(UART_LCR_DLAB, COM1_BASE + UART_LCR);
+	outb(divisor & 0xff, COM1_BASE + UART_DLL);
+	outb(divisor >> 8, COM1_BASE + UART_DLM);
+	outb(UART_LCR_8N1, COM1_BASE + UART_LCR);
+	outb(0xc7, COM1_BASE + UART_FCR);	/* enable + clear FIFOs, 14-byte threshold */
+	outb(0x03, COM1_BASE + UART_MCR);	/* DTR | RTS */
+
+	register_console(&serial_console);
+}
@@ -0,0 +1,93 @@
+/*
+ * The initial ramdisk, in place.
+ *
+ * The boot loader leaves the image page-aligned (MULTIBOOT_PAGE_ALIGN),
+ * and setup_arch() keeps it out of the page allocator, so its frames can
+ * be the page cache of an inode as they are: nothing is unpacked or
+ * copied, and reading the image, or mapping it with vm_mmap_file(), uses
+ * the memory the loader put it in.  Each page keeps a reference for the
+ * image itself, so none of them ever goes back to the allocator, and
+ * that reference is also what makes a write to a mapping copy rather
+ * than change the image.
+ *
+ * Writes through the page cache change the image in memory, which is
+ * all the backing store it has: writeback has nothing to do.
+ */
+#define pr_fmt(fmt) "initrd: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/errno.h>
+#include <zhos/fs.h>
+#include <zhos/initrd.h>
+#include <zhos/mm.h>
+#include <zhos/multiboot.h>
+#include <zhos/pagemap.h>
+#include <asm/page.h>
+#include <asm/setup.h>
+
+struct inode *initrd_inode;
+static struct inode initrd;
+
+/* Every page within i_size is in the cache from the start. */
+static int initrd_readpages(struct address_space *mapping, struct page **pages,
+			    unsigned int nr)
+{
+	return -EIO;
+}
+
+static int initrd_writepages(struct address_space *mapping,
+			     struct page **pages, unsigned int nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++)
+		end_page_writeback(pages[i], 0);
+	return 0;
+}
+
+static const struct address_space_operations initrd_aops = {
+	.readpages	= initrd_readpages,
+	.writepages	= initrd_writepages,
+};
+
+void initrd_init(void)
+{
+	struct multiboot_module *mod;
+	unsigned long pfn, start_pfn, end_pfn;
+	struct page *page;
+	u64 start, end;
+
+	if (!(boot_info->flags & MULTIBOOT_INFO_MODS) || !boot_info->mods_count)
+		return;
+	mod = phys_to_virt(boot_info->mods_addr);
+	start = mod->mod_start;
+	end = mod->mod_end;
+	if (start & ~PAGE_MASK) {
+		pr_warn("image at %#llx is not page-aligned, ignored\n",
+			(unsigned long long)start);
+		return;
+	}
+	start_pfn = PFN_DOWN(start);
+	end_pfn = PFN_UP(end);
+	if (end <= start || !pfn_valid(end_pfn - 1)) {
+		pr_warn("image at %#llx-%#llx is outside memory, ignored\n",
+			(unsigned long long)start, (unsigned long long)end);
+		return;
+	}
+
+	inode_init(&initrd, 0, &initrd_aops);
+	initrd.i_size = end - start;
+	for (pfn = start_pfn; pfn < end_pfn; pfn++) {
+		page = pfn_to_page(pfn);
+		set_page_count(page, 1);	/* the image's */
+		if (WARN_ON(add_to_page_cache(page, &initrd.i_data,
+					      pfn - start_pfn)))
+			return;
+		SetPageUptodate(page);
+		unlock_page(page);
+	}
+	initrd_inode = &initrd;
+	pr_info("%llu KiB at %#llx, used in place\n",
+		(unsigned long long)(end - start) >> 10,
+		(unsigned long long)start);
+}
@@ -0,0 +1,37 @@
+/*
+ * Inodes and open files, as far as the page cache is concerned.
+ */
+#include <zhos/kernel.h>
+#include <zhos/fs.h>
+#include <zhos/list.h>
+#include <zhos/pagemap.h>
+#include <zhos/radix-tree.h>
+#include <zhos/spinlock.h>
+
+void inode_init(struct inode *inode, unsigned long ino,
+		const struct address_space_operations *a_ops)
+{
+	struct address_space *mapping = &inode->i_data;
+
+	inode->i_ino = ino;
+	inode->i_size = 0;
+	spin_lock_init(&inode->i_lock);
+	inode->i_private = NULL;
+
+	mapping->host = inode;
+	INIT_RADIX_TREE(&mapping->page_tree);
+	spin_lock_init(&mapping->tree_lock);
+	mapping->nrpages = 0;
+	mapping->a_ops = a_ops;
+	INIT_LIST_HEAD(&mapping->dirty_list);
+	mapping->dirtied_when = 0;
+	mapping->error = 0;
+}
+
+void file_init(struct file *file, struct inode *inode)
+{
+	file->f_inode = inode;
+	file->f_mapping = &inode->i_data;
+	file->f_pos = 0;
+	file_ra_state_init(&file->f_ra);
+}
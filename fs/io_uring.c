@@ -0,0 +1,482 @@
+/*
+ * Submission and completion rings.
+ *
+ * io_uring_enter() copies each published submission out of the ring
+ * before acting on it, so the submitter may reuse the slot at once, and
+ * runs it: file operations inline through the page cache, or from a
+ * worker thread with IOSQE_ASYNC, timeouts on the timer wheel.  Every
+ * result goes into the completion ring under the ring's completion lock,
+ * which timer callbacks take too.
+ *
+ * A timeout is on its ring's list until it completes, by expiring or by
+ * the count of completions it waits for being reached.  Whoever takes it
+ * off the list posts its completion; whoever stops the timer, or the
+ * timer callback if that fails, frees it.  A request counts as in flight
+ * until freed, and a ring is only torn down with nothing in flight.
+ *
+ * The registered files are looked up for every submission and replaced
+ * whole: the table is read under RCU and an old one freed after a grace
+ * period.
+ */
+#define pr_fmt(fmt) "io_uring: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/bitops.h>
+#include <zhos/errno.h>
+#include <zhos/fs.h>
+#include <zhos/gfp.h>
+#include <zhos/io_uring.h>
+#include <zhos/jiffies.h>
+#include <zhos/kthread.h>
+#include <zhos/list.h>
+#include <zhos/mm.h>
+#include <zhos/rcupdate.h>
+#include <zhos/sched.h>
+#include <zhos/slab.h>
+#include <zhos/spinlock.h>
+#include <zhos/string.h>
+#include <zhos/timer.h>
+#include <zhos/wait.h>
+
+#define IO_WQ_WORKERS		2
+
+struct io_file_table {
+	struct rcu_head rcu;
+	unsigned int nr;
+	struct file *files[];
+};
+
+struct io_ring_ctx {
+	struct io_rings *rings;
+	struct io_uring_sqe *sqes;
+	unsigned int rings_order, sqes_order;
+	u32 sq_entries, cq_entries;
+	u32 cached_sq_head;		/* our copy of rings->sq_head */
+
+	spinlock_t completion_lock;	/* interrupts off */
+	u32 cached_cq_tail;		/* our copy of rings->cq_tail */
+	u32 cq_seq;			/* completions posted, but timeouts' */
+	struct list_head timeouts;
+	unsigned int inflight;		/* requests taken and not yet freed */
+	struct wait_queue_head cq_wait;	/* completions, and inflight */
+
+	struct io_file_table *file_table;	/* RCU */
+};
+
+struct io_kiocb {
+	struct io_ring_ctx *ctx;
+	struct list_head list;		/* worker queue or ctx->timeouts */
+	u8 opcode;
+	u8 flags;
+	int fd;
+	struct file *file;
+	u64 off;
+	u64 addr;
+	u32 len;
+	u64 user_data;
+
+	/* IORING_OP_TIMEOUT */
+	struct timer_list timer;
+	u32 target_seq;			/* with off != 0: cq_seq that ends it */
+	bool done;			/* off ctx->timeouts, completion posted */
+};
+
+static struct kmem_cache *io_req_cachep;
+
+static LIST_HEAD(io_wq_list);
+static DEFINE_SPINLOCK(io_wq_lock);
+static DECLARE_WAIT_QUEUE_HEAD(io_wq_wait);
+static unsigned int io_wq_nr_workers;
+
+static unsigned int io_cqring_events(struct io_ring_ctx *ctx)
+{
+	struct io_rings *r = ctx->rings;
+
+	return READ_ONCE(r->cq_tail) - READ_ONCE(r->cq_head);
+}
+
+/* completion_lock held. */
+static void io_fill_cqe(struct io_ring_ctx *ctx, u64 user_data, s32 res)
+{
+	struct io_rings *r = ctx->rings;
+	u32 tail = ctx->cached_cq_tail;
+	struct io_uring_cqe *cqe;
+
+	if (tail - __atomic_load_n(&r->cq_head, __ATOMIC_ACQUIRE) ==
+	    ctx->cq_entries) {
+		WRITE_ONCE(r->cq_overflow, r->cq_overflow + 1);
+		return;
+	}
+	cqe = &r->cqes[tail & r->cq_ring_mask];
+	cqe->user_data = user_data;
+	cqe->res = res;
+	cqe->flags = 0;
+	ctx->cached_cq_tail = tail + 1;
+	__atomic_store_n(&r->cq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/* completion_lock held: @req will be freed once the lock is dropped. */
+static void io_put_req_locked(struct io_ring_ctx *ctx)
+{
+	__atomic_sub_fetch(&ctx->inflight, 1, __ATOMIC_RELEASE);
+	if (waitqueue_active(&ctx->cq_wait))
+		wake_up(&ctx->cq_wait);
+}
+
+/*
+ * completion_lock held: end the timeouts whose count has been reached,
+ * collecting on @done those whose timers we stopped and so must free.
+ */
+static void io_flush_timeouts(struct io_ring_ctx *ctx, struct list_head *done)
+{
+	struct io_kiocb *req, *n;
+
+	list_for_each_entry_safe(req, n, &ctx->timeouts, list) {
+		if (!req->off || (s32)(ctx->cq_seq - req->target_seq) < 0)
+			continue;
+		list_del_init(&req->list);
+		req->done = true;
+		io_fill_cqe(ctx, req->user_data, 0);
+		if (del_timer(&req->timer)) {
+			list_add_tail(&req->list, done);
+			io_put_req_locked(ctx);
+		}
+	}
+}
+
+static void io_req_complete(struct io_kiocb *req, s32 res)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_kiocb *t, *n;
+	unsigned long flags;
+	LIST_HEAD(done);
+
+	spin_lock_irqsave(&ctx->completion_lock, flags);
+	io_fill_cqe(ctx, req->user_data, res);
+	ctx->cq_seq++;
+	if (!list_empty(&ctx->timeouts))
+		io_flush_timeouts(ctx, &done);
+	io_put_req_locked(ctx);
+	spin_unlock_irqrestore(&ctx->completion_lock, flags);
+
+	kmem_cache_free(io_req_cachep, req);
+	list_for_each_entry_safe(t, n, &done, list)
+		kmem_cache_free(io_req_cachep, t);
+}
+
+static void io_timeout_fn(struct timer_list *timer)
+{
+	struct io_kiocb *req = from_timer(req, timer, timer);
+	struct io_ring_ctx *ctx = req->ctx;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctx->completion_lock, flags);
+	if (!req->done) {
+		req->done = true;
+		list_del_init(&req->list);
+		io_fill_cqe(ctx, req->user_data, -ETIME);
+	}
+	io_put_req_locked(ctx);
+	spin_unlock_irqrestore(&ctx->completion_lock, flags);
+
+	kmem_cache_free(io_req_cachep, req);
+}
+
+static void io_timeout_arm(struct io_kiocb *req)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	u64 ticks = max(DIV_ROUND_UP(req->addr, NSEC_PER_SEC / HZ), 1ULL);
+	unsigned long flags;
+
+	req->done = false;
+	timer_setup(&req->timer, io_timeout_fn, 0);
+
+	spin_lock_irqsave(&ctx->completion_lock, flags);
+	req->target_seq = ctx->cq_seq + req->off;
+	list_add_tail(&req->list, &ctx->timeouts);
+	mod_timer(&req->timer, get_jiffies_64() + ticks);
+	spin_unlock_irqrestore(&ctx->completion_lock, flags);
+}
+
+static void io_issue(struct io_kiocb *req)
+{
+	void *buf = (void *)(unsigned long)req->addr;
+	struct file *file = req->file;
+	loff_t pos = req->off, *ppos = &pos;
+	ssize_t res = 0;
+
+	if (req->off == IORING_OFF_FILE_POS)
+		ppos = &file->f_pos;
+
+	switch (req->opcode) {
+	case IORING_OP_READ:
+		res = generic_file_read(file, buf, req->len, ppos);
+		break;
+	case IORING_OP_WRITE:
+		res = generic_file_write(file, buf, req->len, ppos);
+		break;
+	case IORING_OP_FSYNC:
+		res = generic_file_fsync(file);
+		break;
+	}
+	io_req_complete(req, res);
+}
+
+static int io_wq_worker(void *unused)
+{
+	struct io_kiocb *req;
+	unsigned long flags;
+
+	for (;;) {
+		wait_event(io_wq_wait, !list_empty(&io_wq_list));
+
+		spin_lock_irqsave(&io_wq_lock, flags);
+		if (list_empty(&io_wq_list)) {
+			spin_unlock_irqrestore(&io_wq_lock, flags);
+			continue;
+		}
+		req = list_first_entry(&io_wq_list, struct io_kiocb, list);
+		list_del_init(&req->list);
+		spin_unlock_irqrestore(&io_wq_lock, flags);
+
+		io_issue(req);
+	}
+	return 0;
+}
+
+static void io_wq_enqueue(struct io_kiocb *req)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&io_wq_lock, flags);
+	list_add_tail(&req->list, &io_wq_list);
+	spin_unlock_irqrestore(&io_wq_lock, flags);
+	wake_up(&io_wq_wait);
+}
+
+/* Copy the entry once: the submitter owns the slot again from here on. */
+static void io_init_req(struct io_ring_ctx *ctx, struct io_kiocb *req,
+			const struct io_uring_sqe *sqe)
+{
+	req->ctx = ctx;
+	INIT_LIST_HEAD(&req->list);
+	req->opcode = READ_ONCE(sqe->opcode);
+	req->flags = READ_ONCE(sqe->flags);
+	req->off = READ_ONCE(sqe->off);
+	req->addr = READ_ONCE(sqe->addr);
+	req->len = READ_ONCE(sqe->len);
+	req->user_data = READ_ONCE(sqe->user_data);
+	req->file = NULL;
+	req->fd = READ_ONCE(sqe->fd);
+}
+
+static struct file *io_file_get(struct io_ring_ctx *ctx, int fd)
+{
+	struct io_file_table *table;
+	struct file *file = NULL;
+
+	rcu_read_lock();
+	table = rcu_dereference(ctx->file_table);
+	if (table && fd >= 0 && fd < table->nr)
+		file = table->files[fd];
+	rcu_read_unlock();
+	return file;
+}
+
+static void io_queue_req(struct io_kiocb *req)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+
+	switch (req->opcode) {
+	case IORING_OP_NOP:
+		io_req_complete(req, 0);
+		return;
+	case IORING_OP_TIMEOUT:
+		io_timeout_arm(req);
+		return;
+	case IORING_OP_READ:
+	case IORING_OP_WRITE:
+	case IORING_OP_FSYNC:
+		req->file = io_file_get(ctx, req->fd);
+		if (!req->file) {
+			io_req_complete(req, -EBADF);
+			return;
+		}
+		break;
+	default:
+		io_req_complete(req, -EINVAL);
+		return;
+	}
+
+	if ((req->flags & IOSQE_ASYNC) && io_wq_nr_workers)
+		io_wq_enqueue(req);
+	else
+		io_issue(req);
+}
+
+static int io_submit_sqes(struct io_ring_ctx *ctx, unsigned int nr)
+{
+	struct io_rings *r = ctx->rings;
+	u32 tail = __atomic_load_n(&r->sq_tail, __ATOMIC_ACQUIRE);
+	u32 head = ctx->cached_sq_head;
+	struct io_kiocb *req;
+	unsigned int i;
+
+	nr = min(nr, tail - head);
+	for (i = 0; i < nr; i++) {
+		req = kmem_cache_alloc(io_req_cachep, GFP_KERNEL);
+		if (!req)
+			break;
+		io_init_req(ctx, req, &ctx->sqes[head & r->sq_ring_mask]);
+		head++;
+		__atomic_add_fetch(&ctx->inflight, 1, __ATOMIC_RELAXED);
+		io_queue_req(req);
+	}
+	ctx->cached_sq_head = head;
+	__atomic_store_n(&r->sq_head, head, __ATOMIC_RELEASE);
+
+	return i || !nr ? (int)i : -ENOMEM;
+}
+
+int io_uring_enter(struct io_ring_ctx *ctx, unsigned int to_submit,
+		   unsigned int min_complete, unsigned int flags)
+{
+	int submitted = 0;
+
+	if (to_submit) {
+		submitted = io_submit_sqes(ctx, to_submit);
+		if (submitted < 0)
+			return submitted;
+	}
+	if (flags & IORING_ENTER_GETEVENTS) {
+		min_complete = min(min_complete, ctx->cq_entries);
+		wait_event(ctx->cq_wait, io_cqring_events(ctx) >= min_complete);
+	}
+	return submitted;
+}
+
+int io_uring_register_files(struct io_uring *ring, struct file **files,
+			    unsigned int nr)
+{
+	struct io_ring_ctx *ctx = ring->ctx;
+	struct io_file_table *table = NULL, *old;
+
+	if (nr) {
+		table = kmalloc(sizeof(*table) + nr * sizeof(table->files[0]),
+				GFP_KERNEL);
+		if (!table)
+			return -ENOMEM;
+		table->nr = nr;
+		memcpy(table->files, files, nr * sizeof(table->files[0]));
+	}
+	old = __atomic_exchange_n(&ctx->file_table, table, __ATOMIC_SEQ_CST);
+	if (old)
+		kfree_rcu(old, rcu);
+	return 0;
+}
+
+/**
+ * io_uring_queue_init - set up a ring
+ * @entries: submission ring size, rounded up to a power of two
+ * @ring: the submitter's view, filled in
+ *
+ * The shared indices and completions are in one run of pages and the
+ * submission entries in another, each zeroed and page aligned, so that
+ * either could be mapped into another address space as it is.
+ */
+int io_uring_queue_init(unsigned int entries, struct io_uring *ring)
+{
+	struct io_ring_ctx *ctx;
+	struct io_rings *r;
+
+	if (!entries || entries > IORING_MAX_ENTRIES)
+		return -EINVAL;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+	ctx->sq_entries = roundup_pow_of_two(entries);
+	ctx->cq_entries = 2 * ctx->sq_entries;
+	ctx->rings_order = get_order(sizeof(struct io_rings) +
+				     ctx->cq_entries * sizeof(struct io_uring_cqe));
+	ctx->sqes_order = get_order(ctx->sq_entries *
+				    sizeof(struct io_uring_sqe));
+	ctx->rings = (void *)__get_free_pages(__GFP_ZERO, ctx->rings_order);
+	ctx->sqes = (void *)__get_free_pages(__GFP_ZERO, ctx->sqes_order);
+	if (!ctx->rings || !ctx->sqes) {
+		if (ctx->rings)
+			free_pages((unsigned long)ctx->rings, ctx->rings_order);
+		if (ctx->sqes)
+			free_pages((unsigned long)ctx->sqes, ctx->sqes_order);
+		kfree(ctx);
+		return -ENOMEM;
+	}
+	spin_lock_init(&ctx->completion_lock);
+	INIT_LIST_HEAD(&ctx->timeouts);
+	init_waitqueue_head(&ctx->cq_wait);
+
+	r = ctx->rings;
+	r->sq_ring_entries = ctx->sq_entries;
+	r->sq_ring_mask = ctx->sq_entries - 1;
+	r->cq_ring_entries = ctx->cq_entries;
+	r->cq_ring_mask = ctx->cq_entries - 1;
+
+	ring->ctx = ctx;
+	ring->rings = r;
+	ring->sqes = ctx->sqes;
+	ring->sqe_tail = 0;
+	return 0;
+}
+
+void io_uring_queue_exit(struct io_uring *ring)
+{
+	struct io_ring_ctx *ctx = ring->ctx;
+	struct io_kiocb *req, *n;
+	unsigned long flags;
+	LIST_HEAD(done);
+
+	/* Pending timeouts go without a completion; nobody is reading. */
+	spin_lock_irqsave(&ctx->completion_lock, flags);
+	list_for_each_entry_safe(req, n, &ctx->timeouts, list) {
+		list_del_init(&req->list);
+		req->done = true;
+		if (del_timer(&req->timer)) {
+			list_add_tail(&req->list, &done);
+			io_put_req_locked(ctx);
+		}
+	}
+	spin_unlock_irqrestore(&ctx->completion_lock, flags);
+	list_for_each_entry_safe(req, n, &done, list)
+		kmem_cache_free(io_req_cachep, req);
+
+	wait_event(ctx->cq_wait,
+		   !__atomic_load_n(&ctx->inflight, __ATOMIC_ACQUIRE));
+	/* The last to finish may still hold the lock it woke us under. */
+	spin_lock_irqsave(&ctx->completion_lock, flags);
+	spin_unlock_irqrestore(&ctx->completion_lock, flags);
+
+	kfree(ctx->file_table);
+	free_pages((unsigned long)ctx->rings, ctx->rings_order);
+	free_pages((unsigned long)ctx->sqes, ctx->sqes_order);
+	kfree(ctx);
+	ring->ctx = NULL;
+}
+
+void io_uring_init(void)
+{
+	struct task_struct *p;
+	unsigned int i;
+
+	io_req_cachep = kmem_cache_create("io_kiocb", sizeof(struct io_kiocb),
+					  0, SLAB_PANIC, NULL);
+
+	for (i = 0; i < IO_WQ_WORKERS; i++) {
+		p = kthread_create(io_wq_worker, NULL, "io_wq/%u", i);
+		if (!p) {
+			pr_err("no worker thread %u\n", i);
+			break;
+		}
+		wake_up_process(p);
+		io_wq_nr_workers++;
+	}
+}
@@ -0,0 +1,141 @@
+#ifndef _ZHOS_ACPI_H
+#define _ZHOS_ACPI_H
+
+#include <zhos/compiler.h>
+#include <zhos/types.h>
+
+/* ACPI static tables, as far as the kernel reads them. */
+
+struct acpi_table_rsdp {
+	char signature[8];		/* "RSD PTR " */
+	u8 checksum;			/* of the first 20 bytes */
+	char oem_id[6];
+	u8 revision;
+	u32 rsdt_physical_address;
+	u32 length;			/* revision >= 2 from here on */
+	u64 xsdt_physical_address;
+	u8 extended_checksum;
+	u8 reserved[3];
+} __packed;
+
+struct acpi_table_header {
+	char signature[4];
+	u32 length;
+	u8 revision;
+	u8 checksum;
+	char oem_id[6];
+	char oem_table_id[8];
+	u32 oem_revision;
+	u32 asl_compiler_id;
+	u32 asl_compiler_revision;
+} __packed;
+
+struct acpi_subtable_header {
+	u8 type;
+	u8 length;
+} __packed;
+
+/* MADT: interrupt controllers and the CPUs they belong to. */
+#define ACPI_SIG_MADT		"APIC"
+
+struct acpi_table_madt {
+	struct acpi_table_header header;
+	u32 address;			/* local APIC */
+	u32 flags;
+} __packed;
+
+#define ACPI_MADT_TYPE_LOCAL_APIC		0
+#define ACPI_MADT_TYPE_IO_APIC			1
+#define ACPI_MADT_TYPE_INTERRUPT_OVERRIDE	2
+#define ACPI_MADT_TYPE_LOCAL_APIC_OVERRIDE	5
+#define ACPI_MADT_TYPE_LOCAL_X2APIC		9
+
+#define ACPI_MADT_ENABLED		(1 << 0)
+#define ACPI_MADT_ONLINE_CAPABLE	(1 << 1)
+
+struct acpi_madt_local_apic {
+	struct acpi_subtable_header header;
+	u8 processor_id;
+	u8 id;
+	u32 lapic_flags;
+} __packed;
+
+struct acpi_madt_local_apic_override {
+	struct acpi_subtable_header header;
+	u16 reserved;
+	u64 address;
+} __packed;
+
+struct acpi_madt_local_x2apic {
+	struct acpi_subtable_header header;
+	u16 reserved;
+	u32 local_apic_id;
+	u32 lapic_flags;
+	u32 uid;
+} __packed;
+
+/* SRAT: which proximity domain each CPU and memory range belongs to. */
+#define ACPI_SIG_SRAT		"SRAT"
+
+struct acpi_table_srat {
+	struct acpi_table_header header;
+	u32 table_revision;		/* must be 1 */
+	u64 reserved;
+} __packed;
+
+#define ACPI_SRAT_TYPE_CPU_AFFINITY		0
+#define ACPI_SRAT_TYPE_MEMORY_AFFINITY		1
+#define ACPI_SRAT_TYPE_X2APIC_CPU_AFFINITY	2
+
+#define ACPI_SRAT_CPU_ENABLED		(1 << 0)
+#define ACPI_SRAT_MEM_ENABLED		(1 << 0)
+#define ACPI_SRAT_MEM_HOT_PLUGGABLE	(1 << 1)
+
+struct acpi_srat_cpu_affinity {
+	struct acpi_subtable_header header;
+	u8 proximity_domain_lo;
+	u8 apic_id;
+	u32 flags;
+	u8 local_sapic_eid;
+	u8 proximity_domain_hi[3];
+	u32 clock_domain;
+} __packed;
+
+struct acpi_srat_mem_affinity {
+	struct acpi_subtable_header header;
+	u32 proximity_domain;
+	u16 reserved;
+	u64 base_address;
+	u64 length;
+	u32 reserved1;
+	u32 flags;
+	u64 reserved2;
+} __packed;
+
+struct acpi_srat_x2apic_cpu_affinity {
+	struct acpi_subtable_header header;
+	u16 reserved;
+	u32 proximity_domain;
+	u32 apic_id;
+	u32 flags;
+	u32 clock_domain;
+	u32 reserved2;
+} __packed;
+
+/* SLIT: relative memory latency, row from, column to, by domain. */
+#define ACPI_SIG_SLIT		"SLIT"
+
+struct acpi_table_slit {
+	struct acpi_table_header header;
+	u64 locality_count;
+	u8 entry[];
+} __packed;
+
+typedef int (*acpi_tbl_entry_handler)(const struct acpi_subtable_header *entry);
+
+int acpi_table_init(void);
+struct acpi_table_header *acpi_get_table(const char *signature);
+int acpi_table_parse_entries(const char *signature, unsigned int table_size,
+			     int type, acpi_tbl_entry_handler handler);
+
+#endif /* _ZHOS_ACPI_H */
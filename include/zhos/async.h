@@ -0,0 +1,15 @@
+#ifndef _ZHOS_ASYNC_H
+#define _ZHOS_ASYNC_H
+
+/*
+ * Boot-time work run concurrently (kernel/async.c): each call gets a
+ * thread of its own on the next online CPU, and async_synchronize_full()
+ * waits for all of them.  The work must not depend on any other piece
+ * scheduled alongside it.
+ */
+typedef void (*async_func_t)(void *data);
+
+void async_schedule(async_func_t fn, void *data, const char *name);
+void async_synchronize_full(void);
+
+#endif /* _ZHOS_ASYNC_H */
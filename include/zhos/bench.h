@@ -0,0 +1,7 @@
+#ifndef _ZHOS_BENCH_H
+#define _ZHOS_BENCH_H
+
+/* Start the benchmark suite if "bench" is on the command line. */
+void bench_init(void);
+
+#endif /* _ZHOS_BENCH_H */
@@ -0,0 +1,85 @@
+#ifndef _ZHOS_BIO_H
+#define _ZHOS_BIO_H
+
+#include <zhos/types.h>
+
+/*
+ * A bio is one transfer between a disk and memory: a start sector and the
+ * pieces of pages the data goes to or comes from, in order.  It is built
+ * against a disk so that it never exceeds what the disk's queue takes in
+ * one request, handed to submit_bio(), and ends, from any context, with a
+ * call of its ->bi_end_io().
+ */
+#define SECTOR_SHIFT		9
+#define SECTOR_SIZE		(1 << SECTOR_SHIFT)
+#define PAGE_SECTORS_SHIFT	(PAGE_SHIFT - SECTOR_SHIFT)
+
+typedef u64 sector_t;
+
+typedef u8 blk_status_t;
+
+#define BLK_STS_OK		0
+#define BLK_STS_RESOURCE	1	/* driver out of slots: try again later */
+#define BLK_STS_NOTSUPP		2
+#define BLK_STS_IOERR		3
+
+int blk_status_to_errno(blk_status_t status);
+
+enum req_op {
+	REQ_OP_READ,
+	REQ_OP_WRITE,
+};
+
+struct gendisk;
+struct page;
+
+struct bio_vec {
+	struct page *bv_page;
+	unsigned int bv_len;
+	unsigned int bv_offset;
+};
+
+struct bio;
+typedef void (bio_end_io_t)(struct bio *bio);
+
+struct bio {
+	struct bio *bi_next;		/* in a request */
+	struct gendisk *bi_disk;
+	enum req_op bi_op;
+	blk_status_t bi_status;
+	sector_t bi_sector;
+	unsigned int bi_size;		/* bytes */
+	unsigned short bi_vcnt;
+	unsigned short bi_max_vecs;
+	bio_end_io_t *bi_end_io;
+	void *bi_private;
+	struct bio_vec bi_io_vec[];
+};
+
+#define bio_for_each_bvec(bv, bio, i)					\
+	for ((i) = 0, (bv) = (bio)->bi_io_vec; (i) < (bio)->bi_vcnt;	\
+	     (i)++, (bv)++)
+
+static inline sector_t bio_end_sector(const struct bio *bio)
+{
+	return bio->bi_sector + (bio->bi_size >> SECTOR_SHIFT);
+}
+
+/* Room for @nr_vecs pieces, capped by the disk's segment limit; may sleep. */
+struct bio *bio_alloc(struct gendisk *disk, unsigned int nr_vecs,
+		      enum req_op op);
+void bio_put(struct bio *bio);
+/*
+ * Append @len bytes at @offset in @page, a multiple of the sector size;
+ * false if the bio is full or would grow past the queue's limits.
+ */
+bool bio_add_page(struct bio *bio, struct page *page, unsigned int len,
+		  unsigned int offset);
+
+/* Queue @bio; may sleep for a free request. */
+void submit_bio(struct bio *bio);
+/* Submit and wait; returns the bio's status as an errno. */
+int submit_bio_wait(struct bio *bio);
+void bio_endio(struct bio *bio);
+
+#endif /* _ZHOS_BIO_H */
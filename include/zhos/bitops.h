@@ -0,0 +1,61 @@
+#ifndef _ZHOS_BITOPS_H
+#define _ZHOS_BITOPS_H
+
+#include <zhos/types.h>
+
+/* Index of the lowest set bit; @w must not be 0. */
+static inline unsigned int __ffs64(u64 w)
+{
+	return __builtin_ctzll(w);
+}
+
+/* Index of the highest set bit; @w must not be 0. */
+static inline unsigned int __fls64(u64 w)
+{
+	return 63 - __builtin_clzll(w);
+}
+
+static inline unsigned long roundup_pow_of_two(unsigned long n)
+{
+	return n <= 1 ? 1 : 1UL << (__fls64(n - 1) + 1);
+}
+
+/*
+ * Population count without popcnt (not every x86-64 has it) and without
+ * libgcc's helper.
+ */
+static inline unsigned int hweight64(u64 w)
+{
+	w = w - ((w >> 1) & 0x5555555555555555ULL);
+	w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+	w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	return (w * 0x0101010101010101ULL) >> 56;
+}
+
+/* Atomic bit operations on a word, full barriers like the x86 locked ops. */
+static inline void set_bit(unsigned int nr, unsigned long *addr)
+{
+	__atomic_fetch_or(addr, 1UL << nr, __ATOMIC_SEQ_CST);
+}
+
+static inline void clear_bit(unsigned int nr, unsigned long *addr)
+{
+	__atomic_fetch_and(addr, ~(1UL << nr), __ATOMIC_SEQ_CST);
+}
+
+static inline bool test_bit(unsigned int nr, const unsigned long *addr)
+{
+	return (__atomic_load_n(addr, __ATOMIC_RELAXED) >> nr) & 1;
+}
+
+static inline bool test_and_set_bit(unsigned int nr, unsigned long *addr)
+{
+	return (__atomic_fetch_or(addr, 1UL << nr, __ATOMIC_SEQ_CST) >> nr) & 1;
+}
+
+static inline bool test_and_clear_bit(unsigned int nr, unsigned long *addr)
+{
+	return (__atomic_fetch_and(addr, ~(1UL << nr), __ATOMIC_SEQ_CST) >> nr) & 1;
+}
+
+#endif /* _ZHOS_BITOPS_H */
@@ -0,0 +1,166 @@
+#ifndef _ZHOS_BLK_MQ_H
+#define _ZHOS_BLK_MQ_H
+
+#include <zhos/bio.h>
+#include <zhos/blkdev.h>
+#include <zhos/cpumask.h>
+#include <zhos/list.h>
+#include <zhos/spinlock.h>
+#include <zhos/types.h>
+#include <zhos/wait.h>
+
+/*
+ * Multi-queue block layer (block/blk-mq.c).
+ *
+ * A driver describes its hardware queues in a tag set: how many there are,
+ * how many requests each holds in flight (its tags) and how much private
+ * data it wants with every request.  Each CPU submits into a software
+ * queue of its own, which feeds one of the hardware queues; requests are
+ * merged with adjacent ones while they wait there, and the driver sees
+ * them only through ->queue_rq().
+ */
+struct blk_mq_hw_ctx;
+struct blk_mq_tags;
+
+struct request {
+	struct request_queue *q;
+	struct blk_mq_ctx *mq_ctx;
+	struct blk_mq_hw_ctx *mq_hctx;
+	struct list_head queuelist;
+	int tag;
+	enum req_op op;
+	blk_status_t status;		/* for blk_mq_end_request_batch() */
+	sector_t __sector;
+	unsigned int __data_len;	/* bytes */
+	unsigned short nr_phys_segments;
+	struct bio *bio;
+	struct bio *biotail;
+	/* The driver's tag_set->cmd_size bytes follow. */
+};
+
+static inline sector_t blk_rq_pos(const struct request *rq)
+{
+	return rq->__sector;
+}
+
+static inline unsigned int blk_rq_bytes(const struct request *rq)
+{
+	return rq->__data_len;
+}
+
+static inline unsigned int blk_rq_sectors(const struct request *rq)
+{
+	return rq->__data_len >> SECTOR_SHIFT;
+}
+
+static inline enum req_op req_op(const struct request *rq)
+{
+	return rq->op;
+}
+
+static inline void *blk_mq_rq_to_pdu(struct request *rq)
+{
+	return rq + 1;
+}
+
+static inline struct request *blk_mq_rq_from_pdu(void *pdu)
+{
+	return (struct request *)pdu - 1;
+}
+
+#define __rq_for_each_bio(_bio, rq) \
+	for ((_bio) = (rq)->bio; (_bio); (_bio) = (_bio)->bi_next)
+
+struct blk_mq_ops {
+	/*
+	 * Start @rq.  @last is false while more requests follow in this
+	 * batch, so the device need only be notified for the last one, or
+	 * in ->commit_rqs() should the batch stop short.  BLK_STS_RESOURCE
+	 * means the hardware queue is full; it is only allowed with other
+	 * requests in flight, whose completion runs the queue again.  Any
+	 * other error ends the request at once.
+	 */
+	blk_status_t (*queue_rq)(struct blk_mq_hw_ctx *hctx, struct request *rq,
+				 bool last);
+	void (*commit_rqs)(struct blk_mq_hw_ctx *hctx);
+	/* Optional: set up hctx->driver_data for hardware queue @idx. */
+	int (*init_hctx)(struct blk_mq_hw_ctx *hctx, void *driver_data,
+			 unsigned int idx);
+};
+
+#define BLK_MQ_MAX_DEPTH	1024
+
+struct blk_mq_tag_set {
+	const struct blk_mq_ops *ops;
+	unsigned int nr_hw_queues;
+	unsigned int queue_depth;	/* tags per hardware queue */
+	unsigned int cmd_size;		/* driver data per request */
+	void *driver_data;
+	struct blk_mq_tags **tags;	/* per hardware queue */
+};
+
+/* A CPU's software queue. */
+struct blk_mq_ctx {
+	spinlock_t lock;
+	struct list_head rq_list;	/* waiting for dispatch, oldest first */
+	unsigned int cpu;
+	struct blk_mq_hw_ctx *hctx;
+} __aligned(SMP_CACHE_BYTES);
+
+struct blk_mq_hw_ctx {
+	spinlock_t lock;		/* interrupts off */
+	struct list_head dispatch;	/* taken from the software queues, not yet accepted */
+	struct cpumask ctx_map;		/* CPUs whose software queue has requests */
+	bool running;			/* someone is dispatching */
+	bool rerun;			/* and should go round again */
+	bool restart;			/* the driver was full: run on completion */
+	unsigned long nr_completed;	/* under lock, to spot a racing completion */
+	struct request_queue *queue;
+	struct blk_mq_tags *tags;
+	void *driver_data;
+	unsigned int queue_num;
+
+	/* Statistics. */
+	unsigned long queued;		/* requests allocated */
+	unsigned long merged;		/* bios merged into waiting requests */
+	unsigned long dispatched;	/* ->queue_rq() calls accepted */
+	unsigned long commits;		/* batches the device was told about */
+};
+
+/* At boot, before any driver. */
+void blk_mq_init(void);
+
+int blk_mq_alloc_tag_set(struct blk_mq_tag_set *set);
+struct request_queue *blk_mq_init_queue(struct blk_mq_tag_set *set,
+					void *queuedata);
+
+void blk_mq_submit_bio(struct bio *bio);
+void blk_mq_run_hw_queue(struct blk_mq_hw_ctx *hctx);
+
+/* Complete every bio of @rq with @status and free it; from any context. */
+void blk_mq_end_request(struct request *rq, blk_status_t status);
+
+/*
+ * Completions gathered in one pass over a device's completion queue,
+ * ended together so that the tags are freed, waiters woken and the queue
+ * restarted once per hardware queue rather than once per request.
+ */
+struct io_comp_batch {
+	struct list_head list;
+};
+
+#define DEFINE_IO_COMP_BATCH(name) \
+	struct io_comp_batch name = { .list = LIST_HEAD_INIT((name).list) }
+
+static inline void blk_mq_add_to_batch(struct io_comp_batch *iob,
+				       struct request *rq, blk_status_t status)
+{
+	rq->status = status;
+	list_add_tail(&rq->queuelist, &iob->list);
+}
+
+void blk_mq_end_request_batch(struct io_comp_batch *iob);
+/* The same, from BLOCK_SOFTIRQ: for interrupt handlers. */
+void blk_mq_complete_batch(struct io_comp_batch *iob);
+
+#endif /* _ZHOS_BLK_MQ_H */
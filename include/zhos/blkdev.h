@@ -0,0 +1,71 @@
+#ifndef _ZHOS_BLKDEV_H
+#define _ZHOS_BLKDEV_H
+
+#include <zhos/bio.h>
+#include <zhos/fs.h>
+#include <zhos/list.h>
+#include <zhos/types.h>
+
+/*
+ * Block devices.  A driver sets up a blk-mq tag set and queue
+ * (<zhos/blk-mq.h>), fills in a gendisk and calls add_disk(); the disk's
+ * sectors are then reachable through bios and, a page at a time, through
+ * the page cache of its bd_inode, which readahead and writeback batch
+ * into large bios like any file's.
+ */
+#define DISK_NAME_LEN		16
+
+struct blk_mq_ctx;
+struct blk_mq_hw_ctx;
+struct blk_mq_tag_set;
+
+struct queue_limits {
+	unsigned int max_sectors;	/* per request */
+	unsigned short max_segments;	/* bio_vecs per request */
+	unsigned int logical_block_size;
+};
+
+struct request_queue {
+	struct blk_mq_tag_set *tag_set;
+	struct blk_mq_hw_ctx **queue_hw_ctx;
+	unsigned int nr_hw_queues;
+	struct blk_mq_ctx *queue_ctx;	/* NR_CPUS of them */
+	struct queue_limits limits;
+	void *queuedata;		/* the driver's */
+};
+
+struct gendisk {
+	struct list_head list;
+	char disk_name[DISK_NAME_LEN];
+	struct request_queue *queue;
+	sector_t capacity;		/* in 512-byte sectors */
+	bool read_only;
+	void *private_data;		/* the driver's */
+	struct inode bd_inode;		/* page cache of the whole disk */
+};
+
+static inline void set_capacity(struct gendisk *disk, sector_t sectors)
+{
+	disk->capacity = sectors;
+}
+
+void add_disk(struct gendisk *disk);
+struct gendisk *get_gendisk(const char *name);
+
+/*
+ * A plug holds back the requests a task submits until blk_finish_plug(),
+ * or until it sleeps, so that a burst of bios is merged and reaches the
+ * driver as one batch.
+ */
+struct blk_plug {
+	struct list_head mq_list;
+	unsigned int count;
+};
+
+void blk_start_plug(struct blk_plug *plug);
+void blk_finish_plug(struct blk_plug *plug);
+void blk_flush_plug(struct blk_plug *plug);
+
+void virtio_blk_init(void);
+
+#endif /* _ZHOS_BLKDEV_H */
@@ -0,0 +1,20 @@
+#ifndef _ZHOS_BYTEORDER_H
+#define _ZHOS_BYTEORDER_H
+
+#include <zhos/types.h>
+
+/* Big-endian (network order) values; x86 is little-endian. */
+typedef u16 __be16;
+typedef u32 __be32;
+
+#define cpu_to_be16(x)	((__be16)__builtin_bswap16(x))
+#define cpu_to_be32(x)	((__be32)__builtin_bswap32(x))
+#define be16_to_cpu(x)	((u16)__builtin_bswap16(x))
+#define be32_to_cpu(x)	((u32)__builtin_bswap32(x))
+
+#define htons(x)	cpu_to_be16(x)
+#define htonl(x)	cpu_to_be32(x)
+#define ntohs(x)	be16_to_cpu(x)
+#define ntohl(x)	be32_to_cpu(x)
+
+#endif /* _ZHOS_BYTEORDER_H */
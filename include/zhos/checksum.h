@@ -0,0 +1,30 @@
+#ifndef _ZHOS_CHECKSUM_H
+#define _ZHOS_CHECKSUM_H
+
+#include <zhos/types.h>
+
+/*
+ * The Internet checksum (RFC 1071).  The ones' complement sum does not
+ * depend on byte order, so it is computed on native words and the folded
+ * result stored as is.
+ */
+
+/* Add @len bytes at @buf to the 32-bit partial sum @sum. */
+u32 csum_partial(const void *buf, unsigned int len, u32 sum);
+/* The portable version, which the arch may pick for csum_partial(). */
+u32 csum_partial_generic(const void *buf, unsigned int len, u32 sum);
+
+static inline u16 csum_fold(u32 sum)
+{
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return ~sum;
+}
+
+/* Checksum of an IPv4 header of @ihl 32-bit words; 0 if it is intact. */
+static inline u16 ip_fast_csum(const void *iph, unsigned int ihl)
+{
+	return csum_fold(csum_partial(iph, ihl * 4, 0));
+}
+
+#endif /* _ZHOS_CHECKSUM_H */
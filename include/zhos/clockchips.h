@@ -0,0 +1,52 @@
+#ifndef _ZHOS_CLOCKCHIPS_H
+#define _ZHOS_CLOCKCHIPS_H
+
+#include <zhos/types.h>
+
+/*
+ * Clock event devices: hardware that raises an interrupt after a programmed
+ * interval (one-shot) or at a fixed rate (periodic).  The tick layer owns
+ * the device and installs event_handler.
+ */
+
+#define CLOCK_EVT_FEAT_PERIODIC		0x1
+#define CLOCK_EVT_FEAT_ONESHOT		0x2
+
+enum clock_event_state {
+	CLOCK_EVT_STATE_DETACHED,
+	CLOCK_EVT_STATE_SHUTDOWN,
+	CLOCK_EVT_STATE_PERIODIC,
+	CLOCK_EVT_STATE_ONESHOT,
+};
+
+struct clock_event_device {
+	const char *name;
+	unsigned int features;
+	int rating;
+
+	/* ns -> device cycles: cycles = (ns * mult) >> shift */
+	u32 mult;
+	u32 shift;
+	unsigned long min_delta_ticks;
+	unsigned long max_delta_ticks;
+	u64 min_delta_ns;
+	u64 max_delta_ns;
+
+	enum clock_event_state state;
+
+	int (*set_state_periodic)(struct clock_event_device *dev);
+	int (*set_state_oneshot)(struct clock_event_device *dev);
+	int (*set_state_shutdown)(struct clock_event_device *dev);
+	int (*set_next_event)(unsigned long cycles, struct clock_event_device *dev);
+
+	void (*event_handler)(struct clock_event_device *dev);
+};
+
+u64 clockevent_delta2ns(unsigned long latch, struct clock_event_device *dev);
+void clockevents_config_and_register(struct clock_event_device *dev, u32 freq,
+				     unsigned long min_delta, unsigned long max_delta);
+int clockevents_switch_state(struct clock_event_device *dev,
+			     enum clock_event_state state);
+int clockevents_program_event(struct clock_event_device *dev, u64 delta_ns);
+
+#endif /* _ZHOS_CLOCKCHIPS_H */
@@ -0,0 +1,47 @@
+#ifndef _ZHOS_CLOCKSOURCE_H
+#define _ZHOS_CLOCKSOURCE_H
+
+#include <zhos/compiler.h>
+#include <zhos/types.h>
+
+/*
+ * Free-running counters used for timekeeping.  The highest rated one
+ * registered drives clock_now_ns().
+ */
+struct clocksource {
+	const char *name;
+	u64 (*read)(struct clocksource *cs);
+	u64 mask;		/* counter width */
+	u32 mult;		/* cycles -> ns: ns = (cycles * mult) >> shift */
+	u32 shift;
+	int rating;
+	u64 max_idle_ns;	/* longest gap between reads, 0 if unlimited */
+	int vdso_clock_mode;	/* VDSO_CLOCKMODE_*: readable without the kernel */
+	struct clocksource *next;
+};
+
+#define CLOCKSOURCE_MASK(bits)	((bits) < 64 ? (1ULL << (bits)) - 1 : ~0ULL)
+
+/*
+ * Cycles from @last to @now on a counter @mask wide.  A narrow counter
+ * wraps and is taken modulo its width.  A full-width one never does, so
+ * @now behind @last is a CPU whose counter trails the one that read
+ * @last (the TSCs are not checked for sync): that counts as no time.
+ * Shared with the vDSO, which must come to the same answer.
+ */
+static __always_inline u64 clocksource_delta(u64 now, u64 last, u64 mask)
+{
+	if (mask == ~0ULL)
+		return now > last ? now - last : 0;
+	return (now - last) & mask;
+}
+
+/* Longest interval the timekeeper may go without folding in elapsed time. */
+#define CLOCKSOURCE_MAX_UPDATE_SEC	600
+
+void clocks_calc_mult_shift(u32 *mult, u32 *shift, u32 from, u32 to, u32 maxsec);
+
+void clocksource_register_hz(struct clocksource *cs, u32 hz);
+void clocksource_register_khz(struct clocksource *cs, u32 khz);
+
+#endif /* _ZHOS_CLOCKSOURCE_H */
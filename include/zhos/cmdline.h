@@ -0,0 +1,19 @@
+#ifndef _ZHOS_CMDLINE_H
+#define _ZHOS_CMDLINE_H
+
+#include <zhos/types.h>
+#include <zhos/string.h>
+
+#define COMMAND_LINE_SIZE	256
+
+extern char boot_command_line[COMMAND_LINE_SIZE];
+
+void cmdline_init(const char *s);
+
+/* Copy the value of "key=value" into @buf; -ENOENT if absent. */
+int cmdline_get(const char *key, char *buf, size_t size);
+
+/* True if the bare word @key (or key=...) is present. */
+bool cmdline_has(const char *key);
+
+#endif /* _ZHOS_CMDLINE_H */
@@ -0,0 +1,28 @@
+#ifndef _ZHOS_COMPILER_H
+#define _ZHOS_COMPILER_H
+
+#define likely(x)		__builtin_expect(!!(x), 1)
+#define unlikely(x)		__builtin_expect(!!(x), 0)
+
+#define __packed		__attribute__((packed))
+#define __aligned(x)		__attribute__((aligned(x)))
+#define __section(s)		__attribute__((section(s)))
+#define __used			__attribute__((used))
+#define __unused		__attribute__((unused))
+#define __noreturn		__attribute__((noreturn))
+#define __always_inline		inline __attribute__((always_inline))
+#define __noinline		__attribute__((noinline))
+#define __printf(a, b)		__attribute__((format(printf, a, b)))
+#define __weak			__attribute__((weak))
+
+#define barrier()		__asm__ __volatile__("" ::: "memory")
+
+#define READ_ONCE(x)		(*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, v)	(*(volatile __typeof__(x) *)&(x) = (v))
+
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - __builtin_offsetof(type, member)))
+
+#endif /* _ZHOS_COMPILER_H */
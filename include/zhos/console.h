@@ -0,0 +1,16 @@
+#ifndef _ZHOS_CONSOLE_H
+#define _ZHOS_CONSOLE_H
+
+#include <zhos/types.h>
+
+struct console {
+	const char *name;
+	void (*write)(struct console *con, const char *s, size_t len);
+	struct console *next;
+};
+
+void register_console(struct console *con);
+
+void serial8250_console_init(void);
+
+#endif /* _ZHOS_CONSOLE_H */
@@ -0,0 +1,109 @@
+#ifndef _ZHOS_CPUMASK_H
+#define _ZHOS_CPUMASK_H
+
+#include <zhos/kernel.h>
+#include <zhos/bitops.h>
+#include <zhos/percpu.h>
+
+#define CPUMASK_WORDS	DIV_ROUND_UP(NR_CPUS, 64)
+
+struct cpumask {
+	u64 bits[CPUMASK_WORDS];
+};
+
+/*
+ * possible: enumerated by firmware, has a per-CPU area in use.
+ * online:   running kernel code and taking interrupts.
+ */
+extern struct cpumask __cpu_possible_mask;
+extern struct cpumask __cpu_online_mask;
+
+#define cpu_possible_mask	(&__cpu_possible_mask)
+#define cpu_online_mask		(&__cpu_online_mask)
+
+static inline void cpumask_set_cpu(unsigned int cpu, struct cpumask *m)
+{
+	__atomic_fetch_or(&m->bits[cpu / 64], 1ULL << (cpu % 64), __ATOMIC_RELAXED);
+}
+
+static inline void cpumask_clear_cpu(unsigned int cpu, struct cpumask *m)
+{
+	__atomic_fetch_and(&m->bits[cpu / 64], ~(1ULL << (cpu % 64)),
+			   __ATOMIC_RELAXED);
+}
+
+static inline bool cpumask_test_cpu(unsigned int cpu, const struct cpumask *m)
+{
+	return READ_ONCE(m->bits[cpu / 64]) & (1ULL << (cpu % 64));
+}
+
+/* First CPU in @m after @n (-1 to start); >= NR_CPUS if none. */
+static inline unsigned int cpumask_next(int n, const struct cpumask *m)
+{
+	unsigned int cpu = n + 1, i;
+	u64 w;
+
+	for (i = cpu / 64; i < CPUMASK_WORDS; i++, cpu = i * 64) {
+		w = READ_ONCE(m->bits[i]) & (~0ULL << (cpu % 64));
+		if (w)
+			return i * 64 + __ffs64(w);
+	}
+	return NR_CPUS;
+}
+
+static inline unsigned int cpumask_weight(const struct cpumask *m)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < CPUMASK_WORDS; i++)
+		n += hweight64(READ_ONCE(m->bits[i]));
+	return n;
+}
+
+static inline bool cpumask_empty(const struct cpumask *m)
+{
+	unsigned int i;
+
+	for (i = 0; i < CPUMASK_WORDS; i++)
+		if (READ_ONCE(m->bits[i]))
+			return false;
+	return true;
+}
+
+#define for_each_cpu(cpu, mask)					\
+	for ((cpu) = cpumask_next(-1, mask); (cpu) < NR_CPUS;	\
+	     (cpu) = cpumask_next(cpu, mask))
+
+#define for_each_possible_cpu(cpu)	for_each_cpu(cpu, cpu_possible_mask)
+#define for_each_online_cpu(cpu)	for_each_cpu(cpu, cpu_online_mask)
+
+#define cpu_possible(cpu)	cpumask_test_cpu(cpu, cpu_possible_mask)
+#define cpu_online(cpu)		cpumask_test_cpu(cpu, cpu_online_mask)
+
+static inline void set_cpu_possible(unsigned int cpu, bool possible)
+{
+	if (possible)
+		cpumask_set_cpu(cpu, &__cpu_possible_mask);
+	else
+		cpumask_clear_cpu(cpu, &__cpu_possible_mask);
+}
+
+static inline void set_cpu_online(unsigned int cpu, bool online)
+{
+	if (online)
+		cpumask_set_cpu(cpu, &__cpu_online_mask);
+	else
+		cpumask_clear_cpu(cpu, &__cpu_online_mask);
+}
+
+static inline unsigned int num_online_cpus(void)
+{
+	return cpumask_weight(cpu_online_mask);
+}
+
+static inline unsigned int num_possible_cpus(void)
+{
+	return cpumask_weight(cpu_possible_mask);
+}
+
+#endif /* _ZHOS_CPUMASK_H */
@@ -0,0 +1,34 @@
+#ifndef _ZHOS_DELAY_H
+#define _ZHOS_DELAY_H
+
+#include <zhos/kernel.h>
+#include <zhos/timekeeping.h>
+#include <asm/processor.h>
+
+/*
+ * Busy-wait delays timed by clock_now_ns(), so they are exact from the
+ * moment a hardware clocksource has registered and need no loop
+ * calibration of their own.
+ */
+static inline void ndelay(u64 ns)
+{
+	u64 end = clock_now_ns() + ns;
+
+	while ((s64)(clock_now_ns() - end) < 0)
+		cpu_relax();
+}
+
+static inline void udelay(u64 us)
+{
+	ndelay(us * NSEC_PER_USEC);
+}
+
+static inline void mdelay(u64 ms)
+{
+	ndelay(ms * NSEC_PER_MSEC);
+}
+
+/* Sleep, letting other tasks run; process context only. */
+void msleep(unsigned int msecs);
+
+#endif /* _ZHOS_DELAY_H */
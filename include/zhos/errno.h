@@ -0,0 +1,25 @@
+#ifndef _ZHOS_ERRNO_H
+#define _ZHOS_ERRNO_H
+
+/* Kernel functions return 0 or a negative errno. */
+#define EPERM		1
+#define ENOENT		2
+#define EINTR		4
+#define EIO		5
+#define E2BIG		7
+#define ENOEXEC		8
+#define EBADF		9
+#define EAGAIN		11
+#define ENOMEM		12
+#define EFAULT		14
+#define EBUSY		16
+#define EEXIST		17
+#define ENODEV		19
+#define EINVAL		22
+#define ENOSPC		28
+#define ERANGE		34
+#define ENOSYS		38
+#define ETIME		62
+#define ETIMEDOUT	110
+
+#endif /* _ZHOS_ERRNO_H */
@@ -0,0 +1,85 @@
+#ifndef _ZHOS_FS_H
+#define _ZHOS_FS_H
+
+#include <zhos/list.h>
+#include <zhos/radix-tree.h>
+#include <zhos/spinlock.h>
+#include <zhos/types.h>
+
+/*
+ * What every filesystem shares: inodes, their page cache and open files.
+ * A filesystem embeds a struct inode in its own, sets it up with
+ * inode_init() and supplies address_space_operations to move pages
+ * between the cache and its backing store; reads, writes and fsync then
+ * go through the generic page cache code (mm/filemap.c).
+ */
+typedef s64 loff_t;
+
+struct address_space;
+struct page;
+
+/* Radix tree tags of an address_space's pages. */
+#define PAGECACHE_TAG_DIRTY	0
+#define PAGECACHE_TAG_WRITEBACK	1
+
+struct address_space_operations {
+	/*
+	 * Start reading @nr pages at consecutive indices, each locked and
+	 * not uptodate, and call end_page_read() on every one as it
+	 * completes, from any context.  A non-zero return means nothing
+	 * was started.
+	 */
+	int (*readpages)(struct address_space *mapping, struct page **pages,
+			 unsigned int nr);
+	/* Likewise for @nr pages under writeback, and end_page_writeback(). */
+	int (*writepages)(struct address_space *mapping, struct page **pages,
+			  unsigned int nr);
+};
+
+struct address_space {
+	struct inode *host;
+	struct radix_tree_root page_tree;	/* tree_lock, interrupts off */
+	spinlock_t tree_lock;
+	unsigned long nrpages;
+	const struct address_space_operations *a_ops;
+	struct list_head dirty_list;	/* on the writeback list */
+	u64 dirtied_when;		/* jiffies it went on it */
+	int error;			/* last writeback error, for fsync */
+};
+
+struct inode {
+	unsigned long i_ino;
+	loff_t i_size;			/* written under i_lock */
+	spinlock_t i_lock;
+	struct address_space i_data;
+	void *i_private;		/* the filesystem's */
+};
+
+/* Readahead state of an open file (mm/readahead.c). */
+struct file_ra_state {
+	unsigned long start;		/* first page of the current window */
+	unsigned int size;		/* pages in it */
+	unsigned int async_size;	/* its pages from the readahead mark on */
+	unsigned int ra_pages;		/* largest window, 0 for none */
+	unsigned long prev_index;	/* last page read */
+};
+
+struct file {
+	struct inode *f_inode;
+	struct address_space *f_mapping;
+	loff_t f_pos;
+	struct file_ra_state f_ra;
+};
+
+void inode_init(struct inode *inode, unsigned long ino,
+		const struct address_space_operations *a_ops);
+void file_init(struct file *file, struct inode *inode);
+
+ssize_t generic_file_read(struct file *file, void *buf, size_t count,
+			  loff_t *pos);
+ssize_t generic_file_write(struct file *file, const void *buf, size_t count,
+			   loff_t *pos);
+/* Write back every dirty page and wait; the first error since the last. */
+int generic_file_fsync(struct file *file);
+
+#endif /* _ZHOS_FS_H */
@@ -0,0 +1,125 @@
+#ifndef _ZHOS_FUTEX_H
+#define _ZHOS_FUTEX_H
+
+#include <zhos/compiler.h>
+#include <zhos/types.h>
+
+/*
+ * Futexes (kernel/futex.c): sleeping and waking on a 32-bit word that
+ * the locking code itself changes with atomic instructions.
+ *
+ * Below the call are a mutex and a condition variable built on it, as a
+ * C library would build them: taking a free mutex or releasing one
+ * nobody waits for is one atomic instruction, and only contention makes
+ * the call.
+ */
+#define FUTEX_WAIT		0
+#define FUTEX_WAKE		1
+#define FUTEX_REQUEUE		3
+#define FUTEX_CMP_REQUEUE	4
+
+/* Key the word by address space as well, for memory no one else maps. */
+#define FUTEX_PRIVATE_FLAG	128
+#define FUTEX_CMD_MASK		(~FUTEX_PRIVATE_FLAG)
+
+#define FUTEX_WAIT_PRIVATE	(FUTEX_WAIT | FUTEX_PRIVATE_FLAG)
+#define FUTEX_WAKE_PRIVATE	(FUTEX_WAKE | FUTEX_PRIVATE_FLAG)
+#define FUTEX_CMP_REQUEUE_PRIVATE (FUTEX_CMP_REQUEUE | FUTEX_PRIVATE_FLAG)
+
+/*
+ * The call into the kernel.  FUTEX_WAIT sleeps while *@uaddr == @val, for
+ * up to *@timeout ns if @timeout is not NULL; FUTEX_WAKE wakes up to @val
+ * waiters; FUTEX_(CMP_)REQUEUE wakes @val and moves up to @val2 more to
+ * @uaddr2, if *@uaddr == @val3 for CMP.  May sleep.
+ */
+long do_futex(u32 *uaddr, int op, u32 val, const u64 *timeout, u32 *uaddr2,
+	      u32 val2, u32 val3);
+
+void futex_init(void);
+
+/* Locking side. */
+
+/* 0: unlocked, 1: locked, 2: locked and maybe waited for. */
+struct futex_mutex {
+	u32 val;
+};
+
+#define FUTEX_MUTEX_INIT	{ .val = 0 }
+
+static inline u32 futex_cmpxchg(u32 *p, u32 old, u32 new)
+{
+	__atomic_compare_exchange_n(p, &old, new, false, __ATOMIC_ACQUIRE,
+				    __ATOMIC_RELAXED);
+	return old;
+}
+
+static inline bool futex_mutex_trylock(struct futex_mutex *m)
+{
+	return !futex_cmpxchg(&m->val, 0, 1);
+}
+
+static inline void futex_mutex_lock(struct futex_mutex *m)
+{
+	u32 c = futex_cmpxchg(&m->val, 0, 1);
+
+	if (likely(!c))
+		return;
+	/* Contended: mark it so and sleep until it is free. */
+	if (c != 2)
+		c = __atomic_exchange_n(&m->val, 2, __ATOMIC_ACQUIRE);
+	while (c) {
+		do_futex(&m->val, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0, 0);
+		c = __atomic_exchange_n(&m->val, 2, __ATOMIC_ACQUIRE);
+	}
+}
+
+static inline void futex_mutex_unlock(struct futex_mutex *m)
+{
+	if (likely(__atomic_fetch_sub(&m->val, 1, __ATOMIC_RELEASE) == 1))
+		return;
+	__atomic_store_n(&m->val, 0, __ATOMIC_RELEASE);
+	do_futex(&m->val, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0, 0);
+}
+
+/* Bumped by every signal, so that a waiter cannot miss one. */
+struct futex_cond {
+	u32 seq;
+};
+
+#define FUTEX_COND_INIT		{ .seq = 0 }
+
+/* Called with @m held; returns with it held, possibly spuriously. */
+static inline void futex_cond_wait(struct futex_cond *c, struct futex_mutex *m)
+{
+	u32 seq = __atomic_load_n(&c->seq, __ATOMIC_RELAXED);
+
+	futex_mutex_unlock(m);
+	do_futex(&c->seq, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0, 0);
+	/* May have been requeued onto @m: it is contended from now on. */
+	while (__atomic_exchange_n(&m->val, 2, __ATOMIC_ACQUIRE))
+		do_futex(&m->val, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0, 0);
+}
+
+static inline void futex_cond_signal(struct futex_cond *c)
+{
+	__atomic_add_fetch(&c->seq, 1, __ATOMIC_RELEASE);
+	do_futex(&c->seq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0, 0);
+}
+
+/*
+ * Called with @m held.  Wakes one waiter and moves the rest onto @m, to
+ * be woken one at a time as it is released rather than all at once.
+ */
+static inline void futex_cond_broadcast(struct futex_cond *c,
+					struct futex_mutex *m)
+{
+	u32 seq = __atomic_add_fetch(&c->seq, 1, __ATOMIC_RELEASE);
+
+	/* Our unlock must wake the waiters it is about to inherit. */
+	__atomic_store_n(&m->val, 2, __ATOMIC_RELAXED);
+	if (do_futex(&c->seq, FUTEX_CMP_REQUEUE_PRIVATE, 1, NULL, &m->val,
+		     ~0U, seq) < 0)
+		do_futex(&c->seq, FUTEX_WAKE_PRIVATE, ~0U, NULL, NULL, 0, 0);
+}
+
+#endif /* _ZHOS_FUTEX_H */
@@ -0,0 +1,54 @@
+#ifndef _ZHOS_GFP_H
+#define _ZHOS_GFP_H
+
+#include <zhos/types.h>
+
+struct page;
+
+typedef unsigned int gfp_t;
+
+#define __GFP_ZERO	0x01u	/* clear the pages */
+#define __GFP_COLD	0x02u	/* not touched by the CPU soon, e.g. DMA targets */
+#define __GFP_THISNODE	0x04u	/* from the node asked for or not at all */
+
+/* Allocation never sleeps, so both are usable from any context. */
+#define GFP_KERNEL	0u
+#define GFP_ATOMIC	0u
+
+/* Blocks of 2^0 .. 2^(MAX_ORDER - 1) pages. */
+#define MAX_ORDER	11
+
+struct page *alloc_pages(gfp_t gfp, unsigned int order);
+#define alloc_page(gfp)		alloc_pages(gfp, 0)
+
+/* From @nid's memory, nearest other nodes next; NUMA_NO_NODE: this CPU's. */
+struct page *alloc_pages_node(int nid, gfp_t gfp, unsigned int order);
+
+void __free_pages(struct page *page, unsigned int order);
+#define __free_page(page)	__free_pages(page, 0)
+
+/* Free an order-0 page to the head (hot) or tail (cold) of the CPU's list. */
+void free_hot_cold_page(struct page *page, bool cold);
+
+/* The same, by identity-mapped address. */
+unsigned long __get_free_pages(gfp_t gfp, unsigned int order);
+#define __get_free_page(gfp)	__get_free_pages(gfp, 0)
+unsigned long get_zeroed_page(gfp_t gfp);
+void free_pages(unsigned long addr, unsigned int order);
+#define free_page(addr)		free_pages(addr, 0)
+
+unsigned long nr_free_pages(void);
+
+void page_alloc_init(void);
+
+/*
+ * Pools of pages cleared ahead of time for __GFP_ZERO (mm/prezero.c).
+ * The idle loop calls idle_zero_pages() with interrupts enabled; it
+ * returns false when there is nothing to clear.
+ */
+void prezero_init(void);
+bool idle_zero_pages(void);
+void prezero_stats(unsigned long *taken, unsigned long *missed,
+		   unsigned int order);
+
+#endif /* _ZHOS_GFP_H */
@@ -0,0 +1,45 @@
+#ifndef _ZHOS_HRTIMER_H
+#define _ZHOS_HRTIMER_H
+
+#include <zhos/list.h>
+#include <zhos/types.h>
+
+/*
+ * High-resolution timers run @function in interrupt context once
+ * clock_now_ns() reaches @expires, rather than at a jiffy.  They are for
+ * the few short deadlines the wheel cannot express, such as device
+ * polling intervals of tens of microseconds; a CPU keeps its pending
+ * hrtimers on a sorted list, so there should only ever be a handful.
+ *
+ * A timer is queued on the CPU that starts it and fires there.  Where the
+ * tick device has no one-shot mode they fire from the next tick instead.
+ */
+struct hrtimer_cpu_base;
+
+struct hrtimer {
+	struct list_head node;
+	u64 expires;			/* clock_now_ns() */
+	void (*function)(struct hrtimer *);
+	struct hrtimer_cpu_base *base;	/* set while queued or running */
+};
+
+void hrtimer_init(struct hrtimer *timer, void (*function)(struct hrtimer *));
+
+static inline bool hrtimer_queued(const struct hrtimer *timer)
+{
+	return !list_empty(&timer->node);
+}
+
+/* (Re)arm @timer on this CPU for @expires, an absolute clock_now_ns(). */
+void hrtimer_start(struct hrtimer *timer, u64 expires);
+void hrtimer_start_ns(struct hrtimer *timer, u64 delta_ns);
+/* Returns 1 if @timer was queued; waits for a running callback to end. */
+int hrtimer_cancel(struct hrtimer *timer);
+
+/* Tick interface, interrupts disabled. */
+void hrtimer_run_queues(u64 now);
+u64 hrtimer_next_event(void);
+
+void hrtimers_init_cpu(unsigned int cpu);
+
+#endif /* _ZHOS_HRTIMER_H */
@@ -0,0 +1,57 @@
+#ifndef _ZHOS_HUGE_MM_H
+#define _ZHOS_HUGE_MM_H
+
+#include <zhos/mm_types.h>
+#include <zhos/types.h>
+#include <asm/pgtable.h>
+
+/*
+ * Transparent huge pages (mm/huge_memory.c): anonymous regions mapped
+ * with 2 MiB pages, one TLB entry and one fault for what would be 512,
+ * without their users asking for it.  "transparent_hugepage=" on the
+ * command line picks where they are used:
+ *
+ *   always   every region with a whole aligned 2 MiB in it (the default)
+ *   madvise  only regions marked MADV_HUGEPAGE
+ *   never    nowhere
+ *
+ * A fault in an unmapped, suitable 2 MiB range maps a huge page at
+ * once; if none is free it falls back to a 4 KiB page.  The khugepaged
+ * thread later promotes such ranges, and ranges in regions that became
+ * eligible after being touched, by copying their small pages into a
+ * huge one.
+ */
+#define HPAGE_PMD_ORDER		(PMD_SHIFT - PAGE_SHIFT)
+#define HPAGE_PMD_NR		(1U << HPAGE_PMD_ORDER)
+
+struct thp_stats {
+	unsigned long fault_alloc;	/* faults mapping a huge page */
+	unsigned long fault_fallback;	/* ... that mapped a small one */
+	unsigned long collapse_alloc;	/* ranges khugepaged promoted */
+	unsigned long collapse_alloc_failed;
+};
+
+extern struct thp_stats thp_stats;
+
+#define count_thp_event(item)	\
+	__atomic_add_fetch(&thp_stats.item, 1, __ATOMIC_RELAXED)
+
+/* May @vma use huge pages at all? */
+bool thp_vma_allowed(const struct vm_area_struct *vma);
+
+/* May the 2 MiB range around @addr be mapped with a huge page? */
+static inline bool thp_vma_suitable(const struct vm_area_struct *vma,
+				    unsigned long addr)
+{
+	unsigned long haddr = addr & PMD_MASK;
+
+	return haddr >= vma->vm_start && haddr + PMD_SIZE <= vma->vm_end &&
+	       thp_vma_allowed(vma);
+}
+
+/* One khugepaged pass over @mm; returns the ranges promoted. */
+unsigned int khugepaged_scan_mm(struct mm_struct *mm);
+
+void hugepage_init(void);
+
+#endif /* _ZHOS_HUGE_MM_H */
@@ -0,0 +1,54 @@
+#ifndef _ZHOS_I8253_H
+#define _ZHOS_I8253_H
+
+#include <zhos/types.h>
+
+/* Input clock of the PC's 8253: 14.31818 MHz / 12. */
+#define PIT_TICK_RATE		1193182UL
+#define PIT_LATCH		((PIT_TICK_RATE + CONFIG_HZ / 2) / CONFIG_HZ)
+
+#define PIT_CH0			0x40
+#define PIT_CH1			0x41
+#define PIT_CH2			0x42
+#define PIT_MODE		0x43
+
+/*
+ * Control word: SC1 SC0 | RL1 RL0 | M2 M1 M0 | BCD
+ * SC=11 is illegal on the 8253 (it is the 8254's read-back command).
+ */
+#define PIT_SEL(ch)		((ch) << 6)
+#define PIT_RL_LATCH		(0 << 4)	/* counter latch command */
+#define PIT_RL_LSB		(1 << 4)
+#define PIT_RL_MSB		(2 << 4)
+#define PIT_RL_LSB_MSB		(3 << 4)
+#define PIT_MODE_0		(0 << 1)	/* interrupt on terminal count */
+#define PIT_MODE_1		(1 << 1)	/* programmable one-shot */
+#define PIT_MODE_2		(2 << 1)	/* rate generator */
+#define PIT_MODE_3		(3 << 1)	/* square wave */
+#define PIT_MODE_4		(4 << 1)	/* software triggered strobe */
+#define PIT_MODE_5		(5 << 1)	/* hardware triggered strobe */
+#define PIT_BCD			(1 << 0)
+
+/*
+ * On the PC, counter 2's GATE is driven from and its OUT readable through
+ * system control port B; it also feeds the speaker.
+ */
+#define PIT_CH2_PORT		0x61
+#define PIT_CH2_GATE		0x01
+#define PIT_CH2_SPEAKER		0x02
+#define PIT_CH2_OUT		0x20
+
+/* Counter 2 stopwatch for calibration; caller disables interrupts. */
+void pit_ch2_start(u16 count);
+bool pit_ch2_expired(void);
+void pit_ch2_stop(void);
+
+/* IRQ0 latency measurement while counter 0 is not the tick. */
+int pit_latency_probe_start(void (*fn)(u32 late));
+void pit_latency_probe_arm(u16 delta);
+void pit_latency_probe_stop(void);
+
+void clocksource_i8253_init(void);
+void clockevent_i8253_init(void);
+
+#endif /* _ZHOS_I8253_H */
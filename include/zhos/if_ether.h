@@ -0,0 +1,41 @@
+#ifndef _ZHOS_IF_ETHER_H
+#define _ZHOS_IF_ETHER_H
+
+#include <zhos/byteorder.h>
+#include <zhos/compiler.h>
+#include <zhos/netdevice.h>
+#include <zhos/pktbuf.h>
+#include <zhos/types.h>
+
+#define ETH_HLEN		14
+#define ETH_ZLEN		60	/* minimum frame, without FCS */
+#define ETH_DATA_LEN		1500
+#define ETH_FRAME_LEN		1514
+
+#define ETH_P_IP		0x0800
+#define ETH_P_ARP		0x0806
+
+struct ethhdr {
+	u8 h_dest[ETH_ALEN];
+	u8 h_source[ETH_ALEN];
+	__be16 h_proto;
+} __packed;
+
+static inline struct ethhdr *eth_hdr(const struct pkt_buf *pkt)
+{
+	return (struct ethhdr *)pkt->mac_header;
+}
+
+/*
+ * Note the Ethernet header and step over it, setting pkt->protocol.
+ * Returns nonzero for frames that are too short or not for this host.
+ */
+int eth_type_trans(struct pkt_buf *pkt);
+
+/*
+ * Turn a received frame around in place: back to its Ethernet header,
+ * addressed to its sender from @pkt->dev.
+ */
+void eth_reply(struct pkt_buf *pkt);
+
+#endif /* _ZHOS_IF_ETHER_H */
@@ -0,0 +1,14 @@
+#ifndef _ZHOS_INITRD_H
+#define _ZHOS_INITRD_H
+
+#include <zhos/fs.h>
+
+/*
+ * The boot loader's first module, used in place as a file
+ * (fs/initrd.c): NULL if there is none.
+ */
+extern struct inode *initrd_inode;
+
+void initrd_init(void);
+
+#endif /* _ZHOS_INITRD_H */
@@ -0,0 +1,226 @@
+#ifndef _ZHOS_IO_URING_H
+#define _ZHOS_IO_URING_H
+
+#include <zhos/compiler.h>
+#include <zhos/percpu.h>
+#include <zhos/string.h>
+#include <zhos/types.h>
+
+/*
+ * Submission and completion rings (fs/io_uring.c).
+ *
+ * The submitter fills submission queue entries in a ring it shares with
+ * the kernel, publishes them by moving the tail and makes one
+ * io_uring_enter() call for the lot; results come back as completion
+ * queue entries in a second ring, which the submitter reads without any
+ * call at all.  Each side only writes its own index, releasing what it
+ * filled in and acquiring what the other side did, so the rings work
+ * across a protection boundary as well as within the kernel.
+ *
+ * The structures below are that shared layout; the inline functions are
+ * the submitter's side of it.
+ */
+enum {
+	IORING_OP_NOP,
+	IORING_OP_READ,
+	IORING_OP_WRITE,
+	IORING_OP_FSYNC,
+	IORING_OP_TIMEOUT,
+	IORING_OP_LAST,
+};
+
+/* sqe->flags */
+#define IOSQE_ASYNC		(1U << 0)	/* run from a worker, not inline */
+
+/* io_uring_enter() flags */
+#define IORING_ENTER_GETEVENTS	(1U << 0)	/* wait for min_complete */
+
+/* Read or write at, and advance, the file's own position. */
+#define IORING_OFF_FILE_POS	(~0ULL)
+
+struct io_uring_sqe {
+	u8 opcode;
+	u8 flags;
+	u16 ioprio;
+	s32 fd;			/* index into the registered files */
+	u64 off;		/* file offset; TIMEOUT: completions to wait for */
+	u64 addr;		/* buffer; TIMEOUT: nanoseconds */
+	u32 len;
+	u32 op_flags;
+	u64 user_data;		/* copied to the completion */
+	u64 __pad[3];
+};
+
+struct io_uring_cqe {
+	u64 user_data;
+	s32 res;		/* bytes, or -errno */
+	u32 flags;
+};
+
+/*
+ * Shared indices.  The ring sizes are powers of two and the indices run
+ * freely, wrapping at 2^32; an entry's slot is its index & mask.
+ */
+struct io_rings {
+	u32 sq_head __aligned(SMP_CACHE_BYTES);	/* kernel writes */
+	u32 sq_tail __aligned(SMP_CACHE_BYTES);	/* submitter writes */
+	u32 cq_head __aligned(SMP_CACHE_BYTES);	/* submitter writes */
+	u32 cq_tail __aligned(SMP_CACHE_BYTES);	/* kernel writes */
+	u32 sq_ring_mask, cq_ring_mask;
+	u32 sq_ring_entries, cq_ring_entries;
+	u32 cq_overflow;			/* completions dropped, ring full */
+	struct io_uring_cqe cqes[] __aligned(SMP_CACHE_BYTES);
+};
+
+struct file;
+struct io_ring_ctx;
+
+/* The submitter's view of a ring. */
+struct io_uring {
+	struct io_ring_ctx *ctx;
+	struct io_rings *rings;
+	struct io_uring_sqe *sqes;
+	u32 sqe_tail;			/* filled, not yet published */
+};
+
+#define IORING_MAX_ENTRIES	4096
+
+/* A ring of @entries submissions and twice as many completions. */
+int io_uring_queue_init(unsigned int entries, struct io_uring *ring);
+/* Waits for everything in flight, then frees the ring. */
+void io_uring_queue_exit(struct io_uring *ring);
+/* The files sqe->fd indexes; replaces any earlier set. */
+int io_uring_register_files(struct io_uring *ring, struct file **files,
+			    unsigned int nr);
+
+/*
+ * The call into the kernel: consume up to @to_submit published entries
+ * and, with IORING_ENTER_GETEVENTS, sleep until @min_complete completions
+ * are waiting.  May sleep.  Returns the entries consumed.
+ */
+int io_uring_enter(struct io_ring_ctx *ctx, unsigned int to_submit,
+		   unsigned int min_complete, unsigned int flags);
+
+/* Submitter side. */
+
+static inline struct io_uring_sqe *io_uring_get_sqe(struct io_uring *ring)
+{
+	struct io_rings *r = ring->rings;
+	u32 head = __atomic_load_n(&r->sq_head, __ATOMIC_ACQUIRE);
+	struct io_uring_sqe *sqe;
+
+	if (ring->sqe_tail - head == r->sq_ring_entries)
+		return NULL;
+	sqe = &ring->sqes[ring->sqe_tail++ & r->sq_ring_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+static inline unsigned int io_uring_flush_sq(struct io_uring *ring)
+{
+	struct io_rings *r = ring->rings;
+	u32 tail = r->sq_tail;
+
+	__atomic_store_n(&r->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+	return ring->sqe_tail - tail;
+}
+
+static inline int io_uring_submit_and_wait(struct io_uring *ring,
+					   unsigned int wait_nr)
+{
+	return io_uring_enter(ring->ctx, io_uring_flush_sq(ring), wait_nr,
+			      wait_nr ? IORING_ENTER_GETEVENTS : 0);
+}
+
+static inline int io_uring_submit(struct io_uring *ring)
+{
+	return io_uring_submit_and_wait(ring, 0);
+}
+
+static inline unsigned int io_uring_cq_ready(const struct io_uring *ring)
+{
+	const struct io_rings *r = ring->rings;
+
+	return __atomic_load_n(&r->cq_tail, __ATOMIC_ACQUIRE) - r->cq_head;
+}
+
+/* The oldest completion, or NULL if there is none yet. */
+static inline struct io_uring_cqe *io_uring_peek_cqe(struct io_uring *ring)
+{
+	struct io_rings *r = ring->rings;
+
+	if (!io_uring_cq_ready(ring))
+		return NULL;
+	return &r->cqes[r->cq_head & r->cq_ring_mask];
+}
+
+static inline struct io_uring_cqe *io_uring_wait_cqe(struct io_uring *ring)
+{
+	struct io_uring_cqe *cqe;
+
+	while (!(cqe = io_uring_peek_cqe(ring)))
+		io_uring_enter(ring->ctx, 0, 1, IORING_ENTER_GETEVENTS);
+	return cqe;
+}
+
+/* Hand the slot of the completion just read back to the kernel. */
+static inline void io_uring_cqe_seen(struct io_uring *ring)
+{
+	struct io_rings *r = ring->rings;
+
+	__atomic_store_n(&r->cq_head, r->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+static inline void io_uring_prep_rw(struct io_uring_sqe *sqe, u8 op, int fd,
+				    void *buf, u32 len, u64 off)
+{
+	sqe->opcode = op;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long)buf;
+	sqe->len = len;
+	sqe->off = off;
+}
+
+static inline void io_uring_prep_nop(struct io_uring_sqe *sqe)
+{
+	sqe->opcode = IORING_OP_NOP;
+}
+
+static inline void io_uring_prep_read(struct io_uring_sqe *sqe, int fd,
+				      void *buf, u32 len, u64 off)
+{
+	io_uring_prep_rw(sqe, IORING_OP_READ, fd, buf, len, off);
+}
+
+static inline void io_uring_prep_write(struct io_uring_sqe *sqe, int fd,
+				       const void *buf, u32 len, u64 off)
+{
+	io_uring_prep_rw(sqe, IORING_OP_WRITE, fd, (void *)buf, len, off);
+}
+
+static inline void io_uring_prep_fsync(struct io_uring_sqe *sqe, int fd)
+{
+	sqe->opcode = IORING_OP_FSYNC;
+	sqe->fd = fd;
+}
+
+/*
+ * Complete with -ETIME after @ns, or with 0 once @count other completions
+ * have been posted since it was submitted, if @count is not 0.
+ */
+static inline void io_uring_prep_timeout(struct io_uring_sqe *sqe, u64 ns,
+					 u32 count)
+{
+	sqe->opcode = IORING_OP_TIMEOUT;
+	sqe->addr = ns;
+	sqe->off = count;
+}
+
+static inline void io_uring_sqe_set_data(struct io_uring_sqe *sqe, u64 data)
+{
+	sqe->user_data = data;
+}
+
+void io_uring_init(void);
+
+#endif /* _ZHOS_IO_URING_H */
@@ -0,0 +1,88 @@
+#ifndef _ZHOS_IP_H
+#define _ZHOS_IP_H
+
+#include <zhos/byteorder.h>
+#include <zhos/compiler.h>
+#include <zhos/pktbuf.h>
+#include <zhos/types.h>
+
+struct net_device;
+
+#define IPPROTO_ICMP		1
+#define IPPROTO_TCP		6
+#define IPPROTO_UDP		17
+#define MAX_INET_PROTOS		256
+
+#define IPDEFTTL		64
+
+struct iphdr {
+	u8 ihl:4, version:4;
+	u8 tos;
+	__be16 tot_len;
+	__be16 id;
+	__be16 frag_off;
+	u8 ttl;
+	u8 protocol;
+	u16 check;
+	__be32 saddr;
+	__be32 daddr;
+} __packed;
+
+static inline struct iphdr *ip_hdr(const struct pkt_buf *pkt)
+{
+	return (struct iphdr *)pkt->network_header;
+}
+
+#define IP_MF			0x2000
+#define IP_OFFSET		0x1fff
+
+struct icmphdr {
+	u8 type;
+	u8 code;
+	u16 checksum;
+	__be16 id;
+	__be16 sequence;
+} __packed;
+
+#define ICMP_ECHOREPLY		0
+#define ICMP_ECHO		8
+
+#define ARPHRD_ETHER		1
+#define ARPOP_REQUEST		1
+#define ARPOP_REPLY		2
+
+/* An Ethernet/IPv4 ARP packet. */
+struct arphdr {
+	__be16 ar_hrd;
+	__be16 ar_pro;
+	u8 ar_hln;
+	u8 ar_pln;
+	__be16 ar_op;
+	u8 ar_sha[6];
+	__be32 ar_sip;
+	u8 ar_tha[6];
+	__be32 ar_tip;
+} __packed;
+
+/*
+ * Transport protocols receive the packet with @data at their header and
+ * pkt->network_header at the IP header, and take it over.
+ */
+struct net_protocol {
+	int (*handler)(struct pkt_buf *pkt);
+};
+
+int inet_add_protocol(const struct net_protocol *prot, unsigned int protocol);
+
+/* Send an IPv4 packet turned around by its protocol: swap, checksum, go. */
+int ip_reply(struct pkt_buf *pkt);
+
+int icmp_rcv(struct pkt_buf *pkt);
+
+/* Apply "ip=a.b.c.d" to the first device registered. */
+void ip_dev_config(struct net_device *dev);
+
+void arp_init(void);
+void ip_init(void);
+
+#endif /* _ZHOS_IP_H */
@@ -0,0 +1,37 @@
+#ifndef _ZHOS_IRQ_H
+#define _ZHOS_IRQ_H
+
+#include <zhos/types.h>
+#include <asm/irq_vectors.h>
+
+typedef void (*irq_handler_t)(unsigned int irq, void *dev_id);
+
+struct irq_chip {
+	const char *name;
+	void (*mask)(unsigned int irq);
+	void (*unmask)(unsigned int irq);
+	void (*eoi)(unsigned int irq);
+	/* Optional: true if the interrupt being delivered is not real. */
+	bool (*spurious)(unsigned int irq);
+};
+
+struct irq_desc {
+	irq_handler_t handler;
+	void *dev_id;
+	const char *name;
+	struct irq_chip *chip;
+	unsigned long count;
+	unsigned long spurious;
+};
+
+extern struct irq_desc irq_desc[NR_IRQS];
+
+int request_irq(unsigned int irq, irq_handler_t handler, const char *name,
+		void *dev_id);
+void free_irq(unsigned int irq, void *dev_id);
+void disable_irq(unsigned int irq);
+void enable_irq(unsigned int irq);
+
+void irq_set_chip(unsigned int irq, struct irq_chip *chip);
+
+#endif /* _ZHOS_IRQ_H */
@@ -0,0 +1,50 @@
+#ifndef _ZHOS_IRQ_MODERATION_H
+#define _ZHOS_IRQ_MODERATION_H
+
+#include <zhos/hrtimer.h>
+#include <zhos/types.h>
+
+/*
+ * Interrupt moderation for devices that poll with their interrupt masked,
+ * as NAPI drivers do.  At a low event rate the driver unmasks after each
+ * batch and takes an interrupt per event.  Past @high_rate events a second
+ * it stays masked instead, and @poll is called from an hrtimer after an
+ * interval sized for about @batch events, clamped to [@min_ns, @max_ns]:
+ * @max_ns bounds the latency added to a lone event.  Below @low_rate it
+ * goes back to interrupts.
+ *
+ * The driver reports the events each poll handled with irq_mod_account(),
+ * and calls irq_mod_complete() when it is done, unmasking its interrupt
+ * only if that returns true.  Both come from the driver's poll, which
+ * does not run concurrently with itself.
+ */
+struct irq_moderation {
+	struct hrtimer timer;
+	void (*poll)(struct irq_moderation *mod);	/* from the hrtimer */
+
+	u32 high_rate;			/* events/s */
+	u32 low_rate;
+	u32 batch;
+	u32 min_ns;
+	u32 max_ns;
+
+	bool enabled;
+	bool polling;
+	u64 rate;			/* events/s, running average */
+	u64 window_start;
+	u32 window_events;
+};
+
+void irq_mod_init(struct irq_moderation *mod,
+		  void (*poll)(struct irq_moderation *mod));
+
+static inline void irq_mod_account(struct irq_moderation *mod,
+				   unsigned int events)
+{
+	mod->window_events += events;
+}
+
+/* True if the device should unmask; otherwise a poll has been armed. */
+bool irq_mod_complete(struct irq_moderation *mod);
+
+#endif /* _ZHOS_IRQ_MODERATION_H */
@@ -0,0 +1,34 @@
+#ifndef _ZHOS_JIFFIES_H
+#define _ZHOS_JIFFIES_H
+
+#include <zhos/kernel.h>
+
+#define HZ		CONFIG_HZ
+#define TICK_NSEC	((NSEC_PER_SEC + HZ / 2) / HZ)
+
+/*
+ * Ticks since boot.  With the tick stopped in idle it is caught up when
+ * the CPU wakes, so it never runs backwards but may jump.
+ */
+extern u64 jiffies;
+
+#define time_after(a, b)	((s64)((b) - (a)) < 0)
+#define time_before(a, b)	time_after(b, a)
+#define time_after_eq(a, b)	((s64)((a) - (b)) >= 0)
+
+static inline u64 msecs_to_jiffies(u64 ms)
+{
+	return DIV_ROUND_UP(ms * HZ, 1000);
+}
+
+static inline u64 nsecs_to_jiffies(u64 ns)
+{
+	return DIV_ROUND_UP(ns, TICK_NSEC);
+}
+
+static inline u64 get_jiffies_64(void)
+{
+	return READ_ONCE(jiffies);
+}
+
+#endif /* _ZHOS_JIFFIES_H */
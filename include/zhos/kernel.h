@@ -0,0 +1,45 @@
+#ifndef _ZHOS_KERNEL_H
+#define _ZHOS_KERNEL_H
+
+#include <zhos/types.h>
+#include <zhos/compiler.h>
+
+#define NSEC_PER_USEC	1000ULL
+#define NSEC_PER_MSEC	1000000ULL
+#define NSEC_PER_SEC	1000000000ULL
+#define USEC_PER_SEC	1000000ULL
+
+#define min(a, b)	((a) < (b) ? (a) : (b))
+#define max(a, b)	((a) > (b) ? (a) : (b))
+#define clamp(v, lo, hi) min(max(v, lo), hi)
+
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+#define ALIGN(x, a)		(((x) + ((a) - 1)) & ~((__typeof__(x))(a) - 1))
+#define ALIGN_DOWN(x, a)	((x) & ~((__typeof__(x))(a) - 1))
+#define IS_ALIGNED(x, a)	(((x) & ((__typeof__(x))(a) - 1)) == 0)
+
+int printk(const char *fmt, ...) __printf(1, 2);
+int vprintk(const char *fmt, va_list args);
+int snprintf(char *buf, size_t size, const char *fmt, ...) __printf(3, 4);
+int vsnprintf(char *buf, size_t size, const char *fmt, va_list args);
+
+void __noreturn panic(const char *fmt, ...) __printf(1, 2);
+
+#ifndef pr_fmt
+#define pr_fmt(fmt) fmt
+#endif
+
+#define pr_err(fmt, ...)	printk("error: " pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_warn(fmt, ...)	printk("warning: " pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_info(fmt, ...)	printk(pr_fmt(fmt), ##__VA_ARGS__)
+
+#define BUG()		panic("BUG at %s:%d", __FILE__, __LINE__)
+#define BUG_ON(c)	do { if (unlikely(c)) BUG(); } while (0)
+#define WARN_ON(c) ({							\
+	bool __w = !!(c);						\
+	if (unlikely(__w))						\
+		printk("WARNING at %s:%d\n", __FILE__, __LINE__);	\
+	__w;								\
+})
+
+#endif /* _ZHOS_KERNEL_H */
@@ -0,0 +1,27 @@
+#ifndef _ZHOS_KTHREAD_H
+#define _ZHOS_KTHREAD_H
+
+#include <zhos/compiler.h>
+
+struct task_struct;
+
+/*
+ * A kernel thread runs @fn(@data) and exits with its return value.  It
+ * is created asleep; wake_up_process() starts it.  Returns NULL when no
+ * task can be allocated.
+ */
+struct task_struct *kthread_create(int (*fn)(void *), void *data,
+				   const char *namefmt, ...) __printf(3, 4);
+
+/* Pin a not yet started thread to @cpu. */
+void kthread_bind(struct task_struct *p, unsigned int cpu);
+
+#define kthread_run(fn, data, namefmt, ...) ({				\
+	struct task_struct *__k =					\
+		kthread_create(fn, data, namefmt, ##__VA_ARGS__);	\
+	if (__k)							\
+		wake_up_process(__k);					\
+	__k;								\
+})
+
+#endif /* _ZHOS_KTHREAD_H */
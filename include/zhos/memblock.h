@@ -0,0 +1,46 @@
+#ifndef _ZHOS_MEMBLOCK_H
+#define _ZHOS_MEMBLOCK_H
+
+#include <zhos/types.h>
+
+/*
+ * Boot-time physical memory: the RAM ranges from the firmware map and
+ * the ranges already in use.  It serves the few allocations needed
+ * before the page allocator exists, which then takes over everything
+ * memory holds that is not reserved.
+ */
+#define MEMBLOCK_MAX_REGIONS	128
+
+struct memblock_region {
+	phys_addr_t base;
+	phys_addr_t size;
+};
+
+struct memblock_type {
+	unsigned int cnt;
+	struct memblock_region regions[MEMBLOCK_MAX_REGIONS];
+};
+
+void memblock_add(phys_addr_t base, phys_addr_t size);
+void memblock_reserve(phys_addr_t base, phys_addr_t size);
+bool memblock_is_reserved(phys_addr_t addr);
+/* Is all of [base, base + size) RAM? */
+bool memblock_is_region_memory(phys_addr_t base, phys_addr_t size);
+
+/* Reserve and return @size bytes below memblock_limit; panics on failure. */
+phys_addr_t memblock_alloc(phys_addr_t size, phys_addr_t align);
+
+/* Highest RAM address (exclusive) below memblock_limit. */
+phys_addr_t memblock_end_of_DRAM(void);
+
+/*
+ * Call @fn for every RAM range below memblock_limit that is not
+ * reserved, lowest first.
+ */
+void memblock_for_each_free_range(void (*fn)(phys_addr_t start,
+					     phys_addr_t end));
+
+/* Only memory below this is mapped; init_mem_mapping() raises it. */
+extern phys_addr_t memblock_limit;
+
+#endif /* _ZHOS_MEMBLOCK_H */
@@ -0,0 +1,220 @@
+#ifndef _ZHOS_MM_H
+#define _ZHOS_MM_H
+
+#include <zhos/bitops.h>
+#include <zhos/compiler.h>
+#include <zhos/gfp.h>
+#include <zhos/list.h>
+#include <zhos/numa.h>
+#include <zhos/types.h>
+#include <asm/page.h>
+
+struct address_space;
+struct kmem_cache;
+struct mm_struct;
+struct vm_area_struct;
+
+/*
+ * One struct page per physical page frame below max_pfn, in mem_map[]
+ * indexed by frame number.  Frames in holes and reserved ranges have
+ * one too and are simply never free.
+ */
+struct page {
+	unsigned long flags;
+	struct list_head lru;	/* buddy or per-CPU free list, else the owner's */
+	union {
+		unsigned long private;	/* buddy order while free */
+		struct {		/* every page of a slab */
+			struct kmem_cache *slab_cache;
+			void *freelist;	/* first page only, as is inuse */
+			unsigned int inuse;
+		};
+		struct {		/* page cache */
+			struct address_space *mapping;
+			unsigned long index;	/* in pages */
+		};
+	};
+	int _refcount;
+};
+
+/* Page flags; changed only by the page's owner or under the zone lock. */
+#define PG_buddy	0	/* heads a free buddy block */
+#define PG_reserved	1	/* never handed to the page allocator */
+#define PG_slab		2	/* owned by a kmem_cache */
+
+#define PAGEFLAG(name, bit)						\
+static inline bool Page##name(const struct page *page)			\
+{									\
+	return page->flags & (1UL << (bit));				\
+}									\
+static inline void __SetPage##name(struct page *page)			\
+{									\
+	page->flags |= 1UL << (bit);					\
+}									\
+static inline void __ClearPage##name(struct page *page)		\
+{									\
+	page->flags &= ~(1UL << (bit));					\
+}
+
+PAGEFLAG(Buddy, PG_buddy)
+PAGEFLAG(Reserved, PG_reserved)
+PAGEFLAG(Slab, PG_slab)
+
+#undef PAGEFLAG
+
+/*
+ * Page cache state, changed by whoever holds a reference: atomic.  All of
+ * them are clear again by the time the page is freed.
+ */
+#define PG_locked	3	/* I/O in progress or being modified */
+#define PG_uptodate	4	/* contents valid */
+#define PG_dirty	5	/* newer than the backing store */
+#define PG_writeback	6	/* being written back */
+#define PG_readahead	7	/* reading it triggers the next readahead */
+
+#define PAGEFLAG_ATOMIC(name, bit)					\
+static inline bool Page##name(const struct page *page)			\
+{									\
+	return test_bit(bit, &page->flags);				\
+}									\
+static inline void SetPage##name(struct page *page)			\
+{									\
+	set_bit(bit, &page->flags);					\
+}									\
+static inline void ClearPage##name(struct page *page)			\
+{									\
+	clear_bit(bit, &page->flags);					\
+}									\
+static inline bool TestSetPage##name(struct page *page)			\
+{									\
+	return test_and_set_bit(bit, &page->flags);			\
+}									\
+static inline bool TestClearPage##name(struct page *page)		\
+{									\
+	return test_and_clear_bit(bit, &page->flags);			\
+}
+
+PAGEFLAG_ATOMIC(Locked, PG_locked)
+PAGEFLAG_ATOMIC(Uptodate, PG_uptodate)
+PAGEFLAG_ATOMIC(Dirty, PG_dirty)
+PAGEFLAG_ATOMIC(Writeback, PG_writeback)
+PAGEFLAG_ATOMIC(Readahead, PG_readahead)
+
+#undef PAGEFLAG_ATOMIC
+
+/* The frame's node, in the top bits of ->flags; set once at boot. */
+#define NODES_PGSHIFT	(64 - NODES_SHIFT)
+
+static inline int page_to_nid(const struct page *page)
+{
+	return page->flags >> NODES_PGSHIFT;
+}
+
+static inline void set_page_node(struct page *page, int nid)
+{
+	page->flags = (page->flags & ((1UL << NODES_PGSHIFT) - 1)) |
+		      (unsigned long)nid << NODES_PGSHIFT;
+}
+
+extern struct page *mem_map;
+extern unsigned long max_pfn;
+
+#define PFN_UP(x)	(((x) + PAGE_SIZE - 1) >> PAGE_SHIFT)
+#define PFN_DOWN(x)	((x) >> PAGE_SHIFT)
+#define PFN_PHYS(x)	((phys_addr_t)(x) << PAGE_SHIFT)
+
+/* Smallest order of pages holding @size bytes. */
+static inline unsigned int get_order(unsigned long size)
+{
+	return size > PAGE_SIZE ? __fls64((size - 1) >> PAGE_SHIFT) + 1 : 0;
+}
+
+#define pfn_valid(pfn)		((pfn) < max_pfn)
+#define pfn_to_page(pfn)	(mem_map + (pfn))
+#define page_to_pfn(page)	((unsigned long)((page) - mem_map))
+
+static inline void *page_address(const struct page *page)
+{
+	return phys_to_virt(PFN_PHYS(page_to_pfn(page)));
+}
+
+static inline struct page *virt_to_page(const void *addr)
+{
+	return pfn_to_page(PFN_DOWN(__pa(addr)));
+}
+
+static inline int page_count(const struct page *page)
+{
+	return __atomic_load_n(&page->_refcount, __ATOMIC_RELAXED);
+}
+
+static inline void set_page_count(struct page *page, int v)
+{
+	__atomic_store_n(&page->_refcount, v, __ATOMIC_RELAXED);
+}
+
+static inline void get_page(struct page *page)
+{
+	__atomic_add_fetch(&page->_refcount, 1, __ATOMIC_RELAXED);
+}
+
+/* Drop a reference; true if it was the last. */
+static inline bool put_page_testzero(struct page *page)
+{
+	return __atomic_sub_fetch(&page->_refcount, 1, __ATOMIC_ACQ_REL) == 0;
+}
+
+/* Drop a reference to an order-0 page, freeing it with the last. */
+static inline void put_page(struct page *page)
+{
+	__free_page(page);
+}
+
+/*
+ * Anonymous regions (mm/mmap.c, mm/memory.c): address space reserved
+ * now, backed by zeroed pages as it is touched.  Regions of 2 MiB or
+ * more are 2 MiB aligned so that they can be mapped with huge pages.
+ * They must only be touched with interrupts enabled and outside
+ * interrupt handlers.
+ */
+#define MADV_HUGEPAGE	14
+#define MADV_NOHUGEPAGE	15
+
+/* Returns the start of a new region of @len bytes, or 0. */
+unsigned long vm_mmap_anon(struct mm_struct *mm, unsigned long len,
+			   unsigned long vm_flags);
+/*
+ * A private mapping of @len bytes of @mapping from page @pgoff: its page
+ * cache pages themselves, read-only, each copied when first written.
+ * The mapping must outlive the region.
+ */
+unsigned long vm_mmap_file(struct mm_struct *mm, struct address_space *mapping,
+			   unsigned long pgoff, unsigned long len);
+/* Unmaps and frees the whole region starting at @addr. */
+int vm_munmap(struct mm_struct *mm, unsigned long addr);
+int vm_madvise(struct mm_struct *mm, unsigned long addr, int advice);
+
+/* The region containing @addr, or NULL; under mmap_lock. */
+struct vm_area_struct *vma_lookup(struct mm_struct *mm, unsigned long addr);
+
+#define FAULT_FLAG_WRITE	0x01u
+
+/* Back @addr with a page; 0, or -EFAULT outside any region, or -ENOMEM. */
+int handle_mm_fault(struct mm_struct *mm, unsigned long addr,
+		    unsigned int flags);
+
+/*
+ * Address spaces (kernel/fork.c).  dup_mm() copies one for fork, with
+ * every page shared copy-on-write; mmput() drops a reference, the last
+ * one unmapping everything (exit_mmap()).  mm_next() walks all of them,
+ * from init_mm round to NULL, holding a reference on the one it returns
+ * and dropping the one on @mm.
+ */
+struct mm_struct *mm_alloc(void);
+struct mm_struct *dup_mm(struct mm_struct *oldmm);
+void mmput(struct mm_struct *mm);
+struct mm_struct *mm_next(struct mm_struct *mm);
+int copy_page_range(struct mm_struct *dst, struct mm_struct *src);
+void exit_mmap(struct mm_struct *mm);
+
+#endif /* _ZHOS_MM_H */
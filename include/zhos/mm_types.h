@@ -0,0 +1,59 @@
+#ifndef _ZHOS_MM_TYPES_H
+#define _ZHOS_MM_TYPES_H
+
+#include <zhos/cpumask.h>
+#include <zhos/list.h>
+#include <zhos/numa.h>
+#include <zhos/spinlock.h>
+#include <zhos/types.h>
+#include <asm/pgtable.h>
+
+struct mm_struct;
+
+/*
+ * A demand-paged region: [vm_start, vm_end) is reserved address space
+ * whose pages are only allocated and mapped when first touched.
+ */
+struct vm_area_struct {
+	struct mm_struct *vm_mm;
+	unsigned long vm_start, vm_end;
+	unsigned long vm_flags;
+	struct list_head vm_list;	/* mm->mmap, by address */
+	struct address_space *vm_mapping;	/* NULL: anonymous */
+	unsigned long vm_pgoff;		/* vm_start's page in vm_mapping */
+};
+
+/* vm_flags */
+#define VM_HUGEPAGE	(1UL << 0)	/* even in madvise mode */
+#define VM_NOHUGEPAGE	(1UL << 1)	/* never use huge pages */
+
+/*
+ * An address space.  The kernel's mappings are the same in all of them;
+ * only [mmap_base, mmap_end), the VMAP slot of the PGD, is private.
+ * mmap_lock protects the region list and every change to the page
+ * tables under it; it is a spinlock since nothing done under it sleeps.
+ * The pages mapped are counted by node under it too; the node with
+ * the most is where the scheduler prefers to run the mm's tasks.
+ * cpu_bitmap is the CPUs with it loaded, the ones a flush of it has to
+ * interrupt; each CPU sets and clears its own bit in switch_mm().
+ */
+struct mm_struct {
+	pgd_t *pgd;
+	int mm_users;			/* tasks on it, and other holders */
+	struct list_head mmlist;	/* every mm, headed by init_mm's */
+	spinlock_t mmap_lock;
+	struct list_head mmap;
+	unsigned long mmap_base, mmap_end;
+	u64 ctx_id;			/* never reused; names it in TLB tags */
+	u64 tlb_gen;			/* bumped by every flush of it */
+	struct cpumask cpu_bitmap;	/* CPUs with it loaded */
+	unsigned long numa_pages[MAX_NUMNODES];	/* mapped, by node */
+	int numa_nid;			/* most of them; NUMA_NO_NODE: none */
+};
+
+#define mm_cpumask(mm)	(&(mm)->cpu_bitmap)
+
+/* The kernel's own, on swapper_pg_dir, used by tasks with no mm of theirs. */
+extern struct mm_struct init_mm;
+
+#endif /* _ZHOS_MM_TYPES_H */
@@ -0,0 +1,52 @@
+#ifndef _ZHOS_MULTIBOOT_H
+#define _ZHOS_MULTIBOOT_H
+
+/* Multiboot (version 1) header and boot information, as far as we use it. */
+
+#define MULTIBOOT_HEADER_MAGIC		0x1BADB002
+#define MULTIBOOT_BOOTLOADER_MAGIC	0x2BADB002
+
+#define MULTIBOOT_PAGE_ALIGN		(1 << 0)
+#define MULTIBOOT_MEMORY_INFO		(1 << 1)
+#define MULTIBOOT_AOUT_KLUDGE		(1 << 16)
+
+#define MULTIBOOT_INFO_MEMORY		(1 << 0)
+#define MULTIBOOT_INFO_CMDLINE		(1 << 2)
+#define MULTIBOOT_INFO_MODS		(1 << 3)
+#define MULTIBOOT_INFO_MEM_MAP		(1 << 6)
+
+#ifndef __ASSEMBLY__
+
+#include <zhos/types.h>
+#include <zhos/compiler.h>
+
+struct multiboot_info {
+	u32 flags;
+	u32 mem_lower;
+	u32 mem_upper;
+	u32 boot_device;
+	u32 cmdline;
+	u32 mods_count;
+	u32 mods_addr;
+	u32 syms[4];
+	u32 mmap_length;
+	u32 mmap_addr;
+} __packed;
+
+struct multiboot_mmap_entry {
+	u32 size;		/* of the rest of the entry, not including this field */
+	u64 addr;
+	u64 len;
+	u32 type;
+} __packed;
+
+struct multiboot_module {
+	u32 mod_start;
+	u32 mod_end;
+	u32 cmdline;
+	u32 reserved;
+} __packed;
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* _ZHOS_MULTIBOOT_H */
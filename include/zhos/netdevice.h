@@ -0,0 +1,82 @@
+#ifndef _ZHOS_NETDEVICE_H
+#define _ZHOS_NETDEVICE_H
+
+#include <zhos/byteorder.h>
+#include <zhos/list.h>
+#include <zhos/types.h>
+
+#define IFNAMSIZ		16
+#define ETH_ALEN		6
+
+struct net_device;
+struct pkt_buf;
+
+struct net_device_ops {
+	int (*open)(struct net_device *dev);
+	/* Takes over @pkt whatever it returns; it is freed once sent. */
+	int (*start_xmit)(struct pkt_buf *pkt, struct net_device *dev);
+};
+
+struct net_device_stats {
+	u64 rx_packets, rx_bytes, rx_dropped;
+	u64 tx_packets, tx_bytes, tx_dropped;
+};
+
+struct net_device {
+	struct list_head list;
+	char name[IFNAMSIZ];
+	u8 dev_addr[ETH_ALEN];
+	unsigned int mtu;
+	__be32 ip_addr;			/* 0 until configured */
+	const struct net_device_ops *ops;
+	struct net_device_stats stats;
+	void *priv;
+};
+
+/*
+ * NAPI: a device with packets waiting masks its interrupt and schedules
+ * its napi_struct; the CPU's NET_RX_SOFTIRQ then calls ->poll() with a
+ * budget until it returns less than @weight, at which point the driver
+ * calls napi_complete() and unmasks.  Under load a device is thus polled
+ * with its interrupt off, one batch per call.
+ */
+struct napi_struct {
+	struct list_head poll_list;
+	bool scheduled;
+	int weight;
+	int (*poll)(struct napi_struct *napi, int budget);
+	struct net_device *dev;
+};
+
+#define NAPI_POLL_WEIGHT	64
+
+void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
+		    int (*poll)(struct napi_struct *, int), int weight);
+/* From the device's interrupt handler. */
+void napi_schedule(struct napi_struct *napi);
+void napi_complete(struct napi_struct *napi);
+
+/* Name the device "ethN", open it and add it to the device list. */
+int register_netdev(struct net_device *dev);
+
+/* Hand a received frame up the stack, which takes it over. */
+void netif_receive_pkt(struct pkt_buf *pkt);
+/* Send @pkt on pkt->dev; the device takes it over. */
+int dev_queue_xmit(struct pkt_buf *pkt);
+
+/* Protocol handlers by ethertype; they take over the packet. */
+struct packet_type {
+	u16 type;			/* host order */
+	int (*func)(struct pkt_buf *pkt);
+	struct list_head list;
+};
+
+void dev_add_pack(struct packet_type *pt);
+void dev_remove_pack(struct packet_type *pt);
+
+void net_init(void);
+
+/* Drivers. */
+void e1000_init(void);
+
+#endif /* _ZHOS_NETDEVICE_H */
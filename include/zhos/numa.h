@@ -0,0 +1,46 @@
+#ifndef _ZHOS_NUMA_H
+#define _ZHOS_NUMA_H
+
+#include <zhos/percpu.h>
+#include <zhos/types.h>
+
+/*
+ * Memory nodes (arch/x86/mm/numa.c), from the ACPI SRAT and SLIT.  Node
+ * ids are dense from 0; without those tables, or with "numa=off", there
+ * is one node holding all memory and all CPUs.
+ */
+#define NODES_SHIFT		3
+#define MAX_NUMNODES		(1 << NODES_SHIFT)
+#define NUMA_NO_NODE		(-1)
+
+/* SLIT units: the cost of a node's own memory, and the default otherwise. */
+#define LOCAL_DISTANCE		10
+#define REMOTE_DISTANCE		20
+
+extern unsigned int nr_node_ids;
+
+DECLARE_PER_CPU(int, numa_node);
+
+#define cpu_to_node(cpu)	per_cpu(numa_node, cpu)
+#define numa_node_id()		this_cpu_read(numa_node)
+
+int node_distance(int from, int to);
+
+/* Every node, nearest to @nid first, @nid itself leading. */
+extern u8 node_order[MAX_NUMNODES][MAX_NUMNODES];
+
+/* Boot only, until page_alloc_init(): the node of a physical frame. */
+int early_pfn_to_nid(unsigned long pfn);
+
+/* For the firmware table parser (drivers/acpi/numa.c). */
+int numa_add_memblk(int nid, u64 start, u64 end);
+void numa_set_apicid_node(u32 apicid, int nid);
+void numa_set_distance(int from, int to, int distance);
+
+/* From setup_arch(), once the CPUs are enumerated. */
+void numa_init(void);
+
+/* ACPI SRAT and SLIT; 0 if the SRAT described memory. */
+int acpi_numa_init(void);
+
+#endif /* _ZHOS_NUMA_H */
@@ -0,0 +1,61 @@
+#ifndef _ZHOS_PAGEMAP_H
+#define _ZHOS_PAGEMAP_H
+
+/*
+ * The page cache (mm/filemap.c).  Pages returned by the lookups carry a
+ * reference for the caller, dropped with put_page(); the cache holds one
+ * of its own for as long as the page is in it.
+ */
+#include <zhos/fs.h>
+#include <zhos/mm.h>
+#include <zhos/types.h>
+
+static inline loff_t page_offset(const struct page *page)
+{
+	return (loff_t)page->index << PAGE_SHIFT;
+}
+
+struct page *find_get_page(struct address_space *mapping, unsigned long index);
+/* Found or newly added, locked; NULL when out of memory. */
+struct page *grab_cache_page(struct address_space *mapping,
+			     unsigned long index);
+/* The page at @index, uptodate, read in if need be; NULL with *@err set. */
+struct page *read_cache_page(struct address_space *mapping,
+			     unsigned long index, int *err);
+/* Insert a new page, locked; -EEXIST if @index is taken. */
+int add_to_page_cache(struct page *page, struct address_space *mapping,
+		      unsigned long index);
+/* Drop every page; the caller has written back what it wants kept. */
+void truncate_inode_pages(struct address_space *mapping);
+
+void lock_page(struct page *page);
+void unlock_page(struct page *page);
+void wait_on_page_locked(struct page *page);
+void wait_on_page_writeback(struct page *page);
+void wake_up_page(struct page *page);
+
+/* I/O completion, from any context. */
+void end_page_read(struct page *page, int err);
+void end_page_writeback(struct page *page, int err);
+
+/* Writeback (mm/page-writeback.c). */
+void set_page_dirty(struct page *page);
+void cancel_dirty_page(struct page *page);
+int writeback_mapping(struct address_space *mapping, bool sync);
+int filemap_write_and_wait(struct address_space *mapping);
+void balance_dirty_pages(void);
+void wakeup_flusher_thread(void);
+
+/* Readahead (mm/readahead.c). */
+void file_ra_state_init(struct file_ra_state *ra);
+void page_cache_sync_readahead(struct address_space *mapping,
+			       struct file_ra_state *ra, unsigned long index,
+			       unsigned long req);
+void page_cache_async_readahead(struct address_space *mapping,
+				struct file_ra_state *ra, struct page *page,
+				unsigned long index, unsigned long req);
+
+void pagecache_init(void);
+void page_writeback_init(void);
+
+#endif /* _ZHOS_PAGEMAP_H */
@@ -0,0 +1,84 @@
+#ifndef _ZHOS_PCI_H
+#define _ZHOS_PCI_H
+
+#include <zhos/list.h>
+#include <zhos/types.h>
+
+/* Configuration space header, type 0 unless noted. */
+#define PCI_VENDOR_ID		0x00
+#define PCI_DEVICE_ID		0x02
+#define PCI_COMMAND		0x04
+#define  PCI_COMMAND_IO		0x0001
+#define  PCI_COMMAND_MEMORY	0x0002
+#define  PCI_COMMAND_MASTER	0x0004
+#define PCI_CLASS_REVISION	0x08	/* class << 8 | revision */
+#define PCI_HEADER_TYPE		0x0e
+#define  PCI_HEADER_TYPE_MASK	0x7f
+#define  PCI_HEADER_TYPE_BRIDGE	0x01
+#define  PCI_HEADER_MULTI_FUNC	0x80
+#define PCI_BASE_ADDRESS_0	0x10
+#define  PCI_BASE_ADDRESS_SPACE_IO	0x01
+#define  PCI_BASE_ADDRESS_MEM_TYPE_64	0x04
+#define  PCI_BASE_ADDRESS_MEM_MASK	(~0x0fULL)
+#define  PCI_BASE_ADDRESS_IO_MASK	(~0x03ULL)
+#define PCI_SECONDARY_BUS	0x19	/* type 1 */
+#define PCI_INTERRUPT_LINE	0x3c
+
+#define PCI_CLASS_BRIDGE_PCI	0x0604
+
+#define PCI_NUM_BARS		6
+
+#define PCI_DEVFN(slot, fn)	((((slot) & 0x1f) << 3) | ((fn) & 0x07))
+#define PCI_SLOT(devfn)		(((devfn) >> 3) & 0x1f)
+#define PCI_FUNC(devfn)		((devfn) & 0x07)
+
+struct pci_driver;
+
+struct pci_bar {
+	u64 start;
+	bool io;		/* I/O port space, else memory */
+};
+
+struct pci_dev {
+	struct list_head node;
+	u8 bus, devfn;
+	u16 vendor, device;
+	u32 class;		/* base class << 16 | subclass << 8 | prog-if */
+	u8 hdr_type;
+	u8 irq;			/* legacy line routed by the firmware */
+	struct pci_bar bar[PCI_NUM_BARS];
+	struct pci_driver *driver;
+	void *driver_data;
+};
+
+struct pci_device_id {
+	u16 vendor, device;
+};
+
+#define PCI_DEVICE(v, d)	.vendor = (v), .device = (d)
+
+/* @id_table ends with a zero entry; probe returns 0 to claim the device. */
+struct pci_driver {
+	const char *name;
+	const struct pci_device_id *id_table;
+	int (*probe)(struct pci_dev *dev, const struct pci_device_id *id);
+};
+
+u8 pci_read_config_byte(struct pci_dev *dev, unsigned int where);
+u16 pci_read_config_word(struct pci_dev *dev, unsigned int where);
+u32 pci_read_config_dword(struct pci_dev *dev, unsigned int where);
+void pci_write_config_word(struct pci_dev *dev, unsigned int where, u16 val);
+void pci_write_config_dword(struct pci_dev *dev, unsigned int where, u32 val);
+
+/* Turn on decoding of the device's memory and I/O BARs. */
+void pci_enable_device(struct pci_dev *dev);
+/* Let the device initiate DMA. */
+void pci_set_master(struct pci_dev *dev);
+
+/* Probe @drv against every device found so far that has no driver. */
+void pci_register_driver(struct pci_driver *drv);
+
+/* Enumerate the buses behind the host bridge through port 0xcf8/0xcfc. */
+void pci_init(void);
+
+#endif /* _ZHOS_PCI_H */
@@ -0,0 +1,42 @@
+#ifndef _ZHOS_PERCPU_H
+#define _ZHOS_PERCPU_H
+
+#include <zhos/compiler.h>
+#include <zhos/types.h>
+
+#define NR_CPUS			CONFIG_NR_CPUS
+#define SMP_CACHE_BYTES		64
+
+/*
+ * Per-CPU variables are linked once into .data..percpu, which serves as
+ * the template: setup_per_cpu_areas() gives every CPU its own copy and
+ * records the distance to it in __per_cpu_offset[].  The running CPU finds
+ * its copy through the GS base (see <asm/percpu.h>), so the template itself
+ * is never used at run time.
+ */
+#define PER_CPU_SECTION		".data..percpu"
+
+#define DECLARE_PER_CPU(type, name) \
+	extern __section(PER_CPU_SECTION) __typeof__(type) name
+#define DEFINE_PER_CPU(type, name) \
+	__section(PER_CPU_SECTION) __typeof__(type) name
+#define DEFINE_PER_CPU_ALIGNED(type, name) \
+	__section(PER_CPU_SECTION) __typeof__(type) name __aligned(SMP_CACHE_BYTES)
+
+extern unsigned long __per_cpu_offset[NR_CPUS];
+
+#include <asm/percpu.h>
+
+#define per_cpu_ptr(ptr, cpu) \
+	((__typeof__(ptr))((unsigned long)(ptr) + __per_cpu_offset[cpu]))
+#define per_cpu(var, cpu)	(*per_cpu_ptr(&(var), cpu))
+
+/* Callers must not migrate: interrupts off, or pinned to the CPU. */
+#define this_cpu_ptr(ptr) \
+	((__typeof__(ptr))((unsigned long)(ptr) + __my_cpu_offset()))
+#define this_cpu_read(var)	READ_ONCE(*this_cpu_ptr(&(var)))
+#define this_cpu_write(var, v)	WRITE_ONCE(*this_cpu_ptr(&(var)), v)
+
+void setup_per_cpu_areas(void);
+
+#endif /* _ZHOS_PERCPU_H */
@@ -0,0 +1,45 @@
+#ifndef _ZHOS_PERF_EVENT_H
+#define _ZHOS_PERF_EVENT_H
+
+#include <zhos/types.h>
+
+struct task_struct;
+
+/*
+ * Hardware performance counters (arch/x86/kernel/perf_event.c).  A task
+ * counts events on itself, with the counters switched along with it so
+ * that nothing another task does is charged to it.  One counter is kept
+ * back for sampling: its overflow interrupt takes a profiler sample every
+ * so many events.  All of it fails with -ENODEV on a CPU without
+ * architectural performance monitoring.
+ */
+enum perf_hw_id {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_REFERENCES,	/* last-level cache */
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+	PERF_COUNT_HW_BRANCH_MISSES,
+	PERF_COUNT_HW_MAX,
+};
+
+/* "cycles", "instructions" and so on, by id; -EINVAL if unknown. */
+extern const char *const perf_hw_event_names[PERF_COUNT_HW_MAX];
+int perf_event_lookup(const char *name);
+
+/*
+ * Count @events, a mask of 1 << PERF_COUNT_HW_*, on the calling task
+ * from zero.  -EINVAL if the CPU cannot count one of them, -ENOSPC if
+ * there are fewer counters than events.
+ */
+int perf_task_enable(unsigned int events);
+/* Stop counting; the totals stay readable. */
+void perf_task_disable(void);
+/* @p's totals by id: live for current, else as of its last switch out. */
+int perf_task_read(struct task_struct *p, u64 counts[PERF_COUNT_HW_MAX]);
+
+/* Every CPU calls profile_sample() every @period @event, up to 2^31. */
+int perf_sample_start(unsigned int event, u64 period);
+void perf_sample_stop(void);
+
+#endif /* _ZHOS_PERF_EVENT_H */
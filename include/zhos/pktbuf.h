@@ -0,0 +1,96 @@
+#ifndef _ZHOS_PKTBUF_H
+#define _ZHOS_PKTBUF_H
+
+/*
+ * Packet buffers.  Each one is PKT_BUF_SIZE bytes of a preallocated arena
+ * (net/core/pktbuf.c), big enough for a full Ethernet frame, and that
+ * memory is what the NIC DMAs into and out of: a packet is passed up the
+ * stack and back down by its struct pkt_buf, never copied.
+ *
+ * @data and @len describe the part of the buffer the current layer is
+ * looking at; the pull/push helpers move over headers in place.
+ */
+#include <zhos/kernel.h>
+#include <zhos/list.h>
+#include <zhos/types.h>
+#include <asm/page.h>
+
+#define PKT_BUF_SIZE		2048
+
+struct net_device;
+
+struct pkt_buf {
+	struct list_head list;		/* free list or a queue */
+	struct net_device *dev;		/* received on or to be sent by */
+	u8 *head;			/* PKT_BUF_SIZE bytes */
+	u8 *data;
+	unsigned int len;
+	u8 *mac_header;
+	u8 *network_header;
+	u16 protocol;			/* ethertype, host order */
+};
+
+/* NULL when the pool is exhausted. */
+struct pkt_buf *pkt_alloc(void);
+void pkt_free(struct pkt_buf *pkt);
+
+static inline phys_addr_t pkt_dma_addr(const struct pkt_buf *pkt)
+{
+	return virt_to_phys(pkt->data);
+}
+
+static inline unsigned int pkt_headroom(const struct pkt_buf *pkt)
+{
+	return pkt->data - pkt->head;
+}
+
+static inline unsigned int pkt_tailroom(const struct pkt_buf *pkt)
+{
+	return PKT_BUF_SIZE - pkt_headroom(pkt) - pkt->len;
+}
+
+/* Leave @len bytes in front for headers; only on an empty buffer. */
+static inline void pkt_reserve(struct pkt_buf *pkt, unsigned int len)
+{
+	pkt->data += len;
+}
+
+/* Step over a header at the front; NULL if the packet is shorter. */
+static inline void *pkt_pull(struct pkt_buf *pkt, unsigned int len)
+{
+	if (len > pkt->len)
+		return NULL;
+	pkt->data += len;
+	pkt->len -= len;
+	return pkt->data;
+}
+
+/* Step back over a header in front of @data. */
+static inline void *pkt_push(struct pkt_buf *pkt, unsigned int len)
+{
+	BUG_ON(len > pkt_headroom(pkt));
+	pkt->data -= len;
+	pkt->len += len;
+	return pkt->data;
+}
+
+/* Extend the data by @len bytes at the end; returns where they start. */
+static inline void *pkt_put(struct pkt_buf *pkt, unsigned int len)
+{
+	void *tail = pkt->data + pkt->len;
+
+	BUG_ON(len > pkt_tailroom(pkt));
+	pkt->len += len;
+	return tail;
+}
+
+/* Drop anything past the first @len bytes, such as Ethernet padding. */
+static inline void pkt_trim(struct pkt_buf *pkt, unsigned int len)
+{
+	if (len < pkt->len)
+		pkt->len = len;
+}
+
+void pktbuf_init(void);
+
+#endif /* _ZHOS_PKTBUF_H */
@@ -0,0 +1,56 @@
+#ifndef _ZHOS_PREEMPT_H
+#define _ZHOS_PREEMPT_H
+
+#include <zhos/compiler.h>
+#include <asm/preempt.h>
+
+/*
+ * preempt_count layout:
+ *
+ *   bits  0-7	preemption disable depth (spinlocks, preempt_disable())
+ *   bits  8-15	softirq nesting (kernel/softirq.c)
+ *   bits 16-23	hardirq nesting
+ *
+ * The scheduler only preempts a task whose count is zero.
+ */
+#define PREEMPT_OFFSET		(1 << 0)
+#define SOFTIRQ_OFFSET		(1 << 8)
+#define SOFTIRQ_MASK		(0xff << 8)
+#define HARDIRQ_OFFSET		(1 << 16)
+#define HARDIRQ_MASK		(0xff << 16)
+
+#define in_irq()		(preempt_count() & HARDIRQ_MASK)
+#define in_softirq()		(preempt_count() & SOFTIRQ_MASK)
+#define in_interrupt()		(preempt_count() & (HARDIRQ_MASK | SOFTIRQ_MASK))
+
+/* Set by resched_curr() for the task running on this CPU. */
+DECLARE_PER_CPU(bool, need_resched_flag);
+
+static __always_inline bool need_resched(void)
+{
+	return unlikely(this_cpu_read(need_resched_flag));
+}
+
+void preempt_schedule(void);
+
+#define preempt_disable()				\
+	do {						\
+		__preempt_count_add(PREEMPT_OFFSET);	\
+		barrier();				\
+	} while (0)
+
+#define preempt_enable_no_resched()			\
+	do {						\
+		barrier();				\
+		__preempt_count_sub(PREEMPT_OFFSET);	\
+	} while (0)
+
+#define preempt_enable()					\
+	do {							\
+		barrier();					\
+		if (__preempt_count_dec_and_test() &&		\
+		    need_resched())				\
+			preempt_schedule();			\
+	} while (0)
+
+#endif /* _ZHOS_PREEMPT_H */
@@ -0,0 +1,30 @@
+#ifndef _ZHOS_PROFILE_H
+#define _ZHOS_PROFILE_H
+
+#include <zhos/types.h>
+
+struct pt_regs;
+
+/*
+ * Sampling profiler (kernel/profile.c).  A timer on every CPU records
+ * where that CPU was interrupted, and the call chain that got it there,
+ * into the trace rings; tools/profile turns a dump of them into a
+ * symbolized flat profile and a flame graph.  A hardware counter's
+ * overflow can take the samples instead of the timer.
+ */
+
+/* Sample every online CPU @hz times a second.  Interrupts must be on. */
+int profile_start(unsigned int hz);
+/* Sample every online CPU every @period @event (PERF_COUNT_HW_*). */
+int profile_start_event(unsigned int event, u64 period);
+void profile_stop(void);
+
+/* Record where @regs was interrupted; for the counter overflow handler. */
+void profile_sample(const struct pt_regs *regs);
+
+/* Stop the profiler and dump the trace rings, if it was running. */
+void profile_dump(void);
+
+void profile_init(void);
+
+#endif /* _ZHOS_PROFILE_H */
@@ -0,0 +1,69 @@
+#ifndef _ZHOS_RADIX_TREE_H
+#define _ZHOS_RADIX_TREE_H
+
+#include <zhos/types.h>
+
+/*
+ * A radix tree maps unsigned long indices to pointers, RADIX_TREE_MAP_SHIFT
+ * bits of the index per level, and grows only as tall as the largest
+ * index needs.  Every entry can carry RADIX_TREE_MAX_TAGS tag bits, which
+ * are summarised up the tree so that tagged entries are found without
+ * visiting the rest.
+ *
+ * The caller serialises all access; nodes come from a slab cache, so an
+ * insertion may fail with -ENOMEM but never sleeps.
+ */
+#define RADIX_TREE_MAP_SHIFT	6
+#define RADIX_TREE_MAP_SIZE	(1UL << RADIX_TREE_MAP_SHIFT)
+#define RADIX_TREE_MAP_MASK	(RADIX_TREE_MAP_SIZE - 1)
+#define RADIX_TREE_MAX_TAGS	2
+
+struct radix_tree_node;
+
+struct radix_tree_root {
+	unsigned int height;		/* 0: empty */
+	unsigned int tags;		/* tags set anywhere in the tree */
+	struct radix_tree_node *rnode;
+};
+
+#define RADIX_TREE_INIT		{ .height = 0, .tags = 0, .rnode = NULL }
+
+static inline void INIT_RADIX_TREE(struct radix_tree_root *root)
+{
+	root->height = 0;
+	root->tags = 0;
+	root->rnode = NULL;
+}
+
+/* -EEXIST if @index is taken. */
+int radix_tree_insert(struct radix_tree_root *root, unsigned long index,
+		      void *item);
+void *radix_tree_lookup(struct radix_tree_root *root, unsigned long index);
+/* Returns the entry removed, with its tags, or NULL. */
+void *radix_tree_delete(struct radix_tree_root *root, unsigned long index);
+
+/* The entry at @index must exist. */
+void radix_tree_tag_set(struct radix_tree_root *root, unsigned long index,
+			unsigned int tag);
+void radix_tree_tag_clear(struct radix_tree_root *root, unsigned long index,
+			  unsigned int tag);
+bool radix_tree_tag_get(struct radix_tree_root *root, unsigned long index,
+			unsigned int tag);
+
+static inline bool radix_tree_tagged(const struct radix_tree_root *root,
+				     unsigned int tag)
+{
+	return root->tags & (1U << tag);
+}
+
+/* Up to @max entries from @first on, in index order; returns how many. */
+unsigned int radix_tree_gang_lookup(struct radix_tree_root *root,
+				    void **results, unsigned long first,
+				    unsigned int max);
+unsigned int radix_tree_gang_lookup_tag(struct radix_tree_root *root,
+					void **results, unsigned long first,
+					unsigned int max, unsigned int tag);
+
+void radix_tree_init(void);
+
+#endif /* _ZHOS_RADIX_TREE_H */
@@ -0,0 +1,76 @@
+#ifndef _ZHOS_RCULIST_H
+#define _ZHOS_RCULIST_H
+
+#include <zhos/list.h>
+#include <zhos/rcupdate.h>
+
+/*
+ * Lists walked under rcu_read_lock() while writers, serialised by a lock
+ * of their own, add and remove entries.  An entry is made complete before
+ * it is linked in, and a removed entry keeps its ->next so that a reader
+ * standing on it can walk on; it may only be reused or freed after a
+ * grace period.
+ */
+static inline void __list_add_rcu(struct list_head *new, struct list_head *prev,
+				  struct list_head *next)
+{
+	new->next = next;
+	new->prev = prev;
+	rcu_assign_pointer(prev->next, new);
+	next->prev = new;
+}
+
+static inline void list_add_rcu(struct list_head *new, struct list_head *head)
+{
+	__list_add_rcu(new, head, head->next);
+}
+
+static inline void list_add_tail_rcu(struct list_head *new,
+				     struct list_head *head)
+{
+	__list_add_rcu(new, head->prev, head);
+}
+
+static inline void list_del_rcu(struct list_head *entry)
+{
+	entry->next->prev = entry->prev;
+	WRITE_ONCE(entry->prev->next, entry->next);
+}
+
+#define list_for_each_entry_rcu(pos, head, member)			\
+	for (pos = list_entry(rcu_dereference((head)->next),		\
+			      __typeof__(*pos), member);		\
+	     &pos->member != (head);					\
+	     pos = list_entry(rcu_dereference(pos->member.next),	\
+			      __typeof__(*pos), member))
+
+static inline void hlist_add_head_rcu(struct hlist_node *n,
+				      struct hlist_head *h)
+{
+	struct hlist_node *first = h->first;
+
+	n->next = first;
+	n->pprev = &h->first;
+	rcu_assign_pointer(h->first, n);
+	if (first)
+		first->pprev = &n->next;
+}
+
+static inline void hlist_del_rcu(struct hlist_node *n)
+{
+	struct hlist_node *next = n->next;
+
+	WRITE_ONCE(*n->pprev, next);
+	if (next)
+		next->pprev = n->pprev;
+	n->pprev = NULL;
+}
+
+#define hlist_for_each_entry_rcu(pos, head, member)			\
+	for (pos = hlist_entry_safe(rcu_dereference((head)->first),	\
+				    __typeof__(*(pos)), member);	\
+	     pos;							\
+	     pos = hlist_entry_safe(rcu_dereference((pos)->member.next), \
+				    __typeof__(*(pos)), member))
+
+#endif /* _ZHOS_RCULIST_H */
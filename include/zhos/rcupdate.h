@@ -0,0 +1,81 @@
+#ifndef _ZHOS_RCUPDATE_H
+#define _ZHOS_RCUPDATE_H
+
+#include <zhos/compiler.h>
+#include <zhos/kernel.h>
+#include <zhos/preempt.h>
+#include <asm/barrier.h>
+
+/*
+ * Read-copy-update (kernel/rcu/tree.c).
+ *
+ * Readers bracket their accesses with rcu_read_lock()/rcu_read_unlock(),
+ * which only disable preemption: no lock, no atomic, nothing written but
+ * this CPU's preempt count.  Writers serialise among themselves, publish
+ * new versions with rcu_assign_pointer() and free old ones after a grace
+ * period, by which time every CPU has passed through a quiescent state -
+ * a context switch, a tick outside any read-side section, or idle - and
+ * so cannot still hold a reference.  Read-side sections must not sleep.
+ */
+struct rcu_head {
+	struct rcu_head *next;
+	void (*func)(struct rcu_head *head);
+};
+
+typedef void (*rcu_callback_t)(struct rcu_head *head);
+
+static __always_inline void rcu_read_lock(void)
+{
+	preempt_disable();
+}
+
+static __always_inline void rcu_read_unlock(void)
+{
+	preempt_enable();
+}
+
+/*
+ * x86 does not reorder dependent loads, so fetching the pointer once is
+ * all a reader needs; publishing orders the initialisation before it.
+ */
+#define rcu_dereference(p)		READ_ONCE(p)
+/* Writer side, with @c the lock that makes the plain access safe. */
+#define rcu_dereference_protected(p, c)	(p)
+
+#define rcu_assign_pointer(p, v)			\
+	do {						\
+		smp_wmb();				\
+		WRITE_ONCE(p, v);			\
+	} while (0)
+
+/* No readers yet, or @v is NULL: nothing to order. */
+#define RCU_INIT_POINTER(p, v)		WRITE_ONCE(p, v)
+
+/*
+ * Run @func after a grace period, from RCU_SOFTIRQ on the CPU that
+ * queued it: in softirq context, so it must not sleep.
+ */
+void call_rcu(struct rcu_head *head, rcu_callback_t func);
+/* Sleep until a grace period has elapsed. */
+void synchronize_rcu(void);
+
+/*
+ * kfree() @ptr after a grace period.  The callback is the offset of the
+ * rcu_head in the object, which cannot be mistaken for a function.
+ */
+#define __is_kfree_rcu_offset(off)	((unsigned long)(off) < 4096)
+#define kfree_rcu(ptr, rhf)						\
+	call_rcu(&(ptr)->rhf, (rcu_callback_t)(unsigned long)		\
+		 offsetof(__typeof__(*(ptr)), rhf))
+
+/* Quiescent states and idle, from the scheduler, tick and interrupts. */
+void rcu_note_context_switch(void);
+void rcu_sched_clock_irq(void);
+void rcu_idle_enter(void);
+void rcu_idle_exit(void);
+void rcu_irq_enter(void);
+void rcu_irq_exit(void);
+
+void rcu_init(void);
+
+#endif /* _ZHOS_RCUPDATE_H */
@@ -0,0 +1,101 @@
+#ifndef _ZHOS_SCHED_H
+#define _ZHOS_SCHED_H
+
+#include <zhos/compiler.h>
+#include <zhos/cpumask.h>
+#include <zhos/list.h>
+#include <zhos/preempt.h>
+#include <zhos/types.h>
+#include <asm/current.h>
+#include <asm/fpu.h>
+#include <asm/perf_event.h>
+
+/* Task states. */
+#define TASK_RUNNING		0
+#define TASK_INTERRUPTIBLE	1
+#define TASK_UNINTERRUPTIBLE	2
+#define TASK_DEAD		64
+
+/* Task flags. */
+#define PF_IDLE			0x00000002
+#define PF_KTHREAD		0x00200000
+
+/*
+ * Priorities run from 0 (highest) to MAX_PRIO - 1; each has a FIFO list
+ * in the run queue and a bit in its bitmap.  Equal priorities share the
+ * CPU round-robin, one time slice each.
+ */
+#define MAX_PRIO		64
+#define DEFAULT_PRIO		(MAX_PRIO / 2)
+
+#define THREAD_SIZE		(16 * 1024)
+#define TASK_COMM_LEN		16
+
+struct blk_plug;
+struct mm_struct;
+
+struct thread_struct {
+	unsigned long sp;	/* saved by __switch_to_asm() */
+	struct fpu fpu;
+	struct perf_thread perf;
+};
+
+struct task_struct {
+	struct thread_struct thread;	/* first: entry_64.S uses offset 0 */
+	volatile long state;
+	unsigned int flags;
+	int pid;			/* 0 for the idle tasks */
+	int prio;
+	int time_slice;			/* ticks left */
+	unsigned int cpu;		/* run queue it is on or last ran on */
+	bool on_rq;			/* runnable: queued or running */
+	bool on_cpu;			/* still running on the stack */
+	struct cpumask cpus_allowed;
+	struct list_head run_list;
+	void *stack;
+	int exit_code;
+	u64 nvcsw, nivcsw;		/* voluntary, involuntary switches */
+	struct blk_plug *plug;		/* block requests held back */
+	struct mm_struct *mm;		/* NULL: runs on init_mm */
+	char comm[TASK_COMM_LEN];
+};
+
+#define set_current_state(s)	__atomic_store_n(&current->state, (s), __ATOMIC_SEQ_CST)
+#define __set_current_state(s)	WRITE_ONCE(current->state, (s))
+
+void sched_init(void);
+void init_idle(unsigned int cpu);
+
+void schedule(void);
+void schedule_preempt_disabled(void);
+void preempt_schedule_irq(void);
+void yield(void);
+void scheduler_tick(void);
+void schedule_tail(struct task_struct *prev);
+
+bool wake_up_process(struct task_struct *p);
+void sched_set_prio(struct task_struct *p, int prio);
+
+/* Sleep up to @timeout jiffies; returns the jiffies left if woken early. */
+long schedule_timeout(long timeout);
+#define MAX_SCHEDULE_TIMEOUT	((long)(~0UL >> 1))
+
+void __noreturn do_exit(int code);
+
+/* Tasks and their stacks (kernel/fork.c). */
+struct task_struct *alloc_task(void);
+void free_task(struct task_struct *p);
+void fork_init(void);
+
+/*
+ * A task running @fn(@data) in a copy-on-write copy of the caller's
+ * address space; created asleep, as kthread_create() does.
+ */
+struct task_struct *kernel_fork(int (*fn)(void *), void *data,
+				const char *name);
+/* Leave the current address space for init_mm; from do_exit(). */
+void exit_mm(void);
+
+void __noreturn cpu_idle_loop(void);
+
+#endif /* _ZHOS_SCHED_H */
@@ -0,0 +1,46 @@
+#ifndef _ZHOS_SEQLOCK_H
+#define _ZHOS_SEQLOCK_H
+
+#include <zhos/compiler.h>
+#include <asm/barrier.h>
+#include <asm/processor.h>
+
+/*
+ * Sequence counter for data that is read far more often than written.
+ * Readers never block the writer; they retry if a write overlapped.
+ * Writers must be serialised and must not be interrupted by readers on
+ * the same CPU (write with interrupts disabled).
+ */
+typedef struct {
+	unsigned int sequence;
+} seqcount_t;
+
+static inline unsigned int read_seqcount_begin(const seqcount_t *s)
+{
+	unsigned int seq;
+
+	while ((seq = READ_ONCE(s->sequence)) & 1)
+		cpu_relax();
+	smp_rmb();
+	return seq;
+}
+
+static inline bool read_seqcount_retry(const seqcount_t *s, unsigned int start)
+{
+	smp_rmb();
+	return READ_ONCE(s->sequence) != start;
+}
+
+static inline void write_seqcount_begin(seqcount_t *s)
+{
+	WRITE_ONCE(s->sequence, s->sequence + 1);
+	smp_wmb();
+}
+
+static inline void write_seqcount_end(seqcount_t *s)
+{
+	smp_wmb();
+	WRITE_ONCE(s->sequence, s->sequence + 1);
+}
+
+#endif /* _ZHOS_SEQLOCK_H */
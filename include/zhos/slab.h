@@ -0,0 +1,55 @@
+#ifndef _ZHOS_SLAB_H
+#define _ZHOS_SLAB_H
+
+#include <zhos/gfp.h>
+#include <zhos/types.h>
+
+struct kmem_cache;
+
+/* kmem_cache_create() flags. */
+#define SLAB_HWCACHE_ALIGN	0x00002000UL	/* align objects to cache lines */
+#define SLAB_PANIC		0x00040000UL	/* panic if creation fails */
+#define SLAB_NO_MAGAZINE	0x00100000UL	/* no per-CPU layer, always locked */
+
+/*
+ * A cache of equally sized objects.  @ctor, if given, runs once per
+ * object when its slab is created, and a freed object must be returned
+ * in its constructed state.
+ */
+struct kmem_cache *kmem_cache_create(const char *name, size_t size,
+				     size_t align, unsigned long flags,
+				     void (*ctor)(void *));
+void kmem_cache_destroy(struct kmem_cache *s);
+
+void *kmem_cache_alloc(struct kmem_cache *s, gfp_t gfp);
+void kmem_cache_free(struct kmem_cache *s, void *obj);
+
+static inline void *kmem_cache_zalloc(struct kmem_cache *s, gfp_t gfp)
+{
+	return kmem_cache_alloc(s, gfp | __GFP_ZERO);
+}
+
+/* Return free slabs and the depot's magazines to the page allocator. */
+void kmem_cache_shrink(struct kmem_cache *s);
+
+/* Power-of-two-ish size classes up to KMALLOC_MAX_CACHE_SIZE, pages above. */
+#define KMALLOC_MAX_CACHE_SIZE	8192
+
+void *kmalloc(size_t size, gfp_t gfp);
+void kfree(const void *obj);
+
+static inline void *kzalloc(size_t size, gfp_t gfp)
+{
+	return kmalloc(size, gfp | __GFP_ZERO);
+}
+
+static inline void *kcalloc(size_t n, size_t size, gfp_t gfp)
+{
+	if (size && n > (size_t)-1 / size)
+		return NULL;
+	return kzalloc(n * size, gfp);
+}
+
+void kmem_cache_init(void);
+
+#endif /* _ZHOS_SLAB_H */
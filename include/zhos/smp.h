@@ -0,0 +1,26 @@
+#ifndef _ZHOS_SMP_H
+#define _ZHOS_SMP_H
+
+#include <zhos/cpumask.h>
+#include <zhos/percpu.h>
+
+DECLARE_PER_CPU(unsigned int, cpu_number);
+
+#define smp_processor_id()	this_cpu_read(cpu_number)
+
+void boot_cpu_init(void);
+
+/* Bring up the CPUs found by setup_arch(); called once, from CPU 0. */
+void smp_init(void);
+
+/* Interrupt @cpu so that it re-evaluates what to do next. */
+void smp_send_reschedule(unsigned int cpu);
+
+/* Run @func(@info) on every other online CPU and wait for them all. */
+void smp_call_function(void (*func)(void *info), void *info);
+
+/* The same, on just the online CPUs in @mask other than this one. */
+void smp_call_function_many(const struct cpumask *mask,
+			    void (*func)(void *info), void *info);
+
+#endif /* _ZHOS_SMP_H */
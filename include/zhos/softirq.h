@@ -0,0 +1,34 @@
+#ifndef _ZHOS_SOFTIRQ_H
+#define _ZHOS_SOFTIRQ_H
+
+/*
+ * Deferred interrupt work (kernel/softirq.c).  A handler does what the
+ * device needs at once and raises a vector; the vector's action runs on
+ * the same CPU with interrupts enabled, on the way out of the outermost
+ * interrupt, or in that CPU's ksoftirqd when there is more than one pass
+ * can take.  Actions run in the order below and must not sleep.
+ */
+enum {
+	TIMER_SOFTIRQ,
+	NET_RX_SOFTIRQ,
+	BLOCK_SOFTIRQ,
+	RCU_SOFTIRQ,
+	NR_SOFTIRQS,
+};
+
+void open_softirq(unsigned int nr, void (*action)(void));
+
+/* On this CPU; the _irqoff variant with interrupts already disabled. */
+void raise_softirq_irqoff(unsigned int nr);
+void raise_softirq(unsigned int nr);
+
+/* On @cpu, which is interrupted to run it if that is not this CPU. */
+void raise_softirq_on(unsigned int cpu, unsigned int nr);
+
+/* From the interrupt exit path, interrupts disabled. */
+void irq_exit_softirq(void);
+
+/* Start the ksoftirqd threads; after SMP bring-up. */
+void softirq_init(void);
+
+#endif /* _ZHOS_SOFTIRQ_H */
@@ -0,0 +1,182 @@
+#ifndef _ZHOS_SPINLOCK_H
+#define _ZHOS_SPINLOCK_H
+
+#include <zhos/compiler.h>
+#include <zhos/preempt.h>
+#include <zhos/types.h>
+#include <asm/irqflags.h>
+#include <asm/processor.h>
+
+/*
+ * Queued spinlocks.  An uncontended lock is one compare-and-exchange on
+ * a 32-bit word, whose low byte says it is held.  A CPU that finds it
+ * taken queues behind the others in an MCS list of per-CPU nodes, whose
+ * tail is named in the word's upper half, and spins on a flag in its own
+ * node until its predecessor hands over; only the head of the queue
+ * watches the lock word.  Under contention each waiter therefore spins
+ * in its own cache line, and the lock goes round in arrival order.
+ *
+ * Holding a lock disables preemption; the _irq variants re-enable
+ * interrupts before preemption so a reschedule that became due meanwhile
+ * is taken on unlock.
+ *
+ * Built with CONFIG_LOCK_STAT=1, every lock also counts its acquisitions,
+ * contentions and the TSC cycles spent waiting, summed over all locks
+ * initialised at the same place (kernel/locking/lock_stat.c).
+ */
+struct lock_class;
+
+typedef struct {
+	union {
+		u32 val;
+		struct {
+			u8 locked;
+			u8 __pad;
+			u16 tail;	/* last waiter: (cpu + 1) << 2 | nesting */
+		};
+	};
+#if CONFIG_LOCK_STAT
+	struct lock_class *class;
+#endif
+} spinlock_t;
+
+#define _Q_LOCKED_VAL		1U
+
+#if CONFIG_LOCK_STAT
+struct lock_class {
+	const char *name;
+	u64 acquired, contended;
+	u64 wait_cycles, max_wait;
+	struct lock_class *next;	/* on lock_classes once used */
+	bool registered;
+};
+
+#define __LOCK_CLASS(lockname)	(&(struct lock_class){ .name = #lockname })
+#define __SPIN_LOCK_UNLOCKED(lockname)					\
+	{ .val = 0, .class = __LOCK_CLASS(lockname) }
+
+/* A class per call site, as Linux's lockdep keys them. */
+#define spin_lock_init(lock)						\
+do {									\
+	static struct lock_class __class = { .name = #lock };		\
+									\
+	__spin_lock_init(lock);						\
+	(lock)->class = &__class;					\
+} while (0)
+
+void lock_class_register(struct lock_class *class);
+void lock_stat_contended(spinlock_t *lock, u64 cycles);
+
+static __always_inline void lock_stat_acquired(spinlock_t *lock)
+{
+	struct lock_class *class = lock->class;
+
+	if (!class)
+		return;
+	if (unlikely(!READ_ONCE(class->registered)))
+		lock_class_register(class);
+	__atomic_add_fetch(&class->acquired, 1, __ATOMIC_RELAXED);
+}
+#else
+#define __SPIN_LOCK_UNLOCKED(lockname) { .val = 0 }
+#define spin_lock_init(lock)	__spin_lock_init(lock)
+
+static __always_inline void lock_stat_acquired(spinlock_t *lock)
+{
+}
+
+static inline void lock_stat_contended(spinlock_t *lock, u64 cycles)
+{
+}
+#endif
+
+#define DEFINE_SPINLOCK(name)	spinlock_t name = __SPIN_LOCK_UNLOCKED(name)
+
+/* Print the lock classes by time spent waiting; a no-op without stats. */
+void lock_stat_dump(void);
+void lock_stat_reset(void);
+
+static inline void __spin_lock_init(spinlock_t *lock)
+{
+	lock->val = 0;
+}
+
+void queued_spin_lock_slowpath(spinlock_t *lock);
+
+static __always_inline bool __spin_trylock(spinlock_t *lock)
+{
+	u32 val = 0;
+
+	return __atomic_compare_exchange_n(&lock->val, &val, _Q_LOCKED_VAL,
+					   false, __ATOMIC_ACQUIRE,
+					   __ATOMIC_RELAXED);
+}
+
+static __always_inline void __spin_lock(spinlock_t *lock)
+{
+	if (likely(__spin_trylock(lock)))
+		lock_stat_acquired(lock);
+	else
+		queued_spin_lock_slowpath(lock);
+}
+
+static __always_inline void __spin_unlock(spinlock_t *lock)
+{
+	__atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+static inline void spin_lock(spinlock_t *lock)
+{
+	preempt_disable();
+	__spin_lock(lock);
+}
+
+static inline bool spin_trylock(spinlock_t *lock)
+{
+	preempt_disable();
+	if (__spin_trylock(lock)) {
+		lock_stat_acquired(lock);
+		return true;
+	}
+	preempt_enable();
+	return false;
+}
+
+static inline void spin_unlock(spinlock_t *lock)
+{
+	__spin_unlock(lock);
+	preempt_enable();
+}
+
+static inline bool spin_is_locked(spinlock_t *lock)
+{
+	return READ_ONCE(lock->val);
+}
+
+#define spin_lock_irqsave(lock, flags)			\
+	do {						\
+		(flags) = local_irq_save();		\
+		spin_lock(lock);			\
+	} while (0)
+
+static inline void spin_unlock_irqrestore(spinlock_t *lock, unsigned long flags)
+{
+	__spin_unlock(lock);
+	local_irq_restore(flags);
+	preempt_enable();
+}
+
+static inline void spin_lock_irq(spinlock_t *lock)
+{
+	local_irq_disable();
+	spin_lock(lock);
+}
+
+static inline void spin_unlock_irq(spinlock_t *lock)
+{
+	__spin_unlock(lock);
+	local_irq_enable();
+	preempt_enable();
+}
+
+#endif /* _ZHOS_SPINLOCK_H */
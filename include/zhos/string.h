@@ -0,0 +1,25 @@
+#ifndef _ZHOS_STRING_H
+#define _ZHOS_STRING_H
+
+#include <zhos/types.h>
+
+void *memcpy(void *dst, const void *src, size_t n);
+void *memmove(void *dst, const void *src, size_t n);
+void *memset(void *s, int c, size_t n);
+int memcmp(const void *a, const void *b, size_t n);
+
+/* The portable versions, which the arch may pick for the above. */
+void *memcpy_generic(void *dst, const void *src, size_t n);
+void *memset_generic(void *s, int c, size_t n);
+int memcmp_generic(const void *a, const void *b, size_t n);
+
+size_t strlen(const char *s);
+size_t strnlen(const char *s, size_t max);
+int strcmp(const char *a, const char *b);
+int strncmp(const char *a, const char *b, size_t n);
+char *strchr(const char *s, int c);
+size_t strlcpy(char *dst, const char *src, size_t size);
+
+unsigned long long simple_strtoull(const char *s, char **end, unsigned int base);
+
+#endif /* _ZHOS_STRING_H */
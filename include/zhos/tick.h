@@ -0,0 +1,21 @@
+#ifndef _ZHOS_TICK_H
+#define _ZHOS_TICK_H
+
+#include <zhos/types.h>
+
+struct clock_event_device;
+
+void tick_check_new_device(struct clock_event_device *dev);
+
+/*
+ * Called by the idle loop with interrupts disabled.  While idle the
+ * periodic tick is replaced by one-shot events at the next deadline.
+ */
+void tick_nohz_idle_enter(void);
+void tick_nohz_idle_exit(void);
+
+void wake_up_nohz_cpu(unsigned int cpu);
+
+void tick_nohz_init(void);
+
+#endif /* _ZHOS_TICK_H */
@@ -0,0 +1,42 @@
+#ifndef _ZHOS_TIME_H
+#define _ZHOS_TIME_H
+
+#include <zhos/kernel.h>
+#include <zhos/types.h>
+
+typedef int clockid_t;
+
+#define CLOCK_REALTIME		0
+#define CLOCK_MONOTONIC		1
+
+struct timespec64 {
+	s64 tv_sec;
+	long tv_nsec;
+};
+
+struct timeval {
+	s64 tv_sec;
+	long tv_usec;
+};
+
+static inline void ns_to_timespec64(u64 ns, struct timespec64 *ts)
+{
+	ts->tv_sec = ns / NSEC_PER_SEC;
+	ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+static inline void ns_to_timeval(u64 ns, struct timeval *tv)
+{
+	tv->tv_sec = ns / NSEC_PER_SEC;
+	tv->tv_usec = ns % NSEC_PER_SEC / NSEC_PER_USEC;
+}
+
+/* Seconds since 1970-01-01 00:00:00 UTC; @mon is 1-12, @day 1-31. */
+s64 mktime64(unsigned int year, unsigned int mon, unsigned int day,
+	     unsigned int hour, unsigned int min, unsigned int sec);
+
+/* What clock_gettime() and gettimeofday() do inside the kernel. */
+int do_clock_gettime(clockid_t which, struct timespec64 *ts);
+int do_gettimeofday(struct timeval *tv);
+
+#endif /* _ZHOS_TIME_H */
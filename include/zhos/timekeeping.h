@@ -0,0 +1,23 @@
+#ifndef _ZHOS_TIMEKEEPING_H
+#define _ZHOS_TIMEKEEPING_H
+
+#include <zhos/types.h>
+
+/* Monotonic nanoseconds since boot, from the best registered clocksource. */
+u64 clock_now_ns(void);
+
+/* Nanoseconds since the epoch: clock_now_ns() plus the boot-time offset. */
+u64 clock_real_ns(void);
+
+/* Set CLOCK_REALTIME; called once from the RTC at boot. */
+void timekeeping_set_wall(u64 real_ns);
+
+/* Fold elapsed cycles into the base; called from the tick. */
+void timekeeping_update(void);
+
+/* How long the clocksource may go unread; tickless idle sleeps no longer. */
+u64 timekeeping_max_idle_ns(void);
+
+const char *current_clocksource_name(void);
+
+#endif /* _ZHOS_TIMEKEEPING_H */
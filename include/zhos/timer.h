@@ -0,0 +1,57 @@
+#ifndef _ZHOS_TIMER_H
+#define _ZHOS_TIMER_H
+
+#include <zhos/compiler.h>
+#include <zhos/list.h>
+#include <zhos/types.h>
+
+/*
+ * A kernel timer runs @function in softirq context once jiffies reaches
+ * @expires.  Timers live on the wheel of one CPU, recorded in @flags.
+ */
+struct timer_list {
+	struct hlist_node entry;
+	u64 expires;
+	void (*function)(struct timer_list *);
+	u32 flags;
+	u32 idx;		/* wheel slot, valid while pending */
+};
+
+#define TIMER_CPUMASK		0x0000ffff
+#define TIMER_MIGRATING		0x00010000
+#define TIMER_PINNED		0x00020000	/* never moved by mod_timer() */
+
+#define __TIMER_INITIALIZER(_function, _flags) {	\
+	.entry = { NULL, NULL },			\
+	.function = (_function),			\
+	.flags = (_flags),				\
+}
+
+#define DEFINE_TIMER(_name, _function) \
+	struct timer_list _name = __TIMER_INITIALIZER(_function, 0)
+
+#define from_timer(var, timer, field) \
+	container_of(timer, __typeof__(*var), field)
+
+void timer_setup(struct timer_list *timer,
+		 void (*function)(struct timer_list *), u32 flags);
+
+static inline bool timer_pending(const struct timer_list *timer)
+{
+	return !hlist_unhashed(&timer->entry);
+}
+
+void add_timer(struct timer_list *timer);
+void add_timer_on(struct timer_list *timer, unsigned int cpu);
+int mod_timer(struct timer_list *timer, u64 expires);
+int del_timer(struct timer_list *timer);
+int del_timer_sync(struct timer_list *timer);
+
+/* Tick interface. */
+void run_local_timers(void);
+u64 get_next_timer_interrupt(u64 basej);
+
+void init_timers(void);
+void init_timers_cpu(unsigned int cpu);
+
+#endif /* _ZHOS_TIMER_H */
@@ -0,0 +1,42 @@
+#ifndef _ZHOS_TRACE_H
+#define _ZHOS_TRACE_H
+
+/*
+ * Static tracepoints writing fixed-size binary records into a ring per
+ * CPU (kernel/trace/ring_buffer.c).  While tracing is off each one costs
+ * a load and a not-taken branch.
+ */
+#include <zhos/compiler.h>
+#include <zhos/trace_event.h>
+#include <zhos/types.h>
+
+extern bool tracing_enabled;
+
+void __trace_event(unsigned int type, u64 a, u64 b);
+
+static __always_inline void trace_event(unsigned int type, u64 a, u64 b)
+{
+	if (unlikely(READ_ONCE(tracing_enabled)))
+		__trace_event(type, a, b);
+}
+
+#define trace_sched_switch(prev, next)					\
+	trace_event(TRACE_SCHED_SWITCH,					\
+		    (prev)->pid | (u64)(u32)(prev)->state << 32, (next)->pid)
+#define trace_sched_wakeup(p, cpu)	trace_event(TRACE_SCHED_WAKEUP, (p)->pid, cpu)
+#define trace_sched_migrate(p, from)	trace_event(TRACE_SCHED_MIGRATE, (p)->pid, from)
+#define trace_irq_entry(vector)		trace_event(TRACE_IRQ_ENTRY, vector, 0)
+#define trace_irq_exit(vector)		trace_event(TRACE_IRQ_EXIT, vector, 0)
+#define trace_sys_enter(nr, arg0)	trace_event(TRACE_SYS_ENTER, nr, arg0)
+#define trace_sys_exit(nr, ret)		trace_event(TRACE_SYS_EXIT, nr, ret)
+#define trace_mark(a, b)		trace_event(TRACE_MARK, a, b)
+
+void tracing_on(void);
+void tracing_off(void);
+
+/* Stop tracing and write every CPU's records to the console. */
+void trace_dump(void);
+
+void trace_init(void);
+
+#endif /* _ZHOS_TRACE_H */
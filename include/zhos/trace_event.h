@@ -0,0 +1,50 @@
+#ifndef _ZHOS_TRACE_EVENT_H
+#define _ZHOS_TRACE_EVENT_H
+
+/*
+ * Trace record layout, shared with tools/tracedump: keep it free of
+ * kernel-only headers.  Records never change size; an event that needs
+ * more than two arguments needs two records.
+ */
+#include <zhos/types.h>
+
+enum trace_event_type {
+	TRACE_NONE,
+	TRACE_SCHED_SWITCH,	/* a: prev pid | prev state << 32, b: next pid */
+	TRACE_SCHED_WAKEUP,	/* a: pid, b: target cpu */
+	TRACE_SCHED_MIGRATE,	/* a: pid, b: cpu it was stolen from */
+	TRACE_IRQ_ENTRY,	/* a: vector */
+	TRACE_IRQ_EXIT,		/* a: vector */
+	TRACE_SYS_ENTER,	/* a: syscall number, b: first argument */
+	TRACE_SYS_EXIT,		/* a: syscall number, b: return value */
+	TRACE_MARK,		/* a, b: whatever the caller wants */
+	TRACE_PROFILE_SAMPLE,	/* a: interrupted rip, b: return addresses */
+	TRACE_PROFILE_STACK,	/* a, b: the next two of them, 0 past the end */
+	NR_TRACE_EVENTS
+};
+
+struct trace_entry {
+	u64 ts;			/* clock_now_ns() */
+	u16 type;
+	u16 cpu;
+	u32 pid;		/* current task, 0 for idle */
+	u64 a;
+	u64 b;
+};
+
+#define TRACE_ENTRY_SIZE	32
+
+_Static_assert(sizeof(struct trace_entry) == TRACE_ENTRY_SIZE,
+	       "trace records are fixed-size");
+
+/*
+ * Console dump framing.  Between the begin and end lines, a "C" line per
+ * CPU gives its number and how many records it has written since boot,
+ * and is followed by a "T" line per record still in its ring, oldest
+ * first: the fields in order, as fixed-width hex.
+ */
+#define TRACE_DUMP_BEGIN	"trace: begin"
+#define TRACE_DUMP_END		"trace: end"
+#define TRACE_DUMP_FMT		"T %016llx %04x %04x %08x %016llx %016llx"
+
+#endif /* _ZHOS_TRACE_EVENT_H */
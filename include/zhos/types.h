@@ -0,0 +1,25 @@
+#ifndef _ZHOS_TYPES_H
+#define _ZHOS_TYPES_H
+
+#ifndef __ASSEMBLY__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+typedef uint8_t		u8;
+typedef uint16_t	u16;
+typedef uint32_t	u32;
+typedef uint64_t	u64;
+typedef int8_t		s8;
+typedef int16_t		s16;
+typedef int32_t		s32;
+typedef int64_t		s64;
+
+typedef u64		phys_addr_t;
+typedef long		ssize_t;
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* _ZHOS_TYPES_H */
@@ -0,0 +1,39 @@
+#ifndef _ZHOS_VDSO_H
+#define _ZHOS_VDSO_H
+
+#include <zhos/seqlock.h>
+#include <zhos/time.h>
+#include <zhos/types.h>
+
+/*
+ * The vDSO data page.
+ *
+ * The timekeeper publishes its state here each time it folds in elapsed
+ * cycles: the same base, remainder and mult/shift that clock_now_ns()
+ * uses, so that a reader with nothing but this page and rdtsc computes
+ * exactly the kernel's time.  The page is a page of its own (the .vvar
+ * section), written only by the kernel and meant to be mapped read-only
+ * into user address spaces next to the vDSO code in arch/x86/vdso/.
+ */
+#define VDSO_CLOCKMODE_NONE	0	/* no user-readable counter: call in */
+#define VDSO_CLOCKMODE_TSC	1
+
+struct vdso_data {
+	seqcount_t seq;
+	s32 clock_mode;
+	u64 cycle_last;
+	u64 mask;
+	u32 mult;
+	u32 shift;
+	u64 base_ns;		/* CLOCK_MONOTONIC at cycle_last */
+	u64 base_frac;		/* remainder, in ns << shift */
+	u64 offs_real;		/* CLOCK_REALTIME - CLOCK_MONOTONIC */
+};
+
+extern struct vdso_data vdso_data;
+
+/* The vDSO entry points. */
+int __vdso_clock_gettime(clockid_t clock, struct timespec64 *ts);
+int __vdso_gettimeofday(struct timeval *tv, void *tz);
+
+#endif /* _ZHOS_VDSO_H */
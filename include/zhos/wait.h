@@ -0,0 +1,92 @@
+#ifndef _ZHOS_WAIT_H
+#define _ZHOS_WAIT_H
+
+#include <zhos/list.h>
+#include <zhos/sched.h>
+#include <zhos/spinlock.h>
+
+/*
+ * Wait queues: a task sleeps on one until some condition holds, and
+ * whoever makes it hold calls wake_up().  The waiter sets its state
+ * before testing the condition, so a wake-up between the test and
+ * schedule() is never lost; wake_up() may be called from interrupts.
+ */
+struct wait_queue_entry {
+	struct task_struct *task;
+	struct list_head entry;
+};
+
+struct wait_queue_head {
+	spinlock_t lock;
+	struct list_head head;
+};
+
+#define __WAIT_QUEUE_HEAD_INITIALIZER(name) {			\
+	.lock = __SPIN_LOCK_UNLOCKED(name.lock),		\
+	.head = LIST_HEAD_INIT((name).head),			\
+}
+
+#define DECLARE_WAIT_QUEUE_HEAD(name) \
+	struct wait_queue_head name = __WAIT_QUEUE_HEAD_INITIALIZER(name)
+
+#define DEFINE_WAIT(name)					\
+	struct wait_queue_entry name = {			\
+		.task = current,				\
+		.entry = LIST_HEAD_INIT((name).entry),		\
+	}
+
+static inline void init_waitqueue_head(struct wait_queue_head *wq)
+{
+	spin_lock_init(&wq->lock);
+	INIT_LIST_HEAD(&wq->head);
+}
+
+/*
+ * Unlocked peek for wakers that have just changed the condition; the
+ * atomic operation that changed it orders the two.
+ */
+static inline bool waitqueue_active(struct wait_queue_head *wq)
+{
+	return !list_empty(&wq->head);
+}
+
+void prepare_to_wait(struct wait_queue_head *wq, struct wait_queue_entry *wait,
+		     long state);
+void finish_wait(struct wait_queue_head *wq, struct wait_queue_entry *wait);
+/* Wake every waiter. */
+void wake_up(struct wait_queue_head *wq);
+
+#define wait_event(wq, condition)					\
+do {									\
+	DEFINE_WAIT(__wait);						\
+									\
+	for (;;) {							\
+		prepare_to_wait(&(wq), &__wait, TASK_UNINTERRUPTIBLE);	\
+		if (condition)						\
+			break;						\
+		schedule();						\
+	}								\
+	finish_wait(&(wq), &__wait);					\
+} while (0)
+
+/* Returns the jiffies left, at least 1, or 0 if @timeout ran out. */
+#define wait_event_timeout(wq, condition, timeout)			\
+({									\
+	long __ret = (timeout);						\
+	DEFINE_WAIT(__wait);						\
+									\
+	for (;;) {							\
+		prepare_to_wait(&(wq), &__wait, TASK_UNINTERRUPTIBLE);	\
+		if (condition) {					\
+			__ret = __ret ? __ret : 1;			\
+			break;						\
+		}							\
+		if (!__ret)						\
+			break;						\
+		__ret = schedule_timeout(__ret);			\
+	}								\
+	finish_wait(&(wq), &__wait);					\
+	__ret;								\
+})
+
+#endif /* _ZHOS_WAIT_H */
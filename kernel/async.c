@@ -0,0 +1,89 @@
+/*
+ * Asynchronous boot-time work.
+ *
+ * Probing a device mostly waits for it: resets, link negotiation,
+ * feature handshakes.  Devices that do not depend on each other are
+ * probed in threads of their own, spread round the online CPUs so that
+ * they run side by side rather than take turns on the CPU that booted.
+ * Whatever cannot get a thread runs inline instead, so the work is done
+ * either way.
+ */
+#define pr_fmt(fmt) "async: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/async.h>
+#include <zhos/cpumask.h>
+#include <zhos/gfp.h>
+#include <zhos/kthread.h>
+#include <zhos/sched.h>
+#include <zhos/slab.h>
+#include <zhos/wait.h>
+
+struct async_entry {
+	async_func_t fn;
+	void *data;
+};
+
+static unsigned long async_pending;
+static DECLARE_WAIT_QUEUE_HEAD(async_done);
+static int async_last_cpu = -1;
+
+static int async_thread(void *arg)
+{
+	struct async_entry *e = arg;
+
+	e->fn(e->data);
+	kfree(e);
+	if (!__atomic_sub_fetch(&async_pending, 1, __ATOMIC_SEQ_CST))
+		wake_up(&async_done);
+	return 0;
+}
+
+/* Round robin; async_schedule() is only called from one thread. */
+static unsigned int async_next_cpu(void)
+{
+	unsigned int cpu = cpumask_next(async_last_cpu, cpu_online_mask);
+
+	if (cpu >= NR_CPUS)
+		cpu = cpumask_next(-1, cpu_online_mask);
+	async_last_cpu = cpu;
+	return cpu;
+}
+
+/**
+ * async_schedule - run @fn(@data) in a thread of its own
+ * @fn: the work
+ * @data: its argument
+ * @name: for the thread's name, "async/@name"
+ */
+void async_schedule(async_func_t fn, void *data, const char *name)
+{
+	struct async_entry *e;
+	struct task_struct *p;
+
+	e = kmalloc(sizeof(*e), GFP_KERNEL);
+	if (!e)
+		goto inline_call;
+	e->fn = fn;
+	e->data = data;
+	p = kthread_create(async_thread, e, "async/%s", name);
+	if (!p) {
+		kfree(e);
+		goto inline_call;
+	}
+	kthread_bind(p, async_next_cpu());
+	__atomic_add_fetch(&async_pending, 1, __ATOMIC_SEQ_CST);
+	wake_up_process(p);
+	return;
+
+inline_call:
+	pr_warn("no thread for %s, running it inline\n", name);
+	fn(data);
+}
+
+/* Wait until everything scheduled so far has finished. */
+void async_synchronize_full(void)
+{
+	wait_event(async_done,
+		   !__atomic_load_n(&async_pending, __ATOMIC_SEQ_CST));
+}
@@ -0,0 +1,1197 @@
+/*
+ * Boot-time benchmarks.
+ *
+ * "bench" on the command line runs the suite in a thread on CPU 0 once
+ * all CPUs are up and prints one line per result; "bench=exit" then
+ * leaves QEMU through its isa-debug-exit port (see "make bench").  Times
+ * come from the TSC when it is the calibrated clocksource, otherwise from
+ * clock_now_ns(), and each line is stamped with the time of the run.
+ * With "profile" as well, the samples taken during the run are dumped
+ * when it ends (see tools/profile).
+ */
+#define pr_fmt(fmt) "bench: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/bench.h>
+#include <zhos/bio.h>
+#include <zhos/checksum.h>
+#include <zhos/blk-mq.h>
+#include <zhos/blkdev.h>
+#include <zhos/cmdline.h>
+#include <zhos/delay.h>
+#include <zhos/fs.h>
+#include <zhos/futex.h>
+#include <zhos/gfp.h>
+#include <zhos/huge_mm.h>
+#include <zhos/if_ether.h>
+#include <zhos/i8253.h>
+#include <zhos/initrd.h>
+#include <zhos/io_uring.h>
+#include <zhos/irq.h>
+#include <zhos/jiffies.h>
+#include <zhos/kthread.h>
+#include <zhos/mm.h>
+#include <zhos/mm_types.h>
+#include <zhos/pagemap.h>
+#include <zhos/perf_event.h>
+#include <zhos/profile.h>
+#include <zhos/rcupdate.h>
+#include <zhos/sched.h>
+#include <zhos/slab.h>
+#include <zhos/spinlock.h>
+#include <zhos/string.h>
+#include <zhos/time.h>
+#include <zhos/timekeeping.h>
+#include <zhos/timer.h>
+#include <zhos/vdso.h>
+#include <zhos/wait.h>
+#include <asm/io.h>
+#include <asm/irq.h>
+#include <asm/tsc.h>
+
+#define BENCH_CPU		0
+
+#define PIT_SAMPLES		256
+#define CTXSW_LOOPS		10000
+#define TRAP_LOOPS		100000
+#define CLOCK_LOOPS		100000
+#define STRING_LOOPS		10000
+#define PERF_BRANCH_LOOPS	100
+#define RCU_LOOPS		100000
+#define RCU_SYNCS		16
+#define FUTEX_LOOPS		100000
+#define SPIN_LOOPS		100000
+#define FUTEX_PINGPONGS		10000
+#define TIMER_COUNT		4096
+#define ALLOC_LOOPS		100000
+#define ALLOC_BURST		1024
+#define ZEROED_BURST		64
+#define THP_REGION		(32UL << 20)
+#define THP_ACCESSES		100000
+#define FORK_REGION		(16UL << 20)
+#define PAGECACHE_PAGES		1024
+#define PAGECACHE_WRITE		512
+#define BLK_IOS			256
+#define URING_ENTRIES		64
+#define URING_LOOPS		256
+
+/* QEMU's isa-debug-exit: a write of v exits with status (v << 1) | 1. */
+#define QEMU_DEBUG_EXIT_PORT	0xf4
+
+static bool use_tsc;
+
+static u64 bench_clock(void)
+{
+	return use_tsc ? rdtsc_ordered() : clock_now_ns();
+}
+
+static u64 bench_ns(u64 delta)
+{
+	return use_tsc ? delta * 1000000 / tsc_khz : delta;
+}
+
+/* "[seconds.micros] name: ..." */
+static __printf(2, 3) void report(const char *name, const char *fmt, ...)
+{
+	u64 now = clock_now_ns();
+	char buf[96];
+	va_list args;
+
+	va_start(args, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	pr_info("[%5llu.%06llu] %-20s %s\n",
+		(unsigned long long)(now / NSEC_PER_SEC),
+		(unsigned long long)(now % NSEC_PER_SEC / NSEC_PER_USEC),
+		name, buf);
+}
+
+/* Mean cost of @ops operations taking @delta clock units, and their rate. */
+static void report_ops(const char *name, u64 delta, u64 ops)
+{
+	u64 ns = bench_ns(delta);
+	u64 tenths = ns * 10 / ops;
+
+	report(name, "%5llu.%llu ns/op %10llu ops/s",
+	       (unsigned long long)(tenths / 10),
+	       (unsigned long long)(tenths % 10),
+	       ns ? (unsigned long long)(ops * NSEC_PER_SEC / ns) : 0ULL);
+}
+
+static struct {
+	u32 late;
+	bool fired;
+} pit_probe;
+
+static void pit_probe_done(u32 late)
+{
+	pit_probe.late = late;
+	WRITE_ONCE(pit_probe.fired, true);
+}
+
+static u64 pit_clocks_to_ns(u64 clocks)
+{
+	return clocks * NSEC_PER_SEC / PIT_TICK_RATE;
+}
+
+/*
+ * IRQ0 delivery latency: arm counter 0 for a one-shot and read back how
+ * far past terminal count it had run by the time the handler got there.
+ * The arming delay is varied so that the PIT's 838 ns resolution averages
+ * out; the spread between min and max is the jitter.
+ */
+static void bench_pit_latency(void)
+{
+	u64 sum = 0, min = ~0ULL, max = 0, deadline;
+	unsigned int i, n = 0;
+
+	if (pit_latency_probe_start(pit_probe_done)) {
+		report("pit_irq_latency", "skipped, the PIT is the tick");
+		return;
+	}
+	for (i = 0; i < PIT_SAMPLES; i++) {
+		WRITE_ONCE(pit_probe.fired, false);
+		pit_latency_probe_arm(600 + (i * 37) % 256);
+		deadline = clock_now_ns() + 10 * NSEC_PER_MSEC;
+		while (!READ_ONCE(pit_probe.fired) &&
+		       (s64)(clock_now_ns() - deadline) < 0)
+			cpu_relax();
+		if (!READ_ONCE(pit_probe.fired))
+			continue;
+		sum += pit_probe.late;
+		min = min(min, (u64)pit_probe.late);
+		max = max(max, (u64)pit_probe.late);
+		n++;
+	}
+	pit_latency_probe_stop();
+
+	if (!n) {
+		report("pit_irq_latency", "no interrupt delivered");
+		return;
+	}
+	report("pit_irq_latency", "min %llu avg %llu max %llu ns (%u samples)",
+	       (unsigned long long)pit_clocks_to_ns(min),
+	       (unsigned long long)pit_clocks_to_ns(sum) / n,
+	       (unsigned long long)pit_clocks_to_ns(max), n);
+}
+
+static struct {
+	struct task_struct *bench, *partner;
+	bool stop, fpu;
+} ctxsw;
+
+/* One SSE instruction: enough to make a task's FPU registers live. */
+static void ctxsw_touch_fpu(void)
+{
+	if (ctxsw.fpu)
+		__asm__ __volatile__("pxor %%xmm0, %%xmm0" : : : "memory");
+}
+
+static int ctxsw_partner(void *unused)
+{
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (READ_ONCE(ctxsw.stop))
+			break;
+		ctxsw_touch_fpu();
+		wake_up_process(ctxsw.bench);
+		schedule();
+	}
+	__set_current_state(TASK_RUNNING);
+	WRITE_ONCE(ctxsw.partner, NULL);
+	return 0;
+}
+
+/*
+ * Two threads on one CPU waking each other: two switches per loop.  With
+ * @fpu both use an SSE register every time slice, so that every switch
+ * saves and restores FPU state; with @own_mm the partner has an address
+ * space of its own, so that every switch loads cr3.
+ */
+static void run_ctxsw(const char *name, bool fpu, bool own_mm)
+{
+	struct task_struct *partner;
+	u64 t0, t1;
+	unsigned int i;
+
+	ctxsw.bench = current;
+	ctxsw.stop = false;
+	ctxsw.fpu = fpu;
+	if (own_mm)
+		ctxsw.partner = kernel_fork(ctxsw_partner, NULL, "bench-ctxsw");
+	else
+		ctxsw.partner = kthread_create(ctxsw_partner, NULL,
+					       "bench-ctxsw");
+	partner = ctxsw.partner;
+	if (!partner) {
+		report(name, "no memory for a thread");
+		return;
+	}
+	kthread_bind(partner, BENCH_CPU);
+
+	t0 = bench_clock();
+	for (i = 0; i < CTXSW_LOOPS; i++) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		ctxsw_touch_fpu();
+		wake_up_process(partner);
+		schedule();
+	}
+	t1 = bench_clock();
+
+	WRITE_ONCE(ctxsw.stop, true);
+	wake_up_process(partner);
+	/* The next run reuses ctxsw; the partner clears it on the way out. */
+	while (READ_ONCE(ctxsw.partner))
+		yield();
+	report_ops(name, t1 - t0, 2 * CTXSW_LOOPS);
+}
+
+static void bench_ctxsw(void)
+{
+	run_ctxsw("context_switch", false, false);
+	run_ctxsw("context_switch_fpu", true, false);
+	run_ctxsw("context_switch_mm", false, true);
+}
+
+static void bench_vector_handler(struct pt_regs *regs)
+{
+}
+
+/*
+ * There is no user mode to make a system call from, so this times the
+ * kernel half of one: a software interrupt through the common entry
+ * stub and do_interrupt() and back with iretq.
+ */
+static void bench_trap(void)
+{
+	u64 t0, t1;
+	unsigned int i;
+
+	set_vector_handler(BENCH_VECTOR, bench_vector_handler);
+	t0 = bench_clock();
+	for (i = 0; i < TRAP_LOOPS; i++)
+		__asm__ __volatile__("int %0" : : "i"(BENCH_VECTOR) : "memory");
+	t1 = bench_clock();
+	set_vector_handler(BENCH_VECTOR, NULL);
+
+	report_ops("trap_round_trip", t1 - t0, TRAP_LOOPS);
+}
+
+/*
+ * Reading the time: the vDSO path, which is what a caller outside the
+ * kernel would pay, against clock_now_ns() through the clocksource.
+ */
+static void bench_clock_read(void)
+{
+	struct timespec64 ts;
+	unsigned int i;
+	u64 t0, t1;
+
+	t0 = bench_clock();
+	for (i = 0; i < CLOCK_LOOPS; i++)
+		__vdso_clock_gettime(CLOCK_MONOTONIC, &ts);
+	t1 = bench_clock();
+	report_ops("vdso_clock_gettime", t1 - t0, CLOCK_LOOPS);
+
+	t0 = bench_clock();
+	for (i = 0; i < CLOCK_LOOPS; i++)
+		clock_now_ns();
+	t1 = bench_clock();
+	report_ops("clock_now_ns", t1 - t0, CLOCK_LOOPS);
+}
+
+/*
+ * The primitives as string_init() chose them: a page, a packet and a
+ * copy too short to be worth the SIMD registers.
+ */
+static void bench_string(void)
+{
+	struct page *page;
+	unsigned int i;
+	u64 t0, t1;
+	char *a, *b;
+
+	page = alloc_pages(GFP_KERNEL, 1);
+	if (!page) {
+		report("memcpy_4k", "no memory");
+		return;
+	}
+	a = page_address(page);
+	b = a + PAGE_SIZE;
+	memset(b, 0x5a, PAGE_SIZE);
+
+	t0 = bench_clock();
+	for (i = 0; i < STRING_LOOPS; i++)
+		memset(a, 0x5a, PAGE_SIZE);
+	t1 = bench_clock();
+	report_ops("memset_4k", t1 - t0, STRING_LOOPS);
+
+	t0 = bench_clock();
+	for (i = 0; i < STRING_LOOPS; i++)
+		memcpy(a, b, PAGE_SIZE);
+	t1 = bench_clock();
+	report_ops("memcpy_4k", t1 - t0, STRING_LOOPS);
+
+	t0 = bench_clock();
+	for (i = 0; i < STRING_LOOPS; i++)
+		memcpy(a + i % 64, b, 64);
+	t1 = bench_clock();
+	report_ops("memcpy_64", t1 - t0, STRING_LOOPS);
+
+	t0 = bench_clock();
+	for (i = 0; i < STRING_LOOPS; i++)
+		if (memcmp(a, b, PAGE_SIZE))
+			break;
+	t1 = bench_clock();
+	report_ops("memcmp_4k", t1 - t0, STRING_LOOPS);
+
+	t0 = bench_clock();
+	for (i = 0; i < STRING_LOOPS; i++)
+		csum_partial(a, ETH_DATA_LEN, 0);
+	t1 = bench_clock();
+	report_ops("csum_partial_1500", t1 - t0, STRING_LOOPS);
+
+	__free_pages(page, 1);
+}
+
+/* Count @events on this task alone, until perf_bench_end() reads them. */
+static int perf_bench_begin(const char *name, unsigned int events)
+{
+	int ret = perf_task_enable(events);
+
+	if (ret)
+		report(name, "no counters (%d)", ret);
+	return ret;
+}
+
+static void perf_bench_end(u64 counts[PERF_COUNT_HW_MAX])
+{
+	perf_task_read(current, counts);
+	perf_task_disable();
+}
+
+/* A branch on each of @n random bytes: half of them should mispredict. */
+static unsigned long perf_branch_loop(const u8 *bytes, unsigned int n)
+{
+	unsigned long sum = 0;
+	unsigned int i;
+
+	for (i = 0; i < n; i++) {
+		if (bytes[i] & 1) {
+			/* Keeps the compiler from making it a cmov. */
+			barrier();
+			sum += i;
+		}
+	}
+	return sum;
+}
+
+/*
+ * What the hardware counters make of two loops: page copies, which
+ * should retire several instructions a cycle, and a branch on random
+ * data.  This is the kind of split the timings above cannot give.
+ */
+static void bench_perf(void)
+{
+	u64 counts[PERF_COUNT_HW_MAX], ins, cyc, br;
+	struct page *page;
+	u32 x = 2463534242U;
+	unsigned int i;
+	char *a, *b;
+
+	page = alloc_pages(GFP_KERNEL, 1);
+	if (!page) {
+		report("perf_memcpy_4k", "no memory");
+		return;
+	}
+	a = page_address(page);
+	b = a + PAGE_SIZE;
+	for (i = 0; i < PAGE_SIZE; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		b[i] = x;
+	}
+
+	if (perf_bench_begin("perf_memcpy_4k",
+			     1U << PERF_COUNT_HW_CPU_CYCLES |
+			     1U << PERF_COUNT_HW_INSTRUCTIONS |
+			     1U << PERF_COUNT_HW_CACHE_MISSES))
+		goto out;
+	for (i = 0; i < STRING_LOOPS; i++)
+		memcpy(a, b, PAGE_SIZE);
+	perf_bench_end(counts);
+	ins = counts[PERF_COUNT_HW_INSTRUCTIONS];
+	cyc = counts[PERF_COUNT_HW_CPU_CYCLES] ?: 1;
+	report("perf_memcpy_4k", "%llu.%02llu IPC, %llu LLC misses",
+	       (unsigned long long)(ins / cyc),
+	       (unsigned long long)(ins * 100 / cyc % 100),
+	       (unsigned long long)counts[PERF_COUNT_HW_CACHE_MISSES]);
+
+	if (perf_bench_begin("perf_branch_random",
+			     1U << PERF_COUNT_HW_BRANCH_INSTRUCTIONS |
+			     1U << PERF_COUNT_HW_BRANCH_MISSES))
+		goto out;
+	for (i = 0; i < PERF_BRANCH_LOOPS; i++)
+		perf_branch_loop((const u8 *)b, PAGE_SIZE);
+	perf_bench_end(counts);
+	br = counts[PERF_COUNT_HW_BRANCH_INSTRUCTIONS] ?: 1;
+	report("perf_branch_random", "%llu.%llu%% of %llu branches missed",
+	       (unsigned long long)(counts[PERF_COUNT_HW_BRANCH_MISSES] *
+				    100 / br),
+	       (unsigned long long)(counts[PERF_COUNT_HW_BRANCH_MISSES] *
+				    1000 / br % 10),
+	       (unsigned long long)br);
+out:
+	__free_pages(page, 1);
+}
+
+static struct {
+	unsigned int expired;
+	u64 first, last;
+} timer_bench;
+
+static void bench_timer_fn(struct timer_list *t)
+{
+	u64 now = bench_clock();
+
+	if (!timer_bench.expired++)
+		timer_bench.first = now;
+	timer_bench.last = now;
+}
+
+/*
+ * Wheel inserts spread over every level, their removal, and the rate at
+ * which a batch of timers due on the same tick is run from it.
+ */
+static void bench_timers(void)
+{
+	struct timer_list *timers;
+	u64 t0, t1, base;
+	unsigned int i;
+
+	timers = kcalloc(TIMER_COUNT, sizeof(*timers), GFP_KERNEL);
+	if (!timers) {
+		report("timer_insert", "no memory for timers");
+		return;
+	}
+	for (i = 0; i < TIMER_COUNT; i++)
+		timer_setup(&timers[i], bench_timer_fn, TIMER_PINNED);
+
+	base = get_jiffies_64() + HZ;
+	t0 = bench_clock();
+	for (i = 0; i < TIMER_COUNT; i++)
+		mod_timer(&timers[i], base + (i * 7919UL) % (64UL * HZ));
+	t1 = bench_clock();
+	report_ops("timer_insert", t1 - t0, TIMER_COUNT);
+
+	t0 = bench_clock();
+	for (i = 0; i < TIMER_COUNT; i++)
+		del_timer(&timers[i]);
+	t1 = bench_clock();
+	report_ops("timer_delete", t1 - t0, TIMER_COUNT);
+
+	timer_bench.expired = 0;
+	base = get_jiffies_64() + 2;
+	for (i = 0; i < TIMER_COUNT; i++)
+		mod_timer(&timers[i], base);
+	while (READ_ONCE(timer_bench.expired) < TIMER_COUNT)
+		msleep(10);
+	report_ops("timer_expire", timer_bench.last - timer_bench.first,
+		   TIMER_COUNT - 1);
+
+	kfree(timers);
+}
+
+static void bench_alloc(void)
+{
+	static void *objs[ALLOC_BURST];
+	struct page *page;
+	u64 t0, t1;
+	unsigned int i, j;
+
+	t0 = bench_clock();
+	for (i = 0; i < ALLOC_LOOPS; i++) {
+		page = alloc_page(GFP_KERNEL);
+		if (page)
+			__free_page(page);
+	}
+	t1 = bench_clock();
+	report_ops("page_alloc_free", t1 - t0, ALLOC_LOOPS);
+
+	t0 = bench_clock();
+	for (i = 0; i < ALLOC_LOOPS / 10; i++) {
+		page = alloc_pages(GFP_KERNEL, 3);
+		if (page)
+			__free_pages(page, 3);
+	}
+	t1 = bench_clock();
+	report_ops("page_alloc_free_o3", t1 - t0, ALLOC_LOOPS / 10);
+
+	t0 = bench_clock();
+	for (i = 0; i < ALLOC_LOOPS; i++)
+		kfree(kmalloc(64, GFP_KERNEL));
+	t1 = bench_clock();
+	report_ops("kmalloc_free_64", t1 - t0, ALLOC_LOOPS);
+
+	/* Deep enough to cycle magazines through the depot and the slabs. */
+	t0 = bench_clock();
+	for (i = 0; i < ALLOC_LOOPS / ALLOC_BURST; i++) {
+		for (j = 0; j < ALLOC_BURST; j++)
+			objs[j] = kmalloc(256, GFP_KERNEL);
+		for (j = 0; j < ALLOC_BURST; j++)
+			kfree(objs[j]);
+	}
+	t1 = bench_clock();
+	report_ops("kmalloc_burst_256", t1 - t0,
+		   ALLOC_LOOPS / ALLOC_BURST * ALLOC_BURST);
+}
+
+/*
+ * Zeroed pages as a fault wants them, after a pause in which the idle
+ * CPUs can fill the pool.
+ */
+static void bench_zeroed(void)
+{
+	static struct page *pages[ZEROED_BURST];
+	unsigned int i;
+	u64 t0, t1;
+
+	msleep(100);
+	t0 = bench_clock();
+	for (i = 0; i < ZEROED_BURST; i++)
+		pages[i] = alloc_page(GFP_KERNEL | __GFP_ZERO);
+	t1 = bench_clock();
+	for (i = 0; i < ZEROED_BURST; i++)
+		if (pages[i])
+			__free_page(pages[i]);
+	report_ops("page_alloc_zeroed", t1 - t0, ZEROED_BURST);
+}
+
+/* A write to every page: first touch faults each 4 KiB, or each 2 MiB. */
+static u64 touch_pages(unsigned long start, unsigned long len)
+{
+	unsigned long addr;
+	u64 t0, t1;
+
+	t0 = bench_clock();
+	for (addr = start; addr < start + len; addr += PAGE_SIZE)
+		WRITE_ONCE(*(u8 *)addr, 1);
+	t1 = bench_clock();
+	return t1 - t0;
+}
+
+/*
+ * Reads scattered over the region: 8192 small pages are far more than
+ * the TLB holds, 16 huge ones are not.
+ */
+static u64 thp_random(unsigned long start)
+{
+	u64 x = 1, t0, t1;
+	unsigned int i;
+
+	t0 = bench_clock();
+	for (i = 0; i < THP_ACCESSES; i++) {
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+		READ_ONCE(*(u64 *)(start + ((x >> 20) & (THP_REGION - 8))));
+	}
+	t1 = bench_clock();
+	return t1 - t0;
+}
+
+/*
+ * The same region backed by small pages, then promoted by one khugepaged
+ * pass, then faulted in with huge pages from the start.
+ */
+static void bench_thp(void)
+{
+	unsigned long taken, missed, htaken, hmissed;
+	unsigned long addr;
+	unsigned int nr;
+	u64 t0, t1;
+
+	addr = vm_mmap_anon(&init_mm, THP_REGION, VM_NOHUGEPAGE);
+	if (!addr) {
+		report("thp", "no address space, skipped");
+		return;
+	}
+	report_ops("thp_touch_4k", touch_pages(addr, THP_REGION),
+		   THP_REGION / PAGE_SIZE);
+	report_ops("thp_random_4k", thp_random(addr), THP_ACCESSES);
+
+	vm_madvise(&init_mm, addr, MADV_HUGEPAGE);
+	t0 = bench_clock();
+	nr = khugepaged_scan_mm(&init_mm);
+	t1 = bench_clock();
+	report("thp_collapse", "%u of %lu ranges, %llu us", nr,
+	       THP_REGION / PMD_SIZE,
+	       (unsigned long long)(bench_ns(t1 - t0) / NSEC_PER_USEC));
+	report_ops("thp_random_collapsed", thp_random(addr), THP_ACCESSES);
+	vm_munmap(&init_mm, addr);
+
+	addr = vm_mmap_anon(&init_mm, THP_REGION, VM_HUGEPAGE);
+	if (!addr)
+		return;
+	report_ops("thp_touch_2m", touch_pages(addr, THP_REGION),
+		   THP_REGION / PAGE_SIZE);
+	report_ops("thp_random_2m", thp_random(addr), THP_ACCESSES);
+	vm_munmap(&init_mm, addr);
+
+	report("thp_stats", "%lu faults, %lu fallbacks, %lu collapses",
+	       thp_stats.fault_alloc, thp_stats.fault_fallback,
+	       thp_stats.collapse_alloc);
+
+	prezero_stats(&taken, &missed, 0);
+	prezero_stats(&htaken, &hmissed, HPAGE_PMD_ORDER);
+	report("prezero_stats", "%lu of %lu small, %lu of %lu huge pooled",
+	       taken, taken + missed, htaken, htaken + hmissed);
+}
+
+/*
+ * Copying an address space with a populated region for fork, which only
+ * shares its page tables, and the writes after it, which copy a page
+ * (or a huge page) at each first write.
+ */
+static void bench_fork_one(const char *dup_name, const char *cow_name,
+			   unsigned long vm_flags)
+{
+	struct mm_struct *mm;
+	unsigned long addr;
+	u64 t0, t1;
+
+	addr = vm_mmap_anon(&init_mm, FORK_REGION, vm_flags);
+	if (!addr) {
+		report(dup_name, "no address space, skipped");
+		return;
+	}
+	touch_pages(addr, FORK_REGION);
+
+	t0 = bench_clock();
+	mm = dup_mm(&init_mm);
+	t1 = bench_clock();
+	if (!mm) {
+		report(dup_name, "no memory, skipped");
+		vm_munmap(&init_mm, addr);
+		return;
+	}
+	report(dup_name, "%llu us for %lu MiB",
+	       (unsigned long long)(bench_ns(t1 - t0) / NSEC_PER_USEC),
+	       FORK_REGION >> 20);
+	report_ops(cow_name, touch_pages(addr, FORK_REGION),
+		   FORK_REGION / PAGE_SIZE);
+
+	mmput(mm);
+	vm_munmap(&init_mm, addr);
+}
+
+static void bench_fork(void)
+{
+	bench_fork_one("fork_dup_4k", "fork_cow_4k", VM_NOHUGEPAGE);
+	bench_fork_one("fork_dup_2m", "fork_cow_2m", VM_HUGEPAGE);
+}
+
+/*
+ * An RCU read-side section, which should cost next to nothing, and a
+ * grace period as a writer sees it, with the other CPUs mostly idle.
+ */
+static void bench_rcu(void)
+{
+	unsigned int i;
+	u64 t0, t1;
+
+	t0 = bench_clock();
+	for (i = 0; i < RCU_LOOPS; i++) {
+		rcu_read_lock();
+		rcu_read_unlock();
+	}
+	t1 = bench_clock();
+	report_ops("rcu_read_lock_unlock", t1 - t0, RCU_LOOPS);
+
+	t0 = bench_clock();
+	for (i = 0; i < RCU_SYNCS; i++)
+		synchronize_rcu();
+	t1 = bench_clock();
+	report("synchronize_rcu", "%llu us, %u CPUs",
+	       (unsigned long long)(bench_ns(t1 - t0) / RCU_SYNCS / NSEC_PER_USEC),
+	       num_online_cpus());
+}
+
+/*
+ * A spinlock nobody else wants, then one that every online CPU takes in
+ * a loop, with a critical section of one increment: the cost of handing
+ * the lock and its cache line from CPU to CPU.
+ */
+static struct {
+	spinlock_t lock;
+	unsigned long counter;
+	unsigned int ready, done;
+	bool go;
+} spin_bench = { .lock = __SPIN_LOCK_UNLOCKED(spin_bench.lock) };
+
+static DECLARE_WAIT_QUEUE_HEAD(spin_bench_wait);
+
+static void spin_bench_loop(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < SPIN_LOOPS; i++) {
+		spin_lock(&spin_bench.lock);
+		spin_bench.counter++;
+		spin_unlock(&spin_bench.lock);
+	}
+}
+
+static int spin_bench_thread(void *unused)
+{
+	__atomic_add_fetch(&spin_bench.ready, 1, __ATOMIC_RELEASE);
+	while (!READ_ONCE(spin_bench.go))
+		cpu_relax();
+	spin_bench_loop();
+	__atomic_add_fetch(&spin_bench.done, 1, __ATOMIC_RELEASE);
+	wake_up(&spin_bench_wait);
+	return 0;
+}
+
+static void bench_spinlock(void)
+{
+	unsigned int cpu, n = 0;
+	struct task_struct *p;
+	spinlock_t lock;
+	char name[24];
+	unsigned int i;
+	u64 t0, t1;
+
+	spin_lock_init(&lock);
+	t0 = bench_clock();
+	for (i = 0; i < SPIN_LOOPS; i++) {
+		spin_lock(&lock);
+		spin_unlock(&lock);
+	}
+	t1 = bench_clock();
+	report_ops("spin_lock_uncont", t1 - t0, SPIN_LOOPS);
+
+	if (num_online_cpus() == 1)
+		return;
+	spin_bench.ready = spin_bench.done = 0;
+	spin_bench.go = false;
+	for_each_online_cpu(cpu) {
+		if (cpu == BENCH_CPU)
+			continue;
+		p = kthread_create(spin_bench_thread, NULL, "bench-spin");
+		if (!p)
+			break;
+		kthread_bind(p, cpu);
+		wake_up_process(p);
+		n++;
+	}
+	while (__atomic_load_n(&spin_bench.ready, __ATOMIC_ACQUIRE) != n)
+		cpu_relax();
+
+	t0 = bench_clock();
+	WRITE_ONCE(spin_bench.go, true);
+	spin_bench_loop();
+	wait_event(spin_bench_wait,
+		   __atomic_load_n(&spin_bench.done, __ATOMIC_ACQUIRE) == n);
+	t1 = bench_clock();
+	snprintf(name, sizeof(name), "spin_lock_%ucpus", n + 1);
+	report_ops(name, t1 - t0, (u64)(n + 1) * SPIN_LOOPS);
+}
+
+/*
+ * A futex mutex taken and released with nobody else about, which should
+ * stay out of the kernel; a wake with no waiters, the cheapest way in;
+ * and a word passed back and forth between two threads, on two CPUs if
+ * there are two, each sleeping until the other hands it over.
+ */
+static struct {
+	u32 turn;			/* 1: the partner's */
+	bool stop;
+} pingpong;
+
+static int futex_partner(void *unused)
+{
+	for (;;) {
+		while (!__atomic_load_n(&pingpong.turn, __ATOMIC_ACQUIRE))
+			do_futex(&pingpong.turn, FUTEX_WAIT_PRIVATE, 0, NULL,
+				 NULL, 0, 0);
+		if (READ_ONCE(pingpong.stop))
+			break;
+		__atomic_store_n(&pingpong.turn, 0, __ATOMIC_RELEASE);
+		do_futex(&pingpong.turn, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0, 0);
+	}
+	return 0;
+}
+
+static void bench_futex(void)
+{
+	struct futex_mutex m = FUTEX_MUTEX_INIT;
+	struct task_struct *p;
+	unsigned int i;
+	u32 word = 0;
+	u64 t0, t1;
+
+	t0 = bench_clock();
+	for (i = 0; i < FUTEX_LOOPS; i++) {
+		futex_mutex_lock(&m);
+		futex_mutex_unlock(&m);
+	}
+	t1 = bench_clock();
+	report_ops("futex_mutex_uncont", t1 - t0, FUTEX_LOOPS);
+
+	t0 = bench_clock();
+	for (i = 0; i < FUTEX_LOOPS; i++)
+		do_futex(&word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0, 0);
+	t1 = bench_clock();
+	report_ops("futex_wake_empty", t1 - t0, FUTEX_LOOPS);
+
+	pingpong.turn = 0;
+	pingpong.stop = false;
+	p = kthread_create(futex_partner, NULL, "bench-futex");
+	if (!p) {
+		report("futex_pingpong", "no memory for a thread");
+		return;
+	}
+	kthread_bind(p, num_online_cpus() > 1 ? BENCH_CPU + 1 : BENCH_CPU);
+	wake_up_process(p);
+
+	t0 = bench_clock();
+	for (i = 0; i < FUTEX_PINGPONGS; i++) {
+		__atomic_store_n(&pingpong.turn, 1, __ATOMIC_RELEASE);
+		do_futex(&pingpong.turn, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0, 0);
+		while (__atomic_load_n(&pingpong.turn, __ATOMIC_ACQUIRE))
+			do_futex(&pingpong.turn, FUTEX_WAIT_PRIVATE, 1, NULL,
+				 NULL, 0, 0);
+	}
+	t1 = bench_clock();
+	report_ops("futex_pingpong", t1 - t0, FUTEX_PINGPONGS);
+
+	WRITE_ONCE(pingpong.stop, true);
+	__atomic_store_n(&pingpong.turn, 1, __ATOMIC_RELEASE);
+	do_futex(&pingpong.turn, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0, 0);
+}
+
+/*
+ * The page cache over a backing store that is not there: reads complete
+ * at once with zeroes and writes are dropped, so what is timed is the
+ * cache itself, and the calls show how readahead and writeback batch.
+ */
+static unsigned int null_reads, null_writes;
+
+static int null_readpages(struct address_space *mapping, struct page **pages,
+			  unsigned int nr)
+{
+	unsigned int i;
+
+	null_reads++;
+	for (i = 0; i < nr; i++) {
+		memset(page_address(pages[i]), 0, PAGE_SIZE);
+		end_page_read(pages[i], 0);
+	}
+	return 0;
+}
+
+static int null_writepages(struct address_space *mapping, struct page **pages,
+			   unsigned int nr)
+{
+	unsigned int i;
+
+	null_writes++;
+	for (i = 0; i < nr; i++)
+		end_page_writeback(pages[i], 0);
+	return 0;
+}
+
+static const struct address_space_operations null_aops = {
+	.readpages	= null_readpages,
+	.writepages	= null_writepages,
+};
+
+/* Map @nr pages of @mapping and read each once: one fault per page. */
+static void map_read(const char *name, struct address_space *mapping,
+		     unsigned long nr)
+{
+	unsigned long addr, i;
+	u64 t0, t1;
+
+	addr = vm_mmap_file(&init_mm, mapping, 0, nr << PAGE_SHIFT);
+	if (!addr) {
+		report(name, "no address space, skipped");
+		return;
+	}
+	t0 = bench_clock();
+	for (i = 0; i < nr; i++)
+		READ_ONCE(*(u8 *)(addr + (i << PAGE_SHIFT)));
+	t1 = bench_clock();
+	vm_munmap(&init_mm, addr);
+	report_ops(name, t1 - t0, nr);
+}
+
+static void bench_pagecache(void)
+{
+	static struct inode inode;
+	static char buf[PAGE_SIZE];
+	struct file file;
+	unsigned int i;
+	loff_t pos;
+	u64 t0, t1;
+
+	inode_init(&inode, 1, &null_aops);
+	file_init(&file, &inode);
+
+	pos = 0;
+	t0 = bench_clock();
+	for (i = 0; i < PAGECACHE_PAGES * PAGE_SIZE / PAGECACHE_WRITE; i++)
+		generic_file_write(&file, buf, PAGECACHE_WRITE, &pos);
+	t1 = bench_clock();
+	report_ops("pagecache_write_512", t1 - t0,
+		   PAGECACHE_PAGES * PAGE_SIZE / PAGECACHE_WRITE);
+
+	t0 = bench_clock();
+	generic_file_fsync(&file);
+	t1 = bench_clock();
+	report("pagecache_fsync", "%u pages in %u writes, %llu us",
+	       PAGECACHE_PAGES, null_writes,
+	       (unsigned long long)(bench_ns(t1 - t0) / NSEC_PER_USEC));
+	map_read("pagecache_map_read", &inode.i_data, PAGECACHE_PAGES);
+	if (initrd_inode)
+		map_read("initrd_map_read", &initrd_inode->i_data,
+			 PFN_UP(initrd_inode->i_size));
+
+	truncate_inode_pages(&inode.i_data);
+	pos = 0;
+	t0 = bench_clock();
+	for (i = 0; i < PAGECACHE_PAGES; i++)
+		generic_file_read(&file, buf, PAGE_SIZE, &pos);
+	t1 = bench_clock();
+	report_ops("pagecache_read_cold", t1 - t0, PAGECACHE_PAGES);
+	report("pagecache_readahead", "%u pages in %u reads",
+	       PAGECACHE_PAGES, null_reads);
+
+	pos = 0;
+	t0 = bench_clock();
+	for (i = 0; i < PAGECACHE_PAGES; i++)
+		generic_file_read(&file, buf, PAGE_SIZE, &pos);
+	t1 = bench_clock();
+	report_ops("pagecache_read_hot", t1 - t0, PAGECACHE_PAGES);
+
+	truncate_inode_pages(&inode.i_data);
+}
+
+/*
+ * The rings themselves: batches of NOPs, so what is timed is one
+ * io_uring_enter() per batch plus the per-entry cost; then hot 512-byte
+ * page cache reads through the ring, against the direct calls in
+ * pagecache_read_hot above; then how late a 1 ms timeout completes.
+ */
+static void bench_uring(void)
+{
+	static struct inode inode;
+	static char buf[PAGE_SIZE];
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+	struct io_uring ring;
+	struct file file, *files[1] = { &file };
+	unsigned int i, j;
+	u64 t0, t1;
+	loff_t pos;
+
+	if (io_uring_queue_init(URING_ENTRIES, &ring)) {
+		report("uring", "no memory, skipped");
+		return;
+	}
+
+	t0 = bench_clock();
+	for (i = 0; i < URING_LOOPS; i++) {
+		for (j = 0; j < URING_ENTRIES; j++)
+			io_uring_prep_nop(io_uring_get_sqe(&ring));
+		io_uring_submit_and_wait(&ring, URING_ENTRIES);
+		for (j = 0; j < URING_ENTRIES; j++)
+			io_uring_cqe_seen(&ring);
+	}
+	t1 = bench_clock();
+	report_ops("uring_nop_batch64", t1 - t0, URING_LOOPS * URING_ENTRIES);
+
+	inode_init(&inode, 1, &null_aops);
+	file_init(&file, &inode);
+	io_uring_register_files(&ring, files, 1);
+	pos = 0;
+	for (i = 0; i < PAGECACHE_PAGES / 8; i++)
+		generic_file_read(&file, buf, PAGE_SIZE, &pos);
+
+	t0 = bench_clock();
+	for (i = 0; i < PAGECACHE_PAGES / 8 * PAGE_SIZE / 512;
+	     i += URING_ENTRIES) {
+		for (j = 0; j < URING_ENTRIES; j++)
+			io_uring_prep_read(io_uring_get_sqe(&ring), 0,
+					   buf + (j & 7) * 512, 512,
+					   (u64)(i + j) * 512);
+		io_uring_submit_and_wait(&ring, URING_ENTRIES);
+		for (j = 0; j < URING_ENTRIES; j++)
+			io_uring_cqe_seen(&ring);
+	}
+	t1 = bench_clock();
+	report_ops("uring_read_512_hot", t1 - t0,
+		   PAGECACHE_PAGES / 8 * PAGE_SIZE / 512);
+
+	pos = 0;
+	t0 = bench_clock();
+	for (i = 0; i < PAGECACHE_PAGES / 8 * PAGE_SIZE / 512; i++)
+		generic_file_read(&file, buf, 512, &pos);
+	t1 = bench_clock();
+	report_ops("direct_read_512_hot", t1 - t0,
+		   PAGECACHE_PAGES / 8 * PAGE_SIZE / 512);
+
+	sqe = io_uring_get_sqe(&ring);
+	io_uring_prep_timeout(sqe, NSEC_PER_MSEC, 0);
+	t0 = bench_clock();
+	io_uring_submit(&ring);
+	cqe = io_uring_wait_cqe(&ring);
+	t1 = bench_clock();
+	report("uring_timeout_1ms", "%llu us, res %d",
+	       (unsigned long long)(bench_ns(t1 - t0) / NSEC_PER_USEC),
+	       cqe->res);
+	io_uring_cqe_seen(&ring);
+
+	io_uring_queue_exit(&ring);
+	truncate_inode_pages(&inode.i_data);
+}
+
+/*
+ * 4 KiB reads from the start of the first virtio disk: one at a time, then
+ * all submitted under a plug, where adjacent ones merge and the device
+ * hears about the lot at once.  The disk is only read.
+ */
+static unsigned int blk_inflight;
+static DECLARE_WAIT_QUEUE_HEAD(blk_bench_wait);
+
+static void blk_bench_end_io(struct bio *bio)
+{
+	if (!__atomic_sub_fetch(&blk_inflight, 1, __ATOMIC_SEQ_CST))
+		wake_up(&blk_bench_wait);
+}
+
+static void blk_queue_stats(struct request_queue *q, unsigned long *merged,
+			    unsigned long *commits)
+{
+	unsigned int i;
+
+	*merged = *commits = 0;
+	for (i = 0; i < q->nr_hw_queues; i++) {
+		*merged += READ_ONCE(q->queue_hw_ctx[i]->merged);
+		*commits += READ_ONCE(q->queue_hw_ctx[i]->commits);
+	}
+}
+
+static void bench_blk(void)
+{
+	struct gendisk *disk = get_gendisk("vda");
+	unsigned long merged0, commits0, merged1, commits1;
+	static struct bio *bios[BLK_IOS];
+	struct blk_plug plug;
+	struct page *page;
+	unsigned int i;
+	u64 t0, t1;
+
+	if (!disk || disk->capacity < BLK_IOS << PAGE_SECTORS_SHIFT) {
+		report("blk", "no disk, skipped");
+		return;
+	}
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return;
+	for (i = 0; i < BLK_IOS; i++) {
+		bios[i] = bio_alloc(disk, 1, REQ_OP_READ);
+		if (!bios[i])
+			goto out;
+	}
+
+	t0 = bench_clock();
+	for (i = 0; i < BLK_IOS; i++) {
+		bios[i]->bi_sector = (sector_t)i << PAGE_SECTORS_SHIFT;
+		bio_add_page(bios[i], page, PAGE_SIZE, 0);
+		submit_bio_wait(bios[i]);
+		bios[i]->bi_vcnt = 0;
+		bios[i]->bi_size = 0;
+	}
+	t1 = bench_clock();
+	report_ops("blk_read_4k_qd1", t1 - t0, BLK_IOS);
+
+	/* All into the one page: only the request count matters here. */
+	blk_queue_stats(disk->queue, &merged0, &commits0);
+	blk_inflight = BLK_IOS;
+	t0 = bench_clock();
+	blk_start_plug(&plug);
+	for (i = 0; i < BLK_IOS; i++) {
+		bios[i]->bi_sector = (sector_t)i << PAGE_SECTORS_SHIFT;
+		bios[i]->bi_end_io = blk_bench_end_io;
+		bio_add_page(bios[i], page, PAGE_SIZE, 0);
+		submit_bio(bios[i]);
+	}
+	blk_finish_plug(&plug);
+	wait_event(blk_bench_wait, !READ_ONCE(blk_inflight));
+	t1 = bench_clock();
+	blk_queue_stats(disk->queue, &merged1, &commits1);
+	report_ops("blk_read_4k_plugged", t1 - t0, BLK_IOS);
+	report("blk_merge", "%u bios, %lu merged, %lu notifies", BLK_IOS,
+	       merged1 - merged0, commits1 - commits0);
+
+out:
+	for (i = 0; i < BLK_IOS && bios[i]; i++)
+		bio_put(bios[i]);
+	__free_page(page);
+}
+
+static int bench_thread(void *exit_qemu)
+{
+	use_tsc = tsc_khz && !strcmp(current_clocksource_name(), "tsc");
+	if (use_tsc)
+		report("clock", "tsc, %lu kHz", tsc_khz);
+	else
+		report("clock", "%s", current_clocksource_name());
+
+	bench_pit_latency();
+	bench_ctxsw();
+	bench_trap();
+	bench_clock_read();
+	bench_string();
+	bench_perf();
+	bench_timers();
+	bench_alloc();
+	bench_zeroed();
+	bench_thp();
+	bench_fork();
+	bench_rcu();
+	bench_spinlock();
+	bench_futex();
+	bench_pagecache();
+	bench_uring();
+	bench_blk();
+	profile_dump();
+	if (CONFIG_LOCK_STAT)
+		lock_stat_dump();
+	pr_info("done\n");
+
+	if (exit_qemu)
+		outb(0, QEMU_DEBUG_EXIT_PORT);
+	return 0;
+}
+
+void bench_init(void)
+{
+	char opt[8];
+	struct task_struct *p;
+	bool exit_qemu;
+
+	if (!cmdline_has("bench"))
+		return;
+	exit_qemu = !cmdline_get("bench", opt, sizeof(opt)) &&
+		    !strcmp(opt, "exit");
+
+	p = kthread_create(bench_thread, exit_qemu ? (void *)1 : NULL, "bench");
+	if (!p) {
+		pr_err("cannot create the benchmark thread\n");
+		return;
+	}
+	kthread_bind(p, BENCH_CPU);
+	wake_up_process(p);
+}
@@ -0,0 +1,56 @@
+/*
+ * Kernel command line, as passed by the boot loader.  Options are
+ * whitespace separated "key" or "key=value" words.
+ */
+#include <zhos/kernel.h>
+#include <zhos/errno.h>
+#include <zhos/cmdline.h>
+
+char boot_command_line[COMMAND_LINE_SIZE];
+
+void cmdline_init(const char *s)
+{
+	strlcpy(boot_command_line, s, sizeof(boot_command_line));
+}
+
+static bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n';
+}
+
+/* Returns the character following @key in the first matching word. */
+static const char *cmdline_find(const char *key)
+{
+	size_t len = strlen(key);
+	const char *p = boot_command_line;
+
+	while (*p) {
+		while (is_space(*p))
+			p++;
+		if (!strncmp(p, key, len) &&
+		    (p[len] == '=' || p[len] == '\0' || is_space(p[len])))
+			return p + len;
+		while (*p && !is_space(*p))
+			p++;
+	}
+	return NULL;
+}
+
+int cmdline_get(const char *key, char *buf, size_t size)
+{
+	const char *p = cmdline_find(key);
+	size_t n = 0;
+
+	if (!p || *p != '=')
+		return -ENOENT;
+	for (p++; *p && !is_space(*p) && n + 1 < size; p++)
+		buf[n++] = *p;
+	if (size)
+		buf[n] = '\0';
+	return 0;
+}
+
+bool cmdline_has(const char *key)
+{
+	return cmdline_find(key) != NULL;
+}
@@ -0,0 +1,16 @@
+/*
+ * CPU masks.  The boot CPU is always CPU 0; the others are numbered in
+ * the order firmware enumerates them.
+ */
+#include <zhos/kernel.h>
+#include <zhos/cpumask.h>
+#include <zhos/smp.h>
+
+struct cpumask __cpu_possible_mask;
+struct cpumask __cpu_online_mask;
+
+void boot_cpu_init(void)
+{
+	set_cpu_possible(0, true);
+	set_cpu_online(0, true);
+}
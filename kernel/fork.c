@@ -0,0 +1,234 @@
+/*
+ * Task allocation.  Task structs come from their own object cache and
+ * kernel stacks straight from the page allocator.
+ *
+ * A task either runs on init_mm, as kernel threads do, or has an address
+ * space of its own, copied from its parent's by kernel_fork().  Every
+ * address space is on init_mm's mmlist from mm_alloc() until its last
+ * reference goes, for those that have to visit them all (khugepaged).
+ */
+#include <zhos/kernel.h>
+#include <zhos/errno.h>
+#include <zhos/kthread.h>
+#include <zhos/list.h>
+#include <zhos/mm.h>
+#include <zhos/mm_types.h>
+#include <zhos/preempt.h>
+#include <zhos/sched.h>
+#include <zhos/slab.h>
+#include <zhos/spinlock.h>
+#include <zhos/string.h>
+#include <asm/fpu.h>
+#include <asm/mmu_context.h>
+#include <asm/pgtable.h>
+#include <asm/tlbflush.h>
+
+#define THREAD_SIZE_ORDER	2
+
+_Static_assert(PAGE_SIZE << THREAD_SIZE_ORDER == THREAD_SIZE,
+	       "THREAD_SIZE_ORDER does not match THREAD_SIZE");
+
+static struct kmem_cache *task_struct_cachep;
+static int last_pid;
+static DEFINE_SPINLOCK(mmlist_lock);
+
+/* A zeroed task with its stack, or NULL when out of memory. */
+struct task_struct *alloc_task(void)
+{
+	struct task_struct *p;
+	struct page *stack;
+
+	p = kmem_cache_zalloc(task_struct_cachep, GFP_KERNEL);
+	if (!p)
+		return NULL;
+	stack = alloc_pages(GFP_KERNEL, THREAD_SIZE_ORDER);
+	if (!stack) {
+		kmem_cache_free(task_struct_cachep, p);
+		return NULL;
+	}
+	INIT_LIST_HEAD(&p->run_list);
+	p->pid = __atomic_add_fetch(&last_pid, 1, __ATOMIC_RELAXED);
+	p->stack = page_address(stack);
+	return p;
+}
+
+/* Called by the scheduler once @p has switched away for the last time. */
+void free_task(struct task_struct *p)
+{
+	fpu_free(p);
+	free_pages((unsigned long)p->stack, THREAD_SIZE_ORDER);
+	kmem_cache_free(task_struct_cachep, p);
+}
+
+/* An address space with no regions, sharing the kernel's mappings. */
+struct mm_struct *mm_alloc(void)
+{
+	struct mm_struct *mm;
+	pgd_t *pgd;
+
+	mm = kzalloc(sizeof(*mm), GFP_KERNEL);
+	if (!mm)
+		return NULL;
+	pgd = (pgd_t *)get_zeroed_page(GFP_KERNEL);
+	if (!pgd) {
+		kfree(mm);
+		return NULL;
+	}
+	memcpy(pgd, swapper_pg_dir, PAGE_SIZE);
+	pgd_clear(pgd + pgd_index(VMAP_START));
+
+	mm->pgd = pgd;
+	mm->mm_users = 1;
+	init_new_context(mm);
+	spin_lock_init(&mm->mmap_lock);
+	INIT_LIST_HEAD(&mm->mmap);
+	mm->mmap_base = VMAP_START;
+	mm->mmap_end = VMAP_END;
+	mm->numa_nid = NUMA_NO_NODE;
+
+	spin_lock(&mmlist_lock);
+	list_add_tail(&mm->mmlist, &init_mm.mmlist);
+	spin_unlock(&mmlist_lock);
+	return mm;
+}
+
+/**
+ * dup_mm - copy an address space for fork
+ * @oldmm: the address space to copy
+ *
+ * The copy has the same regions, and shares every page mapped in them
+ * copy-on-write (mm/memory.c), so the cost grows with the number of PTE
+ * tables, not pages.  Called with interrupts enabled, for the TLB
+ * flush; returns NULL when out of memory.
+ */
+struct mm_struct *dup_mm(struct mm_struct *oldmm)
+{
+	struct vm_area_struct *vma, *new;
+	struct mm_struct *mm;
+	int ret = 0;
+
+	mm = mm_alloc();
+	if (!mm)
+		return NULL;
+
+	spin_lock(&oldmm->mmap_lock);
+	/* The pages are shared, so they are where the child's memory is. */
+	memcpy(mm->numa_pages, oldmm->numa_pages, sizeof(mm->numa_pages));
+	mm->numa_nid = oldmm->numa_nid;
+	list_for_each_entry(vma, &oldmm->mmap, vm_list) {
+		new = kmalloc(sizeof(*new), GFP_KERNEL);
+		if (!new) {
+			ret = -ENOMEM;
+			break;
+		}
+		*new = *vma;
+		new->vm_mm = mm;
+		list_add_tail(&new->vm_list, &mm->mmap);
+	}
+	if (!ret)
+		ret = copy_page_range(mm, oldmm);
+	/* Whatever was write-protected must be, on all CPUs, before a write. */
+	flush_tlb_mm_range(oldmm, oldmm->mmap_base, oldmm->mmap_end);
+	spin_unlock(&oldmm->mmap_lock);
+
+	if (ret) {
+		mmput(mm);
+		return NULL;
+	}
+	return mm;
+}
+
+void mmput(struct mm_struct *mm)
+{
+	if (__atomic_sub_fetch(&mm->mm_users, 1, __ATOMIC_ACQ_REL))
+		return;
+	spin_lock(&mmlist_lock);
+	list_del_init(&mm->mmlist);
+	spin_unlock(&mmlist_lock);
+	exit_mmap(mm);
+	free_page((unsigned long)mm->pgd);
+	kfree(mm);
+}
+
+/* A reference on @mm, unless its last one has already gone. */
+static bool mmget_not_zero(struct mm_struct *mm)
+{
+	int users = __atomic_load_n(&mm->mm_users, __ATOMIC_RELAXED);
+
+	do {
+		if (!users)
+			return false;
+	} while (!__atomic_compare_exchange_n(&mm->mm_users, &users,
+					      users + 1, false,
+					      __ATOMIC_ACQUIRE,
+					      __ATOMIC_RELAXED));
+	return true;
+}
+
+/**
+ * mm_next - the next live address space after @mm
+ * @mm: one held by the caller, or NULL to start from init_mm
+ *
+ * The reference on @mm keeps it on the list while the lock is dropped,
+ * and is given up once the next one is held.  Returns NULL, with no
+ * reference, after the last one.  Interrupts enabled: dropping @mm's
+ * reference may take it apart.
+ */
+struct mm_struct *mm_next(struct mm_struct *mm)
+{
+	struct mm_struct *next;
+
+	if (!mm) {
+		__atomic_add_fetch(&init_mm.mm_users, 1, __ATOMIC_RELAXED);
+		return &init_mm;
+	}
+
+	spin_lock(&mmlist_lock);
+	next = mm;
+	do {
+		next = list_entry(next->mmlist.next, struct mm_struct, mmlist);
+	} while (next != &init_mm && !mmget_not_zero(next));
+	spin_unlock(&mmlist_lock);
+
+	mmput(mm);
+	return next == &init_mm ? NULL : next;
+}
+
+void exit_mm(void)
+{
+	struct mm_struct *mm = current->mm;
+
+	if (!mm)
+		return;
+	preempt_disable();
+	current->mm = NULL;
+	switch_mm(mm, &init_mm);
+	preempt_enable();
+	mmput(mm);
+}
+
+struct task_struct *kernel_fork(int (*fn)(void *), void *data,
+				const char *name)
+{
+	struct task_struct *p;
+
+	p = kthread_create(fn, data, "%s", name);
+	if (!p)
+		return NULL;
+	p->mm = dup_mm(current->mm ?: &init_mm);
+	if (!p->mm) {
+		free_task(p);
+		return NULL;
+	}
+	p->flags &= ~PF_KTHREAD;
+	return p;
+}
+
+void fork_init(void)
+{
+	task_struct_cachep = kmem_cache_create("task_struct",
+					       sizeof(struct task_struct),
+					       SMP_CACHE_BYTES,
+					       SLAB_HWCACHE_ALIGN | SLAB_PANIC,
+					       NULL);
+}
@@ -0,0 +1,323 @@
+/*
+ * Fast user-space mutexes.
+ *
+ * A futex is any aligned 32-bit word.  Lock and condition variable
+ * implementations change it with atomic instructions and only come here
+ * to sleep until it changes (FUTEX_WAIT) or to wake those sleeping on it
+ * (FUTEX_WAKE), so an uncontended operation never enters the kernel.
+ *
+ * Waiters are kept in a fixed hash table of buckets, each a lock and a
+ * FIFO list, keyed by the word's address and, for private futexes, the
+ * address space.  FUTEX_WAIT checks the word under the bucket lock and
+ * queues itself before dropping it, and a waker takes the same lock to
+ * dequeue, so a change made before the wake can never be slept through.
+ * Each bucket also counts the tasks that are on their way into it or
+ * queued, so that a wake with nobody waiting takes no lock at all.
+ *
+ * The waker takes a waiter off its list and wakes it under the bucket
+ * lock; the waiter finds itself dequeued only by taking that lock, so its
+ * futex_q, which lives on its stack, is not touched once it has gone.
+ * FUTEX_REQUEUE moves waiters to another word's bucket instead of waking
+ * them, which is how a condition variable broadcast avoids waking every
+ * waiter only to have all but one go back to sleep on the mutex.
+ *
+ * Timeouts are timer wheel timers, through schedule_timeout().
+ */
+#include <zhos/kernel.h>
+#include <zhos/errno.h>
+#include <zhos/futex.h>
+#include <zhos/jiffies.h>
+#include <zhos/list.h>
+#include <zhos/mm_types.h>
+#include <zhos/percpu.h>
+#include <zhos/sched.h>
+#include <zhos/spinlock.h>
+
+#define FUTEX_HASH_BITS		8
+#define FUTEX_HASH_SIZE		(1U << FUTEX_HASH_BITS)
+
+struct futex_key {
+	struct mm_struct *mm;		/* NULL for a shared futex */
+	unsigned long addr;
+};
+
+struct futex_hash_bucket {
+	unsigned int waiters;
+	spinlock_t lock;
+	struct list_head chain;
+} __aligned(SMP_CACHE_BYTES);
+
+/* A waiting task, on its own stack. */
+struct futex_q {
+	struct list_head list;
+	struct task_struct *task;
+	struct futex_key key;
+	spinlock_t *lock_ptr;		/* its bucket's; changed by requeue */
+};
+
+static struct futex_hash_bucket futex_queues[FUTEX_HASH_SIZE];
+
+static int get_futex_key(u32 *uaddr, unsigned int flags,
+			 struct futex_key *key)
+{
+	unsigned long addr = (unsigned long)uaddr;
+
+	if (!uaddr || (addr & (sizeof(u32) - 1)))
+		return -EINVAL;
+	key->mm = NULL;
+	if (flags & FUTEX_PRIVATE_FLAG)
+		key->mm = current->mm ?: &init_mm;
+	key->addr = addr;
+	return 0;
+}
+
+static bool match_futex(const struct futex_key *a, const struct futex_key *b)
+{
+	return a->mm == b->mm && a->addr == b->addr;
+}
+
+static struct futex_hash_bucket *hash_futex(const struct futex_key *key)
+{
+	u64 h = (key->addr >> 2) ^ (unsigned long)key->mm;
+
+	h *= 0x61c8864680b583ebULL;
+	return &futex_queues[h >> (64 - FUTEX_HASH_BITS)];
+}
+
+/*
+ * The waiter's increment is ordered before its read of the word, and a
+ * waker's change of the word before its read of the count, so one of the
+ * two always sees the other.
+ */
+static void hb_waiters_inc(struct futex_hash_bucket *hb)
+{
+	__atomic_add_fetch(&hb->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+static void hb_waiters_dec(struct futex_hash_bucket *hb)
+{
+	__atomic_sub_fetch(&hb->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+static bool hb_waiters_pending(struct futex_hash_bucket *hb)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	return __atomic_load_n(&hb->waiters, __ATOMIC_RELAXED);
+}
+
+/* Called with the bucket lock held; the task is woken before it drops. */
+static void wake_futex(struct futex_hash_bucket *hb, struct futex_q *q)
+{
+	list_del_init(&q->list);
+	hb_waiters_dec(hb);
+	wake_up_process(q->task);
+}
+
+/* Lock the bucket @q is in, following it if it is requeued meanwhile. */
+static spinlock_t *futex_q_lock(struct futex_q *q)
+{
+	spinlock_t *lock;
+
+	for (;;) {
+		lock = READ_ONCE(q->lock_ptr);
+		spin_lock(lock);
+		if (lock == READ_ONCE(q->lock_ptr))
+			return lock;
+		spin_unlock(lock);
+	}
+}
+
+static long futex_wait(u32 *uaddr, unsigned int flags, u32 val,
+		       const u64 *timeout)
+{
+	struct futex_hash_bucket *hb;
+	struct futex_q q;
+	spinlock_t *lock;
+	long left = MAX_SCHEDULE_TIMEOUT;
+	int ret;
+
+	ret = get_futex_key(uaddr, flags, &q.key);
+	if (ret)
+		return ret;
+	if (timeout) {
+		/* A tick boundary may be just ahead; the +1 covers it. */
+		left = min(nsecs_to_jiffies(*timeout) + 1,
+			   (u64)MAX_SCHEDULE_TIMEOUT - 1);
+	}
+
+	hb = hash_futex(&q.key);
+	hb_waiters_inc(hb);
+	spin_lock(&hb->lock);
+	if (READ_ONCE(*uaddr) != val) {
+		spin_unlock(&hb->lock);
+		hb_waiters_dec(hb);
+		return -EAGAIN;
+	}
+	q.task = current;
+	q.lock_ptr = &hb->lock;
+	list_add_tail(&q.list, &hb->chain);
+	set_current_state(TASK_INTERRUPTIBLE);
+	spin_unlock(&hb->lock);
+
+	for (;;) {
+		left = schedule_timeout(left);
+		lock = futex_q_lock(&q);
+		if (list_empty(&q.list)) {
+			spin_unlock(lock);
+			return 0;
+		}
+		if (!left) {
+			list_del_init(&q.list);
+			hb_waiters_dec(container_of(lock, struct futex_hash_bucket,
+						    lock));
+			spin_unlock(lock);
+			return -ETIMEDOUT;
+		}
+		/* Woken by something else: back to sleep, still queued. */
+		set_current_state(TASK_INTERRUPTIBLE);
+		spin_unlock(lock);
+	}
+}
+
+static long futex_wake(u32 *uaddr, unsigned int flags, u32 nr_wake)
+{
+	struct futex_hash_bucket *hb;
+	struct futex_q *q, *next;
+	struct futex_key key;
+	long ret;
+
+	ret = get_futex_key(uaddr, flags, &key);
+	if (ret)
+		return ret;
+	hb = hash_futex(&key);
+	if (!hb_waiters_pending(hb) || !nr_wake)
+		return 0;
+
+	spin_lock(&hb->lock);
+	list_for_each_entry_safe(q, next, &hb->chain, list) {
+		if (!match_futex(&q->key, &key))
+			continue;
+		wake_futex(hb, q);
+		if (++ret == nr_wake)
+			break;
+	}
+	spin_unlock(&hb->lock);
+	return ret;
+}
+
+static void double_lock_hb(struct futex_hash_bucket *hb1,
+			   struct futex_hash_bucket *hb2)
+{
+	/* In address order, against a requeue the other way round. */
+	if (hb1 > hb2) {
+		spin_lock(&hb2->lock);
+		spin_lock(&hb1->lock);
+	} else {
+		spin_lock(&hb1->lock);
+		if (hb1 != hb2)
+			spin_lock(&hb2->lock);
+	}
+}
+
+static void double_unlock_hb(struct futex_hash_bucket *hb1,
+			     struct futex_hash_bucket *hb2)
+{
+	spin_unlock(&hb1->lock);
+	if (hb1 != hb2)
+		spin_unlock(&hb2->lock);
+}
+
+/*
+ * Wake @nr_wake waiters on @uaddr and move up to @nr_requeue more onto
+ * @uaddr2.  With @cmpval, only if @uaddr still holds *@cmpval.
+ */
+static long futex_requeue(u32 *uaddr, unsigned int flags, u32 *uaddr2,
+			  u32 nr_wake, u32 nr_requeue, const u32 *cmpval)
+{
+	struct futex_hash_bucket *hb1, *hb2;
+	struct futex_key key1, key2;
+	struct futex_q *q, *next;
+	u32 woken = 0, moved = 0;
+	long ret;
+
+	ret = get_futex_key(uaddr, flags, &key1);
+	if (!ret)
+		ret = get_futex_key(uaddr2, flags, &key2);
+	if (ret)
+		return ret;
+	hb1 = hash_futex(&key1);
+	hb2 = hash_futex(&key2);
+	if (!cmpval && !hb_waiters_pending(hb1))
+		return 0;
+
+	double_lock_hb(hb1, hb2);
+	if (cmpval && READ_ONCE(*uaddr) != *cmpval) {
+		double_unlock_hb(hb1, hb2);
+		return -EAGAIN;
+	}
+	list_for_each_entry_safe(q, next, &hb1->chain, list) {
+		if (!match_futex(&q->key, &key1))
+			continue;
+		if (woken < nr_wake) {
+			wake_futex(hb1, q);
+			woken++;
+			continue;
+		}
+		if (moved == nr_requeue)
+			break;
+		q->key = key2;
+		if (hb1 != hb2) {
+			list_move_tail(&q->list, &hb2->chain);
+			hb_waiters_inc(hb2);
+			hb_waiters_dec(hb1);
+			WRITE_ONCE(q->lock_ptr, &hb2->lock);
+		}
+		moved++;
+	}
+	double_unlock_hb(hb1, hb2);
+	return woken + moved;
+}
+
+/**
+ * do_futex - the futex system call
+ * @uaddr: the futex word
+ * @op: FUTEX_* operation, or'ed with FUTEX_PRIVATE_FLAG
+ * @val: WAIT: the value the word must hold; otherwise waiters to wake
+ * @timeout: WAIT: relative timeout in nanoseconds, NULL for none
+ * @uaddr2: REQUEUE: the word to move waiters to
+ * @val2: REQUEUE: waiters to move at most
+ * @val3: CMP_REQUEUE: the value @uaddr must hold
+ *
+ * WAIT returns 0 once woken, -EAGAIN if the word did not hold @val and
+ * -ETIMEDOUT if @timeout ran out; callers re-check the word whatever it
+ * returns.  WAKE and REQUEUE return the waiters woken, plus those moved.
+ */
+long do_futex(u32 *uaddr, int op, u32 val, const u64 *timeout, u32 *uaddr2,
+	      u32 val2, u32 val3)
+{
+	unsigned int flags = op & FUTEX_PRIVATE_FLAG;
+
+	switch (op & FUTEX_CMD_MASK) {
+	case FUTEX_WAIT:
+		return futex_wait(uaddr, flags, val, timeout);
+	case FUTEX_WAKE:
+		return futex_wake(uaddr, flags, val);
+	case FUTEX_REQUEUE:
+		return futex_requeue(uaddr, flags, uaddr2, val, val2, NULL);
+	case FUTEX_CMP_REQUEUE:
+		return futex_requeue(uaddr, flags, uaddr2, val, val2, &val3);
+	default:
+		return -ENOSYS;
+	}
+}
+
+void futex_init(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < FUTEX_HASH_SIZE; i++) {
+		futex_queues[i].waiters = 0;
+		spin_lock_init(&futex_queues[i].lock);
+		INIT_LIST_HEAD(&futex_queues[i].chain);
+	}
+}
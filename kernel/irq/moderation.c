@@ -0,0 +1,109 @@
+/*
+ * Interrupt moderation: interrupt per event at low rates, timer-driven
+ * polling with the interrupt masked at high ones.
+ *
+ * The event rate is measured over windows of at least IRQ_MOD_WINDOW_NS,
+ * closed whenever the driver completes a poll, and smoothed over the last
+ * few windows; a window that follows a long quiet spell replaces the
+ * average outright.  Moving between the modes is damped by the gap
+ * between the high and low thresholds.  While polling, the next poll is
+ * due after the time @batch events take at the current rate, so that each
+ * poll has enough to amortise its cost, but never later than @max_ns.
+ *
+ * "irqmod=off" on the command line keeps every device on interrupts.
+ */
+#include <zhos/kernel.h>
+#include <zhos/cmdline.h>
+#include <zhos/hrtimer.h>
+#include <zhos/irq_moderation.h>
+#include <zhos/string.h>
+#include <zhos/timekeeping.h>
+
+#define IRQ_MOD_WINDOW_NS	(1 * NSEC_PER_MSEC)
+#define IRQ_MOD_QUIET_NS	(10 * NSEC_PER_MSEC)
+#define IRQ_MOD_EWMA		4
+
+#define IRQ_MOD_HIGH_RATE	20000
+#define IRQ_MOD_LOW_RATE	5000
+#define IRQ_MOD_BATCH		16
+#define IRQ_MOD_MIN_NS		(20 * NSEC_PER_USEC)
+#define IRQ_MOD_MAX_NS		(200 * NSEC_PER_USEC)
+
+static void irq_mod_timer_fn(struct hrtimer *timer)
+{
+	struct irq_moderation *mod = container_of(timer, struct irq_moderation,
+						  timer);
+
+	mod->poll(mod);
+}
+
+/*
+ * The defaults suit a NIC; a driver may change the thresholds after
+ * this, before its interrupt is enabled.
+ */
+void irq_mod_init(struct irq_moderation *mod,
+		  void (*poll)(struct irq_moderation *mod))
+{
+	char val[8];
+
+	hrtimer_init(&mod->timer, irq_mod_timer_fn);
+	mod->poll = poll;
+	mod->high_rate = IRQ_MOD_HIGH_RATE;
+	mod->low_rate = IRQ_MOD_LOW_RATE;
+	mod->batch = IRQ_MOD_BATCH;
+	mod->min_ns = IRQ_MOD_MIN_NS;
+	mod->max_ns = IRQ_MOD_MAX_NS;
+
+	mod->enabled = cmdline_get("irqmod", val, sizeof(val)) ||
+		       strcmp(val, "off");
+	mod->polling = false;
+	mod->rate = 0;
+	mod->window_start = clock_now_ns();
+	mod->window_events = 0;
+}
+
+static void irq_mod_update_rate(struct irq_moderation *mod, u64 now)
+{
+	u64 elapsed = now - mod->window_start, sample;
+
+	if (elapsed < IRQ_MOD_WINDOW_NS)
+		return;
+
+	sample = (u64)mod->window_events * NSEC_PER_SEC / elapsed;
+	if (elapsed >= IRQ_MOD_QUIET_NS)
+		mod->rate = sample;
+	else
+		mod->rate = (mod->rate * (IRQ_MOD_EWMA - 1) + sample) /
+			    IRQ_MOD_EWMA;
+	mod->window_start = now;
+	mod->window_events = 0;
+}
+
+/**
+ * irq_mod_complete - the driver's poll found no more work
+ * @mod: the device's moderation state
+ *
+ * Returns true if the driver should unmask its interrupt.  Otherwise the
+ * next poll has been armed on this CPU and the interrupt must stay off.
+ */
+bool irq_mod_complete(struct irq_moderation *mod)
+{
+	u64 now, interval;
+
+	if (!mod->enabled)
+		return true;
+
+	now = clock_now_ns();
+	irq_mod_update_rate(mod, now);
+	if (!mod->polling && mod->rate >= mod->high_rate)
+		mod->polling = true;
+	else if (mod->polling && mod->rate < mod->low_rate)
+		mod->polling = false;
+	if (!mod->polling)
+		return true;
+
+	interval = (u64)mod->batch * NSEC_PER_SEC / max(mod->rate, 1ULL);
+	interval = clamp(interval, (u64)mod->min_ns, (u64)mod->max_ns);
+	hrtimer_start(&mod->timer, now + interval);
+	return false;
+}
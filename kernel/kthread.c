@@ -0,0 +1,40 @@
+/*
+ * Kernel threads.
+ */
+#include <zhos/kernel.h>
+#include <zhos/cpumask.h>
+#include <zhos/kthread.h>
+#include <zhos/sched.h>
+#include <zhos/smp.h>
+#include <asm/switch_to.h>
+
+struct task_struct *kthread_create(int (*fn)(void *), void *data,
+				   const char *namefmt, ...)
+{
+	struct task_struct *p;
+	va_list args;
+
+	p = alloc_task();
+	if (!p)
+		return NULL;
+
+	va_start(args, namefmt);
+	vsnprintf(p->comm, sizeof(p->comm), namefmt, args);
+	va_end(args);
+
+	p->state = TASK_INTERRUPTIBLE;
+	p->flags = PF_KTHREAD;
+	p->prio = DEFAULT_PRIO;
+	p->cpu = smp_processor_id();
+	p->cpus_allowed = *cpu_possible_mask;
+	copy_thread(p, fn, data);
+	return p;
+}
+
+void kthread_bind(struct task_struct *p, unsigned int cpu)
+{
+	WARN_ON(p->on_rq);
+	p->cpus_allowed = (struct cpumask){ };
+	cpumask_set_cpu(cpu, &p->cpus_allowed);
+	p->cpu = cpu;
+}
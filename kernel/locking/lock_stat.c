@@ -0,0 +1,115 @@
+/*
+ * Lock contention statistics, for CONFIG_LOCK_STAT=1 builds.
+ *
+ * Locks are counted by class, the place they were initialised at, so
+ * that the numbers for, say, every run queue lock come out as one line.
+ * A class joins the lock_classes list, which is never pruned, the first
+ * time one of its locks is taken.  The counters are updated with relaxed
+ * atomics from any CPU and read without stopping anyone; a dump taken
+ * while locks are busy is a snapshot, not a consistent cut.
+ *
+ * lock_stat_dump() prints the classes that have waited, the most cycles
+ * first, and is run at the end of the benchmarks; without lock
+ * statistics it says only that there are none.
+ */
+#define pr_fmt(fmt) "lock_stat: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/spinlock.h>
+
+#if CONFIG_LOCK_STAT
+#define LOCK_STAT_LINES		32
+
+static struct lock_class *lock_classes;
+
+void lock_class_register(struct lock_class *class)
+{
+	struct lock_class *head;
+
+	if (__atomic_exchange_n(&class->registered, true, __ATOMIC_RELAXED))
+		return;
+	head = __atomic_load_n(&lock_classes, __ATOMIC_RELAXED);
+	do {
+		class->next = head;
+	} while (!__atomic_compare_exchange_n(&lock_classes, &head, class,
+					      false, __ATOMIC_RELEASE,
+					      __ATOMIC_RELAXED));
+}
+
+void lock_stat_contended(spinlock_t *lock, u64 cycles)
+{
+	struct lock_class *class = lock->class;
+	u64 max;
+
+	if (!class)
+		return;
+	lock_stat_acquired(lock);
+	__atomic_add_fetch(&class->contended, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&class->wait_cycles, cycles, __ATOMIC_RELAXED);
+	max = __atomic_load_n(&class->max_wait, __ATOMIC_RELAXED);
+	while (cycles > max &&
+	       !__atomic_compare_exchange_n(&class->max_wait, &max, cycles,
+					    false, __ATOMIC_RELAXED,
+					    __ATOMIC_RELAXED))
+		;
+}
+
+/* The LOCK_STAT_LINES classes that waited longest, most cycles first. */
+void lock_stat_dump(void)
+{
+	struct lock_class *top[LOCK_STAT_LINES], *class;
+	unsigned int n = 0, i, waited = 0;
+	u64 w;
+
+	for (class = __atomic_load_n(&lock_classes, __ATOMIC_ACQUIRE); class;
+	     class = class->next) {
+		if (!READ_ONCE(class->contended))
+			continue;
+		waited++;
+		w = READ_ONCE(class->wait_cycles);
+		if (n < LOCK_STAT_LINES)
+			n++;
+		else if (w <= top[n - 1]->wait_cycles)
+			continue;
+		for (i = n - 1; i > 0 && top[i - 1]->wait_cycles < w; i--)
+			top[i] = top[i - 1];
+		top[i] = class;
+	}
+
+	pr_info("%u of the classes taken have waited\n", waited);
+	printk("%-32s %12s %10s %14s %10s %10s\n", "class", "acquired",
+	       "contended", "wait cycles", "avg", "max");
+	for (i = 0; i < n; i++) {
+		class = top[i];
+		printk("%-32s %12llu %10llu %14llu %10llu %10llu\n",
+		       class->name, (unsigned long long)class->acquired,
+		       (unsigned long long)class->contended,
+		       (unsigned long long)class->wait_cycles,
+		       (unsigned long long)(class->wait_cycles /
+					    class->contended),
+		       (unsigned long long)class->max_wait);
+	}
+}
+
+void lock_stat_reset(void)
+{
+	struct lock_class *class;
+
+	for (class = __atomic_load_n(&lock_classes, __ATOMIC_ACQUIRE); class;
+	     class = class->next) {
+		WRITE_ONCE(class->acquired, 0);
+		WRITE_ONCE(class->contended, 0);
+		WRITE_ONCE(class->wait_cycles, 0);
+		WRITE_ONCE(class->max_wait, 0);
+	}
+}
+#else
+void lock_stat_dump(void)
+{
+	pr_info("not built in (make CONFIG_LOCK_STAT=1)\n");
+}
+
+void lock_stat_reset(void)
+{
+}
+#endif
@@ -0,0 +1,98 @@
+/*
+ * Queued spinlock slow path.
+ *
+ * Each CPU has one MCS node per context that can take a spinlock while
+ * another context on the same CPU is waiting for one: task, interrupt
+ * and a nested interrupt, plus one in reserve.  A waiter claims the next
+ * node, swaps its name into the lock's tail and, if there was a waiter
+ * before it, links itself behind that one and spins on its own node's
+ * flag.  At the head of the queue it waits for the lock byte to clear,
+ * then either takes the lock and empties the queue in one exchange, if
+ * it is still the tail, or takes the lock and passes the head on to the
+ * next node once that has linked itself in.
+ *
+ * Only the head sets the lock byte while the tail is set, so it can do
+ * so with a plain store: everyone else tries for a lock word of 0.
+ */
+#include <zhos/kernel.h>
+#include <zhos/percpu.h>
+#include <zhos/smp.h>
+#include <zhos/spinlock.h>
+#include <asm/processor.h>
+#include <asm/tsc.h>
+
+#define MAX_NODES	4
+
+struct mcs_spinlock {
+	struct mcs_spinlock *next;
+	int locked;			/* 1 once we are the head */
+	int count;			/* nodes in use; node 0's only */
+};
+
+static DEFINE_PER_CPU_ALIGNED(struct mcs_spinlock, qnodes[MAX_NODES]);
+
+static u16 encode_tail(unsigned int cpu, unsigned int idx)
+{
+	return (cpu + 1) << 2 | idx;
+}
+
+static struct mcs_spinlock *decode_tail(u16 tail)
+{
+	unsigned int cpu = (tail >> 2) - 1, idx = tail & 3;
+
+	return per_cpu_ptr(&qnodes[idx], cpu);
+}
+
+void queued_spin_lock_slowpath(spinlock_t *lock)
+{
+	struct mcs_spinlock *node, *prev, *next;
+	u64 start = 0;
+	u16 tail, old;
+	u32 val;
+	int idx;
+
+	if (CONFIG_LOCK_STAT)
+		start = rdtsc();
+
+	node = this_cpu_ptr(&qnodes[0]);
+	idx = node->count++;
+	if (unlikely(idx >= MAX_NODES)) {
+		/* Nested deeper than we have nodes for: spin on the word. */
+		while (!__spin_trylock(lock))
+			cpu_relax();
+		goto release;
+	}
+	tail = encode_tail(smp_processor_id(), idx);
+	node += idx;
+	node->locked = 0;
+	node->next = NULL;
+
+	/* The node is initialised before anyone can find it through tail. */
+	old = __atomic_exchange_n(&lock->tail, tail, __ATOMIC_RELEASE);
+	if (old) {
+		prev = decode_tail(old);
+		WRITE_ONCE(prev->next, node);
+		while (!__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE))
+			cpu_relax();
+	}
+
+	/* Head of the queue: wait for the owner to go. */
+	while (__atomic_load_n(&lock->locked, __ATOMIC_ACQUIRE))
+		cpu_relax();
+
+	val = (u32)tail << 16;
+	if (__atomic_compare_exchange_n(&lock->val, &val, _Q_LOCKED_VAL, false,
+					__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		goto release;
+
+	/* Someone queued behind us: take the lock, then wake them. */
+	WRITE_ONCE(lock->locked, 1);
+	while (!(next = READ_ONCE(node->next)))
+		cpu_relax();
+	__atomic_store_n(&next->locked, 1, __ATOMIC_RELEASE);
+
+release:
+	this_cpu_ptr(&qnodes[0])->count--;
+	if (CONFIG_LOCK_STAT)
+		lock_stat_contended(lock, rdtsc() - start);
+}
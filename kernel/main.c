@@ -0,0 +1,102 @@
+/*
+ * Kernel entry after the switch to long mode (arch/x86/boot/header.S).
+ *
+ * The boot CPU sets up the core of the kernel, starts the other CPUs and
+ * goes idle.  An init thread does the rest: each driver probes its
+ * devices in a thread of its own, the subsystems nothing at boot waits
+ * for start meanwhile, and the benchmarks, the closest thing to a first
+ * user process, start once all of that is done.
+ */
+#include <zhos/kernel.h>
+#include <zhos/async.h>
+#include <zhos/bench.h>
+#include <zhos/blk-mq.h>
+#include <zhos/blkdev.h>
+#include <zhos/console.h>
+#include <zhos/futex.h>
+#include <zhos/gfp.h>
+#include <zhos/huge_mm.h>
+#include <zhos/initrd.h>
+#include <zhos/io_uring.h>
+#include <zhos/kthread.h>
+#include <zhos/netdevice.h>
+#include <zhos/pagemap.h>
+#include <zhos/pci.h>
+#include <zhos/profile.h>
+#include <zhos/radix-tree.h>
+#include <zhos/rcupdate.h>
+#include <zhos/sched.h>
+#include <zhos/slab.h>
+#include <zhos/smp.h>
+#include <zhos/softirq.h>
+#include <zhos/timekeeping.h>
+#include <zhos/timer.h>
+#include <zhos/trace.h>
+#include <asm/fpu.h>
+#include <asm/irqflags.h>
+#include <asm/perf_event.h>
+#include <asm/setup.h>
+#include <asm/string.h>
+
+void __noreturn start_kernel(u32 magic, u32 mbi_phys);
+
+static void e1000_init_async(void *unused)
+{
+	e1000_init();
+}
+
+static void virtio_blk_init_async(void *unused)
+{
+	virtio_blk_init();
+}
+
+static int kernel_init(void *unused)
+{
+	pci_init();
+	async_schedule(e1000_init_async, NULL, "e1000");
+	async_schedule(virtio_blk_init_async, NULL, "virtio_blk");
+
+	page_writeback_init();
+	hugepage_init();
+	io_uring_init();
+
+	async_synchronize_full();
+	pr_info("init: done %llu ms after boot\n",
+		(unsigned long long)(clock_now_ns() / NSEC_PER_MSEC));
+	bench_init();
+	return 0;
+}
+
+void __noreturn start_kernel(u32 magic, u32 mbi_phys)
+{
+	serial8250_console_init();
+	printk("zhos (zihan_os) booting\n");
+	boot_cpu_init();
+
+	setup_arch(magic, mbi_phys);
+	page_alloc_init();
+	kmem_cache_init();
+	radix_tree_init();
+	pagecache_init();
+	initrd_init();
+	blk_mq_init();
+	sched_init();
+	fork_init();
+	fpu_init();
+	perf_init();
+	string_init();
+	futex_init();
+	rcu_init();
+	trace_init();
+	init_timers();
+	time_init();
+
+	local_irq_enable();
+	smp_init();
+	softirq_init();
+	profile_init();
+	net_init();
+	if (!kthread_run(kernel_init, NULL, "init"))
+		panic("cannot create the init thread");
+	cpu_idle_loop();
+}
@@ -0,0 +1,21 @@
+#include <zhos/kernel.h>
+#include <zhos/trace.h>
+#include <asm/irqflags.h>
+
+void __noreturn panic(const char *fmt, ...)
+{
+	va_list args;
+
+	local_irq_disable();
+	printk("\nKernel panic: ");
+	va_start(args, fmt);
+	vprintk(fmt, args);
+	va_end(args);
+	printk("\n");
+
+	if (READ_ONCE(tracing_enabled))
+		trace_dump();
+
+	for (;;)
+		halt();
+}
@@ -0,0 +1,46 @@
+/*
+ * printk: format into a bounded buffer and hand it to every registered
+ * console.
+ */
+#include <zhos/kernel.h>
+#include <zhos/console.h>
+#include <zhos/spinlock.h>
+
+#define PRINTK_BUF_SIZE	512
+
+static struct console *console_list;
+static DEFINE_SPINLOCK(printk_lock);
+
+void register_console(struct console *con)
+{
+	con->next = console_list;
+	console_list = con;
+}
+
+int vprintk(const char *fmt, va_list args)
+{
+	static char buf[PRINTK_BUF_SIZE];
+	struct console *con;
+	unsigned long flags;
+	int len;
+
+	spin_lock_irqsave(&printk_lock, flags);
+	len = vsnprintf(buf, sizeof(buf), fmt, args);
+	if (len >= (int)sizeof(buf))
+		len = sizeof(buf) - 1;
+	for (con = console_list; con; con = con->next)
+		con->write(con, buf, len);
+	spin_unlock_irqrestore(&printk_lock, flags);
+	return len;
+}
+
+int printk(const char *fmt, ...)
+{
+	va_list args;
+	int len;
+
+	va_start(args, fmt);
+	len = vprintk(fmt, args);
+	va_end(args);
+	return len;
+}
@@ -0,0 +1,230 @@
+/*
+ * Sampling profiler.
+ *
+ * Every CPU runs a periodic hrtimer.  Its callback looks at the register
+ * frame of the interrupt it runs from, which is the interrupted context,
+ * and writes the instruction pointer and up to PROFILE_MAX_DEPTH return
+ * addresses into the CPU's trace ring: one TRACE_PROFILE_SAMPLE record,
+ * then a TRACE_PROFILE_STACK record per two return addresses.  The
+ * records go in whether or not tracing is on, and the callback runs with
+ * interrupts off, so a sample's records are always consecutive.
+ *
+ * The call chain is followed through the saved frame pointers (the kernel
+ * is built with -fno-omit-frame-pointer).  A frame must lie above the
+ * previous one and within the interrupted stack, and the walk ends at the
+ * first return address outside kernel text.  An interrupt that lands in
+ * a prologue, before the frame is set up, loses its immediate caller.
+ *
+ * Being a timer, the profiler cannot see into code that runs with
+ * interrupts off: its samples pile up on the instruction that turns them
+ * back on.  The default rate is a prime so that sampling does not run in
+ * step with the tick.
+ *
+ * Instead of the timer, the overflow of a hardware counter can take the
+ * samples, once every so many cycles, cache misses or branch misses
+ * (arch/x86/kernel/perf_event.c), so that they land where those events
+ * happen rather than where the time goes.  The records are the same.
+ *
+ * "profile" on the command line starts it at boot, "profile=N" at N Hz,
+ * and "profile=EVENT" every PROFILE_DEFAULT_PERIOD events, or every
+ * "profile_period=N".
+ */
+#define pr_fmt(fmt) "profile: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/cmdline.h>
+#include <zhos/cpumask.h>
+#include <zhos/errno.h>
+#include <zhos/hrtimer.h>
+#include <zhos/perf_event.h>
+#include <zhos/percpu.h>
+#include <zhos/preempt.h>
+#include <zhos/profile.h>
+#include <zhos/sched.h>
+#include <zhos/smp.h>
+#include <zhos/timekeeping.h>
+#include <zhos/trace.h>
+#include <asm/irq_regs.h>
+#include <asm/ptrace.h>
+
+#define PROFILE_DEFAULT_HZ	997
+#define PROFILE_MAX_HZ		100000
+#define PROFILE_MAX_DEPTH	16
+#define PROFILE_DEFAULT_PERIOD	1000003
+
+extern char _text[], _etext[];
+
+static DEFINE_PER_CPU(struct hrtimer, profile_timers);
+static u64 profile_period;		/* ns; 0 while stopped */
+static bool profile_events;		/* sampling on counter overflow */
+
+static bool kernel_text_address(unsigned long addr)
+{
+	return addr >= (unsigned long)_text && addr < (unsigned long)_etext;
+}
+
+static unsigned int profile_walk(const struct pt_regs *regs, u64 *stack)
+{
+	struct task_struct *curr = current;
+	unsigned long lo = regs->rsp, hi = lo + THREAD_SIZE;
+	unsigned long fp = regs->rbp, ret;
+	unsigned int n = 0;
+
+	if (user_mode(regs))
+		return 0;
+	if (curr && curr->stack && lo - (unsigned long)curr->stack < THREAD_SIZE)
+		hi = (unsigned long)curr->stack + THREAD_SIZE;
+
+	/* A frame holds the caller's frame pointer, then the return address. */
+	while (n < PROFILE_MAX_DEPTH && fp >= lo && fp + 16 <= hi && !(fp & 7)) {
+		ret = ((unsigned long *)fp)[1];
+		if (!kernel_text_address(ret))
+			break;
+		stack[n++] = ret;
+		lo = fp + 16;
+		fp = ((unsigned long *)fp)[0];
+	}
+	return n;
+}
+
+/* Interrupts disabled; @regs is the frame of the interrupted context. */
+void profile_sample(const struct pt_regs *regs)
+{
+	u64 stack[PROFILE_MAX_DEPTH];
+	unsigned int n, i;
+
+	n = profile_walk(regs, stack);
+	__trace_event(TRACE_PROFILE_SAMPLE, regs->rip, n);
+	for (i = 0; i < n; i += 2)
+		__trace_event(TRACE_PROFILE_STACK, stack[i],
+			      i + 1 < n ? stack[i + 1] : 0);
+}
+
+static void profile_tick(struct hrtimer *timer)
+{
+	u64 period = READ_ONCE(profile_period), next, now;
+	struct pt_regs *regs = get_irq_regs();
+
+	if (!period)
+		return;
+
+	if (regs)
+		profile_sample(regs);
+
+	/* Periods missed with interrupts off are dropped, not caught up. */
+	now = clock_now_ns();
+	next = timer->expires + period;
+	if ((s64)(next - now) <= 0)
+		next = now + period;
+	hrtimer_start(timer, next);
+}
+
+static void profile_start_cpu(void *info)
+{
+	hrtimer_start_ns(this_cpu_ptr(&profile_timers), profile_period);
+}
+
+/**
+ * profile_start - start sampling
+ * @hz: samples per second and CPU
+ *
+ * Where the tick device has no one-shot mode the rate is capped at HZ.
+ * Returns -EBUSY if the profiler is already running.
+ */
+int profile_start(unsigned int hz)
+{
+	if (!hz || hz > PROFILE_MAX_HZ)
+		return -EINVAL;
+	if (READ_ONCE(profile_period) || READ_ONCE(profile_events))
+		return -EBUSY;
+
+	WRITE_ONCE(profile_period, NSEC_PER_SEC / hz);
+	preempt_disable();
+	profile_start_cpu(NULL);
+	preempt_enable();
+	smp_call_function(profile_start_cpu, NULL);
+	return 0;
+}
+
+/**
+ * profile_start_event - start sampling on counter overflow
+ * @event: PERF_COUNT_HW_* to sample on
+ * @period: events between samples on each CPU
+ *
+ * Returns -ENODEV without hardware counters, -EBUSY if the profiler is
+ * already running.
+ */
+int profile_start_event(unsigned int event, u64 period)
+{
+	int ret;
+
+	if (READ_ONCE(profile_period) || READ_ONCE(profile_events))
+		return -EBUSY;
+	ret = perf_sample_start(event, period);
+	if (!ret)
+		WRITE_ONCE(profile_events, true);
+	return ret;
+}
+
+void profile_stop(void)
+{
+	unsigned int cpu;
+
+	if (READ_ONCE(profile_events)) {
+		perf_sample_stop();
+		WRITE_ONCE(profile_events, false);
+	}
+	WRITE_ONCE(profile_period, 0);
+	/* A callback that still saw a period has re-armed; take it out. */
+	for_each_possible_cpu(cpu)
+		hrtimer_cancel(per_cpu_ptr(&profile_timers, cpu));
+}
+
+void profile_dump(void)
+{
+	if (!READ_ONCE(profile_period) && !READ_ONCE(profile_events))
+		return;
+	profile_stop();
+	trace_dump();
+}
+
+void profile_init(void)
+{
+	unsigned int cpu, hz = PROFILE_DEFAULT_HZ;
+	u64 period = PROFILE_DEFAULT_PERIOD;
+	char opt[24];
+	int ret, event = -EINVAL;
+
+	for_each_possible_cpu(cpu)
+		hrtimer_init(per_cpu_ptr(&profile_timers, cpu), profile_tick);
+
+	if (!cmdline_has("profile"))
+		return;
+	if (!cmdline_get("profile", opt, sizeof(opt))) {
+		event = perf_event_lookup(opt);
+		if (event < 0)
+			hz = simple_strtoull(opt, NULL, 0);
+	}
+
+	if (event < 0) {
+		ret = profile_start(hz);
+		if (ret)
+			pr_warn("cannot sample at %u Hz: %d\n", hz, ret);
+		else
+			pr_info("sampling at %u Hz on %u cpus\n", hz,
+				num_online_cpus());
+		return;
+	}
+
+	if (!cmdline_get("profile_period", opt, sizeof(opt)))
+		period = simple_strtoull(opt, NULL, 0);
+	ret = profile_start_event(event, period);
+	if (ret)
+		pr_warn("cannot sample every %llu %s: %d\n",
+			(unsigned long long)period, perf_hw_event_names[event],
+			ret);
+	else
+		pr_info("sampling every %llu %s on %u cpus\n",
+			(unsigned long long)period, perf_hw_event_names[event],
+			num_online_cpus());
+}
@@ -0,0 +1,395 @@
+/*
+ * Read-copy-update.
+ *
+ * Grace periods are numbered by rcu_state.gp_seq, odd while one is in
+ * progress.  The rcu_gp thread starts one when callbacks are waiting,
+ * with every online CPU in qsmask; a CPU clears its bit on its first
+ * quiescent state after that - a context switch, or a tick that did not
+ * interrupt a read-side section - and the last to do so ends it.  A CPU
+ * in the idle loop cannot be reading: its dynticks counter is odd there,
+ * and every idle entry, idle exit and interrupt taken from idle bumps it,
+ * so the thread clears idle CPUs itself by comparing the counter against
+ * a snapshot from the start of the grace period, rescanning every
+ * RCU_FQS_JIFFIES until none are left.  Sleeping CPUs are never woken.
+ *
+ * call_rcu() queues on the calling CPU, tagged with the grace period
+ * whose end makes the callback safe; each CPU's list is in segments:
+ * done, waiting for the current grace period, waiting for the next.
+ * After each grace period the thread raises RCU_SOFTIRQ on every CPU
+ * whose list now has callbacks done, and each CPU invokes its own, in a
+ * batch, from the softirq.
+ */
+#define pr_fmt(fmt) "rcu: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/cpumask.h>
+#include <zhos/jiffies.h>
+#include <zhos/kthread.h>
+#include <zhos/percpu.h>
+#include <zhos/rcupdate.h>
+#include <zhos/sched.h>
+#include <zhos/slab.h>
+#include <zhos/smp.h>
+#include <zhos/softirq.h>
+#include <zhos/spinlock.h>
+#include <zhos/wait.h>
+#include <asm/barrier.h>
+#include <asm/irqflags.h>
+
+#define RCU_FQS_JIFFIES		max(1, HZ / 250)
+
+enum {
+	RCU_DONE_TAIL,
+	RCU_WAIT_TAIL,
+	RCU_NEXT_TAIL,
+	RCU_CBLIST_NSEGS,
+};
+
+struct rcu_data {
+	spinlock_t lock;		/* callbacks; interrupts off */
+	struct rcu_head *cblist;
+	struct rcu_head **tails[RCU_CBLIST_NSEGS];
+	unsigned long gp_seq[RCU_CBLIST_NSEGS];	/* wait, next: safe at */
+
+	unsigned long dynticks;		/* odd in the idle loop */
+	bool dynticks_irq;		/* this interrupt came from idle */
+	unsigned long dynticks_snap;	/* rcu_gp's, at grace period start */
+};
+
+static DEFINE_PER_CPU_ALIGNED(struct rcu_data, rcu_data);
+
+static struct rcu_state {
+	spinlock_t lock;		/* qsmask, gp_seq writes; interrupts off */
+	unsigned long gp_seq;
+	struct cpumask qsmask;		/* CPUs yet to pass a quiescent state */
+	bool gp_needed;
+	struct wait_queue_head gp_wq;
+} rcu_state = {
+	.lock = __SPIN_LOCK_UNLOCKED(rcu_state.lock),
+	.gp_wq = __WAIT_QUEUE_HEAD_INITIALIZER(rcu_state.gp_wq),
+};
+
+static DECLARE_WAIT_QUEUE_HEAD(rcu_sync_wq);
+
+/* The grace period whose end makes safe whatever is queued now. */
+static unsigned long rcu_seq_snap(void)
+{
+	return (READ_ONCE(rcu_state.gp_seq) + 3) & ~1UL;
+}
+
+static bool rcu_seq_done(unsigned long s)
+{
+	return (long)(READ_ONCE(rcu_state.gp_seq) - s) >= 0;
+}
+
+static bool rcu_segcblist_empty(struct rcu_data *rdp, int seg)
+{
+	return rdp->tails[seg] == rdp->tails[seg - 1];
+}
+
+/* Caller holds rdp->lock. */
+static void rcu_advance_cbs(struct rcu_data *rdp)
+{
+	if (!rcu_segcblist_empty(rdp, RCU_WAIT_TAIL) &&
+	    rcu_seq_done(rdp->gp_seq[RCU_WAIT_TAIL]))
+		rdp->tails[RCU_DONE_TAIL] = rdp->tails[RCU_WAIT_TAIL];
+	if (!rcu_segcblist_empty(rdp, RCU_NEXT_TAIL) &&
+	    rcu_seq_done(rdp->gp_seq[RCU_NEXT_TAIL]))
+		rdp->tails[RCU_DONE_TAIL] = rdp->tails[RCU_WAIT_TAIL] =
+			rdp->tails[RCU_NEXT_TAIL];
+
+	/* Keep the wait segment the older one. */
+	if (rdp->tails[RCU_WAIT_TAIL] == rdp->tails[RCU_DONE_TAIL]) {
+		rdp->tails[RCU_WAIT_TAIL] = rdp->tails[RCU_NEXT_TAIL];
+		rdp->gp_seq[RCU_WAIT_TAIL] = rdp->gp_seq[RCU_NEXT_TAIL];
+	}
+}
+
+/**
+ * call_rcu - queue a callback for after a grace period
+ * @head: embedded in the object to be freed, usually
+ * @func: what to run, from RCU_SOFTIRQ on the calling CPU
+ *
+ * Callable from any context.  The full barrier orders the caller's
+ * removal of the object before the grace period number is read: any
+ * reader that could still find the object started before that grace
+ * period did.
+ */
+void call_rcu(struct rcu_head *head, rcu_callback_t func)
+{
+	struct rcu_data *rdp;
+	unsigned long flags;
+
+	head->func = func;
+	head->next = NULL;
+	smp_mb();
+
+	flags = local_irq_save();
+	rdp = this_cpu_ptr(&rcu_data);
+	spin_lock(&rdp->lock);
+	rcu_advance_cbs(rdp);
+	*rdp->tails[RCU_NEXT_TAIL] = head;
+	rdp->tails[RCU_NEXT_TAIL] = &head->next;
+	rdp->gp_seq[RCU_NEXT_TAIL] = rcu_seq_snap();
+	rcu_advance_cbs(rdp);
+	spin_unlock(&rdp->lock);
+	local_irq_restore(flags);
+
+	if (!READ_ONCE(rcu_state.gp_needed)) {
+		WRITE_ONCE(rcu_state.gp_needed, true);
+		wake_up(&rcu_state.gp_wq);
+	}
+}
+
+struct rcu_synchronize {
+	struct rcu_head head;
+	bool done;
+};
+
+static void wakeme_after_rcu(struct rcu_head *head)
+{
+	struct rcu_synchronize *rs = container_of(head, struct rcu_synchronize,
+						  head);
+
+	WRITE_ONCE(rs->done, true);
+	wake_up(&rcu_sync_wq);
+}
+
+/**
+ * synchronize_rcu - wait for a grace period
+ *
+ * On the only online CPU, the caller being allowed to sleep is a
+ * quiescent state already; that also covers the boot CPU before there is
+ * a grace-period thread.
+ */
+void synchronize_rcu(void)
+{
+	struct rcu_synchronize rs = { .done = false };
+
+	if (num_online_cpus() == 1)
+		return;
+	call_rcu(&rs.head, wakeme_after_rcu);
+	wait_event(rcu_sync_wq, READ_ONCE(rs.done));
+}
+
+static void rcu_report_qs(unsigned int cpu)
+{
+	unsigned long flags;
+	bool last = false;
+
+	spin_lock_irqsave(&rcu_state.lock, flags);
+	if (cpumask_test_cpu(cpu, &rcu_state.qsmask)) {
+		cpumask_clear_cpu(cpu, &rcu_state.qsmask);
+		last = cpumask_empty(&rcu_state.qsmask);
+	}
+	spin_unlock_irqrestore(&rcu_state.lock, flags);
+
+	if (last)
+		wake_up(&rcu_state.gp_wq);
+}
+
+/* Not in a read-side section; interrupts disabled.  One load if not owed. */
+static void rcu_qs(void)
+{
+	unsigned int cpu = smp_processor_id();
+
+	if (cpumask_test_cpu(cpu, &rcu_state.qsmask))
+		rcu_report_qs(cpu);
+}
+
+/* From __schedule(), before it takes the run queue lock. */
+void rcu_note_context_switch(void)
+{
+	rcu_qs();
+}
+
+/* From the tick: the interrupted context held no read-side section. */
+void rcu_sched_clock_irq(void)
+{
+	if (preempt_count() == HARDIRQ_OFFSET)
+		rcu_qs();
+}
+
+static void rcu_dynticks_inc(struct rcu_data *rdp)
+{
+	/* A locked instruction: a full barrier on either side. */
+	__atomic_add_fetch(&rdp->dynticks, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Interrupts disabled, on the way into halt. */
+void rcu_idle_enter(void)
+{
+	rcu_dynticks_inc(this_cpu_ptr(&rcu_data));
+}
+
+void rcu_idle_exit(void)
+{
+	rcu_dynticks_inc(this_cpu_ptr(&rcu_data));
+}
+
+/* Handlers may read: an interrupt from idle leaves idle for its duration. */
+void rcu_irq_enter(void)
+{
+	struct rcu_data *rdp = this_cpu_ptr(&rcu_data);
+
+	if (READ_ONCE(rdp->dynticks) & 1) {
+		rcu_dynticks_inc(rdp);
+		rdp->dynticks_irq = true;
+	}
+}
+
+void rcu_irq_exit(void)
+{
+	struct rcu_data *rdp = this_cpu_ptr(&rcu_data);
+
+	if (rdp->dynticks_irq) {
+		rdp->dynticks_irq = false;
+		rcu_dynticks_inc(rdp);
+	}
+}
+
+static void rcu_gp_init(void)
+{
+	struct rcu_data *rdp;
+	unsigned long flags;
+	unsigned int cpu;
+
+	spin_lock_irqsave(&rcu_state.lock, flags);
+	WRITE_ONCE(rcu_state.gp_needed, false);
+	WRITE_ONCE(rcu_state.gp_seq, rcu_state.gp_seq + 1);
+	smp_mb();
+	rcu_state.qsmask = *cpu_online_mask;
+	spin_unlock_irqrestore(&rcu_state.lock, flags);
+
+	smp_mb();
+	for_each_cpu(cpu, &rcu_state.qsmask) {
+		rdp = per_cpu_ptr(&rcu_data, cpu);
+		rdp->dynticks_snap = READ_ONCE(rdp->dynticks);
+	}
+}
+
+/* Clear the CPUs that are, or have been, idle.  True once all have reported. */
+static bool rcu_gp_fqs(void)
+{
+	struct rcu_data *rdp;
+	unsigned int cpu;
+
+	smp_mb();
+	for_each_cpu(cpu, &rcu_state.qsmask) {
+		rdp = per_cpu_ptr(&rcu_data, cpu);
+		if ((rdp->dynticks_snap & 1) ||
+		    READ_ONCE(rdp->dynticks) != rdp->dynticks_snap)
+			rcu_report_qs(cpu);
+	}
+	return cpumask_empty(&rcu_state.qsmask);
+}
+
+static void rcu_gp_cleanup(void)
+{
+	unsigned long flags;
+
+	smp_mb();
+	spin_lock_irqsave(&rcu_state.lock, flags);
+	WRITE_ONCE(rcu_state.gp_seq, rcu_state.gp_seq + 1);
+	spin_unlock_irqrestore(&rcu_state.lock, flags);
+}
+
+/* Whether @rdp has callbacks now done; sets gp_needed if more wait. */
+static bool rcu_cpu_has_done_cbs(struct rcu_data *rdp)
+{
+	unsigned long flags;
+	bool done;
+
+	spin_lock_irqsave(&rdp->lock, flags);
+	rcu_advance_cbs(rdp);
+	done = rdp->tails[RCU_DONE_TAIL] != &rdp->cblist;
+	if (rdp->tails[RCU_NEXT_TAIL] != rdp->tails[RCU_DONE_TAIL])
+		WRITE_ONCE(rcu_state.gp_needed, true);
+	spin_unlock_irqrestore(&rdp->lock, flags);
+	return done;
+}
+
+/* Take @rdp's done segment off its list. */
+static struct rcu_head *rcu_extract_done_cbs(struct rcu_data *rdp)
+{
+	struct rcu_head *done = NULL, **tail;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&rdp->lock, flags);
+	rcu_advance_cbs(rdp);
+	tail = rdp->tails[RCU_DONE_TAIL];
+	if (tail != &rdp->cblist) {
+		done = rdp->cblist;
+		rdp->cblist = *tail;
+		*tail = NULL;
+		for (i = 0; i < RCU_CBLIST_NSEGS; i++)
+			if (rdp->tails[i] == tail)
+				rdp->tails[i] = &rdp->cblist;
+	}
+	spin_unlock_irqrestore(&rdp->lock, flags);
+	return done;
+}
+
+static void rcu_do_batch(struct rcu_head *head)
+{
+	struct rcu_head *next;
+	unsigned long off;
+
+	for (; head; head = next) {
+		next = head->next;
+		off = (unsigned long)head->func;
+		if (__is_kfree_rcu_offset(off))
+			kfree((char *)head - off);
+		else
+			head->func(head);
+	}
+}
+
+static void rcu_softirq(void)
+{
+	rcu_do_batch(rcu_extract_done_cbs(this_cpu_ptr(&rcu_data)));
+}
+
+static int rcu_gp_kthread(void *unused)
+{
+	unsigned int cpu;
+
+	for (;;) {
+		wait_event(rcu_state.gp_wq, READ_ONCE(rcu_state.gp_needed));
+
+		rcu_gp_init();
+		while (!rcu_gp_fqs())
+			wait_event_timeout(rcu_state.gp_wq,
+					   cpumask_empty(&rcu_state.qsmask),
+					   RCU_FQS_JIFFIES);
+		rcu_gp_cleanup();
+
+		for_each_online_cpu(cpu)
+			if (rcu_cpu_has_done_cbs(per_cpu_ptr(&rcu_data, cpu)))
+				raise_softirq_on(cpu, RCU_SOFTIRQ);
+	}
+	return 0;
+}
+
+void rcu_init(void)
+{
+	struct rcu_data *rdp;
+	struct task_struct *p;
+	unsigned int cpu;
+	int i;
+
+	for_each_possible_cpu(cpu) {
+		rdp = per_cpu_ptr(&rcu_data, cpu);
+		spin_lock_init(&rdp->lock);
+		for (i = 0; i < RCU_CBLIST_NSEGS; i++)
+			rdp->tails[i] = &rdp->cblist;
+	}
+
+	open_softirq(RCU_SOFTIRQ, rcu_softirq);
+	p = kthread_create(rcu_gp_kthread, NULL, "rcu_gp");
+	if (!p)
+		panic("rcu: no grace-period thread");
+	wake_up_process(p);
+	pr_info("grace periods from ticks and context switches\n");
+}
@@ -0,0 +1,541 @@
+/*
+ * The scheduler.
+ *
+ * Every CPU has its own run queue: one FIFO list per priority and a
+ * 64-bit bitmap of the non-empty ones, so picking the next task is a
+ * find-first-set and a list head whatever the load.  Queues are only
+ * ever locked by their own CPU, except by a waker enqueueing a task on
+ * the queue it last ran on and by an idle CPU stealing work.
+ *
+ * A CPU that finds its queue empty steals the most urgent task it may run
+ * from the busiest queue before going idle.  A CPU running a task with
+ * others queued behind it kicks an idle CPU into doing so, from wakeups
+ * and at most every SCHED_BALANCE_TICKS from its tick.
+ *
+ * With more than one NUMA node, a task's home is the node holding most of
+ * its memory (mm->numa_nid).  Idle CPUs of the same node are kicked and
+ * steal first, a stealing CPU takes a task at home there over one that
+ * is not, and a task woken away from its home moves to an idle CPU there
+ * if it may run on one.
+ *
+ * The running task is not on a list; rq->curr is.  p->on_rq says the task
+ * is runnable (queued or running), p->on_cpu that it is still executing
+ * on its stack, which can outlast on_rq while it switches out.
+ */
+#define pr_fmt(fmt) "sched: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/bitops.h>
+#include <zhos/blkdev.h>
+#include <zhos/cpumask.h>
+#include <zhos/jiffies.h>
+#include <zhos/list.h>
+#include <zhos/mm_types.h>
+#include <zhos/numa.h>
+#include <zhos/percpu.h>
+#include <zhos/preempt.h>
+#include <zhos/rcupdate.h>
+#include <zhos/sched.h>
+#include <zhos/smp.h>
+#include <zhos/spinlock.h>
+#include <zhos/trace.h>
+#include <asm/current.h>
+#include <asm/irqflags.h>
+#include <asm/mmu_context.h>
+#include <asm/switch_to.h>
+
+#define SCHED_TIMESLICE		max(1, HZ / 100)	/* 10 ms */
+#define SCHED_BALANCE_TICKS	max(1, HZ / 250)	/* 4 ms */
+
+struct rq {
+	spinlock_t lock;
+	unsigned int cpu;
+	unsigned int nr_running;	/* queued, not counting curr */
+	u64 bitmap;			/* bit n: queue[n] not empty */
+	struct list_head queue[MAX_PRIO];
+	struct task_struct *curr;
+	struct task_struct *idle;
+	u64 next_balance;		/* jiffies */
+	u64 nr_switches;
+	u64 nr_steals;
+};
+
+_Static_assert(MAX_PRIO <= 64, "one bitmap word per run queue");
+
+static DEFINE_PER_CPU_ALIGNED(struct rq, runqueues);
+static DEFINE_PER_CPU(struct task_struct, idle_tasks);
+
+DEFINE_PER_CPU(int, __preempt_count);
+DEFINE_PER_CPU(bool, need_resched_flag);
+
+/* CPUs running their idle task. */
+static struct cpumask sched_idle_mask;
+
+#define cpu_rq(cpu)	per_cpu_ptr(&runqueues, cpu)
+#define this_rq()	this_cpu_ptr(&runqueues)
+#define task_rq(p)	cpu_rq(READ_ONCE((p)->cpu))
+
+static void enqueue_task(struct rq *rq, struct task_struct *p)
+{
+	if (p->time_slice <= 0)
+		p->time_slice = SCHED_TIMESLICE;
+	list_add_tail(&p->run_list, &rq->queue[p->prio]);
+	rq->bitmap |= 1ULL << p->prio;
+	rq->nr_running++;
+}
+
+static void dequeue_task(struct rq *rq, struct task_struct *p)
+{
+	list_del_init(&p->run_list);
+	if (list_empty(&rq->queue[p->prio]))
+		rq->bitmap &= ~(1ULL << p->prio);
+	rq->nr_running--;
+}
+
+/* Make @cpu call the scheduler at its next opportunity. */
+static void resched_cpu(unsigned int cpu)
+{
+	if (READ_ONCE(per_cpu(need_resched_flag, cpu)))
+		return;
+	WRITE_ONCE(per_cpu(need_resched_flag, cpu), true);
+	if (cpu != smp_processor_id())
+		smp_send_reschedule(cpu);
+}
+
+static void resched_curr(struct rq *rq)
+{
+	resched_cpu(rq->cpu);
+}
+
+/* Where most of @p's memory is; @p not running, so its mm stays. */
+static int task_numa_nid(struct task_struct *p)
+{
+	struct mm_struct *mm = READ_ONCE(p->mm);
+
+	return mm ? READ_ONCE(mm->numa_nid) : NUMA_NO_NODE;
+}
+
+/*
+ * @rq has work queued behind a running task: have an idle CPU steal it,
+ * one on the same node if there is one.
+ */
+static void kick_idle_cpu(struct rq *rq)
+{
+	unsigned int cpu, remote = NR_CPUS;
+	int nid;
+
+	/* No other CPU to kick. */
+	if (NR_CPUS == 1)
+		return;
+	nid = cpu_to_node(rq->cpu);
+	for_each_cpu(cpu, &sched_idle_mask) {
+		if (cpu == rq->cpu || !cpu_online(cpu))
+			continue;
+		if (cpu_to_node(cpu) == nid) {
+			resched_cpu(cpu);
+			return;
+		}
+		if (remote == NR_CPUS)
+			remote = cpu;
+	}
+	if (remote != NR_CPUS)
+		resched_cpu(remote);
+}
+
+static void check_preempt_wakeup(struct rq *rq, struct task_struct *p)
+{
+	if (rq->curr == rq->idle || p->prio < rq->curr->prio)
+		resched_curr(rq);
+	else
+		kick_idle_cpu(rq);
+}
+
+/* Lock the queue of @p, following it if it is stolen meanwhile. */
+static struct rq *task_rq_lock(struct task_struct *p, unsigned long *flags)
+{
+	struct rq *rq;
+
+	for (;;) {
+		rq = task_rq(p);
+		spin_lock_irqsave(&rq->lock, *flags);
+		if (likely(rq == task_rq(p)))
+			return rq;
+		spin_unlock_irqrestore(&rq->lock, *flags);
+	}
+}
+
+/*
+ * @rq locked, @p switched out and on no queue: move it to an idle CPU of
+ * its home node if it is away from it.  Returns the queue, locked, that
+ * @p now belongs to.
+ */
+static struct rq *select_task_rq(struct rq *rq, struct task_struct *p)
+{
+	int nid = task_numa_nid(p);
+	unsigned int cpu;
+
+	if (nr_node_ids == 1 || nid == NUMA_NO_NODE ||
+	    nid == cpu_to_node(rq->cpu))
+		return rq;
+	for_each_cpu(cpu, &sched_idle_mask) {
+		if (cpu_to_node(cpu) != nid || !cpu_online(cpu) ||
+		    !cpumask_test_cpu(cpu, &p->cpus_allowed))
+			continue;
+		/* Followed by task_rq_lock() from here on. */
+		trace_sched_migrate(p, rq->cpu);
+		WRITE_ONCE(p->cpu, cpu);
+		spin_unlock(&rq->lock);
+		rq = cpu_rq(cpu);
+		spin_lock(&rq->lock);
+		break;
+	}
+	return rq;
+}
+
+/**
+ * wake_up_process - make a sleeping task runnable
+ * @p: the task
+ *
+ * @p goes back on the queue of the CPU it last ran on; if that CPU is
+ * busy an idle one will steal it.  If that CPU is not on the node that
+ * holds @p's memory and an idle one there may run it, it goes there
+ * instead.  Returns false if @p was not asleep.
+ */
+bool wake_up_process(struct task_struct *p)
+{
+	unsigned long flags;
+	struct rq *rq;
+	bool woken = false;
+
+	rq = task_rq_lock(p, &flags);
+	if (p->state != TASK_RUNNING && p->state != TASK_DEAD) {
+		WRITE_ONCE(p->state, TASK_RUNNING);
+		/* Not yet switched out: it keeps running. */
+		if (!p->on_rq) {
+			if (!__atomic_load_n(&p->on_cpu, __ATOMIC_ACQUIRE))
+				rq = select_task_rq(rq, p);
+			enqueue_task(rq, p);
+			p->on_rq = true;
+			trace_sched_wakeup(p, rq->cpu);
+			check_preempt_wakeup(rq, p);
+		}
+		woken = true;
+	}
+	spin_unlock_irqrestore(&rq->lock, flags);
+	return woken;
+}
+
+void sched_set_prio(struct task_struct *p, int prio)
+{
+	unsigned long flags;
+	struct rq *rq;
+	bool queued;
+
+	prio = clamp(prio, 0, MAX_PRIO - 1);
+	rq = task_rq_lock(p, &flags);
+	queued = p->on_rq && rq->curr != p;
+	if (queued)
+		dequeue_task(rq, p);
+	p->prio = prio;
+	if (queued) {
+		enqueue_task(rq, p);
+		check_preempt_wakeup(rq, p);
+	} else if (rq->curr == p && rq->bitmap && __ffs64(rq->bitmap) < prio) {
+		resched_curr(rq);
+	}
+	spin_unlock_irqrestore(&rq->lock, flags);
+}
+
+/* Take both locks, in address order, holding @this_rq's on return. */
+static void double_lock_balance(struct rq *this_rq, struct rq *busiest)
+{
+	if (spin_trylock(&busiest->lock))
+		return;
+	if (busiest < this_rq) {
+		spin_unlock(&this_rq->lock);
+		spin_lock(&busiest->lock);
+		spin_lock(&this_rq->lock);
+	} else {
+		spin_lock(&busiest->lock);
+	}
+}
+
+/*
+ * Lockless guess at the queue with the most tasks waiting behind a busy
+ * CPU, on this CPU's node if any there has some.
+ */
+static struct rq *find_busiest_queue(struct rq *this_rq)
+{
+	struct rq *busiest[2] = { NULL, NULL }, *rq;
+	unsigned int cpu, n, max[2] = { 0, 0 };
+	int nid = cpu_to_node(this_rq->cpu);
+	bool remote;
+
+	for_each_online_cpu(cpu) {
+		rq = cpu_rq(cpu);
+		if (rq == this_rq)
+			continue;
+		n = READ_ONCE(rq->nr_running);
+		remote = cpu_to_node(cpu) != nid;
+		/* An idle CPU with work queued is about to run it itself. */
+		if (n > max[remote] && READ_ONCE(rq->curr) != rq->idle) {
+			busiest[remote] = rq;
+			max[remote] = n;
+		}
+	}
+	return busiest[0] ?: busiest[1];
+}
+
+/*
+ * The longest-waiting task of the highest priority that may run here,
+ * preferring one whose memory is on this CPU's node.
+ */
+static struct task_struct *steal_task(struct rq *src, unsigned int cpu)
+{
+	struct task_struct *p, *remote = NULL;
+	int nid = cpu_to_node(cpu), home;
+	u64 map = src->bitmap;
+
+	while (map && !remote) {
+		list_for_each_entry(p, &src->queue[__ffs64(map)], run_list) {
+			if (p->on_cpu ||
+			    !cpumask_test_cpu(cpu, &p->cpus_allowed))
+				continue;
+			home = task_numa_nid(p);
+			if (home == NUMA_NO_NODE || home == nid) {
+				dequeue_task(src, p);
+				return p;
+			}
+			if (!remote)
+				remote = p;
+		}
+		map &= map - 1;
+	}
+	if (remote)
+		dequeue_task(src, remote);
+	return remote;
+}
+
+/*
+ * Called with this_rq->lock held and nothing queued, so the task switching
+ * out is not on the queue while the lock is briefly dropped.
+ */
+static void idle_balance(struct rq *this_rq)
+{
+	struct rq *busiest = find_busiest_queue(this_rq);
+	struct task_struct *p;
+
+	if (!busiest)
+		return;
+
+	double_lock_balance(this_rq, busiest);
+	p = steal_task(busiest, this_rq->cpu);
+	if (p) {
+		trace_sched_migrate(p, busiest->cpu);
+		WRITE_ONCE(p->cpu, this_rq->cpu);
+		enqueue_task(this_rq, p);
+		this_rq->nr_steals++;
+	}
+	spin_unlock(&busiest->lock);
+}
+
+static struct task_struct *pick_next_task(struct rq *rq)
+{
+	struct task_struct *p;
+
+	if (!rq->bitmap)
+		idle_balance(rq);
+	if (!rq->bitmap)
+		return rq->idle;
+
+	p = list_first_entry(&rq->queue[__ffs64(rq->bitmap)],
+			     struct task_struct, run_list);
+	dequeue_task(rq, p);
+	return p;
+}
+
+/* Lock handover: the rq lock taken by __schedule() is dropped here. */
+static void finish_task_switch(struct task_struct *prev)
+{
+	struct rq *rq = this_rq();
+	bool dead = prev->state == TASK_DEAD;
+
+	__atomic_store_n(&prev->on_cpu, false, __ATOMIC_RELEASE);
+	spin_unlock(&rq->lock);
+
+	if (dead)
+		free_task(prev);
+}
+
+/*
+ * Interrupts disabled, preempt count 0.  @preempt: @prev is being
+ * preempted, so it stays runnable whatever state it has set.
+ */
+static void __schedule(bool preempt)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *prev = rq->curr, *next;
+
+	rcu_note_context_switch();
+	spin_lock(&rq->lock);
+	this_cpu_write(need_resched_flag, false);
+
+	if (!preempt && prev->state != TASK_RUNNING) {
+		prev->on_rq = false;
+		prev->nvcsw++;
+	} else if (prev != rq->idle) {
+		enqueue_task(rq, prev);
+		prev->nivcsw++;
+	}
+
+	next = pick_next_task(rq);
+	if (next == prev) {
+		spin_unlock(&rq->lock);
+		return;
+	}
+
+	if (next == rq->idle)
+		cpumask_set_cpu(rq->cpu, &sched_idle_mask);
+	else if (prev == rq->idle)
+		cpumask_clear_cpu(rq->cpu, &sched_idle_mask);
+
+	next->on_cpu = true;
+	rq->curr = next;
+	rq->nr_switches++;
+	this_cpu_write(current_task, next);
+	trace_sched_switch(prev, next);
+
+	switch_mm(prev->mm ?: &init_mm, next->mm ?: &init_mm);
+	prev = switch_to(prev, next);
+	finish_task_switch(prev);
+}
+
+/* First C code of a new task, called from ret_from_fork. */
+void schedule_tail(struct task_struct *prev)
+{
+	finish_task_switch(prev);
+	local_irq_enable();
+}
+
+void schedule(void)
+{
+	if (unlikely(preempt_count()))
+		panic("scheduling while atomic: %s, preempt_count %x",
+		      current->comm, preempt_count());
+
+	/* Requests held back for merging would otherwise wait on us. */
+	if (current->plug && current->state != TASK_RUNNING)
+		blk_flush_plug(current->plug);
+
+	local_irq_disable();
+	__schedule(false);
+	local_irq_enable();
+}
+
+/* For the idle loop, which runs with preemption disabled. */
+void schedule_preempt_disabled(void)
+{
+	preempt_enable_no_resched();
+	schedule();
+	preempt_disable();
+}
+
+/* From preempt_enable(), once the count drops to zero with a resched due. */
+void preempt_schedule(void)
+{
+	if (preempt_count() || irqs_disabled())
+		return;
+
+	do {
+		local_irq_disable();
+		__schedule(true);
+		local_irq_enable();
+	} while (need_resched());
+}
+
+/* From the interrupt return path, interrupts disabled. */
+void preempt_schedule_irq(void)
+{
+	do {
+		__schedule(true);
+	} while (need_resched());
+}
+
+void yield(void)
+{
+	__set_current_state(TASK_RUNNING);
+	schedule();
+}
+
+/* From the tick, in interrupt context. */
+void scheduler_tick(void)
+{
+	struct rq *rq = this_rq();
+	struct task_struct *curr = rq->curr;
+	u64 now = get_jiffies_64();
+
+	if (unlikely(!curr))
+		return;
+
+	spin_lock(&rq->lock);
+	if (curr != rq->idle && --curr->time_slice <= 0) {
+		curr->time_slice = SCHED_TIMESLICE;
+		/* Round-robin among equals; higher priorities preempt on wakeup. */
+		if (rq->bitmap && __ffs64(rq->bitmap) <= curr->prio)
+			resched_curr(rq);
+	}
+	if (rq->nr_running && curr != rq->idle &&
+	    time_after_eq(now, rq->next_balance)) {
+		rq->next_balance = now + SCHED_BALANCE_TICKS;
+		kick_idle_cpu(rq);
+	}
+	spin_unlock(&rq->lock);
+}
+
+void __noreturn do_exit(int code)
+{
+	exit_mm();
+	current->exit_code = code;
+	set_current_state(TASK_DEAD);
+	schedule();
+	BUG();
+}
+
+/* Turn the code running on @cpu (boot or start_secondary()) into its idle task. */
+void init_idle(unsigned int cpu)
+{
+	struct task_struct *idle = per_cpu_ptr(&idle_tasks, cpu);
+	struct rq *rq = cpu_rq(cpu);
+
+	idle->state = TASK_RUNNING;
+	idle->flags = PF_IDLE | PF_KTHREAD;
+	idle->prio = MAX_PRIO;
+	idle->cpu = cpu;
+	idle->on_rq = true;
+	idle->on_cpu = true;
+	INIT_LIST_HEAD(&idle->run_list);
+	cpumask_set_cpu(cpu, &idle->cpus_allowed);
+	snprintf(idle->comm, sizeof(idle->comm), "idle/%u", cpu);
+
+	rq->idle = rq->curr = idle;
+	per_cpu(current_task, cpu) = idle;
+	cpumask_set_cpu(cpu, &sched_idle_mask);
+}
+
+void sched_init(void)
+{
+	unsigned int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct rq *rq = cpu_rq(cpu);
+
+		spin_lock_init(&rq->lock);
+		rq->cpu = cpu;
+		for (i = 0; i < MAX_PRIO; i++)
+			INIT_LIST_HEAD(&rq->queue[i]);
+	}
+	init_idle(smp_processor_id());
+
+	pr_info("%d priorities, %d ms time slice, %u run queues\n", MAX_PRIO,
+		(int)(SCHED_TIMESLICE * 1000 / HZ), num_possible_cpus());
+}
@@ -0,0 +1,39 @@
+/*
+ * The idle loop.  The tick is stopped on the way in (see kernel/time/tick.c)
+ * so an idle CPU only wakes for real deadlines and device interrupts.
+ *
+ * It runs with preemption disabled: whoever wants the CPU sets
+ * need_resched and it hands over from here, with the tick restarted.
+ *
+ * Before halting, it clears free pages for the page allocator's pool of
+ * zeroed pages (mm/prezero.c), a chunk at a time, until the pool is full
+ * or someone wants the CPU.
+ */
+#include <zhos/kernel.h>
+#include <zhos/gfp.h>
+#include <zhos/preempt.h>
+#include <zhos/rcupdate.h>
+#include <zhos/sched.h>
+#include <zhos/tick.h>
+#include <asm/irqflags.h>
+
+void __noreturn cpu_idle_loop(void)
+{
+	preempt_disable();
+	for (;;) {
+		while (!need_resched() && idle_zero_pages())
+			;
+		local_irq_disable();
+		while (!need_resched()) {
+			tick_nohz_idle_enter();
+			rcu_idle_enter();
+			safe_halt();
+			local_irq_disable();
+			rcu_idle_exit();
+		}
+		tick_nohz_idle_exit();
+		local_irq_enable();
+
+		schedule_preempt_disabled();
+	}
+}
@@ -0,0 +1,43 @@
+/*
+ * Wait queues.
+ */
+#include <zhos/kernel.h>
+#include <zhos/sched.h>
+#include <zhos/spinlock.h>
+#include <zhos/wait.h>
+
+void prepare_to_wait(struct wait_queue_head *wq, struct wait_queue_entry *wait,
+		     long state)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&wq->lock, flags);
+	if (list_empty(&wait->entry))
+		list_add_tail(&wait->entry, &wq->head);
+	set_current_state(state);
+	spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+void finish_wait(struct wait_queue_head *wq, struct wait_queue_entry *wait)
+{
+	unsigned long flags;
+
+	__set_current_state(TASK_RUNNING);
+	if (list_empty(&wait->entry))
+		return;
+	spin_lock_irqsave(&wq->lock, flags);
+	list_del_init(&wait->entry);
+	spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+/* Waiters stay queued until they see their condition and finish_wait(). */
+void wake_up(struct wait_queue_head *wq)
+{
+	struct wait_queue_entry *wait;
+	unsigned long flags;
+
+	spin_lock_irqsave(&wq->lock, flags);
+	list_for_each_entry(wait, &wq->head, entry)
+		wake_up_process(wait->task);
+	spin_unlock_irqrestore(&wq->lock, flags);
+}
@@ -0,0 +1,167 @@
+/*
+ * Softirqs: interrupt work deferred to the end of the interrupt.
+ *
+ * Each CPU has a word of pending vectors.  Raising a vector sets its bit;
+ * the outermost interrupt, once its handler is done and the hardirq count
+ * has dropped, runs every pending action with interrupts enabled, so that
+ * devices are not kept waiting behind the timer wheel, a NAPI poll or a
+ * batch of completions.  The softirq count in preempt_count keeps an
+ * interrupt that arrives meanwhile from starting another pass, and keeps
+ * the task from being preempted or counted as quiescent by RCU.
+ *
+ * Actions may raise vectors again, their own included.  A pass picks them
+ * up and goes round up to MAX_SOFTIRQ_RESTART times, within
+ * MAX_SOFTIRQ_TIME; a flood beyond that is left to the CPU's ksoftirqd, a
+ * thread at the default priority, so that it is throttled by the
+ * scheduler rather than starving everything else.  Vectors raised outside
+ * interrupt context wake ksoftirqd too.
+ *
+ * Another CPU's vector is raised by setting its bit and sending it a
+ * reschedule IPI, whose interrupt exit runs the action there.
+ */
+#define pr_fmt(fmt) "softirq: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/cpumask.h>
+#include <zhos/kthread.h>
+#include <zhos/percpu.h>
+#include <zhos/preempt.h>
+#include <zhos/sched.h>
+#include <zhos/smp.h>
+#include <zhos/softirq.h>
+#include <zhos/timekeeping.h>
+#include <asm/irqflags.h>
+
+#define MAX_SOFTIRQ_RESTART	10
+#define MAX_SOFTIRQ_TIME	(2 * NSEC_PER_MSEC)
+
+static void (*softirq_vec[NR_SOFTIRQS])(void);
+
+/* Set by any CPU, cleared by its own. */
+static DEFINE_PER_CPU_ALIGNED(unsigned long, softirq_pending);
+static DEFINE_PER_CPU(struct task_struct *, ksoftirqd);
+
+void open_softirq(unsigned int nr, void (*action)(void))
+{
+	softirq_vec[nr] = action;
+}
+
+static void wakeup_softirqd(void)
+{
+	struct task_struct *tsk = this_cpu_read(ksoftirqd);
+
+	if (tsk)
+		wake_up_process(tsk);
+}
+
+void raise_softirq_irqoff(unsigned int nr)
+{
+	__atomic_or_fetch(this_cpu_ptr(&softirq_pending), 1UL << nr,
+			  __ATOMIC_RELAXED);
+	/* No interrupt exit is coming to run it. */
+	if (!in_interrupt())
+		wakeup_softirqd();
+}
+
+void raise_softirq(unsigned int nr)
+{
+	unsigned long flags = local_irq_save();
+
+	raise_softirq_irqoff(nr);
+	local_irq_restore(flags);
+}
+
+void raise_softirq_on(unsigned int cpu, unsigned int nr)
+{
+	unsigned long flags = local_irq_save();
+
+	if (cpu == smp_processor_id()) {
+		raise_softirq_irqoff(nr);
+	} else {
+		/* The bit before the IPI that makes the CPU look. */
+		__atomic_or_fetch(per_cpu_ptr(&softirq_pending, cpu),
+				  1UL << nr, __ATOMIC_SEQ_CST);
+		smp_send_reschedule(cpu);
+	}
+	local_irq_restore(flags);
+}
+
+static bool local_softirq_pending(void)
+{
+	return __atomic_load_n(this_cpu_ptr(&softirq_pending),
+			       __ATOMIC_RELAXED);
+}
+
+/* Interrupts disabled on entry and on return. */
+static void __do_softirq(void)
+{
+	u64 end = clock_now_ns() + MAX_SOFTIRQ_TIME;
+	unsigned int restart = MAX_SOFTIRQ_RESTART;
+	unsigned long pending;
+	unsigned int nr;
+
+	__preempt_count_add(SOFTIRQ_OFFSET);
+	barrier();
+	do {
+		pending = __atomic_exchange_n(this_cpu_ptr(&softirq_pending),
+					      0, __ATOMIC_RELAXED);
+		local_irq_enable();
+		while (pending) {
+			nr = __builtin_ctzl(pending);
+			pending &= pending - 1;
+			if (softirq_vec[nr])
+				softirq_vec[nr]();
+		}
+		local_irq_disable();
+	} while (local_softirq_pending() && --restart && !need_resched() &&
+		 (s64)(clock_now_ns() - end) < 0);
+
+	if (local_softirq_pending())
+		wakeup_softirqd();
+	barrier();
+	__preempt_count_sub(SOFTIRQ_OFFSET);
+}
+
+/* Not from a nested interrupt, nor one that came in during a pass. */
+void irq_exit_softirq(void)
+{
+	if (!in_interrupt() && local_softirq_pending())
+		__do_softirq();
+}
+
+static int ksoftirqd_thread(void *unused)
+{
+	for (;;) {
+		local_irq_disable();
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!local_softirq_pending()) {
+			local_irq_enable();
+			schedule();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+		__do_softirq();
+		local_irq_enable();
+
+		if (need_resched())
+			schedule();
+	}
+	return 0;
+}
+
+void softirq_init(void)
+{
+	struct task_struct *p;
+	unsigned int cpu;
+
+	for_each_online_cpu(cpu) {
+		p = kthread_create(ksoftirqd_thread, NULL, "ksoftirqd/%u", cpu);
+		if (!p) {
+			pr_err("no ksoftirqd for cpu %u\n", cpu);
+			continue;
+		}
+		kthread_bind(p, cpu);
+		per_cpu(ksoftirqd, cpu) = p;
+		wake_up_process(p);
+	}
+}
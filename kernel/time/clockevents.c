@@ -0,0 +1,90 @@
+/*
+ * Clock event device core: mult/shift setup, state changes and programming
+ * of relative events in nanoseconds.
+ */
+#include <zhos/kernel.h>
+#include <zhos/errno.h>
+#include <zhos/clockchips.h>
+#include <zhos/clocksource.h>
+#include <zhos/tick.h>
+
+u64 clockevent_delta2ns(unsigned long latch, struct clock_event_device *dev)
+{
+	u64 clc = (u64)latch << dev->shift;
+
+	if ((clc >> dev->shift) != (u64)latch)
+		clc = ~0ULL;
+	return clc / dev->mult;
+}
+
+void clockevents_config_and_register(struct clock_event_device *dev, u32 freq,
+				     unsigned long min_delta, unsigned long max_delta)
+{
+	u64 sec = max_delta / freq;
+
+	if (!sec)
+		sec = 1;
+	else if (sec > 600)
+		sec = 600;
+
+	clocks_calc_mult_shift(&dev->mult, &dev->shift, NSEC_PER_SEC, freq, sec);
+	dev->min_delta_ticks = min_delta;
+	dev->max_delta_ticks = max_delta;
+	dev->min_delta_ns = clockevent_delta2ns(min_delta, dev);
+	dev->max_delta_ns = clockevent_delta2ns(max_delta, dev);
+	dev->state = CLOCK_EVT_STATE_DETACHED;
+
+	tick_check_new_device(dev);
+}
+
+int clockevents_switch_state(struct clock_event_device *dev,
+			     enum clock_event_state state)
+{
+	int ret = 0;
+
+	if (dev->state == state)
+		return 0;
+
+	switch (state) {
+	case CLOCK_EVT_STATE_PERIODIC:
+		if (!(dev->features & CLOCK_EVT_FEAT_PERIODIC))
+			return -ENOSYS;
+		ret = dev->set_state_periodic(dev);
+		break;
+	case CLOCK_EVT_STATE_ONESHOT:
+		if (!(dev->features & CLOCK_EVT_FEAT_ONESHOT))
+			return -ENOSYS;
+		ret = dev->set_state_oneshot(dev);
+		break;
+	case CLOCK_EVT_STATE_SHUTDOWN:
+		if (dev->set_state_shutdown)
+			ret = dev->set_state_shutdown(dev);
+		break;
+	default:
+		break;
+	}
+
+	if (!ret)
+		dev->state = state;
+	return ret;
+}
+
+/**
+ * clockevents_program_event - arm a one-shot device @delta_ns from now
+ *
+ * The delta is clamped to what the hardware can express.  Returns the
+ * device's error code, or 0.
+ */
+int clockevents_program_event(struct clock_event_device *dev, u64 delta_ns)
+{
+	unsigned long cycles;
+
+	if (dev->state != CLOCK_EVT_STATE_ONESHOT)
+		return -EINVAL;
+
+	delta_ns = clamp(delta_ns, dev->min_delta_ns, dev->max_delta_ns);
+	cycles = (delta_ns * dev->mult) >> dev->shift;
+	cycles = clamp(cycles, dev->min_delta_ticks, dev->max_delta_ticks);
+
+	return dev->set_next_event(cycles, dev);
+}
@@ -0,0 +1,84 @@
+/*
+ * Clocksource registry.  Every registered clocksource is kept on a list
+ * ordered by rating; timekeeping always runs on the best one.
+ */
+#include <zhos/kernel.h>
+#include <zhos/clocksource.h>
+#include <asm/irqflags.h>
+
+#include "tick-internal.h"
+
+static struct clocksource *clocksource_list;
+
+/**
+ * clocks_calc_mult_shift - mult/shift pair converting @from-Hz units to @to-Hz
+ *
+ * Picks the largest shift (best precision) for which a value covering
+ * @maxsec seconds of input still fits in 64 bits after multiplication.
+ */
+void clocks_calc_mult_shift(u32 *mult, u32 *shift, u32 from, u32 to, u32 maxsec)
+{
+	u64 tmp;
+	u32 sft, sftacc = 32;
+
+	tmp = ((u64)maxsec * from) >> 32;
+	while (tmp) {
+		tmp >>= 1;
+		sftacc--;
+	}
+
+	for (sft = 32; sft > 0; sft--) {
+		tmp = (u64)to << sft;
+		tmp += from / 2;
+		tmp /= from;
+		if ((tmp >> sftacc) == 0)
+			break;
+	}
+	*mult = tmp;
+	*shift = sft;
+}
+
+
+/*
+ * @scale is 1 for @freq in Hz, 1000 for kHz; kHz keeps multi-GHz counters
+ * within 32 bits.
+ */
+static void __clocksource_register_scale(struct clocksource *cs, u32 scale,
+					 u32 freq)
+{
+	struct clocksource **pp;
+	unsigned long flags;
+	u64 sec;
+
+	sec = cs->mask / freq / scale;
+	if (!sec)
+		sec = 1;
+	else if (sec > CLOCKSOURCE_MAX_UPDATE_SEC)
+		sec = CLOCKSOURCE_MAX_UPDATE_SEC;
+	clocks_calc_mult_shift(&cs->mult, &cs->shift, freq, NSEC_PER_SEC / scale,
+			       sec * scale);
+
+	flags = local_irq_save();
+	for (pp = &clocksource_list; *pp && (*pp)->rating >= cs->rating;
+	     pp = &(*pp)->next)
+		;
+	cs->next = *pp;
+	*pp = cs;
+	local_irq_restore(flags);
+
+	pr_info("clocksource: %s registered, %u %s, mult %u shift %u\n",
+		cs->name, freq, scale == 1 ? "Hz" : "kHz", cs->mult, cs->shift);
+
+	if (clocksource_list == cs)
+		timekeeping_change_clocksource(cs);
+}
+
+void clocksource_register_hz(struct clocksource *cs, u32 hz)
+{
+	__clocksource_register_scale(cs, 1, hz);
+}
+
+void clocksource_register_khz(struct clocksource *cs, u32 khz)
+{
+	__clocksource_register_scale(cs, 1000, khz);
+}
@@ -0,0 +1,189 @@
+/*
+ * High-resolution timers.
+ *
+ * Each CPU keeps its pending hrtimers on a list sorted by expiry, so the
+ * next deadline is always the first entry.  When a timer goes to the head
+ * of the list the tick device is re-armed for it (tick_hrtimer_reprogram);
+ * every tick device interrupt first runs whatever has expired, and the
+ * tick then arms the device for the earlier of its own next event and the
+ * first hrtimer.
+ *
+ * Insertion is linear in the number of pending timers.  That is the price
+ * of not having a tree, and is fine for what they are used for: a few
+ * device deadlines per CPU, not general timeouts, which belong on the
+ * wheel.
+ */
+#include <zhos/kernel.h>
+#include <zhos/hrtimer.h>
+#include <zhos/list.h>
+#include <zhos/percpu.h>
+#include <zhos/smp.h>
+#include <zhos/spinlock.h>
+#include <zhos/timekeeping.h>
+#include <asm/processor.h>
+
+#include "tick-internal.h"
+
+struct hrtimer_cpu_base {
+	spinlock_t lock;
+	struct list_head active;	/* sorted by expiry */
+	struct hrtimer *running;
+};
+
+static DEFINE_PER_CPU_ALIGNED(struct hrtimer_cpu_base, hrtimer_bases);
+
+void hrtimer_init(struct hrtimer *timer, void (*function)(struct hrtimer *))
+{
+	INIT_LIST_HEAD(&timer->node);
+	timer->expires = 0;
+	timer->function = function;
+	timer->base = this_cpu_ptr(&hrtimer_bases);
+}
+
+/* timer->base is NULL while hrtimer_start() moves the timer between CPUs. */
+static struct hrtimer_cpu_base *lock_hrtimer_base(struct hrtimer *timer,
+						  unsigned long *flags)
+{
+	struct hrtimer_cpu_base *base;
+
+	for (;;) {
+		base = READ_ONCE(timer->base);
+		if (base) {
+			spin_lock_irqsave(&base->lock, *flags);
+			if (base == READ_ONCE(timer->base))
+				return base;
+			spin_unlock_irqrestore(&base->lock, *flags);
+		}
+		cpu_relax();
+	}
+}
+
+/* Returns true if @timer is now the first to expire. */
+static bool enqueue_hrtimer(struct hrtimer_cpu_base *base,
+			    struct hrtimer *timer)
+{
+	struct hrtimer *pos;
+
+	list_for_each_entry(pos, &base->active, node)
+		if ((s64)(timer->expires - pos->expires) < 0)
+			break;
+	list_add_tail(&timer->node, &pos->node);
+	return base->active.next == &timer->node;
+}
+
+/**
+ * hrtimer_start - (re)arm an hrtimer
+ * @timer: the timer
+ * @expires: absolute expiry, in clock_now_ns() time
+ *
+ * The timer moves to the calling CPU, unless its callback is running
+ * elsewhere: it then stays where hrtimer_cancel() will wait for it, and
+ * that CPU's tick picks up the new expiry when the callback returns.
+ */
+void hrtimer_start(struct hrtimer *timer, u64 expires)
+{
+	struct hrtimer_cpu_base *base, *new_base;
+	unsigned long flags;
+	bool first;
+
+	base = lock_hrtimer_base(timer, &flags);
+	if (hrtimer_queued(timer))
+		list_del_init(&timer->node);
+
+	new_base = this_cpu_ptr(&hrtimer_bases);
+	if (base != new_base && base->running != timer) {
+		WRITE_ONCE(timer->base, NULL);
+		spin_unlock(&base->lock);
+		spin_lock(&new_base->lock);
+		WRITE_ONCE(timer->base, new_base);
+		base = new_base;
+	}
+
+	timer->expires = expires;
+	first = enqueue_hrtimer(base, timer);
+	spin_unlock(&base->lock);
+
+	if (first && base == new_base)
+		tick_hrtimer_reprogram(expires);
+	local_irq_restore(flags);
+}
+
+void hrtimer_start_ns(struct hrtimer *timer, u64 delta_ns)
+{
+	hrtimer_start(timer, clock_now_ns() + delta_ns);
+}
+
+static int hrtimer_try_to_cancel(struct hrtimer *timer)
+{
+	struct hrtimer_cpu_base *base;
+	unsigned long flags;
+	int ret = -1;
+
+	base = lock_hrtimer_base(timer, &flags);
+	if (base->running != timer) {
+		ret = hrtimer_queued(timer);
+		list_del_init(&timer->node);
+	}
+	spin_unlock_irqrestore(&base->lock, flags);
+
+	return ret;
+}
+
+/*
+ * The device is left armed for a cancelled timer; it costs one spurious
+ * interrupt at most.  Must not be called from the timer's own callback.
+ */
+int hrtimer_cancel(struct hrtimer *timer)
+{
+	int ret;
+
+	while ((ret = hrtimer_try_to_cancel(timer)) < 0)
+		cpu_relax();
+	return ret;
+}
+
+/* Called from the tick device interrupt. */
+void hrtimer_run_queues(u64 now)
+{
+	struct hrtimer_cpu_base *base = this_cpu_ptr(&hrtimer_bases);
+	struct hrtimer *timer;
+
+	spin_lock(&base->lock);
+	while (!list_empty(&base->active)) {
+		timer = list_first_entry(&base->active, struct hrtimer, node);
+		if ((s64)(now - timer->expires) < 0)
+			break;
+
+		list_del_init(&timer->node);
+		base->running = timer;
+		spin_unlock(&base->lock);
+		timer->function(timer);
+		spin_lock(&base->lock);
+	}
+	base->running = NULL;
+	spin_unlock(&base->lock);
+}
+
+/* Expiry of the first hrtimer on this CPU, ~0 if there is none. */
+u64 hrtimer_next_event(void)
+{
+	struct hrtimer_cpu_base *base = this_cpu_ptr(&hrtimer_bases);
+	u64 next = ~0ULL;
+
+	spin_lock(&base->lock);
+	if (!list_empty(&base->active))
+		next = list_first_entry(&base->active, struct hrtimer,
+					node)->expires;
+	spin_unlock(&base->lock);
+
+	return next;
+}
+
+void hrtimers_init_cpu(unsigned int cpu)
+{
+	struct hrtimer_cpu_base *base = per_cpu_ptr(&hrtimer_bases, cpu);
+
+	spin_lock_init(&base->lock);
+	INIT_LIST_HEAD(&base->active);
+	base->running = NULL;
+}
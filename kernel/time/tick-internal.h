@@ -0,0 +1,12 @@
+#ifndef _KERNEL_TIME_TICK_INTERNAL_H
+#define _KERNEL_TIME_TICK_INTERNAL_H
+
+#include <zhos/types.h>
+
+struct clocksource;
+
+void timekeeping_change_clocksource(struct clocksource *cs);
+
+void tick_hrtimer_reprogram(u64 expires);
+
+#endif /* _KERNEL_TIME_TICK_INTERNAL_H */
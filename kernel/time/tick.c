@@ -0,0 +1,314 @@
+/*
+ * Tick management.
+ *
+ * Every CPU has its own tick device.  While there is work it ticks at HZ,
+ * re-armed one-shot at each jiffy boundary, or in periodic mode where the
+ * device has no one-shot mode.  On entry to the idle loop the device is
+ * armed for the next deadline instead, skipping every tick in between; on
+ * exit it goes back to ticking.
+ *
+ * jiffies is derived from clock_now_ns(), so it stays exact however many
+ * ticks were skipped.  One CPU at a time (tick_do_timer_cpu) advances it
+ * from its tick; the duty is dropped when that CPU stops its tick and
+ * picked up by the next CPU to tick, so busy CPUs do not all contend for
+ * jiffies_lock.
+ *
+ * The deadline is the next event of the CPU's timer wheel
+ * (kernel/time/timer.c), which also runs from every tick, as does the
+ * scheduler's time slicing.  Being one-shot, the device can also be armed
+ * between ticks for an hrtimer (kernel/time/hrtimer.c): each interrupt
+ * runs the expired hrtimers, and only does the tick's work once the jiffy
+ * boundary it was waiting for has passed.
+ */
+#define pr_fmt(fmt) "tick: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/clockchips.h>
+#include <zhos/cmdline.h>
+#include <zhos/hrtimer.h>
+#include <zhos/jiffies.h>
+#include <zhos/percpu.h>
+#include <zhos/rcupdate.h>
+#include <zhos/sched.h>
+#include <zhos/seqlock.h>
+#include <zhos/smp.h>
+#include <zhos/spinlock.h>
+#include <zhos/tick.h>
+#include <zhos/timekeeping.h>
+#include <zhos/timer.h>
+
+#include "tick-internal.h"
+
+#define TICK_DO_TIMER_NONE	-1
+
+u64 jiffies;
+
+/* clock_now_ns() at the last tick boundary jiffies was advanced to. */
+static u64 last_jiffies_update;
+static DEFINE_SPINLOCK(jiffies_lock);
+static seqcount_t jiffies_seq;
+
+static int tick_do_timer_cpu = TICK_DO_TIMER_NONE;
+
+struct tick_sched {
+	struct clock_event_device *dev;
+	bool idle_active;	/* inside the idle loop */
+	bool tick_stopped;	/* device armed for a deadline, not ticking */
+	u64 next_event;		/* deadline the one-shot device is armed for */
+	u64 next_tick;		/* jiffy boundary of the next tick, one-shot */
+	unsigned long idle_sleeps;
+};
+
+static DEFINE_PER_CPU(struct tick_sched, tick_cpu_sched);
+static bool tick_nohz_enabled = true;
+
+/* Interrupts disabled. */
+static void tick_do_update_jiffies64(u64 now)
+{
+	u64 delta, ticks;
+
+	/* Quick check without the lock: most calls find nothing to do. */
+	if ((s64)(now - READ_ONCE(last_jiffies_update)) < (s64)TICK_NSEC)
+		return;
+
+	spin_lock(&jiffies_lock);
+	delta = now - last_jiffies_update;
+	if ((s64)delta >= (s64)TICK_NSEC) {
+		ticks = delta / TICK_NSEC;
+		write_seqcount_begin(&jiffies_seq);
+		WRITE_ONCE(last_jiffies_update, last_jiffies_update + ticks * TICK_NSEC);
+		WRITE_ONCE(jiffies, jiffies + ticks);
+		write_seqcount_end(&jiffies_seq);
+		timekeeping_update();
+	}
+	spin_unlock(&jiffies_lock);
+}
+
+static void tick_get_jiffies_base(u64 *basej, u64 *basens)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqcount_begin(&jiffies_seq);
+		*basej = jiffies;
+		*basens = last_jiffies_update;
+	} while (read_seqcount_retry(&jiffies_seq, seq));
+}
+
+/* clock_now_ns() of the earliest pending deadline on this CPU. */
+static u64 tick_nohz_next_event(void)
+{
+	u64 basej, basens, next;
+
+	tick_get_jiffies_base(&basej, &basens);
+	next = get_next_timer_interrupt(basej);
+	if (next == ~0ULL)
+		return ~0ULL;
+	return basens + (next - basej) * TICK_NSEC;
+}
+
+static bool tick_can_stop(struct clock_event_device *dev)
+{
+	return tick_nohz_enabled && (dev->features & CLOCK_EVT_FEAT_ONESHOT);
+}
+
+static void tick_program_event(struct tick_sched *ts,
+			       struct clock_event_device *dev,
+			       u64 expires, u64 now)
+{
+	ts->next_event = expires;
+	clockevents_program_event(dev, expires > now ? expires - now : 0);
+}
+
+/* Arm a one-shot for the next deadline instead of the next tick. */
+static bool tick_nohz_stop_tick(struct tick_sched *ts,
+				struct clock_event_device *dev, u64 now)
+{
+	u64 next = tick_nohz_next_event();
+	u64 max_idle = timekeeping_max_idle_ns();
+
+	if (next <= READ_ONCE(last_jiffies_update) + 2 * TICK_NSEC)
+		return false;
+	if (clockevents_switch_state(dev, CLOCK_EVT_STATE_ONESHOT))
+		return false;
+
+	/* The clocksource may need reading before it wraps. */
+	if (next - now > max_idle)
+		next = now + max_idle;
+
+	if (READ_ONCE(tick_do_timer_cpu) == (int)smp_processor_id())
+		WRITE_ONCE(tick_do_timer_cpu, TICK_DO_TIMER_NONE);
+
+	if (!ts->tick_stopped)
+		ts->idle_sleeps++;
+	ts->tick_stopped = true;
+	tick_program_event(ts, dev, min(next, hrtimer_next_event()), now);
+	return true;
+}
+
+/* Arm the one-shot for the next jiffy boundary, or an hrtimer before it. */
+static void tick_program_next_tick(struct tick_sched *ts,
+				   struct clock_event_device *dev, u64 now)
+{
+	u64 next = READ_ONCE(last_jiffies_update) + TICK_NSEC;
+
+	while ((s64)(next - now) <= 0)
+		next += TICK_NSEC;
+	ts->next_tick = next;
+	tick_program_event(ts, dev, min(next, hrtimer_next_event()), now);
+}
+
+static void tick_restart(struct tick_sched *ts, struct clock_event_device *dev)
+{
+	ts->tick_stopped = false;
+	if (dev->features & CLOCK_EVT_FEAT_ONESHOT) {
+		clockevents_switch_state(dev, CLOCK_EVT_STATE_ONESHOT);
+		tick_program_next_tick(ts, dev, clock_now_ns());
+	} else {
+		clockevents_switch_state(dev, CLOCK_EVT_STATE_PERIODIC);
+	}
+}
+
+static bool tick_oneshot(struct clock_event_device *dev)
+{
+	return dev->state == CLOCK_EVT_STATE_ONESHOT;
+}
+
+static void tick_handle_event(struct clock_event_device *dev)
+{
+	struct tick_sched *ts = this_cpu_ptr(&tick_cpu_sched);
+	int cpu = smp_processor_id();
+	u64 now = clock_now_ns();
+
+	hrtimer_run_queues(now);
+
+	/* Woken for an hrtimer ahead of the tick. */
+	if (!ts->tick_stopped && tick_oneshot(dev) &&
+	    (s64)(now - ts->next_tick) < 0) {
+		tick_program_next_tick(ts, dev, now);
+		return;
+	}
+
+	if (unlikely(READ_ONCE(tick_do_timer_cpu) == TICK_DO_TIMER_NONE))
+		WRITE_ONCE(tick_do_timer_cpu, cpu);
+	if (READ_ONCE(tick_do_timer_cpu) == cpu || ts->tick_stopped)
+		tick_do_update_jiffies64(now);
+	run_local_timers();
+	rcu_sched_clock_irq();
+	scheduler_tick();
+
+	/* Still idle: re-arm for the next deadline (or the device limit). */
+	if (ts->idle_active && tick_can_stop(dev) &&
+	    tick_nohz_stop_tick(ts, dev, now))
+		return;
+	if (ts->tick_stopped)
+		tick_restart(ts, dev);
+	else if (tick_oneshot(dev))
+		tick_program_next_tick(ts, dev, now);
+}
+
+/**
+ * tick_hrtimer_reprogram - an hrtimer went first on this CPU's queue
+ * @expires: its expiry
+ *
+ * Called with interrupts disabled.  Pulls the one-shot device in if it is
+ * armed for later; a periodic device runs the timer from its next tick.
+ */
+void tick_hrtimer_reprogram(u64 expires)
+{
+	struct tick_sched *ts = this_cpu_ptr(&tick_cpu_sched);
+	struct clock_event_device *dev = ts->dev;
+
+	if (!dev || !tick_oneshot(dev))
+		return;
+	if ((s64)(expires - ts->next_event) < 0)
+		tick_program_event(ts, dev, expires, clock_now_ns());
+}
+
+void tick_nohz_idle_enter(void)
+{
+	struct tick_sched *ts = this_cpu_ptr(&tick_cpu_sched);
+	struct clock_event_device *dev = ts->dev;
+	u64 now;
+
+	ts->idle_active = true;
+	if (!dev || !tick_can_stop(dev))
+		return;
+
+	/*
+	 * Already stopped: an interrupt woke us, and may have queued a
+	 * timer that is due before the armed deadline.
+	 */
+	if (ts->tick_stopped && tick_nohz_next_event() >= ts->next_event)
+		return;
+
+	now = clock_now_ns();
+	tick_do_update_jiffies64(now);
+	if (!tick_nohz_stop_tick(ts, dev, now) && ts->tick_stopped)
+		tick_restart(ts, dev);
+}
+
+void tick_nohz_idle_exit(void)
+{
+	struct tick_sched *ts = this_cpu_ptr(&tick_cpu_sched);
+
+	ts->idle_active = false;
+	if (!ts->tick_stopped)
+		return;
+
+	tick_do_update_jiffies64(clock_now_ns());
+	tick_restart(ts, ts->dev);
+}
+
+/**
+ * wake_up_nohz_cpu - make @cpu notice a new timer on its wheel
+ *
+ * A CPU with its tick stopped only looks at its wheel again when it
+ * wakes; interrupt it if it is sleeping past the new timer.
+ */
+void wake_up_nohz_cpu(unsigned int cpu)
+{
+	if (cpu != smp_processor_id() &&
+	    READ_ONCE(per_cpu(tick_cpu_sched, cpu).tick_stopped))
+		smp_send_reschedule(cpu);
+}
+
+/* Offer @dev as the tick of the calling CPU. */
+void tick_check_new_device(struct clock_event_device *dev)
+{
+	struct tick_sched *ts = this_cpu_ptr(&tick_cpu_sched);
+	struct clock_event_device *old = ts->dev;
+	unsigned int cpu = smp_processor_id();
+	unsigned long flags;
+
+	if (old && old->rating >= dev->rating)
+		return;
+	if (!(dev->features & (CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT)))
+		return;
+
+	flags = local_irq_save();
+	if (old) {
+		clockevents_switch_state(old, CLOCK_EVT_STATE_SHUTDOWN);
+		old->event_handler = NULL;
+	}
+
+	ts->dev = dev;
+	dev->event_handler = tick_handle_event;
+	if (tick_do_timer_cpu == TICK_DO_TIMER_NONE) {
+		last_jiffies_update = clock_now_ns();
+		tick_do_timer_cpu = cpu;
+	}
+	tick_restart(ts, dev);
+	local_irq_restore(flags);
+
+	pr_info("CPU%u: using %s, HZ=%d, %s\n", cpu, dev->name, HZ,
+		tick_can_stop(dev) ? "tickless idle" : "periodic only");
+}
+
+void tick_nohz_init(void)
+{
+	char val[8];
+
+	if (!cmdline_get("nohz", val, sizeof(val)) && !strcmp(val, "off"))
+		tick_nohz_enabled = false;
+}
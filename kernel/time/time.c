@@ -0,0 +1,47 @@
+/*
+ * POSIX time interfaces: what clock_gettime() and gettimeofday() do once
+ * in the kernel.  The vDSO only falls back to these when the clocksource
+ * cannot be read from outside.
+ */
+#include <zhos/kernel.h>
+#include <zhos/errno.h>
+#include <zhos/time.h>
+#include <zhos/timekeeping.h>
+
+/**
+ * mktime64 - convert a broken-down UTC date to seconds since the epoch
+ *
+ * Gauss' algorithm, counting the year from March so that February's leap
+ * day falls at its end.
+ */
+s64 mktime64(unsigned int year, unsigned int mon, unsigned int day,
+	     unsigned int hour, unsigned int min, unsigned int sec)
+{
+	if ((int)(mon -= 2) <= 0) {
+		mon += 12;
+		year--;
+	}
+	return ((((s64)(year / 4 - year / 100 + year / 400 +
+			367 * mon / 12 + day) +
+		  year * 365 - 719499) * 24 + hour) * 60 + min) * 60 + sec;
+}
+
+int do_clock_gettime(clockid_t which, struct timespec64 *ts)
+{
+	switch (which) {
+	case CLOCK_REALTIME:
+		ns_to_timespec64(clock_real_ns(), ts);
+		return 0;
+	case CLOCK_MONOTONIC:
+		ns_to_timespec64(clock_now_ns(), ts);
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+int do_gettimeofday(struct timeval *tv)
+{
+	ns_to_timeval(clock_real_ns(), tv);
+	return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Timekeeping.
+ *
+ * clock_now_ns() is base_ns plus the cycles read since cycle_last, scaled by
+ * the current clocksource's mult/shift.  The tick folds the elapsed cycles
+ * into base_ns (keeping the sub-ns remainder) so the multiplication stays
+ * in range; a seqcount lets readers run lock-free against that update,
+ * and tk.lock serialises the writers.
+ *
+ * Every update is also copied to the vDSO data page, where the same sum
+ * can be done without entering the kernel.  CLOCK_REALTIME is the
+ * monotonic clock plus offs_real, set once from the RTC at boot.
+ */
+#include <zhos/kernel.h>
+#include <zhos/clocksource.h>
+#include <zhos/jiffies.h>
+#include <zhos/seqlock.h>
+#include <zhos/spinlock.h>
+#include <zhos/timekeeping.h>
+#include <zhos/vdso.h>
+#include <asm/page.h>
+
+#include "tick-internal.h"
+
+static u64 jiffies_read(struct clocksource *cs)
+{
+	return get_jiffies_64();
+}
+
+/* Used until a hardware clocksource registers: tick resolution only. */
+static struct clocksource clocksource_jiffies = {
+	.name	= "jiffies",
+	.read	= jiffies_read,
+	.mask	= CLOCKSOURCE_MASK(64),
+	.mult	= TICK_NSEC,
+	.shift	= 0,
+	.rating	= 1,
+};
+
+static struct timekeeper {
+	spinlock_t lock;
+	seqcount_t seq;
+	struct clocksource *clock;
+	u64 cycle_last;
+	u64 base_ns;
+	u64 base_frac;		/* remainder, in ns << clock->shift */
+	u64 offs_real;		/* CLOCK_REALTIME - CLOCK_MONOTONIC */
+} tk = {
+	.lock = __SPIN_LOCK_UNLOCKED(tk.lock),
+	.clock = &clocksource_jiffies,
+};
+
+static inline u64 tk_delta(struct clocksource *cs, u64 now)
+{
+	return clocksource_delta(now, tk.cycle_last, cs->mask);
+}
+
+static inline u64 tk_scaled_delta(struct clocksource *cs, u64 delta)
+{
+	return delta * cs->mult + tk.base_frac;
+}
+
+u64 clock_now_ns(void)
+{
+	struct clocksource *cs;
+	unsigned int seq;
+	u64 ns;
+
+	do {
+		seq = read_seqcount_begin(&tk.seq);
+		cs = tk.clock;
+		ns = tk.base_ns +
+		     (tk_scaled_delta(cs, tk_delta(cs, cs->read(cs))) >>
+		      cs->shift);
+	} while (read_seqcount_retry(&tk.seq, seq));
+
+	return ns;
+}
+
+/* offs_real only moves when the wall clock is set: no retry needed. */
+u64 clock_real_ns(void)
+{
+	return clock_now_ns() + READ_ONCE(tk.offs_real);
+}
+
+struct vdso_data vdso_data __section(".data..vvar") __aligned(PAGE_SIZE);
+
+/* Caller holds tk.lock. */
+static void update_vsyscall(void)
+{
+	struct clocksource *cs = tk.clock;
+
+	write_seqcount_begin(&vdso_data.seq);
+	vdso_data.clock_mode = cs->vdso_clock_mode;
+	vdso_data.cycle_last = tk.cycle_last;
+	vdso_data.mask = cs->mask;
+	vdso_data.mult = cs->mult;
+	vdso_data.shift = cs->shift;
+	vdso_data.base_ns = tk.base_ns;
+	vdso_data.base_frac = tk.base_frac;
+	vdso_data.offs_real = tk.offs_real;
+	write_seqcount_end(&vdso_data.seq);
+}
+
+/* Caller holds tk.seq for writing. */
+static void tk_accumulate(void)
+{
+	struct clocksource *cs = tk.clock;
+	u64 delta = tk_delta(cs, cs->read(cs));
+	u64 scaled = tk_scaled_delta(cs, delta);
+
+	tk.base_ns += scaled >> cs->shift;
+	tk.base_frac = scaled & ((1ULL << cs->shift) - 1);
+	/* Not back to a trailing CPU's reading: that time would count twice. */
+	tk.cycle_last = (tk.cycle_last + delta) & cs->mask;
+}
+
+void timekeeping_update(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tk.lock, flags);
+	write_seqcount_begin(&tk.seq);
+	tk_accumulate();
+	write_seqcount_end(&tk.seq);
+	update_vsyscall();
+	spin_unlock_irqrestore(&tk.lock, flags);
+}
+
+/* Start CLOCK_REALTIME at @real_ns, nanoseconds since the epoch. */
+void timekeeping_set_wall(u64 real_ns)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tk.lock, flags);
+	write_seqcount_begin(&tk.seq);
+	tk_accumulate();
+	tk.offs_real = real_ns - tk.base_ns;
+	write_seqcount_end(&tk.seq);
+	update_vsyscall();
+	spin_unlock_irqrestore(&tk.lock, flags);
+}
+
+/* Switch clocksources without a step in clock_now_ns(). */
+void timekeeping_change_clocksource(struct clocksource *cs)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tk.lock, flags);
+	write_seqcount_begin(&tk.seq);
+	tk_accumulate();
+	tk.clock = cs;
+	tk.cycle_last = cs->read(cs);
+	tk.base_frac = 0;
+	write_seqcount_end(&tk.seq);
+	update_vsyscall();
+	spin_unlock_irqrestore(&tk.lock, flags);
+
+	pr_info("clocksource: switched to %s\n", cs->name);
+}
+
+u64 timekeeping_max_idle_ns(void)
+{
+	u64 max = READ_ONCE(tk.clock)->max_idle_ns;
+
+	return max ? max : ~0ULL;
+}
+
+const char *current_clocksource_name(void)
+{
+	return tk.clock->name;
+}
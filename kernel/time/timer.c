@@ -0,0 +1,502 @@
+/*
+ * Kernel timers: a hierarchical hashed timer wheel per CPU.
+ *
+ * Level 0 (tv1) has one slot per jiffy for the next TVR_SIZE jiffies; each
+ * following level has TVN_SIZE slots covering TVN_SIZE times the span of
+ * the level below.  A timer is hashed into a slot by its expiry, so adding
+ * and deleting are O(1) whatever the number of pending timers.  Whenever
+ * the lower level wraps, the next slot of the level above is cascaded
+ * down, each timer being re-hashed at most once per level.
+ *
+ * A bitmap of non-empty slots lets both the tick and tickless idle find
+ * the next event in a handful of word operations, and lets the wheel skip
+ * straight over the jiffies where nothing happens.  The tick only looks
+ * whether anything is due; the wheel is run, and the callbacks called,
+ * from TIMER_SOFTIRQ with interrupts enabled.
+ */
+#include <zhos/kernel.h>
+#include <zhos/bitops.h>
+#include <zhos/delay.h>
+#include <zhos/hrtimer.h>
+#include <zhos/jiffies.h>
+#include <zhos/percpu.h>
+#include <zhos/sched.h>
+#include <zhos/smp.h>
+#include <zhos/softirq.h>
+#include <zhos/spinlock.h>
+#include <zhos/tick.h>
+#include <zhos/timer.h>
+#include <asm/processor.h>
+
+#define TVR_BITS	8
+#define TVN_BITS	6
+#define TVR_SIZE	(1 << TVR_BITS)
+#define TVN_SIZE	(1 << TVN_BITS)
+#define TVR_MASK	(TVR_SIZE - 1)
+#define TVN_MASK	(TVN_SIZE - 1)
+#define TVN_LEVELS	4
+
+/* Granularity of upper level @lvl, as a shift of jiffies. */
+#define LVL_SHIFT(lvl)	(TVR_BITS + (lvl) * TVN_BITS)
+#define LVL_SLOT(lvl, i) (TVR_SIZE + (lvl) * TVN_SIZE + (i))
+#define MAX_TVAL	((1ULL << LVL_SHIFT(TVN_LEVELS)) - 1)
+
+#define WHEEL_SIZE	(TVR_SIZE + TVN_LEVELS * TVN_SIZE)
+#define TV1_WORDS	(TVR_SIZE / 64)
+
+struct timer_base {
+	spinlock_t lock;
+	struct timer_list *running_timer;
+	u64 clk;			/* next jiffy to process */
+	unsigned int cpu;
+	/* Words 0..TV1_WORDS-1 map tv1, then one word per upper level. */
+	u64 pending_map[TV1_WORDS + TVN_LEVELS];
+	struct hlist_head vectors[WHEEL_SIZE];
+};
+
+static DEFINE_PER_CPU_ALIGNED(struct timer_base, timer_bases);
+
+static inline struct timer_base *get_timer_base(u32 tflags)
+{
+	return per_cpu_ptr(&timer_bases, tflags & TIMER_CPUMASK);
+}
+
+static inline void set_pending(struct timer_base *base, unsigned int idx)
+{
+	base->pending_map[idx / 64] |= 1ULL << (idx % 64);
+}
+
+static inline void clear_pending(struct timer_base *base, unsigned int idx)
+{
+	base->pending_map[idx / 64] &= ~(1ULL << (idx % 64));
+}
+
+static void enqueue_timer(struct timer_base *base, struct timer_list *timer)
+{
+	u64 expires = timer->expires;
+	u64 delta = expires - base->clk;
+	unsigned int idx, lvl;
+
+	if ((s64)delta < 0) {
+		/* Already due: run it on the next pass. */
+		idx = base->clk & TVR_MASK;
+	} else if (delta < TVR_SIZE) {
+		idx = expires & TVR_MASK;
+	} else {
+		/* Beyond the wheel: park in the last level and re-hash later. */
+		if (delta > MAX_TVAL) {
+			delta = MAX_TVAL;
+			expires = base->clk + MAX_TVAL;
+		}
+		for (lvl = 0; delta >> LVL_SHIFT(lvl + 1); lvl++)
+			;
+		idx = LVL_SLOT(lvl, (expires >> LVL_SHIFT(lvl)) & TVN_MASK);
+	}
+
+	timer->idx = idx;
+	hlist_add_head(&timer->entry, &base->vectors[idx]);
+	set_pending(base, idx);
+}
+
+static void detach_timer(struct timer_base *base, struct timer_list *timer)
+{
+	__hlist_del(&timer->entry);
+	timer->entry.pprev = NULL;
+	if (hlist_empty(&base->vectors[timer->idx]))
+		clear_pending(base, timer->idx);
+}
+
+static int detach_if_pending(struct timer_base *base, struct timer_list *timer)
+{
+	if (!timer_pending(timer))
+		return 0;
+	detach_timer(base, timer);
+	return 1;
+}
+
+/*
+ * Lock the base the timer is on.  The base can change under us while the
+ * timer migrates, so re-check once the lock is held.
+ */
+static struct timer_base *lock_timer_base(struct timer_list *timer,
+					  unsigned long *flags)
+{
+	for (;;) {
+		u32 tf = READ_ONCE(timer->flags);
+
+		if (!(tf & TIMER_MIGRATING)) {
+			struct timer_base *base = get_timer_base(tf);
+
+			spin_lock_irqsave(&base->lock, *flags);
+			if (READ_ONCE(timer->flags) == tf)
+				return base;
+			spin_unlock_irqrestore(&base->lock, *flags);
+		}
+		cpu_relax();
+	}
+}
+
+/*
+ * Move a detached timer from @base to @new_base, both locks dropped and
+ * taken in turn.  A running callback keeps its timer where it is, so that
+ * del_timer_sync() only ever needs to watch one base.
+ */
+static struct timer_base *switch_timer_base(struct timer_list *timer,
+					    struct timer_base *base,
+					    struct timer_base *new_base)
+{
+	if (base == new_base || base->running_timer == timer)
+		return base;
+
+	WRITE_ONCE(timer->flags, timer->flags | TIMER_MIGRATING);
+	spin_unlock(&base->lock);
+	spin_lock(&new_base->lock);
+	WRITE_ONCE(timer->flags,
+		   (timer->flags & ~(TIMER_MIGRATING | TIMER_CPUMASK)) | new_base->cpu);
+	return new_base;
+}
+
+void timer_setup(struct timer_list *timer,
+		 void (*function)(struct timer_list *), u32 flags)
+{
+	INIT_HLIST_NODE(&timer->entry);
+	timer->function = function;
+	timer->flags = (flags & ~TIMER_CPUMASK) | smp_processor_id();
+	timer->idx = 0;
+}
+
+/**
+ * mod_timer - (re)arm a timer
+ * @timer: the timer
+ * @expires: new expiry, in jiffies
+ *
+ * Unless the timer is TIMER_PINNED it moves to the calling CPU's wheel.
+ *
+ * Returns 1 if the timer was pending, 0 otherwise.
+ */
+int mod_timer(struct timer_list *timer, u64 expires)
+{
+	struct timer_base *base, *new_base;
+	unsigned long flags;
+	int ret;
+
+	if (timer_pending(timer) && timer->expires == expires)
+		return 1;
+
+	base = lock_timer_base(timer, &flags);
+	ret = detach_if_pending(base, timer);
+
+	if (!(timer->flags & TIMER_PINNED)) {
+		new_base = this_cpu_ptr(&timer_bases);
+		base = switch_timer_base(timer, base, new_base);
+	}
+
+	timer->expires = expires;
+	enqueue_timer(base, timer);
+	spin_unlock_irqrestore(&base->lock, flags);
+
+	return ret;
+}
+
+void add_timer(struct timer_list *timer)
+{
+	BUG_ON(timer_pending(timer));
+	mod_timer(timer, timer->expires);
+}
+
+/* Start a timer on @cpu's wheel; TIMER_PINNED keeps it there. */
+void add_timer_on(struct timer_list *timer, unsigned int cpu)
+{
+	struct timer_base *base;
+	unsigned long flags;
+
+	BUG_ON(timer_pending(timer));
+
+	base = lock_timer_base(timer, &flags);
+	base = switch_timer_base(timer, base, per_cpu_ptr(&timer_bases, cpu));
+	enqueue_timer(base, timer);
+	spin_unlock_irqrestore(&base->lock, flags);
+
+	wake_up_nohz_cpu(base->cpu);
+}
+
+/**
+ * del_timer - deactivate a timer
+ * @timer: the timer
+ *
+ * The callback may still be running on another CPU on return; use
+ * del_timer_sync() before freeing what it touches.
+ *
+ * Returns 1 if the timer was pending, 0 otherwise.
+ */
+int del_timer(struct timer_list *timer)
+{
+	struct timer_base *base;
+	unsigned long flags;
+	int ret;
+
+	if (!timer_pending(timer))
+		return 0;
+
+	base = lock_timer_base(timer, &flags);
+	ret = detach_if_pending(base, timer);
+	spin_unlock_irqrestore(&base->lock, flags);
+
+	return ret;
+}
+
+static int try_to_del_timer_sync(struct timer_list *timer)
+{
+	struct timer_base *base;
+	unsigned long flags;
+	int ret = -1;
+
+	base = lock_timer_base(timer, &flags);
+	if (base->running_timer != timer)
+		ret = detach_if_pending(base, timer);
+	spin_unlock_irqrestore(&base->lock, flags);
+
+	return ret;
+}
+
+/*
+ * Like del_timer(), but also waits for a running callback to finish.
+ * Must not be called from the timer's own callback.
+ */
+int del_timer_sync(struct timer_list *timer)
+{
+	int ret;
+
+	while ((ret = try_to_del_timer_sync(timer)) < 0)
+		cpu_relax();
+	return ret;
+}
+
+/* First pending tv1 slot at or after @offset, wrapping; -1 if none. */
+static int tv1_next_pending(const u64 *map, unsigned int offset)
+{
+	unsigned int word = offset / 64, i;
+	u64 w;
+
+	for (i = 0; i <= TV1_WORDS; i++) {
+		unsigned int n = (word + i) % TV1_WORDS;
+
+		w = map[n];
+		if (i == 0)
+			w &= ~0ULL << (offset % 64);
+		else if (i == TV1_WORDS)
+			w &= ~(~0ULL << (offset % 64));
+		if (w)
+			return n * 64 + __ffs64(w);
+	}
+	return -1;
+}
+
+/*
+ * Jiffy of the next thing the wheel has to do: either the expiry of a tv1
+ * slot (exact, all its timers share it) or the cascade of an upper slot
+ * (a lower bound on its timers).  ~0 if the wheel is empty.
+ */
+static u64 __next_timer_interrupt(struct timer_base *base)
+{
+	u64 clk = base->clk, next = ~0ULL;
+	unsigned int offset = clk & TVR_MASK, lvl;
+	int slot;
+
+	slot = tv1_next_pending(base->pending_map, offset);
+	if (slot >= 0)
+		next = clk + ((slot - offset) & TVR_MASK);
+
+	for (lvl = 0; lvl < TVN_LEVELS; lvl++) {
+		u64 map = base->pending_map[TV1_WORDS + lvl];
+		unsigned int shift = LVL_SHIFT(lvl), pos;
+		u64 cur, t;
+
+		if (!map)
+			continue;
+		/* Slot @pos cascades at the first multiple of the span >= clk. */
+		cur = (clk + (1ULL << shift) - 1) >> shift;
+		pos = cur & TVN_MASK;
+		map = (map >> pos) | (map << ((TVN_SIZE - pos) & TVN_MASK));
+		t = (cur + __ffs64(map)) << shift;
+		if (t < next)
+			next = t;
+	}
+	return next;
+}
+
+static void cascade(struct timer_base *base, unsigned int lvl, unsigned int i)
+{
+	unsigned int idx = LVL_SLOT(lvl, i);
+	struct timer_list *timer;
+	struct hlist_node *tmp;
+	struct hlist_head head;
+
+	hlist_move_list(&base->vectors[idx], &head);
+	clear_pending(base, idx);
+	hlist_for_each_entry_safe(timer, tmp, &head, entry)
+		enqueue_timer(base, timer);
+}
+
+static void expire_timers(struct timer_base *base, struct hlist_head *head)
+{
+	while (head->first) {
+		struct timer_list *timer = hlist_entry(head->first,
+						       struct timer_list, entry);
+		void (*fn)(struct timer_list *) = timer->function;
+
+		__hlist_del(&timer->entry);
+		timer->entry.pprev = NULL;
+		base->running_timer = timer;
+
+		spin_unlock_irq(&base->lock);
+		fn(timer);
+		spin_lock_irq(&base->lock);
+	}
+	base->running_timer = NULL;
+}
+
+static void __run_timers(struct timer_base *base)
+{
+	u64 now = get_jiffies_64();
+	struct hlist_head head;
+	unsigned int index, lvl;
+
+	spin_lock_irq(&base->lock);
+	while (base->clk <= now) {
+		u64 next = __next_timer_interrupt(base);
+
+		/* Nothing to do in between: jump over the idle jiffies. */
+		if (next > now) {
+			base->clk = now + 1;
+			break;
+		}
+		base->clk = next;
+
+		index = base->clk & TVR_MASK;
+		for (lvl = 0; !index && lvl < TVN_LEVELS; lvl++) {
+			index = (base->clk >> LVL_SHIFT(lvl)) & TVN_MASK;
+			cascade(base, lvl, index);
+		}
+		index = base->clk & TVR_MASK;
+
+		hlist_move_list(&base->vectors[index], &head);
+		clear_pending(base, index);
+		base->clk++;
+		expire_timers(base, &head);
+	}
+	spin_unlock_irq(&base->lock);
+}
+
+static void run_timer_softirq(void)
+{
+	struct timer_base *base = this_cpu_ptr(&timer_bases);
+
+	if (get_jiffies_64() >= READ_ONCE(base->clk))
+		__run_timers(base);
+}
+
+/* Called from the tick with interrupts disabled. */
+void run_local_timers(void)
+{
+	struct timer_base *base = this_cpu_ptr(&timer_bases);
+	u64 now = get_jiffies_64();
+	bool due;
+
+	if (now < READ_ONCE(base->clk))
+		return;
+	spin_lock(&base->lock);
+	due = __next_timer_interrupt(base) <= now;
+	spin_unlock(&base->lock);
+	if (due)
+		raise_softirq_irqoff(TIMER_SOFTIRQ);
+}
+
+/**
+ * get_next_timer_interrupt - next jiffy this CPU's wheel needs the tick
+ * @basej: current jiffies
+ *
+ * Called with interrupts disabled.  Returns @basej if something is
+ * already due, ~0 if nothing is pending.
+ */
+u64 get_next_timer_interrupt(u64 basej)
+{
+	struct timer_base *base = this_cpu_ptr(&timer_bases);
+	u64 next;
+
+	spin_lock(&base->lock);
+	next = __next_timer_interrupt(base);
+	spin_unlock(&base->lock);
+
+	return next < basej ? basej : next;
+}
+
+struct process_timer {
+	struct timer_list timer;
+	struct task_struct *task;
+};
+
+static void process_timeout(struct timer_list *t)
+{
+	struct process_timer *timeout = from_timer(timeout, t, timer);
+
+	wake_up_process(timeout->task);
+}
+
+/**
+ * schedule_timeout - sleep until woken or @timeout jiffies have passed
+ * @timeout: jiffies, or MAX_SCHEDULE_TIMEOUT to wait for a wakeup only
+ *
+ * The caller sets the task state first, as for schedule().  Returns 0 if
+ * the timeout expired, else the jiffies that were left.
+ */
+long schedule_timeout(long timeout)
+{
+	struct process_timer timer;
+	u64 expire;
+
+	if (timeout == MAX_SCHEDULE_TIMEOUT) {
+		schedule();
+		return timeout;
+	}
+	if (timeout <= 0) {
+		__set_current_state(TASK_RUNNING);
+		return 0;
+	}
+
+	expire = get_jiffies_64() + timeout;
+	timer.task = current;
+	timer_setup(&timer.timer, process_timeout, 0);
+	mod_timer(&timer.timer, expire);
+	schedule();
+	del_timer_sync(&timer.timer);
+
+	timeout = expire - get_jiffies_64();
+	return timeout < 0 ? 0 : timeout;
+}
+
+void msleep(unsigned int msecs)
+{
+	long timeout = msecs_to_jiffies(msecs) + 1;
+
+	while (timeout) {
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		timeout = schedule_timeout(timeout);
+	}
+}
+
+void init_timers_cpu(unsigned int cpu)
+{
+	struct timer_base *base = per_cpu_ptr(&timer_bases, cpu);
+
+	spin_lock_init(&base->lock);
+	base->cpu = cpu;
+	base->clk = get_jiffies_64();
+	hrtimers_init_cpu(cpu);
+}
+
+void init_timers(void)
+{
+	init_timers_cpu(smp_processor_id());
+	open_softirq(TIMER_SOFTIRQ, run_timer_softirq);
+}
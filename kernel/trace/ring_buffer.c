@@ -0,0 +1,145 @@
+/*
+ * Trace ring buffers.
+ *
+ * Every CPU writes only its own ring, so a record costs no lock and no
+ * atomic operation: the slot is claimed by an unlocked xadd on the CPU's
+ * head, which an interrupt or NMI nesting on the same CPU cannot split,
+ * and each writer then fills its own slot.  Old records are overwritten
+ * once the ring wraps.
+ *
+ * "trace" on the command line turns tracing on at boot, "trace_buf_kb=N"
+ * sizes each ring (rounded up to a power of two pages).  A panic dumps the
+ * rings if tracing was on; tools/tracedump decodes a console log.
+ */
+#define pr_fmt(fmt) "trace: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/cmdline.h>
+#include <zhos/cpumask.h>
+#include <zhos/gfp.h>
+#include <zhos/mm.h>
+#include <zhos/percpu.h>
+#include <zhos/preempt.h>
+#include <zhos/sched.h>
+#include <zhos/smp.h>
+#include <zhos/string.h>
+#include <zhos/timekeeping.h>
+#include <zhos/trace.h>
+
+#define TRACE_BUF_DEFAULT_KB	64
+
+struct trace_buffer {
+	u64 head;			/* records written since boot */
+	struct trace_entry *entries;
+	unsigned long mask;		/* entries in the ring - 1 */
+};
+
+bool tracing_enabled;
+
+static DEFINE_PER_CPU_ALIGNED(struct trace_buffer, trace_buffers);
+static unsigned int trace_buf_order;
+
+/* Returns the old value of *@p; only atomic against this CPU. */
+static __always_inline u64 local_xadd(u64 *p, u64 v)
+{
+	__asm__ __volatile__("xaddq %0, %1" : "+r"(v), "+m"(*p) :: "memory");
+	return v;
+}
+
+void __trace_event(unsigned int type, u64 a, u64 b)
+{
+	struct task_struct *curr;
+	struct trace_buffer *buf;
+	struct trace_entry *e;
+
+	preempt_disable();
+	buf = this_cpu_ptr(&trace_buffers);
+	if (likely(buf->entries)) {
+		e = &buf->entries[local_xadd(&buf->head, 1) & buf->mask];
+		curr = current;
+		e->ts = clock_now_ns();
+		e->type = type;
+		e->cpu = smp_processor_id();
+		e->pid = curr ? curr->pid : 0;
+		e->a = a;
+		e->b = b;
+	}
+	preempt_enable();
+}
+
+void tracing_on(void)
+{
+	WRITE_ONCE(tracing_enabled, true);
+}
+
+void tracing_off(void)
+{
+	WRITE_ONCE(tracing_enabled, false);
+}
+
+static void trace_dump_cpu(unsigned int cpu)
+{
+	struct trace_buffer *buf = per_cpu_ptr(&trace_buffers, cpu);
+	u64 head = READ_ONCE(buf->head), i;
+	struct trace_entry *e;
+
+	if (!buf->entries)
+		return;
+
+	printk("C %u %llu\n", cpu, (unsigned long long)head);
+	i = head > buf->mask ? head - buf->mask - 1 : 0;
+	for (; i < head; i++) {
+		e = &buf->entries[i & buf->mask];
+		printk(TRACE_DUMP_FMT "\n", (unsigned long long)e->ts, e->type,
+		       e->cpu, e->pid, (unsigned long long)e->a,
+		       (unsigned long long)e->b);
+	}
+}
+
+/**
+ * trace_dump - write the trace rings to the console
+ *
+ * Tracing is turned off first so the rings hold still; a writer already
+ * past the check on another CPU may still be filling its last record.
+ * Leaves tracing off.
+ */
+void trace_dump(void)
+{
+	unsigned int cpu;
+
+	tracing_off();
+	printk(TRACE_DUMP_BEGIN " %u\n", num_possible_cpus());
+	for_each_possible_cpu(cpu)
+		trace_dump_cpu(cpu);
+	printk(TRACE_DUMP_END "\n");
+}
+
+void trace_init(void)
+{
+	unsigned long kb = TRACE_BUF_DEFAULT_KB;
+	struct trace_buffer *buf;
+	struct page *page;
+	unsigned int cpu, nr = 0;
+	char opt[16];
+
+	if (!cmdline_get("trace_buf_kb", opt, sizeof(opt)))
+		kb = simple_strtoull(opt, NULL, 0);
+	trace_buf_order = min(get_order(max(kb, 1UL) << 10), MAX_ORDER - 1);
+
+	for_each_possible_cpu(cpu) {
+		page = alloc_pages(GFP_KERNEL | __GFP_ZERO, trace_buf_order);
+		if (!page) {
+			pr_warn("no ring for cpu %u\n", cpu);
+			continue;
+		}
+		buf = per_cpu_ptr(&trace_buffers, cpu);
+		buf->entries = page_address(page);
+		buf->mask = (PAGE_SIZE << trace_buf_order) / TRACE_ENTRY_SIZE - 1;
+		nr++;
+	}
+
+	pr_info("%lu KiB ring on %u cpus\n",
+		(PAGE_SIZE << trace_buf_order) >> 10, nr);
+	if (cmdline_has("trace"))
+		tracing_on();
+}
@@ -0,0 +1,43 @@
+/*
+ * Internet checksum, 32-bit words into a 64-bit accumulator so that the
+ * carries can be folded in once at the end, two words per load.  This is
+ * the portable version; csum_partial() is the arch's (asm/string.h).
+ */
+#include <zhos/checksum.h>
+#include <zhos/string.h>
+
+static inline u32 fold64(u64 sum)
+{
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	return sum;
+}
+
+u32 csum_partial_generic(const void *buf, unsigned int len, u32 sum)
+{
+	const u8 *p = buf;
+	u64 acc = sum, d;
+	u32 w;
+	u16 h;
+
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&d, p, 8);
+		acc += (u32)d;
+		acc += d >> 32;
+	}
+	if (len >= 4) {
+		memcpy(&w, p, 4);
+		acc += w;
+		p += 4;
+		len -= 4;
+	}
+	if (len >= 2) {
+		memcpy(&h, p, 2);
+		acc += h;
+		p += 2;
+		len -= 2;
+	}
+	if (len)
+		acc += *p;
+	return fold64(acc);
+}
@@ -0,0 +1,353 @@
+/*
+ * Radix tree.
+ *
+ * A tree of height h holds indices below 2^(h * RADIX_TREE_MAP_SHIFT).
+ * Inserting past that grows it from the top, the old root becoming slot
+ * 0 of a new one; deleting frees nodes as they empty and shrinks it back
+ * while the root only uses slot 0.  Each node keeps, per tag, a bitmap of
+ * the slots under which that tag is set anywhere, so a tagged lookup
+ * descends only into subtrees that have something to find.
+ */
+#include <zhos/kernel.h>
+#include <zhos/bitops.h>
+#include <zhos/errno.h>
+#include <zhos/radix-tree.h>
+#include <zhos/slab.h>
+
+/* Gang lookup of every entry rather than tagged ones. */
+#define RADIX_TREE_ANY		RADIX_TREE_MAX_TAGS
+
+struct radix_tree_node {
+	unsigned int shift;		/* of this level's bits in the index */
+	unsigned int offset;		/* slot in the parent */
+	unsigned int count;		/* slots in use */
+	struct radix_tree_node *parent;
+	u64 tags[RADIX_TREE_MAX_TAGS];
+	void *slots[RADIX_TREE_MAP_SIZE];
+};
+
+static struct kmem_cache *radix_tree_node_cachep;
+
+static struct radix_tree_node *node_alloc(struct radix_tree_node *parent,
+					  unsigned int shift,
+					  unsigned int offset)
+{
+	struct radix_tree_node *node;
+
+	node = kmem_cache_zalloc(radix_tree_node_cachep, GFP_KERNEL);
+	if (node) {
+		node->shift = shift;
+		node->offset = offset;
+		node->parent = parent;
+	}
+	return node;
+}
+
+static void node_free(struct radix_tree_node *node)
+{
+	kmem_cache_free(radix_tree_node_cachep, node);
+}
+
+static unsigned long height_to_maxindex(unsigned int height)
+{
+	unsigned int bits = height * RADIX_TREE_MAP_SHIFT;
+
+	return bits >= 64 ? ~0UL : (1UL << bits) - 1;
+}
+
+static unsigned int slot_offset(const struct radix_tree_node *node,
+				unsigned long index)
+{
+	return (index >> node->shift) & RADIX_TREE_MAP_MASK;
+}
+
+/* Grow until @index fits. */
+static int radix_tree_extend(struct radix_tree_root *root, unsigned long index)
+{
+	struct radix_tree_node *node;
+	unsigned int height = 1, tag;
+
+	if (!root->rnode) {
+		while (index > height_to_maxindex(height))
+			height++;
+		node = node_alloc(NULL, (height - 1) * RADIX_TREE_MAP_SHIFT, 0);
+		if (!node)
+			return -ENOMEM;
+		root->rnode = node;
+		root->height = height;
+		return 0;
+	}
+
+	while (index > height_to_maxindex(root->height)) {
+		node = node_alloc(NULL, root->height * RADIX_TREE_MAP_SHIFT, 0);
+		if (!node)
+			return -ENOMEM;
+		node->slots[0] = root->rnode;
+		node->count = 1;
+		for (tag = 0; tag < RADIX_TREE_MAX_TAGS; tag++)
+			if (root->tags & (1U << tag))
+				node->tags[tag] = 1;
+		root->rnode->parent = node;
+		root->rnode = node;
+		root->height++;
+	}
+	return 0;
+}
+
+int radix_tree_insert(struct radix_tree_root *root, unsigned long index,
+		      void *item)
+{
+	struct radix_tree_node *node, *child;
+	unsigned int off;
+	int err;
+
+	err = radix_tree_extend(root, index);
+	if (err)
+		return err;
+
+	node = root->rnode;
+	for (;;) {
+		off = slot_offset(node, index);
+		if (!node->shift)
+			break;
+		child = node->slots[off];
+		if (!child) {
+			child = node_alloc(node, node->shift - RADIX_TREE_MAP_SHIFT,
+					   off);
+			if (!child)
+				return -ENOMEM;
+			node->slots[off] = child;
+			node->count++;
+		}
+		node = child;
+	}
+
+	if (node->slots[off])
+		return -EEXIST;
+	node->slots[off] = item;
+	node->count++;
+	return 0;
+}
+
+/* The bottom-level node for @index, or NULL if there is none. */
+static struct radix_tree_node *lookup_leaf(struct radix_tree_root *root,
+					   unsigned long index)
+{
+	struct radix_tree_node *node = root->rnode;
+
+	if (!node || index > height_to_maxindex(root->height))
+		return NULL;
+	while (node && node->shift)
+		node = node->slots[slot_offset(node, index)];
+	return node;
+}
+
+void *radix_tree_lookup(struct radix_tree_root *root, unsigned long index)
+{
+	struct radix_tree_node *node = lookup_leaf(root, index);
+
+	return node ? node->slots[slot_offset(node, index)] : NULL;
+}
+
+/* Clear @tag at @off and up the tree for as long as nothing else has it. */
+static void node_tag_clear(struct radix_tree_root *root,
+			   struct radix_tree_node *node, unsigned int off,
+			   unsigned int tag)
+{
+	for (;;) {
+		node->tags[tag] &= ~(1ULL << off);
+		if (node->tags[tag])
+			return;
+		if (!node->parent) {
+			root->tags &= ~(1U << tag);
+			return;
+		}
+		off = node->offset;
+		node = node->parent;
+	}
+}
+
+static void radix_tree_shrink(struct radix_tree_root *root)
+{
+	struct radix_tree_node *node = root->rnode, *child;
+
+	while (root->height > 1 && node->count == 1 && node->slots[0]) {
+		child = node->slots[0];
+		child->parent = NULL;
+		child->offset = 0;
+		root->rnode = child;
+		root->height--;
+		node_free(node);
+		node = child;
+	}
+}
+
+void *radix_tree_delete(struct radix_tree_root *root, unsigned long index)
+{
+	struct radix_tree_node *node = lookup_leaf(root, index), *parent;
+	unsigned int off, tag;
+	void *item;
+
+	if (!node)
+		return NULL;
+	off = slot_offset(node, index);
+	item = node->slots[off];
+	if (!item)
+		return NULL;
+
+	for (tag = 0; tag < RADIX_TREE_MAX_TAGS; tag++)
+		if (node->tags[tag] & (1ULL << off))
+			node_tag_clear(root, node, off, tag);
+	node->slots[off] = NULL;
+	node->count--;
+
+	while (node && !node->count) {
+		parent = node->parent;
+		if (parent) {
+			parent->slots[node->offset] = NULL;
+			parent->count--;
+		} else {
+			root->rnode = NULL;
+			root->height = 0;
+			root->tags = 0;
+		}
+		node_free(node);
+		node = parent;
+	}
+	if (root->rnode)
+		radix_tree_shrink(root);
+	return item;
+}
+
+void radix_tree_tag_set(struct radix_tree_root *root, unsigned long index,
+			unsigned int tag)
+{
+	struct radix_tree_node *node = root->rnode;
+	unsigned int off;
+
+	BUG_ON(!node || index > height_to_maxindex(root->height));
+	for (;;) {
+		off = slot_offset(node, index);
+		node->tags[tag] |= 1ULL << off;
+		if (!node->shift)
+			break;
+		node = node->slots[off];
+		BUG_ON(!node);
+	}
+	BUG_ON(!node->slots[off]);
+	root->tags |= 1U << tag;
+}
+
+void radix_tree_tag_clear(struct radix_tree_root *root, unsigned long index,
+			  unsigned int tag)
+{
+	struct radix_tree_node *node = lookup_leaf(root, index);
+
+	if (node)
+		node_tag_clear(root, node, slot_offset(node, index), tag);
+}
+
+bool radix_tree_tag_get(struct radix_tree_root *root, unsigned long index,
+			unsigned int tag)
+{
+	struct radix_tree_node *node = lookup_leaf(root, index);
+
+	return node && (node->tags[tag] & (1ULL << slot_offset(node, index)));
+}
+
+/* Slots of @node that lead to something of interest. */
+static u64 node_map(const struct radix_tree_node *node, unsigned int tag)
+{
+	unsigned int i;
+	u64 map = 0;
+
+	if (tag != RADIX_TREE_ANY)
+		return node->tags[tag];
+	for (i = 0; i < RADIX_TREE_MAP_SIZE; i++)
+		if (node->slots[i])
+			map |= 1ULL << i;
+	return map;
+}
+
+/* @index with the bits of @node's level set to @off and those below clear. */
+static unsigned long index_at(const struct radix_tree_node *node,
+			      unsigned long index, unsigned int off)
+{
+	index &= ~((RADIX_TREE_MAP_MASK << node->shift) |
+		   ((1UL << node->shift) - 1));
+	return index | ((unsigned long)off << node->shift);
+}
+
+/*
+ * First entry of interest at or after *@index under @node; *@index is
+ * moved to it.  NULL if the subtree has none.
+ */
+static void *next_item(struct radix_tree_node *node, unsigned long *index,
+		       unsigned int tag)
+{
+	unsigned int off = slot_offset(node, *index);
+	u64 map = node_map(node, tag);
+	void *item;
+
+	for (;;) {
+		u64 w = map & (~0ULL << off);
+
+		if (!w)
+			return NULL;
+		if (__ffs64(w) != off) {
+			off = __ffs64(w);
+			*index = index_at(node, *index, off);
+		}
+		if (!node->shift)
+			return node->slots[off];
+		item = next_item(node->slots[off], index, tag);
+		if (item)
+			return item;
+		if (++off == RADIX_TREE_MAP_SIZE)
+			return NULL;
+		*index = index_at(node, *index, off);
+	}
+}
+
+static unsigned int __gang_lookup(struct radix_tree_root *root, void **results,
+				  unsigned long index, unsigned int max,
+				  unsigned int tag)
+{
+	unsigned long maxindex = height_to_maxindex(root->height);
+	unsigned int n = 0;
+	void *item;
+
+	if (tag != RADIX_TREE_ANY && !radix_tree_tagged(root, tag))
+		return 0;
+	while (n < max && root->rnode && index <= maxindex) {
+		item = next_item(root->rnode, &index, tag);
+		if (!item)
+			break;
+		results[n++] = item;
+		if (index == ~0UL)
+			break;
+		index++;
+	}
+	return n;
+}
+
+unsigned int radix_tree_gang_lookup(struct radix_tree_root *root,
+				    void **results, unsigned long first,
+				    unsigned int max)
+{
+	return __gang_lookup(root, results, first, max, RADIX_TREE_ANY);
+}
+
+unsigned int radix_tree_gang_lookup_tag(struct radix_tree_root *root,
+					void **results, unsigned long first,
+					unsigned int max, unsigned int tag)
+{
+	return __gang_lookup(root, results, first, max, tag);
+}
+
+void radix_tree_init(void)
+{
+	radix_tree_node_cachep = kmem_cache_create("radix_tree_node",
+						   sizeof(struct radix_tree_node),
+						   0, SLAB_PANIC, NULL);
+}
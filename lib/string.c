@@ -0,0 +1,173 @@
+/*
+ * Freestanding string and memory helpers.  GCC may emit calls to
+ * memcpy/memset/memmove/memcmp for aggregate copies, so these must exist
+ * even where nothing calls them by name.
+ *
+ * memcpy, memset and memcmp themselves are the arch's (asm/string.h),
+ * which starts out on and may stay with the portable versions here: a
+ * word at a time, then bytes.  Unaligned word accesses are fine on x86.
+ */
+#include <zhos/string.h>
+
+typedef u64 __attribute__((may_alias, aligned(1))) word_t;
+
+void *memcpy_generic(void *dst, const void *src, size_t n)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+
+	for (; n >= sizeof(word_t); n -= sizeof(word_t)) {
+		*(word_t *)d = *(const word_t *)s;
+		d += sizeof(word_t);
+		s += sizeof(word_t);
+	}
+	while (n--)
+		*d++ = *s++;
+	return dst;
+}
+
+void *memmove(void *dst, const void *src, size_t n)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+
+	if (d == s || n == 0)
+		return dst;
+	if (d < s) {
+		while (n--)
+			*d++ = *s++;
+	} else {
+		d += n;
+		s += n;
+		while (n--)
+			*--d = *--s;
+	}
+	return dst;
+}
+
+void *memset_generic(void *s, int c, size_t n)
+{
+	unsigned char *p = s;
+	u64 w = (unsigned char)c * 0x0101010101010101ULL;
+
+	for (; n >= sizeof(word_t); n -= sizeof(word_t)) {
+		*(word_t *)p = w;
+		p += sizeof(word_t);
+	}
+	while (n--)
+		*p++ = (unsigned char)c;
+	return s;
+}
+
+int memcmp_generic(const void *a, const void *b, size_t n)
+{
+	const unsigned char *x = a, *y = b;
+
+	/* Skip the equal words; the bytes of the first unequal one decide. */
+	for (; n >= sizeof(word_t); n -= sizeof(word_t)) {
+		if (*(const word_t *)x != *(const word_t *)y)
+			break;
+		x += sizeof(word_t);
+		y += sizeof(word_t);
+	}
+	for (; n; n--, x++, y++)
+		if (*x != *y)
+			return *x - *y;
+	return 0;
+}
+
+size_t strlen(const char *s)
+{
+	const char *p = s;
+
+	while (*p)
+		p++;
+	return p - s;
+}
+
+size_t strnlen(const char *s, size_t max)
+{
+	size_t n = 0;
+
+	while (n < max && s[n])
+		n++;
+	return n;
+}
+
+int strcmp(const char *a, const char *b)
+{
+	while (*a && *a == *b) {
+		a++;
+		b++;
+	}
+	return (unsigned char)*a - (unsigned char)*b;
+}
+
+int strncmp(const char *a, const char *b, size_t n)
+{
+	for (; n; n--, a++, b++) {
+		if (*a != *b)
+			return (unsigned char)*a - (unsigned char)*b;
+		if (!*a)
+			break;
+	}
+	return 0;
+}
+
+char *strchr(const char *s, int c)
+{
+	for (; *s; s++)
+		if (*s == (char)c)
+			return (char *)s;
+	return c ? NULL : (char *)s;
+}
+
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+	size_t len = strlen(src);
+
+	if (size) {
+		size_t n = len >= size ? size - 1 : len;
+
+		memcpy(dst, src, n);
+		dst[n] = '\0';
+	}
+	return len;
+}
+
+unsigned long long simple_strtoull(const char *s, char **end, unsigned int base)
+{
+	unsigned long long v = 0;
+
+	if (!base) {
+		base = 10;
+		if (s[0] == '0') {
+			base = 8;
+			if (s[1] == 'x' || s[1] == 'X') {
+				base = 16;
+				s += 2;
+			}
+		}
+	} else if (base == 16 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+		s += 2;
+	}
+
+	for (;; s++) {
+		unsigned int d;
+
+		if (*s >= '0' && *s <= '9')
+			d = *s - '0';
+		else if (*s >= 'a' && *s <= 'f')
+			d = *s - 'a' + 10;
+		else if (*s >= 'A' && *s <= 'F')
+			d = *s - 'A' + 10;
+		else
+			break;
+		if (d >= base)
+			break;
+		v = v * base + d;
+	}
+	if (end)
+		*end = (char *)s;
+	return v;
+}
@@ -0,0 +1,157 @@
+/*
+ * Minimal vsnprintf: %d %i %u %x %X %o %p %s %c %%, the l/ll/z length
+ * modifiers, and '-', '0' flags with a field width.
+ */
+#include <zhos/kernel.h>
+#include <zhos/string.h>
+
+struct outbuf {
+	char *buf;
+	size_t size;
+	size_t len;
+};
+
+static void emit(struct outbuf *o, char c)
+{
+	if (o->len + 1 < o->size)
+		o->buf[o->len] = c;
+	o->len++;
+}
+
+static void emit_number(struct outbuf *o, unsigned long long v, unsigned int base,
+			bool upper, bool neg, int width, bool zero, bool left)
+{
+	const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	char tmp[24];
+	int n = 0;
+
+	do {
+		tmp[n++] = digits[v % base];
+		v /= base;
+	} while (v);
+
+	width -= n + neg;
+	if (!left && !zero)
+		while (width-- > 0)
+			emit(o, ' ');
+	if (neg)
+		emit(o, '-');
+	if (!left && zero)
+		while (width-- > 0)
+			emit(o, '0');
+	while (n)
+		emit(o, tmp[--n]);
+	while (width-- > 0)
+		emit(o, ' ');
+}
+
+int vsnprintf(char *buf, size_t size, const char *fmt, va_list args)
+{
+	struct outbuf o = { .buf = buf, .size = size, .len = 0 };
+
+	for (; *fmt; fmt++) {
+		bool left = false, zero = false;
+		int width = 0, lng = 0;
+
+		if (*fmt != '%') {
+			emit(&o, *fmt);
+			continue;
+		}
+
+		for (;;) {
+			fmt++;
+			if (*fmt == '-')
+				left = true;
+			else if (*fmt == '0')
+				zero = true;
+			else
+				break;
+		}
+		while (*fmt >= '0' && *fmt <= '9')
+			width = width * 10 + (*fmt++ - '0');
+		while (*fmt == 'l') {
+			lng++;
+			fmt++;
+		}
+		if (*fmt == 'z') {
+			lng = 1;
+			fmt++;
+		}
+
+		switch (*fmt) {
+		case 'd':
+		case 'i': {
+			long long v = lng ? (lng > 1 ? va_arg(args, long long)
+					       : va_arg(args, long))
+				      : va_arg(args, int);
+			bool neg = v < 0;
+
+			emit_number(&o, neg ? -(unsigned long long)v : (unsigned long long)v,
+				    10, false, neg, width, zero, left);
+			break;
+		}
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'o': {
+			unsigned long long v = lng ? (lng > 1 ? va_arg(args, unsigned long long)
+						: va_arg(args, unsigned long))
+					       : va_arg(args, unsigned int);
+			unsigned int base = *fmt == 'u' ? 10 : *fmt == 'o' ? 8 : 16;
+
+			emit_number(&o, v, base, *fmt == 'X', false, width, zero, left);
+			break;
+		}
+		case 'p':
+			emit(&o, '0');
+			emit(&o, 'x');
+			emit_number(&o, (unsigned long)va_arg(args, void *), 16,
+				    false, false, 16, true, false);
+			break;
+		case 's': {
+			const char *s = va_arg(args, const char *);
+			int len;
+
+			if (!s)
+				s = "(null)";
+			len = strlen(s);
+			if (!left)
+				while (width-- > len)
+					emit(&o, ' ');
+			while (*s)
+				emit(&o, *s++);
+			while (width-- > len)
+				emit(&o, ' ');
+			break;
+		}
+		case 'c':
+			emit(&o, (char)va_arg(args, int));
+			break;
+		case '%':
+			emit(&o, '%');
+			break;
+		case '\0':
+			fmt--;
+			break;
+		default:
+			emit(&o, '%');
+			emit(&o, *fmt);
+			break;
+		}
+	}
+
+	if (o.size)
+		o.buf[o.len < o.size ? o.len : o.size - 1] = '\0';
+	return o.len;
+}
+
+int snprintf(char *buf, size_t size, const char *fmt, ...)
+{
+	va_list args;
+	int n;
+
+	va_start(args, fmt);
+	n = vsnprintf(buf, size, fmt, args);
+	va_end(args);
+	return n;
+}
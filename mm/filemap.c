@@ -0,0 +1,399 @@
+/*
+ * The page cache.
+ *
+ * Every inode's cached pages live in its address_space, a radix tree
+ * indexed by page offset in the file, whatever filesystem it belongs to.
+ * Reads are served from it and writes land in it; the filesystem is only
+ * asked to fill pages that are missing, in batches chosen by readahead
+ * (mm/readahead.c), and to write back dirty ones, in batches chosen by
+ * writeback (mm/page-writeback.c).
+ *
+ * A page is locked while its contents are read in or modified.  Sleeping
+ * for a page lock or for writeback to end goes through a small hashed
+ * table of wait queues rather than a queue per page; waking checks the
+ * queue unlocked first, so the common uncontended unlock costs nothing.
+ */
+#include <zhos/kernel.h>
+#include <zhos/errno.h>
+#include <zhos/fs.h>
+#include <zhos/gfp.h>
+#include <zhos/mm.h>
+#include <zhos/pagemap.h>
+#include <zhos/radix-tree.h>
+#include <zhos/spinlock.h>
+#include <zhos/string.h>
+#include <zhos/wait.h>
+
+#define PAGE_WAIT_TABLE_BITS	6
+#define PAGE_WAIT_TABLE_SIZE	(1 << PAGE_WAIT_TABLE_BITS)
+
+/* Pages looked up per pass when walking a whole mapping. */
+#define PAGEVEC_SIZE		16
+
+static struct wait_queue_head page_wait_table[PAGE_WAIT_TABLE_SIZE];
+
+static struct wait_queue_head *page_waitqueue(struct page *page)
+{
+	u64 hash = page_to_pfn(page) * 0x9e37fffffffc0001ULL;
+
+	return &page_wait_table[hash >> (64 - PAGE_WAIT_TABLE_BITS)];
+}
+
+void wake_up_page(struct page *page)
+{
+	struct wait_queue_head *wq = page_waitqueue(page);
+
+	if (waitqueue_active(wq))
+		wake_up(wq);
+}
+
+void lock_page(struct page *page)
+{
+	struct wait_queue_head *wq = page_waitqueue(page);
+
+	while (TestSetPageLocked(page))
+		wait_event(*wq, !PageLocked(page));
+}
+
+void unlock_page(struct page *page)
+{
+	ClearPageLocked(page);
+	wake_up_page(page);
+}
+
+void wait_on_page_locked(struct page *page)
+{
+	if (PageLocked(page))
+		wait_event(*page_waitqueue(page), !PageLocked(page));
+}
+
+void wait_on_page_writeback(struct page *page)
+{
+	if (PageWriteback(page))
+		wait_event(*page_waitqueue(page), !PageWriteback(page));
+}
+
+void end_page_read(struct page *page, int err)
+{
+	if (!err)
+		SetPageUptodate(page);
+	unlock_page(page);
+}
+
+struct page *find_get_page(struct address_space *mapping, unsigned long index)
+{
+	unsigned long flags;
+	struct page *page;
+
+	spin_lock_irqsave(&mapping->tree_lock, flags);
+	page = radix_tree_lookup(&mapping->page_tree, index);
+	if (page)
+		get_page(page);
+	spin_unlock_irqrestore(&mapping->tree_lock, flags);
+
+	return page;
+}
+
+int add_to_page_cache(struct page *page, struct address_space *mapping,
+		      unsigned long index)
+{
+	unsigned long flags;
+	int err;
+
+	SetPageLocked(page);
+	page->mapping = mapping;
+	page->index = index;
+	get_page(page);
+
+	spin_lock_irqsave(&mapping->tree_lock, flags);
+	err = radix_tree_insert(&mapping->page_tree, index, page);
+	if (!err)
+		mapping->nrpages++;
+	spin_unlock_irqrestore(&mapping->tree_lock, flags);
+
+	if (err) {
+		page->mapping = NULL;
+		put_page(page);
+		ClearPageLocked(page);
+	}
+	return err;
+}
+
+struct page *grab_cache_page(struct address_space *mapping,
+			     unsigned long index)
+{
+	struct page *page;
+	int err;
+
+	for (;;) {
+		page = find_get_page(mapping, index);
+		if (page) {
+			lock_page(page);
+			if (page->mapping == mapping)
+				return page;
+			/* Truncated while we slept. */
+			unlock_page(page);
+			put_page(page);
+			continue;
+		}
+
+		page = alloc_page(GFP_KERNEL);
+		if (!page)
+			return NULL;
+		err = add_to_page_cache(page, mapping, index);
+		if (!err)
+			return page;
+		put_page(page);
+		if (err != -EEXIST)
+			return NULL;
+	}
+}
+
+/* @page is locked and out of writeback; drops the cache's reference. */
+static void delete_from_page_cache(struct page *page)
+{
+	struct address_space *mapping = page->mapping;
+	unsigned long flags;
+
+	spin_lock_irqsave(&mapping->tree_lock, flags);
+	radix_tree_delete(&mapping->page_tree, page->index);
+	mapping->nrpages--;
+	spin_unlock_irqrestore(&mapping->tree_lock, flags);
+
+	cancel_dirty_page(page);
+	ClearPageUptodate(page);
+	ClearPageReadahead(page);
+	page->mapping = NULL;
+	put_page(page);
+}
+
+void truncate_inode_pages(struct address_space *mapping)
+{
+	struct page *pages[PAGEVEC_SIZE];
+	unsigned long index = 0, flags;
+	unsigned int n, i;
+
+	for (;;) {
+		spin_lock_irqsave(&mapping->tree_lock, flags);
+		n = radix_tree_gang_lookup(&mapping->page_tree, (void **)pages,
+					   index, PAGEVEC_SIZE);
+		for (i = 0; i < n; i++)
+			get_page(pages[i]);
+		spin_unlock_irqrestore(&mapping->tree_lock, flags);
+		if (!n)
+			break;
+
+		index = pages[n - 1]->index + 1;
+		for (i = 0; i < n; i++) {
+			lock_page(pages[i]);
+			wait_on_page_writeback(pages[i]);
+			if (pages[i]->mapping == mapping)
+				delete_from_page_cache(pages[i]);
+			unlock_page(pages[i]);
+			put_page(pages[i]);
+		}
+		if (!index)
+			break;
+	}
+}
+
+/*
+ * Read @page, locked and not uptodate, on its own and wait for it: the
+ * slow path for a page readahead did not bring in.  Returns with the page
+ * unlocked.
+ */
+static int filemap_read_page(struct address_space *mapping, struct page *page)
+{
+	int err;
+
+	err = mapping->a_ops->readpages(mapping, &page, 1);
+	if (err) {
+		unlock_page(page);
+		return err;
+	}
+	wait_on_page_locked(page);
+	return PageUptodate(page) ? 0 : -EIO;
+}
+
+struct page *read_cache_page(struct address_space *mapping,
+			     unsigned long index, int *err)
+{
+	struct page *page;
+
+	page = find_get_page(mapping, index);
+	if (page && !PageUptodate(page))
+		wait_on_page_locked(page);
+	if (page && PageUptodate(page))
+		return page;
+	if (page)
+		put_page(page);
+
+	page = grab_cache_page(mapping, index);
+	if (!page) {
+		*err = -ENOMEM;
+		return NULL;
+	}
+	if (PageUptodate(page)) {
+		unlock_page(page);
+		return page;
+	}
+	*err = filemap_read_page(mapping, page);
+	if (*err) {
+		put_page(page);
+		return NULL;
+	}
+	return page;
+}
+
+/*
+ * The page at @index, uptodate, reading it ahead if it is missing; NULL
+ * with *@err set on failure.  @req is how many pages the caller still
+ * wants from there on.
+ */
+static struct page *filemap_get_page(struct file *file, unsigned long index,
+				     unsigned long req, int *err)
+{
+	struct address_space *mapping = file->f_mapping;
+	struct file_ra_state *ra = &file->f_ra;
+	struct page *page;
+
+	page = find_get_page(mapping, index);
+	if (!page) {
+		page_cache_sync_readahead(mapping, ra, index, req);
+		page = find_get_page(mapping, index);
+	}
+	if (page && PageReadahead(page))
+		page_cache_async_readahead(mapping, ra, page, index, req);
+	if (page && !PageUptodate(page))
+		wait_on_page_locked(page);
+	if (page && PageUptodate(page))
+		return page;
+
+	/* Readahead failed or could not allocate: once more on its own. */
+	if (page)
+		put_page(page);
+	return read_cache_page(mapping, index, err);
+}
+
+ssize_t generic_file_read(struct file *file, void *buf, size_t count,
+			  loff_t *pos)
+{
+	struct inode *inode = file->f_inode;
+	unsigned long index, last_index;
+	size_t copied = 0, off, n;
+	struct page *page;
+	loff_t isize;
+	int err = 0;
+
+	if (!count)
+		return 0;
+	last_index = (*pos + count - 1) >> PAGE_SHIFT;
+
+	while (count) {
+		isize = READ_ONCE(inode->i_size);
+		if (*pos >= isize)
+			break;
+		index = *pos >> PAGE_SHIFT;
+		page = filemap_get_page(file, index, last_index - index + 1, &err);
+		if (!page)
+			break;
+
+		off = *pos & ~PAGE_MASK;
+		n = min(min(PAGE_SIZE - off, count), (size_t)(isize - *pos));
+		memcpy(buf + copied, page_address(page) + off, n);
+		put_page(page);
+
+		file->f_ra.prev_index = index;
+		copied += n;
+		count -= n;
+		*pos += n;
+	}
+	return copied ? (ssize_t)copied : err;
+}
+
+/*
+ * Get @page, locked and out of writeback, ready for a write of less than
+ * a page: its old contents are needed unless it lies past the end of the
+ * file.  Returns with the page unlocked on error.
+ */
+static int filemap_prepare_partial(struct address_space *mapping,
+				   struct page *page, loff_t isize)
+{
+	int err;
+
+	if (PageUptodate(page))
+		return 0;
+	if (page_offset(page) >= isize) {
+		memset(page_address(page), 0, PAGE_SIZE);
+		SetPageUptodate(page);
+		return 0;
+	}
+	err = filemap_read_page(mapping, page);
+	if (err)
+		return err;
+	lock_page(page);
+	wait_on_page_writeback(page);
+	return 0;
+}
+
+ssize_t generic_file_write(struct file *file, const void *buf, size_t count,
+			   loff_t *pos)
+{
+	struct address_space *mapping = file->f_mapping;
+	struct inode *inode = file->f_inode;
+	size_t written = 0, off, n;
+	unsigned long flags;
+	struct page *page;
+	int err = 0;
+
+	while (count) {
+		off = *pos & ~PAGE_MASK;
+		n = min(PAGE_SIZE - off, count);
+
+		page = grab_cache_page(mapping, *pos >> PAGE_SHIFT);
+		if (!page) {
+			err = -ENOMEM;
+			break;
+		}
+		/* Nothing changes under a write in flight. */
+		wait_on_page_writeback(page);
+		if (n != PAGE_SIZE) {
+			err = filemap_prepare_partial(mapping, page,
+						      READ_ONCE(inode->i_size));
+			if (err) {
+				put_page(page);
+				break;
+			}
+		}
+
+		memcpy(page_address(page) + off, buf + written, n);
+		SetPageUptodate(page);
+		set_page_dirty(page);
+		unlock_page(page);
+		put_page(page);
+
+		spin_lock_irqsave(&inode->i_lock, flags);
+		if (*pos + (loff_t)n > inode->i_size)
+			WRITE_ONCE(inode->i_size, *pos + n);
+		spin_unlock_irqrestore(&inode->i_lock, flags);
+
+		written += n;
+		count -= n;
+		*pos += n;
+		balance_dirty_pages();
+	}
+	return written ? (ssize_t)written : err;
+}
+
+int generic_file_fsync(struct file *file)
+{
+	return filemap_write_and_wait(file->f_mapping);
+}
+
+void pagecache_init(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < PAGE_WAIT_TABLE_SIZE; i++)
+		init_waitqueue_head(&page_wait_table[i]);
+}
@@ -0,0 +1,225 @@
+/*
+ * Transparent huge pages: policy, and promotion by khugepaged.
+ *
+ * Faults map huge pages where they can (mm/memory.c), but a 2 MiB range
+ * still ends up as small pages when no huge page was free at the time,
+ * or when its region only became eligible, by MADV_HUGEPAGE, after it
+ * was touched.  Every KHUGEPAGED_SLEEP_MS khugepaged walks the regions
+ * of every address space (mm_next()) for such ranges and promotes each
+ * one with at most max_ptes_none of its pages unmapped: it takes the PTE
+ * table out, flushes it from every TLB, copies the small pages into a
+ * new huge page (zeroing the holes), maps that in the PMD and frees the
+ * small pages and the table.
+ *
+ * The copy is made with the range unmapped and mmap_lock held, so an
+ * access to it meanwhile faults and waits for the lock, then finds the
+ * huge page.  Nothing can write to the old pages after the flush.
+ */
+#define pr_fmt(fmt) "thp: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/cmdline.h>
+#include <zhos/delay.h>
+#include <zhos/gfp.h>
+#include <zhos/huge_mm.h>
+#include <zhos/kthread.h>
+#include <zhos/list.h>
+#include <zhos/mm.h>
+#include <zhos/mm_types.h>
+#include <zhos/sched.h>
+#include <zhos/spinlock.h>
+#include <zhos/string.h>
+#include <asm/pgtable.h>
+#include <asm/tlbflush.h>
+
+#include "internal.h"
+
+#define KHUGEPAGED_SLEEP_MS	10000
+
+enum thp_mode {
+	THP_NEVER,
+	THP_MADVISE,
+	THP_ALWAYS,
+};
+
+static enum thp_mode thp_mode = THP_ALWAYS;
+static const char *const thp_mode_names[] = {
+	[THP_NEVER]	= "never",
+	[THP_MADVISE]	= "madvise",
+	[THP_ALWAYS]	= "always",
+};
+
+/* As Linux: a range with a single page mapped is worth promoting. */
+static unsigned int max_ptes_none = HPAGE_PMD_NR - 1;
+
+struct thp_stats thp_stats;
+
+bool thp_vma_allowed(const struct vm_area_struct *vma)
+{
+	if ((vma->vm_flags & VM_NOHUGEPAGE) || vma->vm_mapping)
+		return false;
+	if (thp_mode == THP_ALWAYS)
+		return true;
+	return thp_mode == THP_MADVISE && (vma->vm_flags & VM_HUGEPAGE);
+}
+
+/*
+ * Mapped small pages under @pmd, or -1 if it is not a PTE table or it
+ * shares the table or any page with another address space since fork.
+ */
+static int pmd_nr_present(pmd_t *pmd)
+{
+	pte_t *pte;
+	int i, nr = 0;
+
+	if (pmd_none(*pmd) || pmd_large(*pmd) || !pmd_write(*pmd))
+		return -1;
+	pte = pmd_page_vaddr(*pmd);
+	for (i = 0; i < PTRS_PER_PTE; i++) {
+		if (!pte_present(pte[i]))
+			continue;
+		if (page_count(pfn_to_page(pte_pfn(pte[i]))) != 1)
+			return -1;
+		nr++;
+	}
+	return nr;
+}
+
+static bool collapse_candidate(struct mm_struct *mm, unsigned long haddr)
+{
+	struct vm_area_struct *vma = vma_lookup(mm, haddr);
+	pmd_t *pmd;
+	int nr;
+
+	if (!vma || !thp_vma_suitable(vma, haddr))
+		return false;
+	pmd = mm_find_pmd(mm, haddr);
+	if (!pmd)
+		return false;
+	nr = pmd_nr_present(pmd);
+	return nr >= 0 && nr >= HPAGE_PMD_NR - max_ptes_none;
+}
+
+/* The lowest candidate range at or above @addr, or 0; under mmap_lock. */
+static unsigned long find_candidate(struct mm_struct *mm, unsigned long addr)
+{
+	struct vm_area_struct *vma;
+	unsigned long haddr;
+
+	list_for_each_entry(vma, &mm->mmap, vm_list) {
+		if (vma->vm_end <= addr || !thp_vma_allowed(vma))
+			continue;
+		haddr = ALIGN(max(addr, vma->vm_start), PMD_SIZE);
+		for (; haddr + PMD_SIZE <= vma->vm_end; haddr += PMD_SIZE)
+			if (collapse_candidate(mm, haddr))
+				return haddr;
+	}
+	return 0;
+}
+
+static bool collapse_huge_page(struct mm_struct *mm, unsigned long haddr)
+{
+	struct page *hpage, *old;
+	pte_t *table;
+	pmd_t *pmd;
+	u8 *dst;
+	unsigned int i;
+	LIST_HEAD(pages);
+
+	/* Not zeroed: every byte gets written below. */
+	hpage = alloc_pages(GFP_KERNEL, HPAGE_PMD_ORDER);
+	if (!hpage) {
+		count_thp_event(collapse_alloc_failed);
+		return false;
+	}
+
+	spin_lock(&mm->mmap_lock);
+	/* The lock was dropped to allocate: look again. */
+	if (!collapse_candidate(mm, haddr)) {
+		spin_unlock(&mm->mmap_lock);
+		__free_pages(hpage, HPAGE_PMD_ORDER);
+		return false;
+	}
+	pmd = mm_find_pmd(mm, haddr);
+	table = pmd_page_vaddr(*pmd);
+	pmd_clear(pmd);
+	flush_tlb_mm_range(mm, haddr, haddr + PMD_SIZE);
+
+	/* The new page in before the old ones out: numa_nid holds steady. */
+	mm_account_node(mm, hpage, HPAGE_PMD_NR);
+	dst = page_address(hpage);
+	for (i = 0; i < PTRS_PER_PTE; i++, dst += PAGE_SIZE) {
+		if (!pte_present(table[i])) {
+			memset(dst, 0, PAGE_SIZE);
+			continue;
+		}
+		old = pfn_to_page(pte_pfn(table[i]));
+		memcpy(dst, page_address(old), PAGE_SIZE);
+		mm_unaccount_node(mm, old, 1);
+	}
+	release_pte_table(table, &pages);
+
+	set_pmd(pmd, pfn_pmd(page_to_pfn(hpage), PAGE_KERNEL_LARGE));
+	spin_unlock(&mm->mmap_lock);
+
+	free_page_list(&pages);
+	count_thp_event(collapse_alloc);
+	return true;
+}
+
+/**
+ * khugepaged_scan_mm - promote what can be promoted in @mm
+ * @mm: the address space
+ *
+ * Must be called with interrupts enabled, as for any TLB flush.
+ */
+unsigned int khugepaged_scan_mm(struct mm_struct *mm)
+{
+	unsigned long addr = 0;
+	unsigned int nr = 0;
+
+	if (thp_mode == THP_NEVER)
+		return 0;
+
+	for (;;) {
+		spin_lock(&mm->mmap_lock);
+		addr = find_candidate(mm, addr);
+		spin_unlock(&mm->mmap_lock);
+		if (!addr)
+			break;
+		nr += collapse_huge_page(mm, addr);
+		addr += PMD_SIZE;
+	}
+	return nr;
+}
+
+static int khugepaged(void *unused)
+{
+	struct mm_struct *mm;
+
+	for (;;) {
+		msleep(KHUGEPAGED_SLEEP_MS);
+		for (mm = mm_next(NULL); mm; mm = mm_next(mm))
+			khugepaged_scan_mm(mm);
+	}
+	return 0;
+}
+
+void hugepage_init(void)
+{
+	char opt[16];
+	unsigned int i;
+
+	if (!cmdline_get("transparent_hugepage", opt, sizeof(opt))) {
+		for (i = 0; i < ARRAY_SIZE(thp_mode_names); i++)
+			if (!strcmp(opt, thp_mode_names[i]))
+				thp_mode = i;
+	}
+
+	if (thp_mode != THP_NEVER &&
+	    !kthread_run(khugepaged, NULL, "khugepaged"))
+		pr_err("no khugepaged thread\n");
+
+	pr_info("%s, khugepaged every %u ms\n", thp_mode_names[thp_mode],
+		KHUGEPAGED_SLEEP_MS);
+}
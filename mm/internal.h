@@ -0,0 +1,80 @@
+#ifndef _MM_INTERNAL_H
+#define _MM_INTERNAL_H
+
+#include <zhos/list.h>
+#include <zhos/mm.h>
+#include <zhos/mm_types.h>
+#include <asm/pgtable.h>
+
+/* The PMD entry mapping @addr, or NULL if there is no table for it yet. */
+pmd_t *mm_find_pmd(struct mm_struct *mm, unsigned long addr);
+
+/*
+ * Drop the reference a page table entry held on @page.  The last one
+ * queues the block on @list, by its lru with the order in ->private, to
+ * be freed by free_page_list() once no TLB can reach it any more.
+ */
+static inline void release_page(struct page *page, unsigned int order,
+				 struct list_head *list)
+{
+	if (!put_page_testzero(page))
+		return;
+	set_page_count(page, 1);
+	page->private = order;
+	list_add_tail(&page->lru, list);
+}
+
+/* Count @nr pages of @page's node newly mapped in @mm; mmap_lock held. */
+static inline void mm_account_node(struct mm_struct *mm, struct page *page,
+				   unsigned long nr)
+{
+	int nid = page_to_nid(page);
+
+	mm->numa_pages[nid] += nr;
+	if (mm->numa_nid == NUMA_NO_NODE ||
+	    mm->numa_pages[nid] > mm->numa_pages[mm->numa_nid])
+		WRITE_ONCE(mm->numa_nid, nid);
+}
+
+/* And @nr pages unmapped from @mm; the node with the most may change. */
+static inline void mm_unaccount_node(struct mm_struct *mm, struct page *page,
+				     unsigned long nr)
+{
+	int nid = page_to_nid(page), best = NUMA_NO_NODE;
+	unsigned int i;
+
+	mm->numa_pages[nid] -= nr;
+	if (nid != mm->numa_nid)
+		return;
+	for (i = 0; i < nr_node_ids; i++)
+		if (mm->numa_pages[i] && (best == NUMA_NO_NODE ||
+		    mm->numa_pages[i] > mm->numa_pages[best]))
+			best = i;
+	WRITE_ONCE(mm->numa_nid, best);
+}
+
+/* The same for a PTE table; the last reference releases its pages too. */
+void release_pte_table(pte_t *table, struct list_head *list);
+
+void free_page_list(struct list_head *list);
+
+/*
+ * Clear every mapping in [start, end), releasing the pages it used.
+ * Fails with nothing changed if a PTE table shared with another address
+ * space, only partly in the range, cannot be copied.
+ */
+int zap_page_range(struct mm_struct *mm, unsigned long start,
+		   unsigned long end, struct list_head *list);
+
+/* Take apart the private page tables of an mm nobody uses any more. */
+void free_pgtables(struct mm_struct *mm, struct list_head *list);
+
+/* What a node's zone was given at boot, for the zeroed pools. */
+unsigned long node_managed_pages(int nid);
+
+/* The zeroed pools, for the page allocator (mm/prezero.c). */
+struct page *prezero_take(int nid, unsigned int order);
+unsigned long prezero_drain(void);
+unsigned long nr_prezeroed_pages(void);
+
+#endif /* _MM_INTERNAL_H */
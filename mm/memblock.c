@@ -0,0 +1,164 @@
+/*
+ * Boot-time memory ranges.  Both lists are kept sorted with adjacent and
+ * overlapping regions merged, so a free range is simply a gap between
+ * reservations inside a memory region.
+ */
+#define pr_fmt(fmt) "memblock: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/memblock.h>
+#include <zhos/string.h>
+#include <asm/page.h>
+
+static struct memblock_type memblock_memory;
+static struct memblock_type memblock_reserved;
+
+phys_addr_t memblock_limit = BOOT_IDENTITY_SIZE;
+
+static void memblock_insert(struct memblock_type *type, phys_addr_t base,
+			    phys_addr_t size)
+{
+	struct memblock_region *r = type->regions;
+	phys_addr_t end = base + size;
+	unsigned int i, j;
+
+	if (!size)
+		return;
+
+	/* First region that ends at or after @base. */
+	for (i = 0; i < type->cnt && r[i].base + r[i].size < base; i++)
+		;
+
+	/* Absorb every region the new one touches. */
+	for (j = i; j < type->cnt && r[j].base <= end; j++) {
+		base = min(base, r[j].base);
+		end = max(end, r[j].base + r[j].size);
+	}
+
+	if (i == j) {
+		if (type->cnt == MEMBLOCK_MAX_REGIONS)
+			panic("memblock: out of regions");
+		memmove(&r[i + 1], &r[i], (type->cnt - i) * sizeof(*r));
+		type->cnt++;
+	} else if (j > i + 1) {
+		memmove(&r[i + 1], &r[j], (type->cnt - j) * sizeof(*r));
+		type->cnt -= j - i - 1;
+	}
+	r[i].base = base;
+	r[i].size = end - base;
+}
+
+void memblock_add(phys_addr_t base, phys_addr_t size)
+{
+	memblock_insert(&memblock_memory, base, size);
+}
+
+void memblock_reserve(phys_addr_t base, phys_addr_t size)
+{
+	memblock_insert(&memblock_reserved, base, size);
+}
+
+bool memblock_is_reserved(phys_addr_t addr)
+{
+	struct memblock_region *r = memblock_reserved.regions;
+	unsigned int i;
+
+	for (i = 0; i < memblock_reserved.cnt; i++)
+		if (addr >= r[i].base && addr < r[i].base + r[i].size)
+			return true;
+	return false;
+}
+
+bool memblock_is_region_memory(phys_addr_t base, phys_addr_t size)
+{
+	struct memblock_region *m = memblock_memory.regions;
+	unsigned int i;
+
+	for (i = 0; i < memblock_memory.cnt; i++)
+		if (base >= m[i].base && base + size <= m[i].base + m[i].size)
+			return true;
+	return false;
+}
+
+/* Gaps between reservations inside memory regions, below memblock_limit. */
+static void for_each_free_range(void (*fn)(phys_addr_t, phys_addr_t, void *),
+				void *data)
+{
+	struct memblock_region *m = memblock_memory.regions;
+	struct memblock_region *r = memblock_reserved.regions;
+	unsigned int i, j = 0;
+
+	for (i = 0; i < memblock_memory.cnt; i++) {
+		phys_addr_t start = m[i].base;
+		phys_addr_t end = min(m[i].base + m[i].size, memblock_limit);
+
+		while (start < end) {
+			phys_addr_t stop = end;
+
+			while (j < memblock_reserved.cnt &&
+			       r[j].base + r[j].size <= start)
+				j++;
+			if (j < memblock_reserved.cnt && r[j].base <= start) {
+				start = r[j].base + r[j].size;
+				continue;
+			}
+			if (j < memblock_reserved.cnt && r[j].base < end)
+				stop = r[j].base;
+			fn(start, stop, data);
+			start = stop;
+		}
+	}
+}
+
+struct alloc_req {
+	phys_addr_t size, align, found;
+};
+
+/* Keeps the highest fit, so early allocations stay clear of low memory. */
+static void alloc_fit(phys_addr_t start, phys_addr_t end, void *data)
+{
+	struct alloc_req *req = data;
+	phys_addr_t base;
+
+	if (end - start < req->size)
+		return;
+	base = ALIGN_DOWN(end - req->size, req->align);
+	if (base >= start)
+		req->found = base;
+}
+
+phys_addr_t memblock_alloc(phys_addr_t size, phys_addr_t align)
+{
+	struct alloc_req req = { .size = size, .align = align, .found = 0 };
+
+	for_each_free_range(alloc_fit, &req);
+	if (!req.found)
+		panic("memblock: cannot allocate %llu bytes",
+		      (unsigned long long)size);
+	memblock_reserve(req.found, size);
+	return req.found;
+}
+
+phys_addr_t memblock_end_of_DRAM(void)
+{
+	struct memblock_region *m = memblock_memory.regions;
+	unsigned int i;
+
+	for (i = memblock_memory.cnt; i > 0; i--)
+		if (m[i - 1].base < memblock_limit)
+			return min(m[i - 1].base + m[i - 1].size, memblock_limit);
+	return 0;
+}
+
+static void free_range_cb(phys_addr_t start, phys_addr_t end, void *data)
+{
+	void (**fn)(phys_addr_t, phys_addr_t) = data;
+
+	(*fn)(start, end);
+}
+
+void memblock_for_each_free_range(void (*fn)(phys_addr_t start,
+					     phys_addr_t end))
+{
+	for_each_free_range(free_range_cb, &fn);
+}
@@ -0,0 +1,510 @@
+/*
+ * Demand paging of anonymous regions, and copy-on-write.
+ *
+ * A region's page tables start empty; the first touch of each page
+ * faults, and handle_mm_fault() backs it with a zeroed page.  Where the
+ * whole 2 MiB around the address belongs to a region that may use huge
+ * pages, the fault maps a zeroed 2 MiB page in the PMD instead, so that
+ * the other 511 pages never fault at all.
+ *
+ * fork (dup_mm()) copies no pages and no PTE tables either: parent and
+ * child share each PTE table, write-protected as a whole by clearing
+ * _PAGE_RW in both PMD entries, and each huge page, write-protected in
+ * the PMD entry itself.  So copying an address space costs one entry per
+ * 2 MiB mapped rather than one per page.  The first write fault under a
+ * shared table copies it for the faulting side, write-protecting every
+ * page in both copies; a copy's pages are then copied one at a time, as
+ * they are written, unless the copy turns out to be the only one left.
+ *
+ * A page's reference count is the number of page table entries, not of
+ * address spaces, that map it: a PTE table holds one reference on each
+ * page in it, whoever shares the table, and the table has a count of its
+ * own.  A write-protected page with a count of one is written in place.
+ *
+ * A file region's first touch maps the page cache page itself, read
+ * only, reading it in first if it is not cached.  The cache holds a
+ * reference of its own, so a write always copies the page, as it would
+ * one shared after fork.
+ *
+ * Everything is done under mm->mmap_lock except allocating a data page
+ * (and with it the zeroing, 2 MiB of it for a huge page): that happens
+ * with the lock dropped, after which the fault starts over and uses the
+ * page only if the entry still needs it.  Filling an empty entry or
+ * making one writable needs no flush, except of a stale entry on this
+ * CPU; taking a page away does, on every CPU, before it can be freed.
+ */
+#define pr_fmt(fmt) "mm: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/errno.h>
+#include <zhos/gfp.h>
+#include <zhos/huge_mm.h>
+#include <zhos/list.h>
+#include <zhos/mm.h>
+#include <zhos/mm_types.h>
+#include <zhos/pagemap.h>
+#include <zhos/spinlock.h>
+#include <zhos/string.h>
+#include <asm/pgtable.h>
+#include <asm/tlbflush.h>
+
+#include "internal.h"
+
+pmd_t *mm_find_pmd(struct mm_struct *mm, unsigned long addr)
+{
+	pgd_t *pgd = mm->pgd + pgd_index(addr);
+	pud_t *pud;
+
+	if (pgd_none(*pgd))
+		return NULL;
+	pud = pud_offset(pgd, addr);
+	if (pud_none(*pud) || pud_large(*pud))
+		return NULL;
+	return pmd_offset(pud, addr);
+}
+
+/* A zeroed table page, or 0. */
+static u64 alloc_table(void)
+{
+	unsigned long table = get_zeroed_page(GFP_KERNEL);
+
+	return table ? __pa((void *)table) | _KERNPG_TABLE : 0;
+}
+
+/* As mm_find_pmd(), allocating the tables above the PMD as needed. */
+static pmd_t *pmd_alloc(struct mm_struct *mm, unsigned long addr)
+{
+	pgd_t *pgd = mm->pgd + pgd_index(addr);
+	pud_t *pud;
+	u64 table;
+
+	if (pgd_none(*pgd)) {
+		table = alloc_table();
+		if (!table)
+			return NULL;
+		set_pgd(pgd, __pgd(table));
+	}
+	pud = pud_offset(pgd, addr);
+	if (pud_none(*pud)) {
+		table = alloc_table();
+		if (!table)
+			return NULL;
+		set_pud(pud, __pud(table));
+	}
+	return pmd_offset(pud, addr);
+}
+
+void release_pte_table(pte_t *table, struct list_head *list)
+{
+	struct page *page = virt_to_page(table);
+	unsigned int i;
+
+	if (!put_page_testzero(page))
+		return;
+	for (i = 0; i < PTRS_PER_PTE; i++)
+		if (pte_present(table[i]))
+			release_page(pfn_to_page(pte_pfn(table[i])), 0, list);
+	set_page_count(page, 1);
+	page->private = 0;
+	list_add_tail(&page->lru, list);
+}
+
+/*
+ * Make the PTE table under @pmd this address space's own, and writable.
+ * Its pages stay write-protected: they are shared now.
+ */
+static int unshare_pte_table(pmd_t *pmd, struct list_head *list)
+{
+	pte_t *old = pmd_page_vaddr(*pmd), *new;
+	unsigned int i;
+
+	if (pmd_write(*pmd))
+		return 0;
+	if (page_count(virt_to_page(old)) == 1) {
+		set_pmd(pmd, pmd_mkwrite(*pmd));
+		return 0;
+	}
+
+	new = (pte_t *)get_zeroed_page(GFP_KERNEL);
+	if (!new)
+		return -ENOMEM;
+	/*
+	 * The other sharers only reach @old through write-protected PMD
+	 * entries, so its entries can be write-protected under them.
+	 */
+	for (i = 0; i < PTRS_PER_PTE; i++) {
+		if (!pte_present(old[i]))
+			continue;
+		set_pte(&old[i], pte_wrprotect(old[i]));
+		get_page(pfn_to_page(pte_pfn(old[i])));
+		new[i] = old[i];
+	}
+	set_pmd(pmd, __pmd(__pa(new) | _KERNPG_TABLE));
+	release_pte_table(old, list);
+	return 0;
+}
+
+/**
+ * handle_mm_fault - back a faulting address in @mm
+ * @mm: the address space
+ * @addr: the address that faulted
+ * @flags: FAULT_FLAG_WRITE for a write
+ *
+ * Maps a huge page if the range around @addr is suitable and one can be
+ * had, a small page otherwise, or breaks the sharing of a write-protected
+ * page that is written.  Doing nothing is success too: another CPU may
+ * have handled the same fault first.
+ */
+int handle_mm_fault(struct mm_struct *mm, unsigned long addr,
+		    unsigned int flags)
+{
+	bool write = flags & FAULT_FLAG_WRITE, try_huge = true, hzero = false;
+	struct page *page = NULL, *hpage = NULL, *fpage = NULL, *old;
+	struct address_space *mapping = NULL;
+	struct vm_area_struct *vma;
+	unsigned long index = 0;
+	LIST_HEAD(pages);
+	pmd_t *pmd;
+	pte_t *pte;
+	u64 table;
+	int ret = 0;
+
+again:
+	spin_lock(&mm->mmap_lock);
+	vma = vma_lookup(mm, addr);
+	if (!vma) {
+		ret = -EFAULT;
+		goto out;
+	}
+	pmd = pmd_alloc(mm, addr);
+	if (!pmd) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	if (pmd_large(*pmd)) {
+		if (!write || pmd_write(*pmd))
+			goto spurious;
+		old = pfn_to_page(pmd_pfn(*pmd));
+		if (page_count(old) == 1) {
+			set_pmd(pmd, pmd_mkwrite(*pmd));
+			goto spurious;
+		}
+		if (!hpage) {
+			/* Not zeroed: it is about to be overwritten. */
+			spin_unlock(&mm->mmap_lock);
+			hpage = alloc_pages(GFP_KERNEL, HPAGE_PMD_ORDER);
+			if (!hpage)
+				return -ENOMEM;
+			goto again;
+		}
+		memcpy(page_address(hpage), page_address(old), PMD_SIZE);
+		set_pmd(pmd, pfn_pmd(page_to_pfn(hpage), PAGE_KERNEL_LARGE));
+		mm_account_node(mm, hpage, HPAGE_PMD_NR);
+		mm_unaccount_node(mm, old, HPAGE_PMD_NR);
+		hpage = NULL;
+		flush_tlb_mm_range(mm, addr & PMD_MASK,
+				   (addr & PMD_MASK) + PMD_SIZE);
+		release_page(old, HPAGE_PMD_ORDER, &pages);
+		goto out;
+	}
+
+	if (pmd_none(*pmd) && try_huge && thp_vma_suitable(vma, addr)) {
+		if (!hpage) {
+			spin_unlock(&mm->mmap_lock);
+			hpage = alloc_pages(GFP_KERNEL | __GFP_ZERO,
+					    HPAGE_PMD_ORDER);
+			if (!hpage) {
+				count_thp_event(fault_fallback);
+				try_huge = false;
+			}
+			hzero = true;
+			goto again;
+		}
+		/* Allocated for a copy that is no longer needed? */
+		if (unlikely(!hzero))
+			memset(page_address(hpage), 0, PMD_SIZE);
+		set_pmd(pmd, pfn_pmd(page_to_pfn(hpage), PAGE_KERNEL_LARGE));
+		mm_account_node(mm, hpage, HPAGE_PMD_NR);
+		hpage = NULL;
+		count_thp_event(fault_alloc);
+		goto out;
+	}
+
+	if (pmd_none(*pmd)) {
+		table = alloc_table();
+		if (!table) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		set_pmd(pmd, __pmd(table));
+	}
+	/* Even a read fault changes the table: it may not be shared. */
+	ret = unshare_pte_table(pmd, &pages);
+	if (ret)
+		goto out;
+	pte = pte_offset_kernel(pmd, addr);
+
+	if (pte_present(*pte)) {
+		if (!write || pte_write(*pte))
+			goto spurious;
+		old = pfn_to_page(pte_pfn(*pte));
+		if (page_count(old) == 1) {
+			set_pte(pte, pte_mkwrite(*pte));
+			goto spurious;
+		}
+		if (!page)
+			goto alloc_page;
+		memcpy(page_address(page), page_address(old), PAGE_SIZE);
+		set_pte(pte, pfn_pte(page_to_pfn(page), PAGE_KERNEL));
+		mm_account_node(mm, page, 1);
+		mm_unaccount_node(mm, old, 1);
+		page = NULL;
+		flush_tlb_mm_range(mm, addr, addr + PAGE_SIZE);
+		release_page(old, 0, &pages);
+		goto out;
+	}
+
+	if (vma->vm_mapping) {
+		mapping = vma->vm_mapping;
+		index = vma->vm_pgoff + ((addr - vma->vm_start) >> PAGE_SHIFT);
+		if ((loff_t)index << PAGE_SHIFT >=
+		    READ_ONCE(mapping->host->i_size)) {
+			ret = -EFAULT;
+			goto out;
+		}
+		/* Read for another region the last time round? */
+		if (fpage && (fpage->mapping != mapping ||
+			      fpage->index != index)) {
+			put_page(fpage);
+			fpage = NULL;
+		}
+		if (!fpage)
+			fpage = find_get_page(mapping, index);
+		if (!fpage || !PageUptodate(fpage))
+			goto read_page;
+		/* The lookup's reference becomes the entry's. */
+		set_pte(pte, pte_wrprotect(pfn_pte(page_to_pfn(fpage),
+						   PAGE_KERNEL)));
+		mm_account_node(mm, fpage, 1);
+		fpage = NULL;
+		goto out;
+	}
+
+	if (!page)
+		goto alloc_page;
+	set_pte(pte, pfn_pte(page_to_pfn(page), PAGE_KERNEL));
+	mm_account_node(mm, page, 1);
+	page = NULL;
+	goto out;
+
+read_page:
+	/* Reading may sleep; the region's mapping outlives the region. */
+	spin_unlock(&mm->mmap_lock);
+	if (fpage)
+		put_page(fpage);
+	fpage = read_cache_page(mapping, index, &ret);
+	if (!fpage)
+		return ret;
+	goto again;
+
+alloc_page:
+	/* Zeroed either way: what it is needed for may change meanwhile. */
+	spin_unlock(&mm->mmap_lock);
+	page = alloc_page(GFP_KERNEL | __GFP_ZERO);
+	if (!page)
+		return -ENOMEM;
+	goto again;
+
+spurious:
+	/* Already handled, but this CPU may still hold the old entry. */
+	__flush_tlb_one(addr);
+out:
+	spin_unlock(&mm->mmap_lock);
+	free_page_list(&pages);
+	/* Lost a race, or the region went away while allocating. */
+	if (hpage)
+		__free_pages(hpage, HPAGE_PMD_ORDER);
+	if (page)
+		__free_page(page);
+	if (fpage)
+		put_page(fpage);
+	return ret;
+}
+
+/* Clear the small pages in [start, end), all under one PMD. */
+static void zap_pte_range(struct mm_struct *mm, pmd_t *pmd,
+			  unsigned long start, unsigned long end,
+			  struct list_head *list)
+{
+	pte_t *table = pmd_page_vaddr(*pmd);
+	pte_t *pte = pte_offset_kernel(pmd, start);
+	struct page *page;
+	unsigned int i;
+
+	if (start == (start & PMD_MASK) && end - start == PMD_SIZE)
+		goto drop;
+	/* Only part of it: zap_page_range() has unshared the table. */
+	for (; start < end; start += PAGE_SIZE, pte++) {
+		if (!pte_present(*pte))
+			continue;
+		page = pfn_to_page(pte_pfn(*pte));
+		mm_unaccount_node(mm, page, 1);
+		release_page(page, 0, list);
+		pte_clear(pte);
+	}
+	for (i = 0; i < PTRS_PER_PTE; i++)
+		if (!pte_none(table[i]))
+			return;
+	goto free;
+drop:
+	/* Gone from this mm even if another still shares the table. */
+	for (i = 0; i < PTRS_PER_PTE; i++) {
+		if (!pte_present(table[i]))
+			continue;
+		mm_unaccount_node(mm, pfn_to_page(pte_pfn(table[i])), 1);
+	}
+free:
+	pmd_clear(pmd);
+	release_pte_table(table, list);
+}
+
+/* A shared table only partly in [start, end) has to be copied first. */
+static int unshare_edge(struct mm_struct *mm, unsigned long addr,
+			unsigned long start, unsigned long end,
+			struct list_head *list)
+{
+	unsigned long haddr = addr & PMD_MASK;
+	pmd_t *pmd;
+
+	if (haddr >= start && haddr + PMD_SIZE <= end)
+		return 0;
+	pmd = mm_find_pmd(mm, addr);
+	if (!pmd || pmd_none(*pmd) || pmd_large(*pmd))
+		return 0;
+	return unshare_pte_table(pmd, list);
+}
+
+int zap_page_range(struct mm_struct *mm, unsigned long start,
+		   unsigned long end, struct list_head *list)
+{
+	struct page *page;
+	unsigned long next;
+	pmd_t *pmd;
+	int ret;
+
+	ret = unshare_edge(mm, start, start, end, list);
+	if (!ret)
+		ret = unshare_edge(mm, end - 1, start, end, list);
+	if (ret)
+		return ret;
+
+	for (; start < end; start = next) {
+		next = min((start & PMD_MASK) + PMD_SIZE, end);
+		pmd = mm_find_pmd(mm, start);
+		if (!pmd || pmd_none(*pmd))
+			continue;
+		if (pmd_large(*pmd)) {
+			/* Only ever mapped with all 2 MiB inside one region. */
+			page = pfn_to_page(pmd_pfn(*pmd));
+			mm_unaccount_node(mm, page, HPAGE_PMD_NR);
+			release_page(page, HPAGE_PMD_ORDER, list);
+			pmd_clear(pmd);
+			continue;
+		}
+		zap_pte_range(mm, pmd, start, next, list);
+	}
+	return 0;
+}
+
+void free_page_list(struct list_head *list)
+{
+	struct page *page, *tmp;
+
+	list_for_each_entry_safe(page, tmp, list, lru) {
+		list_del_init(&page->lru);
+		__free_pages(page, page->private);
+	}
+}
+
+/*
+ * The VMAP slot is the only part of the page tables an address space has
+ * to itself; the slot's PUD table, and only that, hangs off its PGD.
+ */
+static pud_t *vmap_pud_table(struct mm_struct *mm)
+{
+	pgd_t *pgd = mm->pgd + pgd_index(VMAP_START);
+
+	return pgd_none(*pgd) ? NULL : pgd_page_vaddr(*pgd);
+}
+
+/**
+ * copy_page_range - share @src's mappings with @dst, copy-on-write
+ * @dst: a new address space with @src's regions and no mappings yet
+ * @src: the address space forked, its mmap_lock held
+ *
+ * Only the PUD and PMD tables are copied.  Every PTE table and huge page
+ * mapped gains a reference and is write-protected in both; @src's TLBs
+ * must be flushed before its lock is dropped.  On failure @dst is left
+ * partly filled in, for exit_mmap() to take apart.
+ */
+int copy_page_range(struct mm_struct *dst, struct mm_struct *src)
+{
+	pud_t *src_pud = vmap_pud_table(src);
+	pmd_t *src_pmd, *dst_pmd;
+	unsigned int i, j;
+	unsigned long addr;
+	struct page *page;
+
+	if (!src_pud)
+		return 0;
+	for (i = 0; i < PTRS_PER_PUD; i++) {
+		if (pud_none(src_pud[i]))
+			continue;
+		addr = VMAP_START + i * PUD_SIZE;
+		dst_pmd = pmd_alloc(dst, addr);
+		if (!dst_pmd)
+			return -ENOMEM;
+		src_pmd = pud_page_vaddr(src_pud[i]);
+		for (j = 0; j < PTRS_PER_PMD; j++) {
+			if (pmd_none(src_pmd[j]))
+				continue;
+			if (pmd_large(src_pmd[j]))
+				page = pfn_to_page(pmd_pfn(src_pmd[j]));
+			else
+				page = virt_to_page(pmd_page_vaddr(src_pmd[j]));
+			get_page(page);
+			set_pmd(&src_pmd[j], pmd_wrprotect(src_pmd[j]));
+			dst_pmd[j] = src_pmd[j];
+		}
+	}
+	return 0;
+}
+
+/* Take apart the VMAP slot of an address space nobody uses any more. */
+void free_pgtables(struct mm_struct *mm, struct list_head *list)
+{
+	pud_t *pud = vmap_pud_table(mm);
+	pmd_t *pmd;
+	unsigned int i, j;
+
+	if (!pud)
+		return;
+	for (i = 0; i < PTRS_PER_PUD; i++) {
+		if (pud_none(pud[i]))
+			continue;
+		pmd = pud_page_vaddr(pud[i]);
+		for (j = 0; j < PTRS_PER_PMD; j++) {
+			if (pmd_none(pmd[j]))
+				continue;
+			if (pmd_large(pmd[j]))
+				release_page(pfn_to_page(pmd_pfn(pmd[j])),
+					     HPAGE_PMD_ORDER, list);
+			else
+				release_pte_table(pmd_page_vaddr(pmd[j]), list);
+		}
+		free_page((unsigned long)pmd);
+	}
+	free_page((unsigned long)pud);
+	pgd_clear(mm->pgd + pgd_index(VMAP_START));
+}
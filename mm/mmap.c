@@ -0,0 +1,214 @@
+/*
+ * Anonymous and file regions.
+ *
+ * A region is only a reservation of address space until it is touched
+ * (mm/memory.c); a file region then maps the file's page cache pages,
+ * so reading it copies nothing.  Each address space keeps its regions
+ * on a list sorted by address; a new one goes in the lowest gap that
+ * fits, 2 MiB aligned when it is at least that large so that huge pages
+ * can back it.  Regions are few and long-lived, so a list serves.
+ */
+#define pr_fmt(fmt) "mm: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/errno.h>
+#include <zhos/list.h>
+#include <zhos/mm.h>
+#include <zhos/mm_types.h>
+#include <zhos/slab.h>
+#include <zhos/spinlock.h>
+#include <asm/pgtable.h>
+#include <asm/tlbflush.h>
+
+#include "internal.h"
+
+struct mm_struct init_mm = {
+	.mm_users	= 1,
+	.ctx_id		= 1,
+	.mmap_lock	= __SPIN_LOCK_UNLOCKED(init_mm.mmap_lock),
+	.mmap		= LIST_HEAD_INIT(init_mm.mmap),
+	.mmlist		= LIST_HEAD_INIT(init_mm.mmlist),
+	.mmap_base	= VMAP_START,
+	.mmap_end	= VMAP_END,
+	.numa_nid	= NUMA_NO_NODE,
+};
+
+struct vm_area_struct *vma_lookup(struct mm_struct *mm, unsigned long addr)
+{
+	struct vm_area_struct *vma;
+
+	list_for_each_entry(vma, &mm->mmap, vm_list) {
+		if (addr < vma->vm_start)
+			break;
+		if (addr < vma->vm_end)
+			return vma;
+	}
+	return NULL;
+}
+
+/* Links @vma into the lowest gap of @mm that fits it; false if none. */
+static bool insert_vma(struct mm_struct *mm, struct vm_area_struct *vma,
+		       unsigned long len, unsigned long align)
+{
+	unsigned long start = ALIGN(mm->mmap_base, align);
+	struct vm_area_struct *next;
+
+	list_for_each_entry(next, &mm->mmap, vm_list) {
+		if (start + len <= next->vm_start)
+			break;
+		start = ALIGN(next->vm_end, align);
+	}
+	if (start + len > mm->mmap_end || start + len < start)
+		return false;
+
+	vma->vm_start = start;
+	vma->vm_end = start + len;
+	/* Before @next, or at the tail if the loop ran off the end. */
+	list_add_tail(&vma->vm_list, &next->vm_list);
+	return true;
+}
+
+/**
+ * vm_mmap_anon - reserve an anonymous region
+ * @mm: the address space
+ * @len: size in bytes, rounded up to whole pages
+ * @vm_flags: VM_HUGEPAGE or VM_NOHUGEPAGE, or 0
+ *
+ * Returns the start of the region, or 0 when out of address space or
+ * memory.
+ */
+unsigned long vm_mmap_anon(struct mm_struct *mm, unsigned long len,
+			   unsigned long vm_flags)
+{
+	unsigned long align;
+	struct vm_area_struct *vma;
+
+	len = ALIGN(len, PAGE_SIZE);
+	if (!len)
+		return 0;
+	align = len >= PMD_SIZE ? PMD_SIZE : PAGE_SIZE;
+
+	vma = kzalloc(sizeof(*vma), GFP_KERNEL);
+	if (!vma)
+		return 0;
+	vma->vm_mm = mm;
+	vma->vm_flags = vm_flags;
+
+	spin_lock(&mm->mmap_lock);
+	if (!insert_vma(mm, vma, len, align)) {
+		spin_unlock(&mm->mmap_lock);
+		kfree(vma);
+		return 0;
+	}
+	spin_unlock(&mm->mmap_lock);
+	return vma->vm_start;
+}
+
+/**
+ * vm_mmap_file - map part of a file, privately
+ * @mm: the address space
+ * @mapping: the file's page cache
+ * @pgoff: the first page of the file to map
+ * @len: size in bytes, rounded up to whole pages
+ *
+ * Returns the start of the region, or 0 when out of address space or
+ * memory.  Always small pages: the cache's pages are not contiguous.
+ */
+unsigned long vm_mmap_file(struct mm_struct *mm, struct address_space *mapping,
+			   unsigned long pgoff, unsigned long len)
+{
+	struct vm_area_struct *vma;
+
+	len = ALIGN(len, PAGE_SIZE);
+	if (!len)
+		return 0;
+
+	vma = kzalloc(sizeof(*vma), GFP_KERNEL);
+	if (!vma)
+		return 0;
+	vma->vm_mm = mm;
+	vma->vm_flags = VM_NOHUGEPAGE;
+	vma->vm_mapping = mapping;
+	vma->vm_pgoff = pgoff;
+
+	spin_lock(&mm->mmap_lock);
+	if (!insert_vma(mm, vma, len, PAGE_SIZE)) {
+		spin_unlock(&mm->mmap_lock);
+		kfree(vma);
+		return 0;
+	}
+	spin_unlock(&mm->mmap_lock);
+	return vma->vm_start;
+}
+
+/*
+ * The pages come out of the page tables under the lock but are only
+ * freed once no TLB can still reach them.
+ */
+int vm_munmap(struct mm_struct *mm, unsigned long addr)
+{
+	struct vm_area_struct *vma;
+	LIST_HEAD(pages);
+	int ret;
+
+	spin_lock(&mm->mmap_lock);
+	vma = vma_lookup(mm, addr);
+	if (!vma || vma->vm_start != addr) {
+		spin_unlock(&mm->mmap_lock);
+		return -EINVAL;
+	}
+	ret = zap_page_range(mm, vma->vm_start, vma->vm_end, &pages);
+	if (!ret)
+		list_del_init(&vma->vm_list);
+	spin_unlock(&mm->mmap_lock);
+	if (ret)
+		return ret;
+
+	flush_tlb_mm_range(mm, vma->vm_start, vma->vm_end);
+	free_page_list(&pages);
+	kfree(vma);
+	return 0;
+}
+
+/*
+ * Only changes which faults may use huge pages from now on; what is
+ * already mapped stays as it is, until khugepaged promotes it.
+ */
+int vm_madvise(struct mm_struct *mm, unsigned long addr, int advice)
+{
+	struct vm_area_struct *vma;
+	int ret = 0;
+
+	spin_lock(&mm->mmap_lock);
+	vma = vma_lookup(mm, addr);
+	if (!vma) {
+		ret = -EINVAL;
+	} else if (advice == MADV_HUGEPAGE) {
+		vma->vm_flags &= ~VM_NOHUGEPAGE;
+		vma->vm_flags |= VM_HUGEPAGE;
+	} else if (advice == MADV_NOHUGEPAGE) {
+		vma->vm_flags &= ~VM_HUGEPAGE;
+		vma->vm_flags |= VM_NOHUGEPAGE;
+	} else {
+		ret = -EINVAL;
+	}
+	spin_unlock(&mm->mmap_lock);
+	return ret;
+}
+
+/*
+ * The last reference to @mm is gone and no CPU has its page tables
+ * loaded, so no TLB holds any of its entries: nothing to flush.
+ */
+void exit_mmap(struct mm_struct *mm)
+{
+	struct vm_area_struct *vma, *tmp;
+	LIST_HEAD(pages);
+
+	free_pgtables(mm, &pages);
+	free_page_list(&pages);
+	list_for_each_entry_safe(vma, tmp, &mm->mmap, vm_list) {
+		list_del_init(&vma->vm_list);
+		kfree(vma);
+	}
+}
@@ -0,0 +1,331 @@
+/*
+ * Dirty page accounting and writeback.
+ *
+ * A write only dirties pages in the cache; the "writeback" thread writes
+ * them out later, so that a run of small writes reaches the filesystem
+ * as a few large ones.  It wakes every DIRTY_WRITEBACK_INTERVAL and
+ * writes back each mapping that has been dirty for DIRTY_EXPIRE_INTERVAL,
+ * or every dirty mapping while the dirty pages are over the background
+ * threshold.  A mapping's dirty pages are found in index order through
+ * their radix tree tag and handed to ->writepages() a run of consecutive
+ * pages, up to WB_BATCH, at a time.
+ *
+ * Writers that take the dirty and under-writeback pages past the hard
+ * threshold wait in balance_dirty_pages() for writeback to catch up, so
+ * a fast writer cannot fill memory with pages the disk has yet to see.
+ */
+#define pr_fmt(fmt) "writeback: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/fs.h>
+#include <zhos/gfp.h>
+#include <zhos/jiffies.h>
+#include <zhos/kthread.h>
+#include <zhos/list.h>
+#include <zhos/mm.h>
+#include <zhos/pagemap.h>
+#include <zhos/radix-tree.h>
+#include <zhos/sched.h>
+#include <zhos/spinlock.h>
+#include <zhos/wait.h>
+
+#define WB_BATCH			32
+#define DIRTY_WRITEBACK_INTERVAL	(5 * HZ)
+#define DIRTY_EXPIRE_INTERVAL		(30 * HZ)
+#define DIRTY_BACKGROUND_RATIO		10	/* percent of memory */
+#define DIRTY_RATIO			20
+#define DIRTY_THROTTLE_JIFFIES		max(1, HZ / 10)
+
+static unsigned long nr_dirty, nr_writeback;
+static unsigned long dirty_background_thresh, dirty_thresh;
+
+/* Mappings with dirty pages, oldest first. */
+static LIST_HEAD(dirty_mappings);
+static DEFINE_SPINLOCK(wb_lock);
+
+static struct task_struct *wb_thread;
+static bool wb_kick;
+static DECLARE_WAIT_QUEUE_HEAD(wb_wait);
+static DECLARE_WAIT_QUEUE_HEAD(dirty_throttle_wait);
+
+static unsigned long nr_dirty_and_writeback(void)
+{
+	return READ_ONCE(nr_dirty) + READ_ONCE(nr_writeback);
+}
+
+void set_page_dirty(struct page *page)
+{
+	struct address_space *mapping = page->mapping;
+	unsigned long flags;
+
+	if (TestSetPageDirty(page))
+		return;
+	__atomic_add_fetch(&nr_dirty, 1, __ATOMIC_RELAXED);
+
+	spin_lock_irqsave(&mapping->tree_lock, flags);
+	radix_tree_tag_set(&mapping->page_tree, page->index,
+			   PAGECACHE_TAG_DIRTY);
+	spin_unlock_irqrestore(&mapping->tree_lock, flags);
+
+	spin_lock_irqsave(&wb_lock, flags);
+	if (list_empty(&mapping->dirty_list)) {
+		mapping->dirtied_when = get_jiffies_64();
+		list_add_tail(&mapping->dirty_list, &dirty_mappings);
+	}
+	spin_unlock_irqrestore(&wb_lock, flags);
+}
+
+/* The page is leaving the cache; its tag goes with it. */
+void cancel_dirty_page(struct page *page)
+{
+	if (TestClearPageDirty(page))
+		__atomic_sub_fetch(&nr_dirty, 1, __ATOMIC_RELAXED);
+}
+
+/* @page locked: if it is dirty, make it clean and under writeback. */
+static bool start_page_writeback(struct page *page)
+{
+	struct address_space *mapping = page->mapping;
+	unsigned long flags;
+
+	if (!TestClearPageDirty(page))
+		return false;
+	__atomic_sub_fetch(&nr_dirty, 1, __ATOMIC_RELAXED);
+
+	spin_lock_irqsave(&mapping->tree_lock, flags);
+	radix_tree_tag_clear(&mapping->page_tree, page->index,
+			     PAGECACHE_TAG_DIRTY);
+	radix_tree_tag_set(&mapping->page_tree, page->index,
+			   PAGECACHE_TAG_WRITEBACK);
+	spin_unlock_irqrestore(&mapping->tree_lock, flags);
+
+	SetPageWriteback(page);
+	__atomic_add_fetch(&nr_writeback, 1, __ATOMIC_RELAXED);
+	return true;
+}
+
+/*
+ * A failed write leaves the page clean but records the error for the
+ * next fsync, as there is no telling whether retrying would help.
+ */
+void end_page_writeback(struct page *page, int err)
+{
+	struct address_space *mapping = page->mapping;
+	unsigned long flags;
+
+	if (err)
+		WRITE_ONCE(mapping->error, err);
+
+	spin_lock_irqsave(&mapping->tree_lock, flags);
+	radix_tree_tag_clear(&mapping->page_tree, page->index,
+			     PAGECACHE_TAG_WRITEBACK);
+	spin_unlock_irqrestore(&mapping->tree_lock, flags);
+
+	ClearPageWriteback(page);
+	__atomic_sub_fetch(&nr_writeback, 1, __ATOMIC_RELAXED);
+	wake_up_page(page);
+	if (waitqueue_active(&dirty_throttle_wait))
+		wake_up(&dirty_throttle_wait);
+}
+
+/* Hand @nr consecutive pages under writeback to the filesystem. */
+static int write_run(struct address_space *mapping, struct page **run,
+		     unsigned int nr)
+{
+	unsigned int i;
+	int err;
+
+	if (!nr)
+		return 0;
+	err = mapping->a_ops->writepages(mapping, run, nr);
+	for (i = 0; i < nr; i++) {
+		if (err)
+			end_page_writeback(run[i], err);
+		put_page(run[i]);
+	}
+	return err;
+}
+
+/**
+ * writeback_mapping - start writing back a mapping's dirty pages
+ * @mapping: the mapping
+ * @sync: also wait for pages already under writeback, which a background
+ *	pass skips
+ *
+ * Returns the first error ->writepages() reported.  Completion is up to
+ * the filesystem; see filemap_write_and_wait().
+ */
+int writeback_mapping(struct address_space *mapping, bool sync)
+{
+	struct page *pages[WB_BATCH], *run[WB_BATCH], *page;
+	unsigned int n, i, nr_run = 0;
+	unsigned long index = 0, flags;
+	int err = 0, ret;
+
+	do {
+		spin_lock_irqsave(&mapping->tree_lock, flags);
+		n = radix_tree_gang_lookup_tag(&mapping->page_tree,
+					       (void **)pages, index, WB_BATCH,
+					       PAGECACHE_TAG_DIRTY);
+		for (i = 0; i < n; i++)
+			get_page(pages[i]);
+		spin_unlock_irqrestore(&mapping->tree_lock, flags);
+		if (!n)
+			break;
+		index = pages[n - 1]->index + 1;
+
+		for (i = 0; i < n; i++) {
+			page = pages[i];
+			lock_page(page);
+			if (sync)
+				wait_on_page_writeback(page);
+			if (page->mapping != mapping || PageWriteback(page) ||
+			    !start_page_writeback(page)) {
+				unlock_page(page);
+				put_page(page);
+				continue;
+			}
+			unlock_page(page);
+
+			if (nr_run == WB_BATCH ||
+			    (nr_run && run[nr_run - 1]->index + 1 != page->index)) {
+				ret = write_run(mapping, run, nr_run);
+				err = err ? err : ret;
+				nr_run = 0;
+			}
+			run[nr_run++] = page;
+		}
+	} while (index);
+
+	ret = write_run(mapping, run, nr_run);
+	return err ? err : ret;
+}
+
+int filemap_write_and_wait(struct address_space *mapping)
+{
+	struct page *pages[WB_BATCH];
+	unsigned long index = 0, flags;
+	unsigned int n, i;
+	int err, ret;
+
+	err = writeback_mapping(mapping, true);
+
+	do {
+		spin_lock_irqsave(&mapping->tree_lock, flags);
+		n = radix_tree_gang_lookup_tag(&mapping->page_tree,
+					       (void **)pages, index, WB_BATCH,
+					       PAGECACHE_TAG_WRITEBACK);
+		for (i = 0; i < n; i++)
+			get_page(pages[i]);
+		spin_unlock_irqrestore(&mapping->tree_lock, flags);
+		if (!n)
+			break;
+		index = pages[n - 1]->index + 1;
+
+		for (i = 0; i < n; i++) {
+			wait_on_page_writeback(pages[i]);
+			put_page(pages[i]);
+		}
+	} while (index);
+
+	ret = __atomic_exchange_n(&mapping->error, 0, __ATOMIC_RELAXED);
+	return err ? err : ret;
+}
+
+/* One pass over the dirty mappings. */
+static void wb_do_writeback(void)
+{
+	struct address_space *mapping;
+	unsigned long flags;
+	LIST_HEAD(io);
+	u64 now;
+	bool tagged;
+
+	spin_lock_irqsave(&wb_lock, flags);
+	list_splice_init(&dirty_mappings, &io);
+	while (!list_empty(&io)) {
+		mapping = list_first_entry(&io, struct address_space,
+					   dirty_list);
+		now = get_jiffies_64();
+		if (nr_dirty_and_writeback() <= dirty_background_thresh &&
+		    time_before(now, mapping->dirtied_when +
+				DIRTY_EXPIRE_INTERVAL)) {
+			list_move_tail(&mapping->dirty_list, &dirty_mappings);
+			continue;
+		}
+		spin_unlock_irqrestore(&wb_lock, flags);
+
+		writeback_mapping(mapping, false);
+
+		/*
+		 * set_page_dirty() tags the page before it looks at the list,
+		 * so a mapping dirtied again from here on is put back.
+		 */
+		spin_lock_irqsave(&wb_lock, flags);
+		spin_lock(&mapping->tree_lock);
+		tagged = radix_tree_tagged(&mapping->page_tree,
+					   PAGECACHE_TAG_DIRTY);
+		spin_unlock(&mapping->tree_lock);
+		list_del_init(&mapping->dirty_list);
+		if (tagged) {
+			mapping->dirtied_when = now;
+			list_add_tail(&mapping->dirty_list, &dirty_mappings);
+		}
+	}
+	spin_unlock_irqrestore(&wb_lock, flags);
+}
+
+static int writeback_thread(void *unused)
+{
+	for (;;) {
+		wait_event_timeout(wb_wait, READ_ONCE(wb_kick),
+				   DIRTY_WRITEBACK_INTERVAL);
+		WRITE_ONCE(wb_kick, false);
+		wb_do_writeback();
+	}
+	return 0;
+}
+
+void wakeup_flusher_thread(void)
+{
+	if (!READ_ONCE(wb_kick)) {
+		WRITE_ONCE(wb_kick, true);
+		wake_up(&wb_wait);
+	}
+}
+
+/* After dirtying pages; may sleep. */
+void balance_dirty_pages(void)
+{
+	if (!wb_thread || nr_dirty_and_writeback() <= dirty_background_thresh)
+		return;
+
+	wakeup_flusher_thread();
+	while (nr_dirty_and_writeback() > dirty_thresh) {
+		wait_event_timeout(dirty_throttle_wait,
+				   nr_dirty_and_writeback() <= dirty_thresh,
+				   DIRTY_THROTTLE_JIFFIES);
+		wakeup_flusher_thread();
+	}
+}
+
+/* The thresholds are fractions of the memory free at the time. */
+void page_writeback_init(void)
+{
+	unsigned long pages = nr_free_pages();
+	struct task_struct *p;
+
+	dirty_background_thresh = pages * DIRTY_BACKGROUND_RATIO / 100;
+	dirty_thresh = pages * DIRTY_RATIO / 100;
+
+	p = kthread_create(writeback_thread, NULL, "writeback");
+	if (!p) {
+		pr_err("no writeback thread\n");
+		return;
+	}
+	wb_thread = p;
+	wake_up_process(p);
+
+	pr_info("background at %lu dirty pages, throttle at %lu\n",
+		dirty_background_thresh, dirty_thresh);
+}
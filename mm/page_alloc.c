@@ -0,0 +1,451 @@
+/*
+ * Physical page allocator.
+ *
+ * Free memory is kept by a binary buddy allocator: blocks of 2^order
+ * pages on one list per order, split on allocation and merged with their
+ * buddy (the block whose frame number differs only in bit @order) on
+ * free.  The buddy lists take the zone lock.
+ *
+ * Single pages, by far the most common request, are served from a list
+ * per CPU instead, with only interrupts disabled.  It is refilled from
+ * and drained to the buddy lists a batch at a time.  Pages freed by the
+ * CPU go to the head, as likely still in its caches, and are handed out
+ * from there; __GFP_COLD allocations and cold frees use the tail, which
+ * is also what a drain gives back.
+ *
+ * Each NUMA node has a zone of its own, with its own buddy lists and
+ * lock, and blocks never merge across nodes.  Allocations are
+ * first-touch: they come from the node of the CPU asking, or the node
+ * given to alloc_pages_node(), and fall back to the others nearest
+ * first.  A CPU's list only ever holds pages of its own node; a page
+ * freed on another node's CPU goes straight back to its zone.
+ */
+#define pr_fmt(fmt) "mm: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/bitops.h>
+#include <zhos/gfp.h>
+#include <zhos/list.h>
+#include <zhos/memblock.h>
+#include <zhos/mm.h>
+#include <zhos/numa.h>
+#include <zhos/percpu.h>
+#include <zhos/spinlock.h>
+#include <zhos/string.h>
+#include <asm/irqflags.h>
+
+#include "internal.h"
+
+struct free_area {
+	struct list_head free_list;
+	unsigned long nr_free;
+};
+
+struct zone {
+	spinlock_t lock;
+	int node;
+	unsigned long managed_pages;	/* handed to the allocator at boot */
+	unsigned long free_pages;	/* on the buddy lists */
+	struct free_area free_area[MAX_ORDER];
+};
+
+struct per_cpu_pages {
+	int count;
+	int high;			/* drain a batch above this */
+	int batch;
+	struct list_head list;		/* hot at the head, cold at the tail */
+};
+
+struct page *mem_map;
+unsigned long max_pfn;
+
+static struct zone node_zones[MAX_NUMNODES];
+static DEFINE_PER_CPU_ALIGNED(struct per_cpu_pages, pcp_lists);
+
+static inline void set_buddy_order(struct page *page, unsigned int order)
+{
+	page->private = order;
+	__SetPageBuddy(page);
+}
+
+static inline bool page_is_buddy(struct page *buddy, unsigned int order)
+{
+	return PageBuddy(buddy) && buddy->private == order;
+}
+
+/* Zone lock held. */
+static void __free_one_page(struct zone *z, unsigned long pfn,
+			    unsigned int order)
+{
+	unsigned long buddy_pfn;
+	struct page *buddy;
+
+	z->free_pages += 1UL << order;
+	while (order < MAX_ORDER - 1) {
+		buddy_pfn = pfn ^ (1UL << order);
+		if (!pfn_valid(buddy_pfn))
+			break;
+		buddy = pfn_to_page(buddy_pfn);
+		if (!page_is_buddy(buddy, order) ||
+		    page_to_nid(buddy) != z->node)
+			break;
+		list_del_init(&buddy->lru);
+		z->free_area[order].nr_free--;
+		__ClearPageBuddy(buddy);
+		pfn &= buddy_pfn;
+		order++;
+	}
+	set_buddy_order(pfn_to_page(pfn), order);
+	list_add(&pfn_to_page(pfn)->lru, &z->free_area[order].free_list);
+	z->free_area[order].nr_free++;
+}
+
+static void free_one_page(struct zone *z, unsigned long pfn,
+			  unsigned int order)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&z->lock, flags);
+	__free_one_page(z, pfn, order);
+	spin_unlock_irqrestore(&z->lock, flags);
+}
+
+/* Put the upper halves of a 2^@high block back until 2^@low is left. */
+static void expand(struct zone *z, struct page *page, unsigned int low,
+		   unsigned int high)
+{
+	unsigned long size = 1UL << high;
+
+	while (high > low) {
+		high--;
+		size >>= 1;
+		set_buddy_order(&page[size], high);
+		list_add(&page[size].lru, &z->free_area[high].free_list);
+		z->free_area[high].nr_free++;
+	}
+}
+
+/* Zone lock held. */
+static struct page *__rmqueue(struct zone *z, unsigned int order)
+{
+	struct free_area *area;
+	struct page *page;
+	unsigned int o;
+
+	for (o = order; o < MAX_ORDER; o++) {
+		area = &z->free_area[o];
+		if (list_empty(&area->free_list))
+			continue;
+		page = list_first_entry(&area->free_list, struct page, lru);
+		list_del_init(&page->lru);
+		__ClearPageBuddy(page);
+		area->nr_free--;
+		expand(z, page, order, o);
+		z->free_pages -= 1UL << order;
+		return page;
+	}
+	return NULL;
+}
+
+/* Move up to @count single pages onto @list; returns how many. */
+static int rmqueue_bulk(struct zone *z, int count, struct list_head *list)
+{
+	struct page *page;
+	int i;
+
+	spin_lock(&z->lock);
+	for (i = 0; i < count; i++) {
+		page = __rmqueue(z, 0);
+		if (!page)
+			break;
+		list_add_tail(&page->lru, list);
+	}
+	spin_unlock(&z->lock);
+	return i;
+}
+
+/* Give the @count coldest pages of @pcp back to the buddy lists. */
+static void free_pcppages_bulk(struct zone *z, struct per_cpu_pages *pcp,
+			       int count)
+{
+	struct page *page;
+
+	spin_lock(&z->lock);
+	while (count-- && !list_empty(&pcp->list)) {
+		page = list_last_entry(&pcp->list, struct page, lru);
+		list_del_init(&page->lru);
+		pcp->count--;
+		__free_one_page(z, page_to_pfn(page), 0);
+	}
+	spin_unlock(&z->lock);
+}
+
+/* Interrupts disabled; @z is this CPU's node. */
+static struct page *rmqueue_pcplist(struct zone *z, gfp_t gfp)
+{
+	struct per_cpu_pages *pcp = this_cpu_ptr(&pcp_lists);
+	struct page *page;
+
+	if (list_empty(&pcp->list))
+		pcp->count += rmqueue_bulk(z, pcp->batch, &pcp->list);
+	if (list_empty(&pcp->list))
+		return NULL;
+	if (gfp & __GFP_COLD)
+		page = list_last_entry(&pcp->list, struct page, lru);
+	else
+		page = list_first_entry(&pcp->list, struct page, lru);
+	list_del_init(&page->lru);
+	pcp->count--;
+	return page;
+}
+
+static struct page *rmqueue(struct zone *z, gfp_t gfp, unsigned int order)
+{
+	struct page *page;
+	unsigned long flags;
+
+	flags = local_irq_save();
+	if (likely(order == 0) && z->node == numa_node_id()) {
+		page = rmqueue_pcplist(z, gfp);
+	} else {
+		spin_lock(&z->lock);
+		page = __rmqueue(z, order);
+		spin_unlock(&z->lock);
+	}
+	local_irq_restore(flags);
+	return page;
+}
+
+/* @nid's zone, then the others nearest first unless __GFP_THISNODE. */
+static struct page *get_page_from_freelist(int nid, gfp_t gfp,
+					   unsigned int order)
+{
+	unsigned int i, n = gfp & __GFP_THISNODE ? 1 : nr_node_ids;
+	struct page *page;
+
+	for (i = 0; i < n; i++) {
+		page = rmqueue(&node_zones[node_order[nid][i]], gfp, order);
+		if (page)
+			return page;
+	}
+	return NULL;
+}
+
+/**
+ * alloc_pages_node - allocate a block of pages on a node
+ * @nid: the node to allocate from, or NUMA_NO_NODE for this CPU's
+ * @gfp: __GFP_* modifiers
+ * @order: log2 of the number of pages
+ *
+ * Returns the first page of the block, with a reference count of one,
+ * or NULL when no block that large is free.  When @nid has none, the
+ * block comes from the nearest node that does, unless __GFP_THISNODE.
+ * __GFP_ZERO takes a block the idle CPUs of @nid cleared beforehand if
+ * there is one.
+ */
+struct page *alloc_pages_node(int nid, gfp_t gfp, unsigned int order)
+{
+	struct page *page;
+
+	if (WARN_ON(order >= MAX_ORDER))
+		return NULL;
+	if (nid == NUMA_NO_NODE)
+		nid = numa_node_id();
+
+	if (gfp & __GFP_ZERO) {
+		page = prezero_take(nid, order);
+		if (page)
+			return page;
+	}
+	page = get_page_from_freelist(nid, gfp, order);
+	/* The pools hold free memory too; give it back before failing. */
+	if (!page && prezero_drain())
+		page = get_page_from_freelist(nid, gfp, order);
+	if (!page)
+		return NULL;
+
+	set_page_count(page, 1);
+	if (gfp & __GFP_ZERO)
+		memset(page_address(page), 0, PAGE_SIZE << order);
+	return page;
+}
+
+/* First touch: from the memory of the CPU asking. */
+struct page *alloc_pages(gfp_t gfp, unsigned int order)
+{
+	return alloc_pages_node(NUMA_NO_NODE, gfp, order);
+}
+
+void free_hot_cold_page(struct page *page, bool cold)
+{
+	struct per_cpu_pages *pcp;
+	struct zone *z;
+	unsigned long flags;
+
+	flags = local_irq_save();
+	if (page_to_nid(page) != numa_node_id()) {
+		z = &node_zones[page_to_nid(page)];
+		spin_lock(&z->lock);
+		__free_one_page(z, page_to_pfn(page), 0);
+		spin_unlock(&z->lock);
+		local_irq_restore(flags);
+		return;
+	}
+	pcp = this_cpu_ptr(&pcp_lists);
+	if (cold)
+		list_add_tail(&page->lru, &pcp->list);
+	else
+		list_add(&page->lru, &pcp->list);
+	if (++pcp->count > pcp->high)
+		free_pcppages_bulk(&node_zones[numa_node_id()], pcp,
+				   pcp->batch);
+	local_irq_restore(flags);
+}
+
+/* Drop a reference to a block from alloc_pages(); the last one frees it. */
+void __free_pages(struct page *page, unsigned int order)
+{
+	if (!put_page_testzero(page))
+		return;
+	if (WARN_ON(PageBuddy(page) || PageReserved(page)))
+		return;
+
+	if (likely(order == 0)) {
+		free_hot_cold_page(page, false);
+		return;
+	}
+	free_one_page(&node_zones[page_to_nid(page)], page_to_pfn(page), order);
+}
+
+unsigned long __get_free_pages(gfp_t gfp, unsigned int order)
+{
+	struct page *page = alloc_pages(gfp, order);
+
+	return page ? (unsigned long)page_address(page) : 0;
+}
+
+unsigned long get_zeroed_page(gfp_t gfp)
+{
+	return __get_free_pages(gfp | __GFP_ZERO, 0);
+}
+
+void free_pages(unsigned long addr, unsigned int order)
+{
+	if (addr)
+		__free_pages(virt_to_page((void *)addr), order);
+}
+
+/* Buddy lists, every CPU's list and the zeroed pools; a snapshot, unlocked. */
+unsigned long nr_free_pages(void)
+{
+	unsigned long n = nr_prezeroed_pages();
+	unsigned int cpu, nid;
+
+	for (nid = 0; nid < nr_node_ids; nid++)
+		n += READ_ONCE(node_zones[nid].free_pages);
+	for (cpu = 0; cpu < NR_CPUS; cpu++)
+		n += READ_ONCE(per_cpu(pcp_lists, cpu).count);
+	return n;
+}
+
+unsigned long node_managed_pages(int nid)
+{
+	return node_zones[nid].managed_pages;
+}
+
+/* Hand a free run of one node's frames to its buddy lists. */
+static void __init_free_pfns(struct zone *z, unsigned long pfn,
+			     unsigned long end_pfn)
+{
+	unsigned int order;
+
+	while (pfn < end_pfn) {
+		order = pfn ? min(__ffs64(pfn), MAX_ORDER - 1) : MAX_ORDER - 1;
+		while (pfn + (1UL << order) > end_pfn)
+			order--;
+		__free_one_page(z, pfn, order);
+		z->managed_pages += 1UL << order;
+		pfn += 1UL << order;
+	}
+}
+
+/* Hand a free memblock range to the buddy lists in the largest blocks it allows. */
+static void __init_free_range(phys_addr_t start, phys_addr_t end)
+{
+	unsigned long pfn = PFN_UP(start), end_pfn = PFN_DOWN(end), run;
+	int nid;
+
+	for (; pfn < end_pfn && pfn_valid(pfn); pfn++)
+		__ClearPageReserved(pfn_to_page(pfn));
+	end_pfn = pfn;
+
+	/* No block may straddle two nodes. */
+	for (pfn = PFN_UP(start); pfn < end_pfn; pfn = run) {
+		nid = page_to_nid(pfn_to_page(pfn));
+		for (run = pfn + 1; run < end_pfn; run++)
+			if (page_to_nid(pfn_to_page(run)) != nid)
+				break;
+		__init_free_pfns(&node_zones[nid], pfn, run);
+	}
+}
+
+static void pcp_init(void)
+{
+	struct per_cpu_pages *pcp;
+	unsigned int cpu;
+	int batch;
+
+	/* About a quarter of a thousandth of the node per batch, 1-32 pages. */
+	for (cpu = 0; cpu < NR_CPUS; cpu++) {
+		batch = clamp(node_managed_pages(cpu_to_node(cpu)) / 4096,
+			      1UL, 32UL);
+		pcp = per_cpu_ptr(&pcp_lists, cpu);
+		INIT_LIST_HEAD(&pcp->list);
+		pcp->count = 0;
+		pcp->batch = batch;
+		pcp->high = 6 * batch;
+	}
+}
+
+/* Take over all memory memblock has not handed out or had reserved. */
+void page_alloc_init(void)
+{
+	unsigned long pfn, map_size, managed = 0;
+	struct page *page;
+	unsigned int i, nid;
+
+	max_pfn = PFN_DOWN(memblock_end_of_DRAM());
+	if (!max_pfn)
+		panic("no usable memory");
+
+	map_size = ALIGN(max_pfn * sizeof(struct page), PAGE_SIZE);
+	mem_map = phys_to_virt(memblock_alloc(map_size, PAGE_SIZE));
+	memset(mem_map, 0, map_size);
+
+	for (nid = 0; nid < MAX_NUMNODES; nid++) {
+		spin_lock_init(&node_zones[nid].lock);
+		node_zones[nid].node = nid;
+		for (i = 0; i < MAX_ORDER; i++)
+			INIT_LIST_HEAD(&node_zones[nid].free_area[i].free_list);
+	}
+
+	for (pfn = 0; pfn < max_pfn; pfn++) {
+		page = pfn_to_page(pfn);
+		__SetPageReserved(page);
+		set_page_node(page, early_pfn_to_nid(pfn));
+	}
+	memblock_for_each_free_range(__init_free_range);
+
+	pcp_init();
+
+	for (nid = 0; nid < nr_node_ids; nid++)
+		managed += node_zones[nid].managed_pages;
+	pr_info("%lu KiB available, %lu KiB reserved or in holes, %lu KiB for mem_map\n",
+		managed << (PAGE_SHIFT - 10),
+		(max_pfn - managed) << (PAGE_SHIFT - 10), map_size >> 10);
+	for (nid = 0; nid < nr_node_ids && nr_node_ids > 1; nid++)
+		pr_info("node %u: %lu KiB available\n", nid,
+			node_zones[nid].managed_pages << (PAGE_SHIFT - 10));
+
+	prezero_init();
+}
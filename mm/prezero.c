@@ -0,0 +1,271 @@
+/*
+ * Pre-zeroed pages.
+ *
+ * A first touch of anonymous memory, a new page table and most other
+ * __GFP_ZERO allocations would clear their pages inline, 4 KiB at a time
+ * or, for a huge page fault, 2 MiB at once.  Idle CPUs do that work
+ * ahead of time instead: each time round the idle loop, before halting,
+ * a CPU takes a free block from the buddy allocator, clears a chunk of
+ * it and, once all of it is clear, puts it in a pool that alloc_pages()
+ * draws on for __GFP_ZERO requests of the same order.
+ *
+ * There is a pool for single pages and one for huge pages, each kept
+ * below a small fraction of memory, and neither is filled once free
+ * memory runs low.  A huge page is cleared a chunk at a time, so that
+ * need_resched is looked at every few microseconds; a CPU that goes back
+ * to work keeps its half-cleared block and carries on next time it is
+ * idle.  An allocation that finds the buddy lists empty empties the
+ * pools back into them and retries, so the zeroed pages stay available.
+ *
+ * Each NUMA node has its own pair of pools, sized to the node and filled
+ * by its own idle CPUs from its own memory, and a __GFP_ZERO allocation
+ * only takes from the pools of the node it is for.
+ *
+ * "prezero=off" on the command line turns all of this off.
+ */
+#define pr_fmt(fmt) "prezero: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/cmdline.h>
+#include <zhos/gfp.h>
+#include <zhos/huge_mm.h>
+#include <zhos/list.h>
+#include <zhos/mm.h>
+#include <zhos/numa.h>
+#include <zhos/percpu.h>
+#include <zhos/spinlock.h>
+#include <zhos/string.h>
+
+#include "internal.h"
+
+#define ZERO_CHUNK		(64 * 1024)
+
+struct zero_pool {
+	spinlock_t lock;
+	unsigned int order;
+	unsigned long count;
+	unsigned long high;
+	struct list_head list;
+	unsigned long taken, missed;
+};
+
+/* A block an idle CPU is clearing. */
+struct zero_work {
+	struct page *page;
+	struct zero_pool *pool;
+	unsigned long done;		/* bytes cleared */
+	bool filling;			/* allocating one: do not drain */
+};
+
+static struct zero_pool zero_pools[MAX_NUMNODES][2];
+static DEFINE_PER_CPU(struct zero_work, zero_work);
+static bool prezero_enabled;
+static unsigned long prezero_low;	/* free pages below which to stop */
+
+static struct zero_pool *order_pool(int nid, unsigned int order)
+{
+	if (order == 0)
+		return &zero_pools[nid][0];
+	if (order == HPAGE_PMD_ORDER)
+		return &zero_pools[nid][1];
+	return NULL;
+}
+
+/**
+ * prezero_take - a zeroed block from the pool, for alloc_pages_node()
+ * @nid: the node it is for
+ * @order: the order asked for
+ *
+ * Returns NULL if @nid has no pool for @order or it is empty.
+ */
+struct page *prezero_take(int nid, unsigned int order)
+{
+	struct zero_pool *pool = order_pool(nid, order);
+	struct page *page = NULL;
+	unsigned long flags;
+
+	if (!pool || !READ_ONCE(prezero_enabled))
+		return NULL;
+	if (READ_ONCE(pool->count)) {
+		spin_lock_irqsave(&pool->lock, flags);
+		if (!list_empty(&pool->list)) {
+			page = list_first_entry(&pool->list, struct page, lru);
+			list_del_init(&page->lru);
+			pool->count--;
+		}
+		spin_unlock_irqrestore(&pool->lock, flags);
+	}
+	__atomic_add_fetch(page ? &pool->taken : &pool->missed, 1,
+			   __ATOMIC_RELAXED);
+	return page;
+}
+
+/* Give every pooled block back; returns how many pages that freed. */
+unsigned long prezero_drain(void)
+{
+	struct zero_pool *pool;
+	struct page *page, *next;
+	unsigned long flags, freed = 0;
+	LIST_HEAD(list);
+	unsigned int i;
+
+	if (this_cpu_ptr(&zero_work)->filling)
+		return 0;
+	for (i = 0; i < nr_node_ids * 2; i++) {
+		pool = &zero_pools[i / 2][i % 2];
+		spin_lock_irqsave(&pool->lock, flags);
+		list_splice_init(&pool->list, &list);
+		freed += pool->count << pool->order;
+		pool->count = 0;
+		spin_unlock_irqrestore(&pool->lock, flags);
+		list_for_each_entry_safe(page, next, &list, lru) {
+			list_del_init(&page->lru);
+			__free_pages(page, pool->order);
+		}
+	}
+	return freed;
+}
+
+/* Pooled pages, for nr_free_pages(); unlocked. */
+unsigned long nr_prezeroed_pages(void)
+{
+	unsigned long n = 0;
+
+	struct zero_pool *pool;
+	unsigned int i;
+
+	for (i = 0; i < nr_node_ids * 2; i++) {
+		pool = &zero_pools[i / 2][i % 2];
+		n += READ_ONCE(pool->count) << pool->order;
+	}
+	return n;
+}
+
+static bool pool_wants(struct zero_pool *pool)
+{
+	return READ_ONCE(pool->count) < pool->high;
+}
+
+static void pool_add(struct zero_pool *pool, struct page *page)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pool->lock, flags);
+	list_add(&page->lru, &pool->list);
+	pool->count++;
+	spin_unlock_irqrestore(&pool->lock, flags);
+}
+
+/*
+ * Start on a block for the first pool of this CPU's node that wants one,
+ * small pages first, as long as memory is not short.
+ */
+static bool zero_work_start(struct zero_work *w)
+{
+	int nid = numa_node_id();
+	struct zero_pool *pool;
+	unsigned int i;
+
+	if (nr_free_pages() - nr_prezeroed_pages() < prezero_low)
+		return false;
+	for (i = 0; i < ARRAY_SIZE(zero_pools[nid]); i++) {
+		pool = &zero_pools[nid][i];
+		if (!pool->high || !pool_wants(pool))
+			continue;
+		w->filling = true;
+		w->page = alloc_pages_node(nid, GFP_KERNEL | __GFP_THISNODE,
+					   pool->order);
+		w->filling = false;
+		if (!w->page)
+			return false;
+		w->pool = pool;
+		w->done = 0;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * idle_zero_pages - clear one chunk of a page for the pools
+ *
+ * Called by the idle loop with interrupts enabled, while nothing else
+ * wants the CPU.  Returns false when there is nothing to do, so that the
+ * CPU may as well halt.
+ */
+bool idle_zero_pages(void)
+{
+	struct zero_work *w = this_cpu_ptr(&zero_work);
+	unsigned long size, n;
+
+	if (!READ_ONCE(prezero_enabled))
+		return false;
+	if (!w->page && !zero_work_start(w))
+		return false;
+
+	size = PAGE_SIZE << w->pool->order;
+	n = min(size - w->done, (unsigned long)ZERO_CHUNK);
+	memset(page_address(w->page) + w->done, 0, n);
+	w->done += n;
+	if (w->done < size)
+		return true;
+
+	/* Someone may have filled the pool meanwhile. */
+	if (pool_wants(w->pool))
+		pool_add(w->pool, w->page);
+	else
+		__free_pages(w->page, w->pool->order);
+	w->page = NULL;
+	return true;
+}
+
+/* How many __GFP_ZERO allocations of @order the pools served, and missed. */
+void prezero_stats(unsigned long *taken, unsigned long *missed,
+		   unsigned int order)
+{
+	struct zero_pool *pool;
+	unsigned int nid;
+
+	*taken = *missed = 0;
+	for (nid = 0; nid < nr_node_ids; nid++) {
+		pool = order_pool(nid, order);
+		if (!pool)
+			return;
+		*taken += READ_ONCE(pool->taken);
+		*missed += READ_ONCE(pool->missed);
+	}
+}
+
+void prezero_init(void)
+{
+	unsigned long managed, small = 0, huge = 0;
+	struct zero_pool *pools;
+	unsigned int nid;
+	char val[8];
+
+	for (nid = 0; nid < MAX_NUMNODES; nid++) {
+		pools = zero_pools[nid];
+		spin_lock_init(&pools[0].lock);
+		INIT_LIST_HEAD(&pools[0].list);
+		spin_lock_init(&pools[1].lock);
+		INIT_LIST_HEAD(&pools[1].list);
+		pools[0].order = 0;
+		pools[1].order = HPAGE_PMD_ORDER;
+	}
+	if (!cmdline_get("prezero", val, sizeof(val)) && !strcmp(val, "off"))
+		return;
+
+	/* A 256th of the node in small pages, a 64th in huge ones, at most. */
+	for (nid = 0; nid < nr_node_ids; nid++) {
+		managed = node_managed_pages(nid);
+		pools = zero_pools[nid];
+		pools[0].high = !managed ? 0 :
+				clamp(managed / 256, 16UL, 2048UL);
+		pools[1].high = min(managed / 64 / HPAGE_PMD_NR, 8UL);
+		small += pools[0].high;
+		huge += pools[1].high;
+	}
+	prezero_low = nr_free_pages() / 8;
+	WRITE_ONCE(prezero_enabled, true);
+	pr_info("up to %lu small and %lu huge pages kept zeroed\n",
+		small, huge);
+}
@@ -0,0 +1,184 @@
+/*
+ * Readahead.
+ *
+ * Each open file has a window, the pages [start, start + size) it last
+ * read ahead.  A page cache miss that carries on a sequential read (the
+ * page after the one read last) opens a window at the miss a few times
+ * the size of the request; any other miss reads just what was asked for.
+ * The first page of the window's last async_size is marked PG_readahead,
+ * and the reader reaching it starts the next window, twice as large up
+ * to ra_pages, so that the I/O for one window overlaps the reading of
+ * the one before.
+ *
+ * Missing pages are added to the cache locked and handed to ->readpages()
+ * a run of consecutive pages at a time; pages already cached break a run.
+ */
+#include <zhos/kernel.h>
+#include <zhos/bitops.h>
+#include <zhos/fs.h>
+#include <zhos/gfp.h>
+#include <zhos/mm.h>
+#include <zhos/pagemap.h>
+#include <zhos/radix-tree.h>
+#include <zhos/spinlock.h>
+#include <zhos/string.h>
+
+#define VM_READAHEAD_PAGES	32	/* 128 KiB */
+
+void file_ra_state_init(struct file_ra_state *ra)
+{
+	memset(ra, 0, sizeof(*ra));
+	ra->ra_pages = VM_READAHEAD_PAGES;
+	ra->prev_index = ~0UL;		/* index 0 reads as sequential */
+}
+
+static unsigned int get_init_ra_size(unsigned long req, unsigned int max)
+{
+	unsigned long size = roundup_pow_of_two(req);
+
+	if (size <= max / 32)
+		size *= 4;
+	else if (size <= max / 4)
+		size *= 2;
+	return min(size, (unsigned long)max);
+}
+
+static unsigned int get_next_ra_size(const struct file_ra_state *ra)
+{
+	unsigned int size = ra->size * (ra->size < ra->ra_pages / 16 ? 4 : 2);
+
+	return min(size, ra->ra_pages);
+}
+
+static bool page_cache_present(struct address_space *mapping,
+			       unsigned long index)
+{
+	unsigned long flags;
+	bool present;
+
+	spin_lock_irqsave(&mapping->tree_lock, flags);
+	present = radix_tree_lookup(&mapping->page_tree, index);
+	spin_unlock_irqrestore(&mapping->tree_lock, flags);
+
+	return present;
+}
+
+/* Pages that could not be read stay in the cache, unlocked and not uptodate. */
+static void read_pages(struct address_space *mapping, struct page **pages,
+		       unsigned int nr)
+{
+	unsigned int i;
+	int err;
+
+	if (!nr)
+		return;
+	err = mapping->a_ops->readpages(mapping, pages, nr);
+	for (i = 0; i < nr; i++) {
+		if (err) {
+			ClearPageReadahead(pages[i]);
+			unlock_page(pages[i]);
+		}
+		put_page(pages[i]);
+	}
+}
+
+/*
+ * Read the missing pages of [@start, @start + @nr) that lie inside the
+ * file, marking the one @lookahead from the end, if it is read.
+ */
+static void do_page_cache_readahead(struct address_space *mapping,
+				    unsigned long start, unsigned long nr,
+				    unsigned long lookahead)
+{
+	loff_t isize = READ_ONCE(mapping->host->i_size);
+	struct page *run[VM_READAHEAD_PAGES], *page;
+	unsigned long i, index, end_index;
+	unsigned int nr_run = 0;
+
+	if (!isize)
+		return;
+	end_index = (isize - 1) >> PAGE_SHIFT;
+
+	for (i = 0; i < nr; i++) {
+		index = start + i;
+		if (index > end_index)
+			break;
+		if (page_cache_present(mapping, index)) {
+			read_pages(mapping, run, nr_run);
+			nr_run = 0;
+			continue;
+		}
+
+		page = alloc_pages(__GFP_COLD, 0);
+		if (!page)
+			break;
+		if (add_to_page_cache(page, mapping, index)) {
+			put_page(page);
+			read_pages(mapping, run, nr_run);
+			nr_run = 0;
+			continue;
+		}
+		if (lookahead && i == nr - lookahead)
+			SetPageReadahead(page);
+
+		run[nr_run++] = page;
+		if (nr_run == ARRAY_SIZE(run)) {
+			read_pages(mapping, run, nr_run);
+			nr_run = 0;
+		}
+	}
+	read_pages(mapping, run, nr_run);
+}
+
+/**
+ * page_cache_sync_readahead - a read missed the page cache
+ * @mapping: the file's pages
+ * @ra: the file's readahead state
+ * @index: the page missed
+ * @req: pages the read wants from @index on
+ */
+void page_cache_sync_readahead(struct address_space *mapping,
+			       struct file_ra_state *ra, unsigned long index,
+			       unsigned long req)
+{
+	unsigned int max = ra->ra_pages;
+
+	if (!max || (index != ra->prev_index + 1 && index != ra->prev_index)) {
+		do_page_cache_readahead(mapping, index,
+					min(req, (unsigned long)max(max, 1U)), 0);
+		return;
+	}
+
+	ra->start = index;
+	ra->size = get_init_ra_size(req, max);
+	ra->async_size = ra->size > req ? ra->size - req : ra->size;
+	do_page_cache_readahead(mapping, ra->start, ra->size, ra->async_size);
+}
+
+/**
+ * page_cache_async_readahead - a read reached a PG_readahead page
+ * @mapping: the file's pages
+ * @ra: the file's readahead state
+ * @page: the marked page
+ * @index: its index
+ * @req: pages the read wants from @index on
+ */
+void page_cache_async_readahead(struct address_space *mapping,
+				struct file_ra_state *ra, struct page *page,
+				unsigned long index, unsigned long req)
+{
+	ClearPageReadahead(page);
+	if (!ra->ra_pages)
+		return;
+
+	if (index == ra->start + ra->size - ra->async_size) {
+		ra->start += ra->size;
+		ra->size = get_next_ra_size(ra);
+	} else {
+		/* Another reader's mark, or our window was lost. */
+		ra->start = index + 1;
+		ra->size = get_init_ra_size(req, ra->ra_pages);
+	}
+	ra->async_size = ra->size;
+	do_page_cache_readahead(mapping, ra->start, ra->size, ra->async_size);
+}
@@ -0,0 +1,522 @@
+/*
+ * Object caches.
+ *
+ * The slab layer carves blocks from the page allocator into equally sized
+ * objects.  A slab's bookkeeping lives in the struct page of its first
+ * page (free list, count in use) and its free objects are chained through
+ * a pointer inside them, past the object when a constructor has to keep
+ * its contents.  Each new slab starts its objects one cache line further
+ * in, cycling through the slack at the end of the block, so objects at the
+ * same index in different slabs do not all land on the same cache sets.
+ *
+ * In front of it every CPU keeps two magazines, small stacks of free
+ * objects (Bonwick and Adams, "Magazines and Vmem", USENIX 2001).  An
+ * allocation pops from the loaded magazine, a free pushes to it; when it
+ * runs empty or full the previous one is swapped in, and only when both
+ * are exhausted is a full or empty magazine traded with the cache's
+ * depot under its lock.  The slab layer itself is reached only when the
+ * depot runs dry, so most operations take no lock and touch only lines
+ * the CPU already owns.
+ */
+#define pr_fmt(fmt) "slab: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/bitops.h>
+#include <zhos/list.h>
+#include <zhos/mm.h>
+#include <zhos/percpu.h>
+#include <zhos/slab.h>
+#include <zhos/smp.h>
+#include <zhos/spinlock.h>
+#include <zhos/string.h>
+#include <asm/irqflags.h>
+
+#define SLAB_MAX_ORDER		3
+#define MAG_MAX_ROUNDS		32
+
+struct kmem_magazine {
+	struct list_head list;		/* in the depot */
+	unsigned int rounds;
+	void *objs[MAG_MAX_ROUNDS];
+};
+
+struct kmem_cache_cpu {
+	struct kmem_magazine *loaded;
+	struct kmem_magazine *previous;	/* always full or empty */
+} __aligned(SMP_CACHE_BYTES);
+
+struct kmem_cache {
+	struct kmem_cache_cpu cpu[NR_CPUS];
+
+	spinlock_t lock;		/* slab lists and depot */
+	struct list_head slabs_full;
+	struct list_head slabs_partial;
+	struct list_head slabs_free;
+	unsigned int nr_free_slabs;
+	struct list_head depot_full;
+	struct list_head depot_empty;
+
+	unsigned int object_size;	/* as requested */
+	unsigned int size;		/* stride, with free pointer and alignment */
+	unsigned int offset;		/* of the free pointer in an object */
+	unsigned int order;		/* of each slab */
+	unsigned int num;		/* objects per slab */
+	unsigned int colour;		/* number of colour offsets beyond 0 */
+	unsigned int colour_next;
+	unsigned int mag_size;		/* rounds per magazine */
+	unsigned long flags;
+	void (*ctor)(void *);
+	const char *name;
+	struct list_head list;
+};
+
+static struct kmem_cache kmem_cache_boot;	/* of struct kmem_cache */
+static struct kmem_cache kmem_magazine_boot;	/* of struct kmem_magazine */
+
+static LIST_HEAD(slab_caches);
+static DEFINE_SPINLOCK(slab_caches_lock);
+
+static inline void *get_freepointer(struct kmem_cache *s, void *obj)
+{
+	return *(void **)((char *)obj + s->offset);
+}
+
+static inline void set_freepointer(struct kmem_cache *s, void *obj, void *fp)
+{
+	*(void **)((char *)obj + s->offset) = fp;
+}
+
+/* First page of the slab holding @obj. */
+static inline struct page *obj_to_slab(struct kmem_cache *s, const void *obj)
+{
+	unsigned long pfn = PFN_DOWN(__pa(obj));
+
+	return pfn_to_page(ALIGN_DOWN(pfn, 1UL << s->order));
+}
+
+/* The slab layer: s->lock held. */
+
+static bool cache_grow(struct kmem_cache *s)
+{
+	unsigned int i, pages = 1U << s->order;
+	struct page *page;
+	char *base, *obj;
+
+	page = alloc_pages(GFP_KERNEL, s->order);
+	if (!page)
+		return false;
+
+	for (i = 0; i < pages; i++) {
+		__SetPageSlab(&page[i]);
+		page[i].slab_cache = s;
+	}
+
+	base = (char *)page_address(page) + s->colour_next * SMP_CACHE_BYTES;
+	if (++s->colour_next > s->colour)
+		s->colour_next = 0;
+
+	page->freelist = NULL;
+	page->inuse = 0;
+	for (i = s->num; i > 0; i--) {
+		obj = base + (i - 1) * s->size;
+		if (s->ctor)
+			s->ctor(obj);
+		set_freepointer(s, obj, page->freelist);
+		page->freelist = obj;
+	}
+
+	list_add(&page->lru, &s->slabs_free);
+	s->nr_free_slabs++;
+	return true;
+}
+
+static void slab_destroy(struct kmem_cache *s, struct page *page)
+{
+	unsigned int i;
+
+	list_del_init(&page->lru);
+	for (i = 0; i < (1U << s->order); i++) {
+		__ClearPageSlab(&page[i]);
+		page[i].slab_cache = NULL;
+	}
+	__free_pages(page, s->order);
+}
+
+static void *slab_alloc(struct kmem_cache *s)
+{
+	struct page *page;
+	void *obj;
+
+	if (list_empty(&s->slabs_partial)) {
+		if (list_empty(&s->slabs_free) && !cache_grow(s))
+			return NULL;
+		page = list_first_entry(&s->slabs_free, struct page, lru);
+		list_move_tail(&page->lru, &s->slabs_partial);
+		s->nr_free_slabs--;
+	}
+	page = list_first_entry(&s->slabs_partial, struct page, lru);
+
+	obj = page->freelist;
+	page->freelist = get_freepointer(s, obj);
+	if (++page->inuse == s->num)
+		list_move_tail(&page->lru, &s->slabs_full);
+	return obj;
+}
+
+static void slab_free(struct kmem_cache *s, void *obj)
+{
+	struct page *page = obj_to_slab(s, obj);
+
+	set_freepointer(s, obj, page->freelist);
+	page->freelist = obj;
+	if (page->inuse-- == s->num)
+		list_move_tail(&page->lru, &s->slabs_partial);
+	if (page->inuse)
+		return;
+
+	/* Keep one empty slab around to absorb alloc/free cycles. */
+	if (s->nr_free_slabs) {
+		slab_destroy(s, page);
+	} else {
+		list_move_tail(&page->lru, &s->slabs_free);
+		s->nr_free_slabs++;
+	}
+}
+
+static void free_magazine_objs(struct kmem_cache *s, struct kmem_magazine *m)
+{
+	while (m->rounds)
+		slab_free(s, m->objs[--m->rounds]);
+}
+
+/* The magazine layer: interrupts disabled. */
+
+static void *mag_alloc(struct kmem_cache *s, struct kmem_cache_cpu *c)
+{
+	struct kmem_magazine *full;
+
+	for (;;) {
+		if (c->loaded && c->loaded->rounds)
+			return c->loaded->objs[--c->loaded->rounds];
+		if (c->previous && c->previous->rounds) {
+			full = c->previous;
+			c->previous = c->loaded;
+			c->loaded = full;
+			continue;
+		}
+
+		spin_lock(&s->lock);
+		if (list_empty(&s->depot_full)) {
+			spin_unlock(&s->lock);
+			return NULL;
+		}
+		full = list_first_entry(&s->depot_full, struct kmem_magazine, list);
+		list_del_init(&full->list);
+		if (c->previous)
+			list_add(&c->previous->list, &s->depot_empty);
+		spin_unlock(&s->lock);
+
+		c->previous = c->loaded;
+		c->loaded = full;
+	}
+}
+
+static bool mag_free(struct kmem_cache *s, struct kmem_cache_cpu *c, void *obj)
+{
+	struct kmem_magazine *empty;
+
+	for (;;) {
+		if (c->loaded && c->loaded->rounds < s->mag_size) {
+			c->loaded->objs[c->loaded->rounds++] = obj;
+			return true;
+		}
+		if (c->previous && !c->previous->rounds) {
+			empty = c->previous;
+			c->previous = c->loaded;
+			c->loaded = empty;
+			continue;
+		}
+
+		empty = NULL;
+		spin_lock(&s->lock);
+		if (!list_empty(&s->depot_empty)) {
+			empty = list_first_entry(&s->depot_empty,
+						 struct kmem_magazine, list);
+			list_del_init(&empty->list);
+		}
+		spin_unlock(&s->lock);
+		if (!empty) {
+			empty = kmem_cache_alloc(&kmem_magazine_boot, GFP_ATOMIC);
+			if (!empty)
+				return false;
+			empty->rounds = 0;
+			INIT_LIST_HEAD(&empty->list);
+		}
+
+		if (c->previous) {
+			spin_lock(&s->lock);
+			list_add(&c->previous->list, &s->depot_full);
+			spin_unlock(&s->lock);
+		}
+		c->previous = c->loaded;
+		c->loaded = empty;
+	}
+}
+
+void *kmem_cache_alloc(struct kmem_cache *s, gfp_t gfp)
+{
+	unsigned long flags;
+	void *obj = NULL;
+
+	flags = local_irq_save();
+	if (!(s->flags & SLAB_NO_MAGAZINE))
+		obj = mag_alloc(s, &s->cpu[smp_processor_id()]);
+	if (!obj) {
+		spin_lock(&s->lock);
+		obj = slab_alloc(s);
+		spin_unlock(&s->lock);
+	}
+	local_irq_restore(flags);
+
+	if (obj && (gfp & __GFP_ZERO))
+		memset(obj, 0, s->object_size);
+	return obj;
+}
+
+void kmem_cache_free(struct kmem_cache *s, void *obj)
+{
+	unsigned long flags;
+
+	if (!obj)
+		return;
+
+	flags = local_irq_save();
+	if ((s->flags & SLAB_NO_MAGAZINE) ||
+	    !mag_free(s, &s->cpu[smp_processor_id()], obj)) {
+		spin_lock(&s->lock);
+		slab_free(s, obj);
+		spin_unlock(&s->lock);
+	}
+	local_irq_restore(flags);
+}
+
+/* Empty the depot and free every empty slab; per-CPU magazines stay. */
+void kmem_cache_shrink(struct kmem_cache *s)
+{
+	struct kmem_magazine *m, *n;
+	struct page *page, *tmp;
+	unsigned long flags;
+	LIST_HEAD(mags);
+
+	spin_lock_irqsave(&s->lock, flags);
+	list_splice_init(&s->depot_full, &mags);
+	list_splice_init(&s->depot_empty, &mags);
+	list_for_each_entry(m, &mags, list)
+		free_magazine_objs(s, m);
+	list_for_each_entry_safe(page, tmp, &s->slabs_free, lru)
+		slab_destroy(s, page);
+	s->nr_free_slabs = 0;
+	spin_unlock_irqrestore(&s->lock, flags);
+
+	list_for_each_entry_safe(m, n, &mags, list)
+		kmem_cache_free(&kmem_magazine_boot, m);
+}
+
+/* Objects per slab of 2^@order pages, and the bytes left over. */
+static unsigned int slab_estimate(unsigned int order, unsigned int size,
+				  unsigned int *left)
+{
+	unsigned int bytes = PAGE_SIZE << order;
+
+	*left = bytes % size;
+	return bytes / size;
+}
+
+static int kmem_cache_setup(struct kmem_cache *s, const char *name, size_t size,
+			    size_t align, unsigned long flags,
+			    void (*ctor)(void *))
+{
+	unsigned int order, left = 0, num = 0;
+
+	memset(s, 0, sizeof(*s));
+	spin_lock_init(&s->lock);
+	INIT_LIST_HEAD(&s->slabs_full);
+	INIT_LIST_HEAD(&s->slabs_partial);
+	INIT_LIST_HEAD(&s->slabs_free);
+	INIT_LIST_HEAD(&s->depot_full);
+	INIT_LIST_HEAD(&s->depot_empty);
+	INIT_LIST_HEAD(&s->list);
+
+	if (align < sizeof(void *))
+		align = sizeof(void *);
+	if ((flags & SLAB_HWCACHE_ALIGN) && size > SMP_CACHE_BYTES / 2)
+		align = max(align, (size_t)SMP_CACHE_BYTES);
+
+	s->name = name;
+	s->object_size = size;
+	s->flags = flags;
+	s->ctor = ctor;
+	/* A constructed object must survive being free: chain past it. */
+	s->offset = ctor ? ALIGN(size, sizeof(void *)) : 0;
+	s->size = ALIGN(max(size, s->offset + sizeof(void *)), align);
+
+	/* Smallest slab that wastes at most an eighth of itself. */
+	for (order = 0; order <= SLAB_MAX_ORDER; order++) {
+		num = slab_estimate(order, s->size, &left);
+		if (num && left * 8 <= (PAGE_SIZE << order))
+			break;
+	}
+	if (order > SLAB_MAX_ORDER) {
+		order = SLAB_MAX_ORDER;
+		num = slab_estimate(order, s->size, &left);
+	}
+	if (!num)
+		return -1;
+
+	s->order = order;
+	s->num = num;
+	s->colour = left / SMP_CACHE_BYTES;
+
+	/* Fewer, larger objects need fewer rounds to amortize a depot trip. */
+	if (s->size <= 256)
+		s->mag_size = MAG_MAX_ROUNDS;
+	else if (s->size <= 1024)
+		s->mag_size = MAG_MAX_ROUNDS / 2;
+	else
+		s->mag_size = MAG_MAX_ROUNDS / 4;
+
+	spin_lock(&slab_caches_lock);
+	list_add_tail(&s->list, &slab_caches);
+	spin_unlock(&slab_caches_lock);
+	return 0;
+}
+
+struct kmem_cache *kmem_cache_create(const char *name, size_t size,
+				     size_t align, unsigned long flags,
+				     void (*ctor)(void *))
+{
+	struct kmem_cache *s;
+
+	s = kmem_cache_alloc(&kmem_cache_boot, GFP_KERNEL);
+	if (s && kmem_cache_setup(s, name, size, align, flags, ctor)) {
+		kmem_cache_free(&kmem_cache_boot, s);
+		s = NULL;
+	}
+	if (!s && (flags & SLAB_PANIC))
+		panic("cannot create slab cache %s", name);
+	return s;
+}
+
+/* The cache must be idle: no objects in use and no CPU touching it. */
+void kmem_cache_destroy(struct kmem_cache *s)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+	unsigned int cpu;
+
+	if (!s)
+		return;
+
+	spin_lock(&slab_caches_lock);
+	list_del_init(&s->list);
+	spin_unlock(&slab_caches_lock);
+
+	for (cpu = 0; cpu < NR_CPUS; cpu++) {
+		c = &s->cpu[cpu];
+		spin_lock_irqsave(&s->lock, flags);
+		if (c->loaded)
+			list_add(&c->loaded->list, &s->depot_full);
+		if (c->previous)
+			list_add(&c->previous->list, &s->depot_full);
+		c->loaded = c->previous = NULL;
+		spin_unlock_irqrestore(&s->lock, flags);
+	}
+	kmem_cache_shrink(s);
+
+	if (!list_empty(&s->slabs_full) || !list_empty(&s->slabs_partial))
+		pr_warn("%s destroyed with objects in use\n", s->name);
+	kmem_cache_free(&kmem_cache_boot, s);
+}
+
+static const struct {
+	const char *name;
+	unsigned int size;
+} kmalloc_info[] = {
+	{ "kmalloc-8", 8 },	{ "kmalloc-16", 16 },	{ "kmalloc-32", 32 },
+	{ "kmalloc-64", 64 },	{ "kmalloc-96", 96 },	{ "kmalloc-128", 128 },
+	{ "kmalloc-192", 192 },	{ "kmalloc-256", 256 },	{ "kmalloc-512", 512 },
+	{ "kmalloc-1k", 1024 },	{ "kmalloc-2k", 2048 },	{ "kmalloc-4k", 4096 },
+	{ "kmalloc-8k", 8192 },
+};
+
+static struct kmem_cache *kmalloc_caches[ARRAY_SIZE(kmalloc_info)];
+
+/* Sizes up to 192 in steps of 8, a table lookup; powers of two above. */
+static u8 size_index[24];
+
+static struct kmem_cache *kmalloc_slab(size_t size)
+{
+	if (size <= 192)
+		return kmalloc_caches[size_index[(size - 1) / 8]];
+	/* 256 is index 7, each doubling one more. */
+	return kmalloc_caches[__fls64(size - 1)];
+}
+
+void *kmalloc(size_t size, gfp_t gfp)
+{
+	unsigned int order;
+	struct page *page;
+
+	if (!size)
+		return NULL;
+	if (size <= KMALLOC_MAX_CACHE_SIZE)
+		return kmem_cache_alloc(kmalloc_slab(size), gfp);
+
+	/* Large: whole pages, the order recorded for kfree(). */
+	order = get_order(size);
+	page = alloc_pages(gfp, order);
+	if (!page)
+		return NULL;
+	page->private = order;
+	return page_address(page);
+}
+
+void kfree(const void *obj)
+{
+	struct page *page;
+
+	if (!obj)
+		return;
+	page = virt_to_page(obj);
+	if (likely(PageSlab(page)))
+		kmem_cache_free(page->slab_cache, (void *)obj);
+	else
+		__free_pages(page, page->private);
+}
+
+void kmem_cache_init(void)
+{
+	unsigned int i, j;
+
+	kmem_cache_setup(&kmem_cache_boot, "kmem_cache",
+			 sizeof(struct kmem_cache), SMP_CACHE_BYTES,
+			 SLAB_NO_MAGAZINE, NULL);
+	kmem_cache_setup(&kmem_magazine_boot, "kmem_magazine",
+			 sizeof(struct kmem_magazine), 0,
+			 SLAB_HWCACHE_ALIGN | SLAB_NO_MAGAZINE, NULL);
+
+	for (i = 0; i < ARRAY_SIZE(kmalloc_info); i++)
+		kmalloc_caches[i] = kmem_cache_create(kmalloc_info[i].name,
+						      kmalloc_info[i].size, 0,
+						      SLAB_PANIC, NULL);
+
+	for (i = 0, j = 0; i < ARRAY_SIZE(size_index); i++) {
+		while (kmalloc_info[j].size < (i + 1) * 8)
+			j++;
+		size_index[i] = j;
+	}
+
+	pr_info("%u kmalloc caches up to %u bytes, magazines of %u-%u objects\n",
+		(unsigned int)ARRAY_SIZE(kmalloc_info), KMALLOC_MAX_CACHE_SIZE,
+		MAG_MAX_ROUNDS / 4, MAG_MAX_ROUNDS);
+}
@@ -0,0 +1,195 @@
+/*
+ * Network devices, NAPI polling and protocol dispatch.
+ *
+ * Interrupt handlers put their napi_struct on the CPU's poll list and
+ * raise NET_RX_SOFTIRQ.  The softirq polls the list round-robin, a
+ * device's weight per turn, and stops after NET_RX_BUDGET packets or
+ * NET_RX_JIFFIES ticks, whichever comes first, raising itself again for
+ * the rest; a flood that keeps it going is left to ksoftirqd and so
+ * throttled by the scheduler rather than starving everything else.
+ *
+ * Every packet looks its protocol up in ptype_list, so the list is read
+ * under RCU; only registration takes ptype_lock.
+ */
+#define pr_fmt(fmt) "net: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/cpumask.h>
+#include <zhos/if_ether.h>
+#include <zhos/ip.h>
+#include <zhos/jiffies.h>
+#include <zhos/list.h>
+#include <zhos/netdevice.h>
+#include <zhos/percpu.h>
+#include <zhos/pktbuf.h>
+#include <zhos/rculist.h>
+#include <zhos/softirq.h>
+#include <zhos/spinlock.h>
+#include <asm/irqflags.h>
+
+#define NET_RX_BUDGET		300
+#define NET_RX_JIFFIES		max(1, HZ / 500)
+
+/* Interrupts off. */
+static DEFINE_PER_CPU_ALIGNED(struct list_head, poll_list);
+
+static LIST_HEAD(netdev_list);
+static DEFINE_SPINLOCK(netdev_lock);
+static unsigned int netdev_count;
+
+static LIST_HEAD(ptype_list);
+static DEFINE_SPINLOCK(ptype_lock);
+
+void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
+		    int (*poll)(struct napi_struct *, int), int weight)
+{
+	INIT_LIST_HEAD(&napi->poll_list);
+	napi->scheduled = false;
+	napi->weight = weight;
+	napi->poll = poll;
+	napi->dev = dev;
+}
+
+void napi_schedule(struct napi_struct *napi)
+{
+	unsigned long flags;
+
+	if (__atomic_exchange_n(&napi->scheduled, true, __ATOMIC_ACQUIRE))
+		return;
+
+	flags = local_irq_save();
+	list_add_tail(&napi->poll_list, this_cpu_ptr(&poll_list));
+	raise_softirq_irqoff(NET_RX_SOFTIRQ);
+	local_irq_restore(flags);
+}
+
+/* The napi_struct is off the poll list while ->poll() runs. */
+void napi_complete(struct napi_struct *napi)
+{
+	__atomic_store_n(&napi->scheduled, false, __ATOMIC_RELEASE);
+}
+
+static void net_rx_action(void)
+{
+	struct list_head *list = this_cpu_ptr(&poll_list);
+	u64 time_limit = get_jiffies_64() + NET_RX_JIFFIES;
+	int budget = NET_RX_BUDGET, work;
+	struct napi_struct *napi;
+
+	for (;;) {
+		local_irq_disable();
+		if (list_empty(list))
+			break;
+		if (budget <= 0 || time_after_eq(get_jiffies_64(), time_limit)) {
+			raise_softirq_irqoff(NET_RX_SOFTIRQ);
+			break;
+		}
+		napi = list_first_entry(list, struct napi_struct, poll_list);
+		list_del_init(&napi->poll_list);
+		local_irq_enable();
+
+		work = napi->poll(napi, napi->weight);
+		/* Used its whole weight: more is waiting, go round again. */
+		if (work >= napi->weight) {
+			local_irq_disable();
+			list_add_tail(&napi->poll_list, list);
+			local_irq_enable();
+		}
+		budget -= work;
+	}
+	local_irq_enable();
+}
+
+int register_netdev(struct net_device *dev)
+{
+	unsigned long flags;
+	int err;
+
+	spin_lock_irqsave(&netdev_lock, flags);
+	snprintf(dev->name, sizeof(dev->name), "eth%u", netdev_count++);
+	spin_unlock_irqrestore(&netdev_lock, flags);
+
+	if (!dev->mtu)
+		dev->mtu = ETH_DATA_LEN;
+	err = dev->ops->open(dev);
+	if (err) {
+		pr_err("%s: open failed (%d)\n", dev->name, err);
+		return err;
+	}
+
+	spin_lock_irqsave(&netdev_lock, flags);
+	list_add_tail(&dev->list, &netdev_list);
+	spin_unlock_irqrestore(&netdev_lock, flags);
+
+	pr_info("%s: %02x:%02x:%02x:%02x:%02x:%02x\n", dev->name,
+		dev->dev_addr[0], dev->dev_addr[1], dev->dev_addr[2],
+		dev->dev_addr[3], dev->dev_addr[4], dev->dev_addr[5]);
+	ip_dev_config(dev);
+	return 0;
+}
+
+void dev_add_pack(struct packet_type *pt)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ptype_lock, flags);
+	list_add_tail_rcu(&pt->list, &ptype_list);
+	spin_unlock_irqrestore(&ptype_lock, flags);
+}
+
+/* @pt is no longer called on return. */
+void dev_remove_pack(struct packet_type *pt)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&ptype_lock, flags);
+	list_del_rcu(&pt->list);
+	spin_unlock_irqrestore(&ptype_lock, flags);
+	synchronize_rcu();
+}
+
+void netif_receive_pkt(struct pkt_buf *pkt)
+{
+	struct net_device *dev = pkt->dev;
+	struct packet_type *pt;
+
+	dev->stats.rx_packets++;
+	dev->stats.rx_bytes += pkt->len;
+
+	if (eth_type_trans(pkt)) {
+		dev->stats.rx_dropped++;
+		pkt_free(pkt);
+		return;
+	}
+	rcu_read_lock();
+	list_for_each_entry_rcu(pt, &ptype_list, list) {
+		if (pt->type == pkt->protocol) {
+			pt->func(pkt);
+			rcu_read_unlock();
+			return;
+		}
+	}
+	rcu_read_unlock();
+	pkt_free(pkt);
+}
+
+int dev_queue_xmit(struct pkt_buf *pkt)
+{
+	struct net_device *dev = pkt->dev;
+
+	return dev->ops->start_xmit(pkt, dev);
+}
+
+void net_init(void)
+{
+	unsigned int cpu;
+
+	pktbuf_init();
+
+	for_each_possible_cpu(cpu)
+		INIT_LIST_HEAD(per_cpu_ptr(&poll_list, cpu));
+	open_softirq(NET_RX_SOFTIRQ, net_rx_action);
+
+	arp_init();
+	ip_init();
+}
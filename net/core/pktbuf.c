@@ -0,0 +1,148 @@
+/*
+ * Packet buffer pool.
+ *
+ * The arena is allocated once at boot, in blocks of PKT_CHUNK_ORDER pages
+ * cut into PKT_BUF_SIZE buffers, each with its struct pkt_buf in a side
+ * array; nothing is allocated or freed per packet after that.  Like the
+ * page allocator's per-CPU lists, every CPU keeps a small stack of free
+ * buffers used with interrupts off, moved to and from the shared free
+ * list PKT_CACHE_BATCH at a time under the pool lock.
+ */
+#define pr_fmt(fmt) "pktbuf: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/cmdline.h>
+#include <zhos/gfp.h>
+#include <zhos/list.h>
+#include <zhos/mm.h>
+#include <zhos/percpu.h>
+#include <zhos/pktbuf.h>
+#include <zhos/slab.h>
+#include <zhos/spinlock.h>
+#include <zhos/string.h>
+#include <asm/irqflags.h>
+
+#define PKT_POOL_DEFAULT	2048
+#define PKT_CHUNK_ORDER		4
+#define PKT_BUFS_PER_CHUNK	((PAGE_SIZE << PKT_CHUNK_ORDER) / PKT_BUF_SIZE)
+
+#define PKT_CACHE_SIZE		64
+#define PKT_CACHE_BATCH		16
+
+struct pkt_cache {
+	unsigned int count;
+	struct pkt_buf *bufs[PKT_CACHE_SIZE];
+};
+
+static struct {
+	spinlock_t lock;
+	struct list_head free;
+	unsigned int nr_free;
+	unsigned int nr_total;
+} pool = {
+	.lock = __SPIN_LOCK_UNLOCKED(pool.lock),
+	.free = LIST_HEAD_INIT(pool.free),
+};
+
+static DEFINE_PER_CPU_ALIGNED(struct pkt_cache, pkt_caches);
+
+/* Interrupts off. */
+static void pkt_cache_refill(struct pkt_cache *pc)
+{
+	struct pkt_buf *pkt;
+
+	spin_lock(&pool.lock);
+	while (pc->count < PKT_CACHE_BATCH && !list_empty(&pool.free)) {
+		pkt = list_first_entry(&pool.free, struct pkt_buf, list);
+		list_del_init(&pkt->list);
+		pool.nr_free--;
+		pc->bufs[pc->count++] = pkt;
+	}
+	spin_unlock(&pool.lock);
+}
+
+/* Interrupts off. */
+static void pkt_cache_drain(struct pkt_cache *pc)
+{
+	unsigned int n;
+
+	spin_lock(&pool.lock);
+	for (n = 0; n < PKT_CACHE_BATCH; n++) {
+		list_add(&pc->bufs[--pc->count]->list, &pool.free);
+		pool.nr_free++;
+	}
+	spin_unlock(&pool.lock);
+}
+
+struct pkt_buf *pkt_alloc(void)
+{
+	struct pkt_buf *pkt = NULL;
+	struct pkt_cache *pc;
+	unsigned long flags;
+
+	flags = local_irq_save();
+	pc = this_cpu_ptr(&pkt_caches);
+	if (!pc->count)
+		pkt_cache_refill(pc);
+	if (pc->count)
+		pkt = pc->bufs[--pc->count];
+	local_irq_restore(flags);
+
+	if (pkt) {
+		pkt->dev = NULL;
+		pkt->data = pkt->head;
+		pkt->len = 0;
+		pkt->mac_header = pkt->network_header = NULL;
+		pkt->protocol = 0;
+	}
+	return pkt;
+}
+
+void pkt_free(struct pkt_buf *pkt)
+{
+	struct pkt_cache *pc;
+	unsigned long flags;
+
+	flags = local_irq_save();
+	pc = this_cpu_ptr(&pkt_caches);
+	if (pc->count == PKT_CACHE_SIZE)
+		pkt_cache_drain(pc);
+	pc->bufs[pc->count++] = pkt;
+	local_irq_restore(flags);
+}
+
+/* "pktbufs=N" sets the size of the arena, in buffers. */
+void pktbuf_init(void)
+{
+	unsigned long nr = PKT_POOL_DEFAULT, chunks, i, j;
+	struct pkt_buf *pkts;
+	struct page *page;
+	char opt[16];
+	u8 *mem;
+
+	if (!cmdline_get("pktbufs", opt, sizeof(opt)))
+		nr = simple_strtoull(opt, NULL, 0);
+	chunks = DIV_ROUND_UP(nr, PKT_BUFS_PER_CHUNK);
+	nr = chunks * PKT_BUFS_PER_CHUNK;
+
+	pkts = kcalloc(nr, sizeof(*pkts), GFP_KERNEL);
+	if (!pkts) {
+		pr_err("no memory for %lu buffer descriptors\n", nr);
+		return;
+	}
+	for (i = 0; i < chunks; i++) {
+		page = alloc_pages(GFP_KERNEL, PKT_CHUNK_ORDER);
+		if (!page)
+			break;
+		mem = page_address(page);
+		for (j = 0; j < PKT_BUFS_PER_CHUNK; j++) {
+			struct pkt_buf *pkt = &pkts[i * PKT_BUFS_PER_CHUNK + j];
+
+			pkt->head = mem + j * PKT_BUF_SIZE;
+			list_add_tail(&pkt->list, &pool.free);
+		}
+	}
+	pool.nr_total = pool.nr_free = i * PKT_BUFS_PER_CHUNK;
+
+	pr_info("%u buffers of %u bytes\n", pool.nr_total, PKT_BUF_SIZE);
+}
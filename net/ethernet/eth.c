@@ -0,0 +1,36 @@
+/*
+ * Ethernet framing.
+ */
+#include <zhos/kernel.h>
+#include <zhos/if_ether.h>
+#include <zhos/netdevice.h>
+#include <zhos/pktbuf.h>
+#include <zhos/string.h>
+
+static bool is_broadcast_ether_addr(const u8 *addr)
+{
+	return (addr[0] & addr[1] & addr[2] & addr[3] & addr[4] & addr[5]) == 0xff;
+}
+
+int eth_type_trans(struct pkt_buf *pkt)
+{
+	struct ethhdr *eth = (struct ethhdr *)pkt->data;
+
+	if (!pkt_pull(pkt, ETH_HLEN))
+		return -1;
+	if (memcmp(eth->h_dest, pkt->dev->dev_addr, ETH_ALEN) &&
+	    !is_broadcast_ether_addr(eth->h_dest))
+		return -1;
+	pkt->mac_header = (u8 *)eth;
+	pkt->protocol = ntohs(eth->h_proto);
+	return 0;
+}
+
+void eth_reply(struct pkt_buf *pkt)
+{
+	struct ethhdr *eth = eth_hdr(pkt);
+
+	pkt_push(pkt, pkt->data - pkt->mac_header);
+	memcpy(eth->h_dest, eth->h_source, ETH_ALEN);
+	memcpy(eth->h_source, pkt->dev->dev_addr, ETH_ALEN);
+}
@@ -0,0 +1,47 @@
+/*
+ * ARP, answering requests for our own address.  The request is turned into
+ * the reply in its own buffer.  There is no neighbour cache yet: replies
+ * from this host go back to the link address the request came from.
+ */
+#include <zhos/kernel.h>
+#include <zhos/if_ether.h>
+#include <zhos/ip.h>
+#include <zhos/netdevice.h>
+#include <zhos/pktbuf.h>
+#include <zhos/string.h>
+
+static int arp_rcv(struct pkt_buf *pkt)
+{
+	struct net_device *dev = pkt->dev;
+	struct arphdr *arp = (struct arphdr *)pkt->data;
+	__be32 sip;
+
+	if (pkt->len < sizeof(*arp) ||
+	    arp->ar_hrd != htons(ARPHRD_ETHER) || arp->ar_pro != htons(ETH_P_IP) ||
+	    arp->ar_hln != ETH_ALEN || arp->ar_pln != 4 ||
+	    arp->ar_op != htons(ARPOP_REQUEST) ||
+	    !dev->ip_addr || arp->ar_tip != dev->ip_addr) {
+		pkt_free(pkt);
+		return 0;
+	}
+
+	sip = arp->ar_sip;
+	arp->ar_op = htons(ARPOP_REPLY);
+	memcpy(arp->ar_tha, arp->ar_sha, ETH_ALEN);
+	arp->ar_tip = sip;
+	memcpy(arp->ar_sha, dev->dev_addr, ETH_ALEN);
+	arp->ar_sip = dev->ip_addr;
+
+	eth_reply(pkt);
+	return dev_queue_xmit(pkt);
+}
+
+static struct packet_type arp_packet_type = {
+	.type	= ETH_P_ARP,
+	.func	= arp_rcv,
+};
+
+void arp_init(void)
+{
+	dev_add_pack(&arp_packet_type);
+}
@@ -0,0 +1,25 @@
+/*
+ * ICMP.  Echo requests are answered from the buffer they arrived in: the
+ * type is flipped and the addresses swapped, nothing is copied.
+ */
+#include <zhos/kernel.h>
+#include <zhos/checksum.h>
+#include <zhos/ip.h>
+#include <zhos/pktbuf.h>
+
+int icmp_rcv(struct pkt_buf *pkt)
+{
+	struct icmphdr *icmph = (struct icmphdr *)pkt->data;
+
+	if (pkt->len < sizeof(*icmph) ||
+	    csum_fold(csum_partial(icmph, pkt->len, 0)) ||
+	    icmph->type != ICMP_ECHO) {
+		pkt_free(pkt);
+		return 0;
+	}
+
+	icmph->type = ICMP_ECHOREPLY;
+	icmph->checksum = 0;
+	icmph->checksum = csum_fold(csum_partial(icmph, pkt->len, 0));
+	return ip_reply(pkt);
+}
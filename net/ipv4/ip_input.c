@@ -0,0 +1,132 @@
+/*
+ * IPv4 receive path.
+ *
+ * A datagram is checked, trimmed to its own length and handed to its
+ * transport protocol in the same buffer it was received into.  Fragments
+ * are not reassembled and nothing is forwarded.  ICMP is the only
+ * protocol registered so far; others are counted and dropped.
+ */
+#define pr_fmt(fmt) "ipv4: " fmt
+
+#include <zhos/kernel.h>
+#include <zhos/checksum.h>
+#include <zhos/cmdline.h>
+#include <zhos/if_ether.h>
+#include <zhos/ip.h>
+#include <zhos/netdevice.h>
+#include <zhos/pktbuf.h>
+
+static const struct net_protocol *inet_protos[MAX_INET_PROTOS];
+static u64 ip_noproto, ip_hdr_errors;
+
+int inet_add_protocol(const struct net_protocol *prot, unsigned int protocol)
+{
+	if (protocol >= MAX_INET_PROTOS || inet_protos[protocol])
+		return -1;
+	inet_protos[protocol] = prot;
+	return 0;
+}
+
+static int ip_rcv(struct pkt_buf *pkt)
+{
+	struct net_device *dev = pkt->dev;
+	struct iphdr *iph = (struct iphdr *)pkt->data;
+	const struct net_protocol *prot;
+	unsigned int hlen, len;
+
+	if (pkt->len < sizeof(*iph))
+		goto hdr_error;
+	hlen = iph->ihl * 4;
+	len = ntohs(iph->tot_len);
+	if (iph->version != 4 || hlen < sizeof(*iph) ||
+	    len < hlen || len > pkt->len || ip_fast_csum(iph, iph->ihl))
+		goto hdr_error;
+
+	if (!dev->ip_addr || iph->daddr != dev->ip_addr ||
+	    ntohs(iph->frag_off) & (IP_MF | IP_OFFSET))
+		goto drop;
+
+	pkt_trim(pkt, len);
+	pkt->network_header = (u8 *)iph;
+	pkt_pull(pkt, hlen);
+
+	prot = inet_protos[iph->protocol];
+	if (!prot) {
+		ip_noproto++;
+		goto drop;
+	}
+	return prot->handler(pkt);
+
+hdr_error:
+	ip_hdr_errors++;
+drop:
+	pkt_free(pkt);
+	return 0;
+}
+
+int ip_reply(struct pkt_buf *pkt)
+{
+	struct iphdr *iph = ip_hdr(pkt);
+	__be32 daddr = iph->saddr;
+
+	pkt_push(pkt, pkt->data - pkt->network_header);
+	iph->saddr = iph->daddr;
+	iph->daddr = daddr;
+	iph->ttl = IPDEFTTL;
+	iph->check = 0;
+	iph->check = ip_fast_csum(iph, iph->ihl);
+
+	eth_reply(pkt);
+	return dev_queue_xmit(pkt);
+}
+
+static int in_aton(const char *s, __be32 *addr)
+{
+	unsigned long long v;
+	u32 a = 0;
+	char *end;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		v = simple_strtoull(s, &end, 10);
+		if (end == s || v > 255 || (i < 3 && *end != '.'))
+			return -1;
+		a = a << 8 | v;
+		s = end + 1;
+	}
+	*addr = htonl(a);
+	return 0;
+}
+
+void ip_dev_config(struct net_device *dev)
+{
+	static bool configured;
+	char opt[20];
+	u32 a;
+
+	if (configured || cmdline_get("ip", opt, sizeof(opt)))
+		return;
+	configured = true;
+	if (in_aton(opt, &dev->ip_addr)) {
+		pr_warn("bad address ip=%s\n", opt);
+		return;
+	}
+	a = ntohl(dev->ip_addr);
+	pr_info("%s: %u.%u.%u.%u\n", dev->name, a >> 24, (a >> 16) & 0xff,
+		(a >> 8) & 0xff, a & 0xff);
+}
+
+static struct packet_type ip_packet_type = {
+	.type	= ETH_P_IP,
+	.func	= ip_rcv,
+};
+
+static const struct net_protocol icmp_protocol = {
+	.handler = icmp_rcv,
+};
+
+void ip_init(void)
+{
+	inet_add_protocol(&icmp_protocol, IPPROTO_ICMP);
+	dev_add_pack(&ip_packet_type);
+}
@@ -0,0 +1,540 @@
+/*
+ * profile - symbolize the kernel's profiler samples from a console log.
+ *
+ *   profile [-n lines] [-f folded] [-s svg] zhos.elf [log]
+ *
+ * Reads the log (stdin by default), picks the profiler's records out of
+ * the last trace dump and resolves the addresses against the symbol
+ * table of the kernel image.  Prints a flat profile, one line per
+ * function with the share of samples it was running in (self) and on the
+ * stack for (total), by self time; -n limits it to that many lines, 0 for
+ * all.
+ *
+ * -f writes the call chains in the folded format flamegraph.pl reads,
+ * "outermost;...;innermost count", one line per distinct chain; -s draws
+ * a flame graph of them as SVG, outermost frames at the bottom and the
+ * width of a frame its share of the samples.
+ */
+#include <elf.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zhos/trace_event.h>
+
+#define MAX_FRAMES	64
+
+struct symbol {
+	unsigned long long addr, size;
+	const char *name;
+	int func;			/* STT_FUNC rather than an asm label */
+	unsigned long long self, total;
+	size_t seen;			/* last sample counted in total */
+};
+
+struct sample {
+	unsigned long long ts;
+	unsigned int nr;		/* frames[0] is where it was running */
+	struct symbol *frames[MAX_FRAMES];
+};
+
+/* A node of the call tree; the children are the functions it called. */
+struct node {
+	struct symbol *sym;
+	unsigned long long total, self;
+	struct node *child, *next;
+};
+
+static struct symbol *syms;
+static size_t nr_syms;
+static struct symbol unknown_sym = { .name = "[unknown]" };
+
+static struct sample *samples;
+static size_t nr_samples, max_samples;
+static unsigned int nr_cpus;
+
+static struct node root = { .sym = &(struct symbol){ .name = "all" } };
+
+static void *xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p) {
+		perror("profile");
+		exit(1);
+	}
+	return p;
+}
+
+static void *xcalloc(size_t nmemb, size_t size)
+{
+	void *p = calloc(nmemb, size);
+
+	if (!p) {
+		perror("profile");
+		exit(1);
+	}
+	return p;
+}
+
+static void *read_file(const char *path, size_t *len)
+{
+	FILE *f = fopen(path, "rb");
+	char *buf;
+	long n;
+
+	if (!f)
+		return NULL;
+	if (fseek(f, 0, SEEK_END) || (n = ftell(f)) < 0 ||
+	    fseek(f, 0, SEEK_SET)) {
+		fclose(f);
+		return NULL;
+	}
+	buf = xrealloc(NULL, n ? n : 1);
+	if (fread(buf, 1, n, f) != (size_t)n) {
+		fclose(f);
+		free(buf);
+		errno = EIO;
+		return NULL;
+	}
+	fclose(f);
+	*len = n;
+	return buf;
+}
+
+static int cmp_symbol(const void *x, const void *y)
+{
+	const struct symbol *a = x, *b = y;
+
+	if (a->addr != b->addr)
+		return a->addr < b->addr ? -1 : 1;
+	return b->func - a->func;
+}
+
+/* Text symbols of the image; the names point into the file, kept loaded. */
+static int load_symbols(const char *path)
+{
+	const Elf64_Shdr *sh, *strtab;
+	const Elf64_Ehdr *eh;
+	const Elf64_Sym *sym;
+	size_t len, i, j, n;
+	char *buf;
+
+	buf = read_file(path, &len);
+	if (!buf)
+		return -errno;
+
+	eh = (const Elf64_Ehdr *)buf;
+	if (len < sizeof(*eh) || memcmp(eh->e_ident, ELFMAG, SELFMAG) ||
+	    eh->e_ident[EI_CLASS] != ELFCLASS64 ||
+	    eh->e_shoff + (unsigned long long)eh->e_shnum * sizeof(*sh) > len)
+		return -ENOEXEC;
+	sh = (const Elf64_Shdr *)(buf + eh->e_shoff);
+
+	for (i = 0; i < eh->e_shnum; i++) {
+		if (sh[i].sh_type != SHT_SYMTAB || sh[i].sh_link >= eh->e_shnum)
+			continue;
+		strtab = &sh[sh[i].sh_link];
+		if (sh[i].sh_offset + sh[i].sh_size > len ||
+		    strtab->sh_offset + strtab->sh_size > len)
+			return -ENOEXEC;
+
+		sym = (const Elf64_Sym *)(buf + sh[i].sh_offset);
+		n = sh[i].sh_size / sizeof(*sym);
+		syms = xrealloc(syms, (nr_syms + n) * sizeof(*syms));
+		for (j = 0; j < n; j++, sym++) {
+			unsigned int type = ELF64_ST_TYPE(sym->st_info);
+
+			if (type != STT_FUNC && type != STT_NOTYPE)
+				continue;
+			if (!sym->st_name || sym->st_name >= strtab->sh_size ||
+			    sym->st_shndx == SHN_UNDEF ||
+			    sym->st_shndx >= eh->e_shnum ||
+			    !(sh[sym->st_shndx].sh_flags & SHF_EXECINSTR))
+				continue;
+			syms[nr_syms++] = (struct symbol){
+				.addr = sym->st_value,
+				.size = sym->st_size,
+				.name = buf + strtab->sh_offset + sym->st_name,
+				.func = type == STT_FUNC,
+			};
+		}
+	}
+	if (!nr_syms)
+		return -ENOENT;
+
+	/* One symbol per address, functions over labels. */
+	qsort(syms, nr_syms, sizeof(*syms), cmp_symbol);
+	for (i = 1, n = 1; i < nr_syms; i++)
+		if (syms[i].addr != syms[n - 1].addr)
+			syms[n++] = syms[i];
+	nr_syms = n;
+
+	/* A label runs up to the next symbol. */
+	for (i = 0; i < nr_syms; i++)
+		if (!syms[i].size && i + 1 < nr_syms)
+			syms[i].size = syms[i + 1].addr - syms[i].addr;
+	return 0;
+}
+
+static struct symbol *lookup(unsigned long long addr)
+{
+	size_t lo = 0, hi = nr_syms, mid;
+
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (syms[mid].addr <= addr)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	if (addr >= syms[lo].addr && addr - syms[lo].addr < syms[lo].size)
+		return &syms[lo];
+	return &unknown_sym;
+}
+
+static void add_sample(const struct sample *s)
+{
+	if (nr_samples == max_samples) {
+		max_samples = max_samples ? 2 * max_samples : 4096;
+		samples = xrealloc(samples, max_samples * sizeof(*samples));
+	}
+	samples[nr_samples++] = *s;
+}
+
+/*
+ * A sample's stack records follow it directly in its CPU's ring, and the
+ * dump lists each CPU's ring in order, so they follow it in the log.  A
+ * sample cut short, by the ring wrapping or by the end of a CPU's
+ * records, is dropped.  Return addresses are looked up one byte back, in
+ * the call instruction, which a call at the very end of a function needs.
+ */
+static int read_dump(FILE *f)
+{
+	unsigned long long ts, a, b, written;
+	unsigned int type, cpu, pid, want = 0;
+	char line[256], *s;
+	struct sample cur;
+	int in_dump = 0, dumps = 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		s = strstr(line, TRACE_DUMP_BEGIN);
+		if (s && sscanf(s + strlen(TRACE_DUMP_BEGIN), "%u",
+				&nr_cpus) == 1) {
+			/* Only the last dump in the log counts. */
+			nr_samples = 0;
+			want = 0;
+			in_dump = 1;
+			dumps++;
+			continue;
+		}
+		if (!in_dump)
+			continue;
+		if (strstr(line, TRACE_DUMP_END)) {
+			in_dump = 0;
+			continue;
+		}
+		if (sscanf(line, "C %u %llu", &cpu, &written) == 2) {
+			want = 0;
+			continue;
+		}
+		if (sscanf(line, "T %llx %x %x %x %llx %llx",
+			   &ts, &type, &cpu, &pid, &a, &b) != 6)
+			continue;
+
+		if (type == TRACE_PROFILE_SAMPLE) {
+			want = b < MAX_FRAMES ? b : MAX_FRAMES - 1;
+			cur.ts = ts;
+			cur.nr = 1;
+			cur.frames[0] = lookup(a);
+		} else if (type == TRACE_PROFILE_STACK && want) {
+			cur.frames[cur.nr++] = lookup(a - 1);
+			if (--want && b) {
+				cur.frames[cur.nr++] = lookup(b - 1);
+				want--;
+			}
+		} else {
+			continue;
+		}
+		if (!want)
+			add_sample(&cur);
+	}
+	return dumps ? 0 : -ENOENT;
+}
+
+static void build_tree(void)
+{
+	struct node *n, **pos;
+	size_t i;
+	int j;
+
+	for (i = 0; i < nr_samples; i++) {
+		n = &root;
+		n->total++;
+		for (j = samples[i].nr - 1; j >= 0; j--) {
+			for (pos = &n->child; *pos; pos = &(*pos)->next)
+				if ((*pos)->sym == samples[i].frames[j])
+					break;
+			if (!*pos) {
+				*pos = xcalloc(1, sizeof(**pos));
+				(*pos)->sym = samples[i].frames[j];
+			}
+			n = *pos;
+			n->total++;
+		}
+		n->self++;
+	}
+}
+
+static int cmp_flat(const void *x, const void *y)
+{
+	const struct symbol *a = *(struct symbol *const *)x;
+	const struct symbol *b = *(struct symbol *const *)y;
+
+	if (a->self != b->self)
+		return a->self > b->self ? -1 : 1;
+	if (a->total != b->total)
+		return a->total > b->total ? -1 : 1;
+	return strcmp(a->name, b->name);
+}
+
+static void print_flat(size_t lines)
+{
+	unsigned long long first = ~0ULL, last = 0;
+	struct symbol **order, *sym;
+	size_t i, n = 0;
+	unsigned int j;
+
+	order = xcalloc(nr_syms + 1, sizeof(*order));
+	for (i = 0; i < nr_samples; i++) {
+		if (samples[i].ts < first)
+			first = samples[i].ts;
+		if (samples[i].ts > last)
+			last = samples[i].ts;
+		samples[i].frames[0]->self++;
+		/* Recursion puts a function on the stack once, not twice. */
+		for (j = 0; j < samples[i].nr; j++) {
+			sym = samples[i].frames[j];
+			if (sym->seen != i + 1) {
+				sym->seen = i + 1;
+				if (!sym->total++)
+					order[n++] = sym;
+			}
+		}
+	}
+	qsort(order, n, sizeof(*order), cmp_flat);
+
+	printf("%zu samples on %u cpus over %.3f s\n\n", nr_samples, nr_cpus,
+	       (last - first) / 1e9);
+	printf("  self%%  total%%     self    total  function\n");
+	for (i = 0; i < n && (!lines || i < lines); i++)
+		printf("%6.2f%% %6.2f%% %8llu %8llu  %s\n",
+		       100.0 * order[i]->self / nr_samples,
+		       100.0 * order[i]->total / nr_samples,
+		       order[i]->self, order[i]->total, order[i]->name);
+	free(order);
+}
+
+static void write_folded(FILE *f, const struct node *n,
+			 const struct node **path, unsigned int depth)
+{
+	const struct node *c;
+	unsigned int i;
+
+	if (n != &root)
+		path[depth++] = n;
+	if (n->self) {
+		for (i = 0; i < depth; i++)
+			fprintf(f, "%s%s", i ? ";" : "", path[i]->sym->name);
+		fprintf(f, " %llu\n", n->self);
+	}
+	for (c = n->child; c; c = c->next)
+		write_folded(f, c, path, depth);
+}
+
+#define SVG_WIDTH	1200
+#define SVG_FRAME	16
+#define SVG_TOP		32
+#define SVG_CHAR	7		/* average glyph width at 12px */
+
+static unsigned int tree_depth(const struct node *n)
+{
+	unsigned int d, max = 0;
+	const struct node *c;
+
+	for (c = n->child; c; c = c->next)
+		if ((d = tree_depth(c)) > max)
+			max = d;
+	return max + 1;
+}
+
+static void svg_text(FILE *f, const char *s, size_t max)
+{
+	size_t len = strlen(s), i;
+
+	if (len > max)
+		len = max >= 2 ? max - 2 : 0;
+	for (i = 0; i < len; i++) {
+		switch (s[i]) {
+		case '&':
+			fputs("&amp;", f);
+			break;
+		case '<':
+			fputs("&lt;", f);
+			break;
+		case '>':
+			fputs("&gt;", f);
+			break;
+		default:
+			fputc(s[i], f);
+			break;
+		}
+	}
+	if (len < strlen(s))
+		fputs("..", f);
+}
+
+/* Warm colours, fixed per name so that a function looks the same twice. */
+static unsigned int name_hash(const char *s)
+{
+	unsigned int h = 2166136261u;
+
+	while (*s)
+		h = (h ^ (unsigned char)*s++) * 16777619u;
+	return h;
+}
+
+static void svg_node(FILE *f, const struct node *n, double x,
+		     unsigned int depth, unsigned int max_depth)
+{
+	double scale = (double)(SVG_WIDTH - 20) / root.total;
+	double w = n->total * scale, y;
+	const struct node *c;
+	unsigned int h;
+
+	if (w < 0.1)
+		return;
+	y = SVG_TOP + (double)(max_depth - depth - 1) * SVG_FRAME;
+	h = name_hash(n->sym->name);
+
+	fprintf(f, "<g><title>");
+	svg_text(f, n->sym->name, ~(size_t)0);
+	fprintf(f, " (%llu samples, %.2f%%)</title>", n->total,
+		100.0 * n->total / root.total);
+	fprintf(f, "<rect x=\"%.1f\" y=\"%.1f\" width=\"%.1f\" height=\"%d\" "
+		"fill=\"rgb(%u,%u,%u)\" rx=\"2\"/>", x, y, w, SVG_FRAME - 1,
+		205 + h % 50, (h >> 8) % 230, (h >> 16) % 55);
+	if (w >= 3 * SVG_CHAR) {
+		fprintf(f, "<text x=\"%.1f\" y=\"%.1f\">", x + 3,
+			y + SVG_FRAME - 4);
+		svg_text(f, n->sym->name, (size_t)((w - 6) / SVG_CHAR));
+		fprintf(f, "</text>");
+	}
+	fprintf(f, "</g>\n");
+
+	for (c = n->child; c; c = c->next) {
+		svg_node(f, c, x, depth + 1, max_depth);
+		x += c->total * scale;
+	}
+}
+
+static void write_svg(FILE *f)
+{
+	unsigned int depth = tree_depth(&root);
+	unsigned int height = SVG_TOP + depth * SVG_FRAME + 8;
+
+	fprintf(f, "<?xml version=\"1.0\" standalone=\"no\"?>\n"
+		"<svg version=\"1.1\" width=\"%d\" height=\"%u\" "
+		"xmlns=\"http://www.w3.org/2000/svg\" "
+		"font-family=\"monospace\" font-size=\"12\">\n",
+		SVG_WIDTH, height);
+	fprintf(f, "<rect width=\"100%%\" height=\"100%%\" fill=\"#f8f8f0\"/>\n"
+		"<text x=\"%d\" y=\"20\" text-anchor=\"middle\" "
+		"font-size=\"16\">zhos kernel, %zu samples</text>\n",
+		SVG_WIDTH / 2, nr_samples);
+	svg_node(f, &root, 10, 0, depth);
+	fprintf(f, "</svg>\n");
+}
+
+static FILE *open_output(const char *path)
+{
+	FILE *f = fopen(path, "w");
+
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	return f;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-n lines] [-f folded] [-s svg] "
+		"zhos.elf [log]\n", prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *folded = NULL, *svg = NULL;
+	const struct node **path;
+	size_t lines = 50;
+	FILE *f = stdin, *out;
+	int i, ret;
+
+	for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++) {
+		if (i + 1 == argc || argv[i][2])
+			usage(argv[0]);
+		switch (argv[i][1]) {
+		case 'n':
+			lines = strtoul(argv[++i], NULL, 0);
+			break;
+		case 'f':
+			folded = argv[++i];
+			break;
+		case 's':
+			svg = argv[++i];
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (argc - i < 1 || argc - i > 2)
+		usage(argv[0]);
+
+	ret = load_symbols(argv[i]);
+	if (ret) {
+		fprintf(stderr, "profile: %s: %s\n", argv[i], strerror(-ret));
+		return 1;
+	}
+	if (argc - i == 2 && !(f = fopen(argv[i + 1], "r"))) {
+		perror(argv[i + 1]);
+		return 1;
+	}
+
+	if (read_dump(f)) {
+		fprintf(stderr, "profile: no trace dump found\n");
+		return 1;
+	}
+	if (!nr_samples) {
+		fprintf(stderr, "profile: no samples in the trace dump\n");
+		return 1;
+	}
+
+	build_tree();
+	print_flat(lines);
+
+	if (folded) {
+		path = xcalloc(tree_depth(&root), sizeof(*path));
+		out = open_output(folded);
+		write_folded(out, &root, path, 0);
+		fclose(out);
+		free(path);
+	}
+	if (svg) {
+		out = open_output(svg);
+		write_svg(out);
+		fclose(out);
+	}
+	return 0;
+}
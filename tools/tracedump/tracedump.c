@@ -0,0 +1,191 @@
+/*
+ * tracedump - decode a kernel trace dump from a console log.
+ *
+ *   tracedump [log]
+ *
+ * Reads the log (stdin by default), picks out the records between the
+ * "trace: begin" and "trace: end" lines of the last dump, merges the
+ * CPUs by timestamp and prints one line per event:
+ *
+ *   seconds.nanoseconds cpu pid event arguments
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zhos/trace_event.h>
+
+static const char *const event_names[NR_TRACE_EVENTS] = {
+	[TRACE_NONE]		= "none",
+	[TRACE_SCHED_SWITCH]	= "sched_switch",
+	[TRACE_SCHED_WAKEUP]	= "sched_wakeup",
+	[TRACE_SCHED_MIGRATE]	= "sched_migrate",
+	[TRACE_IRQ_ENTRY]	= "irq_entry",
+	[TRACE_IRQ_EXIT]	= "irq_exit",
+	[TRACE_SYS_ENTER]	= "sys_enter",
+	[TRACE_SYS_EXIT]	= "sys_exit",
+	[TRACE_MARK]		= "mark",
+	[TRACE_PROFILE_SAMPLE]	= "profile",
+	[TRACE_PROFILE_STACK]	= "profile_stack",
+};
+
+static struct trace_entry *entries;
+static size_t nr_entries, max_entries;
+static unsigned long long written_total;
+
+static void add_entry(const struct trace_entry *e)
+{
+	if (nr_entries == max_entries) {
+		max_entries = max_entries ? 2 * max_entries : 4096;
+		entries = realloc(entries, max_entries * sizeof(*entries));
+		if (!entries) {
+			perror("tracedump");
+			exit(1);
+		}
+	}
+	entries[nr_entries++] = *e;
+}
+
+static int parse_record(const char *line, struct trace_entry *e)
+{
+	unsigned long long ts, a, b;
+	unsigned int type, cpu, pid;
+
+	if (sscanf(line, "T %llx %x %x %x %llx %llx",
+		   &ts, &type, &cpu, &pid, &a, &b) != 6)
+		return -1;
+	e->ts = ts;
+	e->type = type;
+	e->cpu = cpu;
+	e->pid = pid;
+	e->a = a;
+	e->b = b;
+	return 0;
+}
+
+/* Mixed-in console output from other CPUs is skipped, not fatal. */
+static int read_dump(FILE *f)
+{
+	char line[256], *s;
+	unsigned long long written;
+	unsigned int cpu, nr_cpus;
+	struct trace_entry e;
+	int in_dump = 0, dumps = 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		s = strstr(line, TRACE_DUMP_BEGIN);
+		if (s && sscanf(s + strlen(TRACE_DUMP_BEGIN), "%u", &nr_cpus) == 1) {
+			/* Only the last dump in the log counts. */
+			nr_entries = 0;
+			written_total = 0;
+			in_dump = 1;
+			dumps++;
+			continue;
+		}
+		if (!in_dump)
+			continue;
+		if (strstr(line, TRACE_DUMP_END)) {
+			in_dump = 0;
+			continue;
+		}
+		if (sscanf(line, "C %u %llu", &cpu, &written) == 2) {
+			written_total += written;
+			continue;
+		}
+		if (!parse_record(line, &e))
+			add_entry(&e);
+	}
+	return dumps ? 0 : -ENOENT;
+}
+
+static int cmp_entry(const void *x, const void *y)
+{
+	const struct trace_entry *a = x, *b = y;
+
+	if (a->ts != b->ts)
+		return a->ts < b->ts ? -1 : 1;
+	return (int)a->cpu - (int)b->cpu;
+}
+
+static const char *task_state(unsigned int state)
+{
+	switch (state) {
+	case 0:
+		return "R";
+	case 1:
+		return "S";
+	case 2:
+		return "D";
+	case 64:
+		return "X";
+	default:
+		return "?";
+	}
+}
+
+static void print_entry(const struct trace_entry *e)
+{
+	const char *name = e->type < NR_TRACE_EVENTS ? event_names[e->type] : NULL;
+
+	printf("%6llu.%09llu %3u %5u %-13s ",
+	       (unsigned long long)(e->ts / 1000000000),
+	       (unsigned long long)(e->ts % 1000000000),
+	       e->cpu, e->pid, name ? name : "?");
+
+	switch (e->type) {
+	case TRACE_SCHED_SWITCH:
+		printf("%u %s -> %llu\n", (unsigned int)e->a,
+		       task_state(e->a >> 32), (unsigned long long)e->b);
+		break;
+	case TRACE_SCHED_WAKEUP:
+	case TRACE_SCHED_MIGRATE:
+		printf("pid %llu cpu %llu\n", (unsigned long long)e->a,
+		       (unsigned long long)e->b);
+		break;
+	case TRACE_IRQ_ENTRY:
+	case TRACE_IRQ_EXIT:
+		printf("vec %llu\n", (unsigned long long)e->a);
+		break;
+	case TRACE_SYS_ENTER:
+		printf("nr %llu arg 0x%llx\n", (unsigned long long)e->a,
+		       (unsigned long long)e->b);
+		break;
+	case TRACE_SYS_EXIT:
+		printf("nr %llu ret %lld\n", (unsigned long long)e->a,
+		       (long long)e->b);
+		break;
+	default:
+		printf("0x%llx 0x%llx\n", (unsigned long long)e->a,
+		       (unsigned long long)e->b);
+		break;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	FILE *f = stdin;
+	size_t i;
+
+	if (argc > 2) {
+		fprintf(stderr, "usage: %s [log]\n", argv[0]);
+		return 2;
+	}
+	if (argc == 2 && !(f = fopen(argv[1], "r"))) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	if (read_dump(f)) {
+		fprintf(stderr, "tracedump: no trace dump found\n");
+		return 1;
+	}
+
+	qsort(entries, nr_entries, sizeof(*entries), cmp_entry);
+	for (i = 0; i < nr_entries; i++)
+		print_entry(&entries[i]);
+	if (written_total > nr_entries)
+		fprintf(stderr, "tracedump: %llu older records overwritten\n",
+			written_total - nr_entries);
+	return 0;
+}